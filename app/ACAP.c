@@ -26,6 +26,7 @@
 #include <gio/gio.h>
 #include <axsdk/axevent.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include "ACAP.h"
 
 // Logging macros
@@ -51,6 +52,10 @@ static void ACAP_ENDPOINT_settings(const ACAP_HTTP_Response response, const ACAP
 static void ACAP_ENDPOINT_app(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request);
 static char ACAP_package_name[ACAP_MAX_PACKAGE_NAME];
 static ACAP_Config_Update ACAP_UpdateCallback = NULL;
+static pthread_mutex_t config_mutex;
+extern pthread_mutex_t status_mutex;
+static pthread_once_t config_mutex_once = PTHREAD_ONCE_INIT;
+static int http_workers = ACAP_HTTP_WORKERS;
 cJSON* SplitString(const char* input, const char* delimiter);
 
 
@@ -113,6 +118,10 @@ cJSON* ACAP(const char* package, ACAP_Config_Update callback) {
 
     cJSON_AddItemToObject(app, "settings", settings);
 
+    cJSON* workers = cJSON_GetObjectItem(settings, "httpWorkers");
+    if (workers && cJSON_IsNumber(workers) && workers->valueint > 0)
+        http_workers = workers->valueint > ACAP_HTTP_MAX_WORKERS ? ACAP_HTTP_MAX_WORKERS : workers->valueint;
+
     // Initialize subsystems
 	ACAP_VAPIX_Init();
     ACAP_EVENTS();
@@ -150,8 +159,21 @@ ACAP_ENDPOINT_app(const ACAP_HTTP_Response response, const ACAP_HTTP_Request req
         ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Use GET");
         return;
     }
-	
-    ACAP_HTTP_Respond_JSON(response, app);
+
+    // Print under the locks, write without them; app includes the status tree
+    ACAP_Config_Lock();
+    pthread_mutex_lock(&status_mutex);
+    char* json = cJSON_PrintUnformatted(app);
+    pthread_mutex_unlock(&status_mutex);
+    ACAP_Config_Unlock();
+
+    if (!json) {
+        ACAP_HTTP_Respond_Error(response, 500, "Memory allocation failed");
+        return;
+    }
+    ACAP_HTTP_Header_JSON(response);
+    ACAP_HTTP_Respond_Data(response, strlen(json), json);
+    free(json);
 }
 
 static void
@@ -165,7 +187,9 @@ ACAP_ENDPOINT_settings(const ACAP_HTTP_Response response, const ACAP_HTTP_Reques
 
     // Handle GET request - return current settings
     if (strcmp(method, "GET") == 0) {
+        ACAP_Config_Lock();
         ACAP_HTTP_Respond_JSON(response, cJSON_GetObjectItem(app, "settings"));
+        ACAP_Config_Unlock();
         return;
     }
 
@@ -193,7 +217,8 @@ ACAP_ENDPOINT_settings(const ACAP_HTTP_Response response, const ACAP_HTTP_Reques
 
         LOG_TRACE("%s: %s\n", __func__, request->postData);
 
-        // Update settings
+        // Update settings; one update at a time, and never while another worker prints them
+        ACAP_Config_Lock();
         cJSON* settings = cJSON_GetObjectItem(app, "settings");
         cJSON* param = params->child;
         while (param) {
@@ -213,6 +238,7 @@ ACAP_ENDPOINT_settings(const ACAP_HTTP_Response response, const ACAP_HTTP_Reques
         if (ACAP_UpdateCallback) {
             ACAP_UpdateCallback("settings", settings);
         }
+        ACAP_Config_Unlock();
 
         ACAP_HTTP_Respond_Text(response, "Settings updated successfully");
         return;
@@ -227,9 +253,27 @@ const char* ACAP_Name(void) {
 }
  
 
+static void config_mutex_init(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&config_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void ACAP_Config_Lock(void) {
+    pthread_once(&config_mutex_once, config_mutex_init);
+    pthread_mutex_lock(&config_mutex);
+}
+
+void ACAP_Config_Unlock(void) {
+    pthread_mutex_unlock(&config_mutex);
+}
+
 int
 ACAP_Set_Config(const char* service, cJSON* serviceSettings ) {
 	LOG_TRACE("%s: %s\n",__func__,service);
+	ACAP_Config_Lock();
 	cJSON* existing = cJSON_GetObjectItem(app, service);
 	if (existing) {
 		LOG_TRACE("%s: %s already exists, replacing\n",__func__,service);
@@ -237,6 +281,7 @@ ACAP_Set_Config(const char* service, cJSON* serviceSettings ) {
 	} else {
 		cJSON_AddItemToObject(app, service, serviceSettings);
 	}
+	ACAP_Config_Unlock();
 	return 1;
 }
 
@@ -254,16 +299,24 @@ ACAP_Get_Config(const char* service) {
  * HTTP Request Processing Implementation
  *------------------------------------------------------------------*/
 
-static pthread_t http_thread;
-static int http_thread_running = 0; // Flag to track thread state
+static pthread_t http_threads[ACAP_HTTP_MAX_WORKERS];
+static int http_thread_count = 0;
+static volatile int http_thread_running = 0; // Flag to track thread state
 static pthread_mutex_t http_nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Workers take turns in FCGX_Accept_r on the shared socket
+static pthread_mutex_t http_accept_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 typedef struct {
     char path[ACAP_MAX_PATH_LENGTH];
     ACAP_HTTP_Callback callback;
 } HTTPNode;
 
-// Thread function for FastCGI processing
+static void unlock_accept(void* arg) {
+    (void)arg;
+    pthread_mutex_unlock(&http_accept_mutex);
+}
+
+// Worker thread; each handles one request at a time
 void* fastcgi_thread_func(void* arg) {
     while (http_thread_running) {
         ACAP_HTTP_Process(); // Process FastCGI requests
@@ -278,8 +331,7 @@ static HTTPNode http_nodes[ACAP_MAX_HTTP_NODES];
 static int http_node_count = 0;
 
 
-static const char* get_path_without_query(const char* uri) {
-    static char path[ACAP_MAX_PATH_LENGTH];
+static const char* get_path_without_query(const char* uri, char* path) {
     const char* query = strchr(uri, '?');
     
     if (query) {
@@ -301,15 +353,38 @@ int ACAP_HTTP() {
             LOG_WARN("Failed to initialize FCGI\n");
             return 0;
         }
+
+        // Open the socket once; all workers accept on it
+        const char* socket_path = getenv("FCGI_SOCKET_NAME");
+        if (!socket_path) {
+            LOG_WARN("Failed to get FCGI_SOCKET_NAME\n");
+            return 0;
+        }
+        fcgi_sock = FCGX_OpenSocket(socket_path, 5 + http_workers);
+        if (fcgi_sock < 0) {
+            LOG_WARN("Failed to open FCGI socket\n");
+            return 0;
+        }
+        chmod(socket_path, 0777);
         initialized = 1;
 
-        // Start the FastCGI thread
+        // Start the FastCGI workers
         http_thread_running = 1;
-        if (pthread_create(&http_thread, NULL, fastcgi_thread_func, NULL) != 0) {
-            LOG_WARN("Failed to create FastCGI thread\n");
+        for (int i = 0; i < http_workers; i++) {
+            if (pthread_create(&http_threads[http_thread_count], NULL, fastcgi_thread_func, NULL) != 0) {
+                LOG_WARN("Failed to create FastCGI thread %d\n", i);
+                break;
+            }
+            http_thread_count++;
+        }
+        if (!http_thread_count) {
+            http_thread_running = 0;
+            close(fcgi_sock);
+            fcgi_sock = -1;
             initialized = 0; // Roll back initialization
             return 0;
         }
+        LOG_TRACE("%s: %d FastCGI workers\n", __func__, http_thread_count);
     }
     return 1;
 }
@@ -326,11 +401,14 @@ void ACAP_HTTP_Cleanup() {
         fcgi_sock = -1;
     }
 
-    // Stop the FastCGI thread
+    // Stop the FastCGI workers
     if (http_thread_running) {
-        http_thread_running = 0; // Signal the thread to stop
-		pthread_cancel(http_thread); // Request cancellation
-        pthread_join(http_thread, NULL); // Wait for the thread to finish
+        http_thread_running = 0; // Signal the workers to stop
+        for (int i = 0; i < http_thread_count; i++)
+            pthread_cancel(http_threads[i]); // Request cancellation
+        for (int i = 0; i < http_thread_count; i++)
+            pthread_join(http_threads[i], NULL); // Wait for the workers to finish
+        http_thread_count = 0;
     }
     initialized = 0;
 }
@@ -396,46 +474,42 @@ int ACAP_HTTP_Node(const char *nodename, ACAP_HTTP_Callback callback) {
 
 
 void ACAP_HTTP_Process() {
-	FCGX_Request request;
+	FCGX_Request* request;
     ACAP_HTTP_Request_DATA requestData = {0};
-    char* socket_path = NULL;
+    char path[ACAP_MAX_PATH_LENGTH];
+    int accepted;
 
-    if (!initialized)
+    if (!initialized || fcgi_sock < 0)
 		return;
 
-    // Get socket path
-    socket_path = getenv("FCGI_SOCKET_NAME");
-    if (!socket_path) {
-        LOG_WARN("Failed to get FCGI_SOCKET_NAME\n");
+    // Initialize request; allocated so that a callback can detach it
+    request = malloc(sizeof(FCGX_Request));
+    if (!request) {
+        LOG_WARN("%s: Memory allocation failed\n", __func__);
         return;
     }
-
-    // Open socket if not already open
-    if (fcgi_sock == -1) {
-        fcgi_sock = FCGX_OpenSocket(socket_path, 5);
-        if (fcgi_sock < 0) {
-            LOG_WARN("Failed to open FCGI socket\n");
-            return;
-        }
-        chmod(socket_path, 0777);
-    }
-
-    // Initialize request
-    if (FCGX_InitRequest(&request, fcgi_sock, 0) != 0) {
+    if (FCGX_InitRequest(request, fcgi_sock, 0) != 0) {
         LOG_WARN("FCGX_InitRequest failed\n");
+        free(request);
         return;
     }
 
     // Accept the request
-    if (FCGX_Accept_r(&request) != 0) {
-        FCGX_Free(&request, 1);
+    // Released by the cleanup handler if the worker is cancelled in accept
+    pthread_mutex_lock(&http_accept_mutex);
+    pthread_cleanup_push(unlock_accept, NULL);
+    accepted = FCGX_Accept_r(request);
+    pthread_cleanup_pop(1);
+    if (accepted != 0) {
+        FCGX_Free(request, 1);
+        free(request);
         return;
     }
 
     // Setup request data structure
-    requestData.request = &request;
-    requestData.method = FCGX_GetParam("REQUEST_METHOD", request.envp);
-    requestData.contentType = FCGX_GetParam("CONTENT_TYPE", request.envp);
+    requestData.request = request;
+    requestData.method = FCGX_GetParam("REQUEST_METHOD", request->envp);
+    requestData.contentType = FCGX_GetParam("CONTENT_TYPE", request->envp);
     
     // Handle POST data
     if (requestData.method && strcmp(requestData.method, "POST") == 0) {
@@ -443,7 +517,7 @@ void ACAP_HTTP_Process() {
         if (contentLength > 0 && contentLength < ACAP_MAX_BUFFER_SIZE) {
             char* postData = malloc(contentLength + 1);
 				if (postData) {
-					size_t bytesRead = FCGX_GetStr(postData, contentLength, request.in);
+					size_t bytesRead = FCGX_GetStr(postData, contentLength, request->in);
 					if (bytesRead < contentLength) {
 						free(postData);
 						goto cleanup;
@@ -456,39 +530,63 @@ void ACAP_HTTP_Process() {
     }
 
     // Process the request
-    const char* uriString = FCGX_GetParam("REQUEST_URI", request.envp);
+    const char* uriString = FCGX_GetParam("REQUEST_URI", request->envp);
     if (!uriString) {
-        ACAP_HTTP_Respond_Error(&request, 400, "Invalid URI");
+        ACAP_HTTP_Respond_Error(request, 400, "Invalid URI");
         goto cleanup;
     }
 
     //LOG_TRACE("%s: Processing URI: %s\n", __func__, uriString);
 
     // Find and execute matching callback
-    const char* pathOnly = get_path_without_query(uriString);
+    const char* pathOnly = get_path_without_query(uriString, path);
     ACAP_HTTP_Callback matching_callback = NULL;
 
+    pthread_mutex_lock(&http_nodes_mutex);
     for (int i = 0; i < http_node_count; i++) {
         if (strcmp(http_nodes[i].path, pathOnly) == 0) {
             matching_callback = http_nodes[i].callback;
             break;
         }
     }
+    pthread_mutex_unlock(&http_nodes_mutex);
 
     if (matching_callback) {
-        matching_callback(&request, &requestData);
+        matching_callback(request, &requestData);
     } else {
-        ACAP_HTTP_Respond_Error(&request, 404, "Not Found");
+        ACAP_HTTP_Respond_Error(request, 404, "Not Found");
     }
 
 cleanup:
     if (requestData.postData) {
         free((void*)requestData.postData);
     }
-    FCGX_Finish_r(&request);
+    if (!requestData.detached)
+        ACAP_HTTP_Finish(request);
     return;
 }
 
+ACAP_HTTP_Response ACAP_HTTP_Detach(const ACAP_HTTP_Request request) {
+    if (!request || !request->request)
+        return NULL;
+    request->detached = 1;
+    return request->request;
+}
+
+int ACAP_HTTP_Flush(ACAP_HTTP_Response response) {
+    if (!response || !response->out)
+        return 0;
+    // Fails once the client has gone away
+    return FCGX_FFlush(response->out) == 0;
+}
+
+void ACAP_HTTP_Finish(ACAP_HTTP_Response response) {
+    if (!response)
+        return;
+    FCGX_Finish_r(response);
+    free(response);
+}
+
 /*------------------------------------------------------------------
  * HTTP Request Parameter Handling Implementation
  *------------------------------------------------------------------*/
@@ -703,161 +801,259 @@ int ACAP_HTTP_Respond_Text(ACAP_HTTP_Response response, const char* message) {
 
 pthread_mutex_t status_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void ACAP_ENDPOINT_status(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
-																						  
-    const char* method = ACAP_HTTP_Get_Method(request);
-    
-    if (!method || strcmp(method, "GET") != 0) {
-        ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Only GET supported");
-        return;
-    }
-
-    pthread_mutex_lock(&status_mutex);
-
-    if (!status_container)
-        status_container = cJSON_CreateObject();
-
-    ACAP_HTTP_Respond_JSON(response, status_container);
+/*
+ * Setters bump a per-group version. /status prints only the groups that
+ * changed since the last request and keeps the assembled document until
+ * the next change, so polling costs a copy of a cached buffer. Printing
+ * holds status_mutex for the changed groups only; the response is written
+ * with no lock held.
+ */
+typedef struct {
+    atomic_int refs;
+    size_t size;
+    char etag[64];
+    char json[];
+} StatusText;
 
-    pthread_mutex_unlock(&status_mutex);
+typedef struct {
+    char name[ACAP_STATUS_MAX_NAME];
+    unsigned long version;          // Bumped by setters under status_mutex
+    unsigned long printed_version;  // Version of text
+    StatusText* text;               // Owned by status_cache_mutex holders
+} StatusGroup;
+
+static StatusGroup status_groups[ACAP_STATUS_MAX_GROUPS];
+static int status_group_count = 0;
+static atomic_ulong status_version = 1;
+static unsigned long status_epoch = 0;         // Keeps ETags unique across restarts
+static pthread_mutex_t status_cache_mutex = PTHREAD_MUTEX_INITIALIZER;  // Readers only
+static StatusText* status_document = NULL;
+static unsigned long status_document_version = 0;
+static int status_cache_count = 0;             // Groups in the cache, read under status_mutex
+
+static StatusText* status_text_create(size_t size) {
+    StatusText* text = malloc(sizeof(StatusText) + size + 1);
+    if (!text)
+        return NULL;
+    atomic_init(&text->refs, 1);
+    text->size = size;
+    text->etag[0] = '\0';
+    text->json[size] = '\0';
+    return text;
 }
 
-cJSON* ACAP_STATUS(void) {
-    if (!status_container) {
-        status_container = cJSON_CreateObject();
-		ACAP_HTTP_Node("status",ACAP_ENDPOINT_status);
-	}
-    return status_container;
+static void status_text_unref(StatusText* text) {
+    if (text && atomic_fetch_sub(&text->refs, 1) == 1)
+        free(text);
 }
 
-cJSON* ACAP_STATUS_Group(const char* name) {
-    if (!name || !status_container) {
+// Caller holds status_mutex
+static cJSON* status_group(const char* name) {
+    if (!name || !status_container)
         return NULL;
-    }
 
     cJSON* group = cJSON_GetObjectItem(status_container, name);
+    if (group)
+        return group;
+    if (strlen(name) >= ACAP_STATUS_MAX_NAME || status_group_count >= ACAP_STATUS_MAX_GROUPS) {
+        LOG_WARN("Failed to create status group: %s\n", name);
+        return NULL;
+    }
+    group = cJSON_CreateObject();
     if (!group) {
-        group = cJSON_CreateObject();
-        if (!group) {
-            LOG_WARN("Failed to create status group: %s\n", name);
-            return NULL;
-        }
-        cJSON_AddItemToObject(status_container, name, group);
+        LOG_WARN("Failed to create status group: %s\n", name);
+        return NULL;
     }
+    cJSON_AddItemToObject(status_container, name, group);
+    StatusGroup* entry = &status_groups[status_group_count++];
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->version = 1;
+    entry->printed_version = 0;
+    entry->text = NULL;
+    atomic_fetch_add(&status_version, 1);
     return group;
 }
 
+// Caller holds status_mutex
+static StatusGroup* status_group_entry(const char* name) {
+    for (int i = 0; i < status_group_count; i++)
+        if (strcmp(status_groups[i].name, name) == 0)
+            return &status_groups[i];
+    return NULL;
+}
 
-void ACAP_STATUS_SetBool(const char* group, const char* name, int state) {
-    if (!group || !name) {
-        LOG_WARN("%s: Invalid group or name parameter\n", __func__);
+// Takes ownership of value
+static void status_set(const char* group, const char* name, cJSON* value) {
+    if (!group || !name || !value) {
+        LOG_WARN("%s: Invalid parameters\n", __func__);
+        cJSON_Delete(value);
         return;
     }
 
-    cJSON* groupObj = ACAP_STATUS_Group(group);
+    pthread_mutex_lock(&status_mutex);
+    cJSON* groupObj = status_group(group);
     if (!groupObj) {
-		LOG_TRACE("%s: Unknown %s\n",__func__,group);
+        LOG_TRACE("%s: Unknown %s\n", __func__, group);
+        pthread_mutex_unlock(&status_mutex);
+        cJSON_Delete(value);
         return;
     }
+    if (cJSON_GetObjectItem(groupObj, name))
+        cJSON_ReplaceItemInObject(groupObj, name, value);
+    else
+        cJSON_AddItemToObject(groupObj, name, value);
+    StatusGroup* entry = status_group_entry(group);
+    if (entry)
+        entry->version++;
+    atomic_fetch_add(&status_version, 1);
+    pthread_mutex_unlock(&status_mutex);
+}
 
-    pthread_mutex_lock(&status_mutex);
+// Reprint changed groups and reassemble the document; caller holds status_cache_mutex
+static void status_refresh(void) {
+    if (status_document && status_document_version == atomic_load(&status_version))
+        return;
 
-    cJSON* item = cJSON_GetObjectItem(groupObj, name);
-    if (item) {
-        cJSON_ReplaceItemInObject(groupObj, name, cJSON_CreateBool(state));
-    } else {
-        cJSON_AddItemToObject(groupObj, name, cJSON_CreateBool(state));
+    pthread_mutex_lock(&status_mutex);
+    unsigned long version = atomic_load(&status_version);
+    int count = status_group_count;
+    status_cache_count = count;
+    for (int i = 0; i < count; i++) {
+        StatusGroup* entry = &status_groups[i];
+        if (entry->text && entry->printed_version == entry->version)
+            continue;
+        char* json = cJSON_PrintUnformatted(cJSON_GetObjectItem(status_container, entry->name));
+        StatusText* text = json ? status_text_create(strlen(json)) : NULL;
+        if (text) {
+            memcpy(text->json, json, text->size);
+            snprintf(text->etag, sizeof(text->etag), "\"%lx-%s-%lu\"", status_epoch, entry->name, entry->version);
+            status_text_unref(entry->text);
+            entry->text = text;
+            entry->printed_version = entry->version;
+        }
+        free(json);
     }
     pthread_mutex_unlock(&status_mutex);
 
+    // {"group":{...},...} from the printed groups
+    size_t size = 2;
+    for (int i = 0; i < count; i++)
+        if (status_groups[i].text)
+            size += strlen(status_groups[i].name) + 4 + status_groups[i].text->size;
+    StatusText* document = status_text_create(size);
+    if (!document)
+        return;
+    char* out = document->json;
+    *out++ = '{';
+    for (int i = 0; i < count; i++) {
+        StatusGroup* entry = &status_groups[i];
+        if (!entry->text)
+            continue;
+        out += sprintf(out, "%s\"%s\":", out == document->json + 1 ? "" : ",", entry->name);
+        memcpy(out, entry->text->json, entry->text->size);
+        out += entry->text->size;
+    }
+    *out++ = '}';
+    *out = '\0';
+    document->size = out - document->json;
+    snprintf(document->etag, sizeof(document->etag), "\"%lx-%lu\"", status_epoch, version);
+
+    status_text_unref(status_document);
+    status_document = document;
+    status_document_version = version;
 }
 
-void ACAP_STATUS_SetNumber(const char* group, const char* name, double value) {
-    if (!group || !name) {
-        LOG_WARN("Invalid group or name parameter\n");
+static void ACAP_ENDPOINT_status(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    const char* method = ACAP_HTTP_Get_Method(request);
+    
+    if (!method || strcmp(method, "GET") != 0) {
+        ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Only GET supported");
         return;
     }
 
-    cJSON* groupObj = ACAP_STATUS_Group(group);
-    if (!groupObj) {
+    const char* groupName = ACAP_HTTP_Request_Param(request, "group");
+    StatusText* text = NULL;
+
+    pthread_mutex_lock(&status_cache_mutex);
+    status_refresh();
+    if (groupName) {
+        // Only entries that were complete when the cache was refreshed
+        for (int i = 0; i < status_cache_count; i++)
+            if (strcmp(status_groups[i].name, groupName) == 0)
+                text = status_groups[i].text;
+    } else {
+        text = status_document;
+    }
+    if (text)
+        atomic_fetch_add(&text->refs, 1);
+    pthread_mutex_unlock(&status_cache_mutex);
+
+    if (!text) {
+        if (groupName)
+            ACAP_HTTP_Respond_Error(response, 404, "Unknown status group");
+        else
+            ACAP_HTTP_Respond_Error(response, 500, "Status unavailable");
+        free((void*)groupName);
         return;
     }
+    free((void*)groupName);
 
-    pthread_mutex_lock(&status_mutex);
-
-    cJSON* item = cJSON_GetObjectItem(groupObj, name);
-    if (item) {
-        cJSON_ReplaceItemInObject(groupObj, name, cJSON_CreateNumber(value));
+    const char* match = FCGX_GetParam("HTTP_IF_NONE_MATCH", response->envp);
+    if (match && strstr(match, text->etag)) {
+        ACAP_HTTP_Respond_String(response,
+            "Status: 304 Not Modified\r\n"
+            "ETag: %s\r\n"
+            "Cache-Control: no-cache\r\n\r\n", text->etag);
     } else {
-        cJSON_AddItemToObject(groupObj, name, cJSON_CreateNumber(value));
+        ACAP_HTTP_Respond_String(response,
+            "Content-Type: application/json; charset=utf-8\r\n"
+            "Cache-Control: no-cache\r\n"
+            "ETag: %s\r\n"
+            "Content-Length: %zu\r\n\r\n", text->etag, text->size);
+        ACAP_HTTP_Respond_Data(response, text->size, text->json);
     }
-    pthread_mutex_unlock(&status_mutex);
+    status_text_unref(text);
 }
 
-void ACAP_STATUS_SetString(const char* group, const char* name, const char* string) {
-    if (!group || !name || !string) {
-        LOG_WARN("Invalid parameters\n");
-        return;
-    }
-
-    cJSON* groupObj = ACAP_STATUS_Group(group);
-    if (!groupObj) {
-        return;
-    }
+cJSON* ACAP_STATUS(void) {
+    if (!status_container) {
+        status_container = cJSON_CreateObject();
+        status_epoch = (unsigned long)time(NULL);
+		ACAP_HTTP_Node("status",ACAP_ENDPOINT_status);
+	}
+    return status_container;
+}
 
+cJSON* ACAP_STATUS_Group(const char* name) {
     pthread_mutex_lock(&status_mutex);
-
-    cJSON* item = cJSON_GetObjectItem(groupObj, name);
-    if (item) {
-        cJSON_ReplaceItemInObject(groupObj, name, cJSON_CreateString(string));
-    } else {
-        cJSON_AddItemToObject(groupObj, name, cJSON_CreateString(string));
-    }
+    cJSON* group = status_group(name);
     pthread_mutex_unlock(&status_mutex);
+    return group;
 }
 
-void ACAP_STATUS_SetObject(const char* group, const char* name, cJSON* data) {
-    if (!group || !name || !data) {
-        LOG_WARN("Invalid parameters\n");
-        return;
-    }
-
-    cJSON* groupObj = ACAP_STATUS_Group(group);
-    if (!groupObj) {
-        return;
-    }
 
-    pthread_mutex_lock(&status_mutex);
+void ACAP_STATUS_SetBool(const char* group, const char* name, int state) {
+    status_set(group, name, cJSON_CreateBool(state));
+}
 
-    cJSON* item = cJSON_GetObjectItem(groupObj, name);
-    if (item) {
-        cJSON_ReplaceItemInObject(groupObj, name, cJSON_Duplicate(data, 1));
-    } else {
-        cJSON_AddItemToObject(groupObj, name, cJSON_Duplicate(data, 1));
-    }
+void ACAP_STATUS_SetNumber(const char* group, const char* name, double value) {
+    status_set(group, name, cJSON_CreateNumber(value));
+}
 
-    pthread_mutex_unlock(&status_mutex);
+void ACAP_STATUS_SetString(const char* group, const char* name, const char* string) {
+    status_set(group, name, string ? cJSON_CreateString(string) : NULL);
 }
 
-void ACAP_STATUS_SetNull(const char* group, const char* name) {
-    if (!group || !name) {
-        LOG_WARN("Invalid group or name parameter\n");
-        return;
-    }
+void ACAP_STATUS_SetObject(const char* group, const char* name, cJSON* data) {
+    status_set(group, name, data ? cJSON_Duplicate(data, 1) : NULL);
+}
 
-    cJSON* groupObj = ACAP_STATUS_Group(group);
-    if (!groupObj) {
-        return;
-    }
-    pthread_mutex_lock(&status_mutex);
+void ACAP_STATUS_TakeObject(const char* group, const char* name, cJSON* data) {
+    status_set(group, name, data);
+}
 
-    cJSON* item = cJSON_GetObjectItem(groupObj, name);
-    if (item) {
-        cJSON_ReplaceItemInObject(groupObj, name, cJSON_CreateNull());
-    } else {
-        cJSON_AddItemToObject(groupObj, name, cJSON_CreateNull());
-    }
-    pthread_mutex_unlock(&status_mutex);
+void ACAP_STATUS_SetNull(const char* group, const char* name) {
+    status_set(group, name, cJSON_CreateNull());
 }
 
 /*------------------------------------------------------------------
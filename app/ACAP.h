@@ -21,6 +21,10 @@ extern "C" {
 #define ACAP_MAX_PATH_LENGTH 128
 #define ACAP_MAX_PACKAGE_NAME 30
 #define ACAP_MAX_BUFFER_SIZE 4096
+#define ACAP_HTTP_WORKERS 4        // Default FastCGI worker threads (setting httpWorkers)
+#define ACAP_HTTP_MAX_WORKERS 16
+#define ACAP_STATUS_MAX_GROUPS 32
+#define ACAP_STATUS_MAX_NAME 32
 
 
 // Return types
@@ -47,6 +51,7 @@ typedef struct {
     const char* method;      // Request method (GET, POST, etc.)
     const char* contentType; // Content-Type header
     const char* queryString; // Raw query string
+    int detached;            // Set by ACAP_HTTP_Detach()
 } ACAP_HTTP_Request_DATA;
 
 typedef ACAP_HTTP_Request_DATA* ACAP_HTTP_Request;
@@ -61,6 +66,10 @@ cJSON*		ACAP(const char* package, ACAP_Config_Update updateCallback);
 const char* ACAP_Name(void);
 int 		ACAP_Set_Config(const char* service, cJSON* serviceSettings);
 cJSON* 		ACAP_Get_Config(const char* service);
+// Hold while reading or replacing config objects from an HTTP callback.
+// Recursive; the settings endpoint holds it while calling the update callback.
+void		ACAP_Config_Lock(void);
+void		ACAP_Config_Unlock(void);
 void		ACAP_Cleanup(void);
 
 /*-----------------------------------------------------
@@ -89,6 +98,13 @@ int 		ACAP_HTTP_Respond_Data(ACAP_HTTP_Response response, size_t count, const vo
 int 		ACAP_HTTP_Respond_Error(ACAP_HTTP_Response response, int code, const char* message);
 int 		ACAP_HTTP_Respond_Text(ACAP_HTTP_Response response, const char* message);
 
+// Long-lived responses (streaming from another thread)
+// Detach keeps the response open after the callback returns; request data is not kept.
+// The owner writes with the Respond functions, flushes, and must call ACAP_HTTP_Finish().
+ACAP_HTTP_Response ACAP_HTTP_Detach(const ACAP_HTTP_Request request);
+int 		ACAP_HTTP_Flush(ACAP_HTTP_Response response);
+void		ACAP_HTTP_Finish(ACAP_HTTP_Response response);
+
 /*-----------------------------------------------------
 	EVENTS
   -----------------------------------------------------*/
@@ -150,6 +166,7 @@ void		ACAP_STATUS_SetBool(const char* group, const char* name, int state);
 void		ACAP_STATUS_SetNumber(const char* group, const char* name, double value);
 void		ACAP_STATUS_SetString(const char* group, const char* name, const char* string);
 void		ACAP_STATUS_SetObject(const char* group, const char* name, cJSON* data);
+void		ACAP_STATUS_TakeObject(const char* group, const char* name, cJSON* data); // Takes ownership, no copy
 void		ACAP_STATUS_SetNull(const char* group, const char* name);
 
 /*-----------------------------------------------------
@@ -0,0 +1,368 @@
+/**
+ * Aggregate.c - Windowed per-label detection summary
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <glib.h>
+
+#include "Aggregate.h"
+#include "ACAP.h"
+#include "MQTT.h"
+
+#define LOG_MODULE "Aggregate"
+#include "Log.h"
+
+#define AGG_MAX_LABELS      32
+#define AGG_MAX_BUCKETS     60      /* windowSec / stepSec is capped to this */
+#define AGG_MAX_IDS         256     /* Track ids followed per frame */
+#define AGG_LABEL_SIZE      32
+#define AGG_MAX_HOLD_MS     30000   /* A frame's objects count for at most this long */
+
+typedef struct {
+    unsigned int present;       /* Samples where the label was seen */
+    unsigned int min;           /* Least objects in a sample where it was seen */
+    unsigned int max;
+    unsigned long sum;          /* Objects over all frames */
+    double object_ms;           /* Objects times the ms they were present */
+    unsigned int entries;
+    unsigned int exits;
+} AggregateCount;
+
+typedef struct {
+    double start;               /* ms */
+    unsigned int frames;
+    unsigned int samples;       /* Frames, plus the objects held over from the previous bucket */
+    double observed_ms;         /* Time covered by frames */
+    AggregateCount counts[AGG_MAX_LABELS];
+} AggregateBucket;
+
+typedef struct {
+    int label;
+    double id;
+} AggregateTrack;
+
+static pthread_mutex_t aggregate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int enabled = 0;
+static int sliding = 0;
+static int mqtt_publish = 1;
+static double window_ms = 60000;
+static double step_ms = 60000;
+static int bucket_count = 1;        /* Buckets per window */
+
+static char labels[AGG_MAX_LABELS][AGG_LABEL_SIZE];
+static int label_count = 0;
+
+static AggregateBucket buckets[AGG_MAX_BUCKETS];
+static int head = 0;                /* Bucket taking frames */
+static int filled = 0;              /* Buckets with data, including head */
+static int tracked = 0;             /* Detections carry track ids */
+static AggregateTrack previous[AGG_MAX_IDS];
+static int previous_count = 0;
+
+// The capture rate follows scene activity, so each frame's objects are
+// weighted by the time until the next frame instead of counted per frame
+static unsigned int held[AGG_MAX_LABELS];  /* Objects per label in the last frame */
+static double held_frame = 0;       /* Time of the last frame, 0 before the first */
+static double held_since = 0;       /* Held objects are credited up to here */
+
+static cJSON* latest = NULL;        /* Last published summary */
+static char topic[96] = "";
+
+static double setting_number(cJSON* aggregate, const char* name, double fallback) {
+    cJSON* item = cJSON_GetObjectItem(aggregate, name);
+    return item && cJSON_IsNumber(item) && item->valuedouble > 0 ? item->valuedouble : fallback;
+}
+
+// Caller holds aggregate_mutex
+static void aggregate_restart(double nowMs) {
+    memset(buckets, 0, sizeof(buckets));
+    head = 0;
+    filled = 1;
+    tracked = 0;
+    previous_count = 0;
+    held_frame = 0;
+    held_since = 0;
+    // Align to the step so tumbling windows start on whole minutes etc.
+    buckets[0].start = floor(nowMs / step_ms) * step_ms;
+}
+
+static int label_index(const char* label) {
+    for (int i = 0; i < label_count; i++)
+        if (strcmp(labels[i], label) == 0)
+            return i;
+    if (label_count == AGG_MAX_LABELS)
+        return -1;
+    snprintf(labels[label_count], AGG_LABEL_SIZE, "%s", label);
+    return label_count++;
+}
+
+// Time from held_since to untilMs that the last frame's objects cover
+static double hold_ms(double untilMs) {
+    if (!held_frame)
+        return 0;
+    double end = fmin(untilMs, held_frame + AGG_MAX_HOLD_MS);
+    return end > held_since ? end - held_since : 0;
+}
+
+// Credit the last frame's objects up to untilMs, which must be in the head bucket
+static void aggregate_hold(double untilMs) {
+    double ms = hold_ms(untilMs);
+    AggregateBucket* bucket = &buckets[head];
+    bucket->observed_ms += ms;
+    for (int i = 0; i < label_count; i++)
+        bucket->counts[i].object_ms += held[i] * ms;
+    if (untilMs > held_since)
+        held_since = untilMs;
+}
+
+static void count_sample(AggregateCount* count, unsigned int objects) {
+    if (!objects)
+        return;
+    if (!count->present || objects < count->min)
+        count->min = objects;
+    if (objects > count->max)
+        count->max = objects;
+    count->present++;
+}
+
+// The last frame's objects are also what a new bucket starts with
+static void aggregate_carry(void) {
+    AggregateBucket* bucket = &buckets[head];
+    if (!held_frame || held_frame + AGG_MAX_HOLD_MS <= bucket->start)
+        return;
+    bucket->samples++;
+    for (int i = 0; i < label_count; i++)
+        count_sample(&bucket->counts[i], held[i]);
+}
+
+// Summary of the last filled buckets
+static cJSON* aggregate_summary(double endMs) {
+    AggregateCount total[AGG_MAX_LABELS];
+    memset(total, 0, sizeof(total));
+    unsigned int frames = 0;
+    unsigned int samples = 0;
+    // A window in progress also covers the time since the last frame
+    double observed = hold_ms(endMs);
+    for (int i = 0; i < label_count; i++)
+        total[i].object_ms = held[i] * observed;
+    double start = buckets[head].start;
+    for (int n = 0; n < filled; n++) {
+        const AggregateBucket* bucket = &buckets[(head - n + AGG_MAX_BUCKETS) % AGG_MAX_BUCKETS];
+        start = bucket->start;
+        frames += bucket->frames;
+        samples += bucket->samples;
+        observed += bucket->observed_ms;
+        for (int i = 0; i < label_count; i++) {
+            const AggregateCount* count = &bucket->counts[i];
+            if (count->present) {
+                if (!total[i].present || count->min < total[i].min)
+                    total[i].min = count->min;
+                if (count->max > total[i].max)
+                    total[i].max = count->max;
+            }
+            total[i].present += count->present;
+            total[i].sum += count->sum;
+            total[i].object_ms += count->object_ms;
+            total[i].entries += count->entries;
+            total[i].exits += count->exits;
+        }
+    }
+
+    cJSON* summary = cJSON_CreateObject();
+    cJSON_AddStringToObject(summary, "mode", sliding ? "sliding" : "tumbling");
+    cJSON_AddNumberToObject(summary, "windowSec", window_ms / 1000);
+    cJSON_AddNumberToObject(summary, "start", start);
+    cJSON_AddNumberToObject(summary, "end", endMs);
+    cJSON_AddNumberToObject(summary, "frames", frames);
+    cJSON_AddNumberToObject(summary, "seconds", round(observed / 100) / 10);
+    cJSON* items = cJSON_AddObjectToObject(summary, "labels");
+    for (int i = 0; i < label_count; i++) {
+        if (!total[i].present && !total[i].exits)
+            continue;
+        cJSON* item = cJSON_AddObjectToObject(items, labels[i]);
+        // Frames without the label count as zero objects
+        cJSON_AddNumberToObject(item, "min", total[i].present < samples ? 0 : total[i].min);
+        cJSON_AddNumberToObject(item, "max", total[i].max);
+        // Objects present on average over the covered time
+        cJSON_AddNumberToObject(item, "avg", observed > 0 ? round(100.0 * total[i].object_ms / observed) / 100 : 0);
+        cJSON_AddNumberToObject(item, "detections", total[i].sum);
+        if (tracked) {
+            cJSON_AddNumberToObject(item, "entries", total[i].entries);
+            cJSON_AddNumberToObject(item, "exits", total[i].exits);
+        }
+    }
+    return summary;
+}
+
+static void aggregate_publish(double endMs) {
+    cJSON_Delete(latest);
+    latest = aggregate_summary(endMs);
+    if (!mqtt_publish)
+        return;
+    if (!topic[0])
+        snprintf(topic, sizeof(topic), "aggregate/%s", ACAP_DEVICE_Prop("serial"));
+    // Retained, so a new subscriber gets the last window at once
+    MQTT_Publish_JSON(topic, latest, 0, 1);
+}
+
+// Close the buckets that ended before nowMs; caller holds aggregate_mutex
+static void aggregate_advance(double nowMs) {
+    double end = buckets[head].start + step_ms;
+    if (nowMs < end)
+        return;
+    // After a gap longer than the window, publish what there was and start over
+    if (nowMs >= end + window_ms) {
+        aggregate_hold(end);
+        aggregate_publish(end);
+        aggregate_restart(nowMs);
+        return;
+    }
+    while (nowMs >= end) {
+        // A tumbling window is a single bucket of windowSec
+        aggregate_hold(end);
+        aggregate_publish(end);
+        head = (head + 1) % AGG_MAX_BUCKETS;
+        memset(&buckets[head], 0, sizeof(AggregateBucket));
+        buckets[head].start = end;
+        aggregate_carry();
+        filled = filled < bucket_count ? filled + 1 : bucket_count;
+        end += step_ms;
+    }
+}
+
+void Aggregate_Settings(cJSON* settings) {
+    cJSON* aggregate = cJSON_GetObjectItem(settings, "aggregate");
+    pthread_mutex_lock(&aggregate_mutex);
+    enabled = aggregate && cJSON_IsTrue(cJSON_GetObjectItem(aggregate, "enabled"));
+    cJSON* mode = cJSON_GetObjectItem(aggregate, "mode");
+    sliding = cJSON_IsString(mode) && strcmp(mode->valuestring, "sliding") == 0;
+    mqtt_publish = !cJSON_IsFalse(cJSON_GetObjectItem(aggregate, "mqtt"));
+    window_ms = setting_number(aggregate, "windowSec", 60) * 1000;
+    step_ms = sliding ? setting_number(aggregate, "stepSec", 10) * 1000 : window_ms;
+    if (step_ms > window_ms)
+        step_ms = window_ms;
+    if (window_ms / step_ms > AGG_MAX_BUCKETS)
+        step_ms = window_ms / AGG_MAX_BUCKETS;
+    bucket_count = (int)ceil(window_ms / step_ms - 1e-9);
+    if (bucket_count > AGG_MAX_BUCKETS)
+        bucket_count = AGG_MAX_BUCKETS;
+    // Sliding windows cover whole steps
+    window_ms = bucket_count * step_ms;
+    cJSON_Delete(latest);
+    latest = NULL;
+    aggregate_restart(ACAP_DEVICE_Timestamp());
+    pthread_mutex_unlock(&aggregate_mutex);
+    LOG_TRACE("%s: enabled=%d mode=%s window=%.0fms step=%.0fms buckets=%d\n", __func__,
+              enabled, sliding ? "sliding" : "tumbling", window_ms, step_ms, bucket_count);
+}
+
+void Aggregate_Frame(cJSON* detections, double nowMs) {
+    pthread_mutex_lock(&aggregate_mutex);
+    if (!enabled) {
+        pthread_mutex_unlock(&aggregate_mutex);
+        return;
+    }
+    aggregate_advance(nowMs);
+    aggregate_hold(nowMs);
+
+    unsigned int frame_counts[AGG_MAX_LABELS] = { 0 };
+    AggregateTrack current[AGG_MAX_IDS];
+    int current_count = 0;
+    cJSON* detection = detections ? detections->child : NULL;
+    for (; detection; detection = detection->next) {
+        cJSON* label = cJSON_GetObjectItem(detection, "label");
+        int index = label_index(cJSON_IsString(label) ? label->valuestring : "");
+        if (index < 0)
+            continue;
+        frame_counts[index]++;
+        cJSON* id = cJSON_GetObjectItem(detection, "id");
+        if (cJSON_IsNumber(id) && current_count < AGG_MAX_IDS) {
+            current[current_count].label = index;
+            current[current_count].id = id->valuedouble;
+            current_count++;
+        }
+    }
+
+    AggregateBucket* bucket = &buckets[head];
+    bucket->frames++;
+    bucket->samples++;
+    for (int i = 0; i < label_count; i++) {
+        bucket->counts[i].sum += frame_counts[i];
+        count_sample(&bucket->counts[i], frame_counts[i]);
+    }
+    memcpy(held, frame_counts, sizeof(held));
+    held_frame = held_since = nowMs;
+
+    // Entries and exits from track ids that appear or leave between frames
+    if (current_count)
+        tracked = 1;
+    if (tracked) {
+        for (int i = 0; i < current_count; i++) {
+            int seen = 0;
+            for (int j = 0; j < previous_count && !seen; j++)
+                seen = previous[j].id == current[i].id && previous[j].label == current[i].label;
+            if (!seen)
+                bucket->counts[current[i].label].entries++;
+        }
+        for (int j = 0; j < previous_count; j++) {
+            int seen = 0;
+            for (int i = 0; i < current_count && !seen; i++)
+                seen = previous[j].id == current[i].id && previous[j].label == current[i].label;
+            if (!seen)
+                bucket->counts[previous[j].label].exits++;
+        }
+        memcpy(previous, current, sizeof(AggregateTrack) * current_count);
+        previous_count = current_count;
+    }
+    pthread_mutex_unlock(&aggregate_mutex);
+}
+
+// Windows also close while no frames are captured
+static gboolean aggregate_tick(gpointer user_data) {
+    pthread_mutex_lock(&aggregate_mutex);
+    if (enabled)
+        aggregate_advance(ACAP_DEVICE_Timestamp());
+    pthread_mutex_unlock(&aggregate_mutex);
+    return G_SOURCE_CONTINUE;
+}
+
+// GET: last window summary; ?current=1 for the window in progress
+static void aggregate_http(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    const char* current = ACAP_HTTP_Request_Param(request, "current");
+    int in_progress = current && strcmp(current, "1") == 0;
+    free((void*)current);
+
+    // Print under the lock and respond without it, so a slow client does not hold up frames
+    char* json = NULL;
+    pthread_mutex_lock(&aggregate_mutex);
+    int active = enabled;
+    if (active && latest && !in_progress) {
+        json = cJSON_PrintUnformatted(latest);
+    } else if (active) {
+        cJSON* summary = aggregate_summary(ACAP_DEVICE_Timestamp());
+        json = cJSON_PrintUnformatted(summary);
+        cJSON_Delete(summary);
+    }
+    pthread_mutex_unlock(&aggregate_mutex);
+
+    if (!active) {
+        ACAP_HTTP_Respond_Error(response, 404, "Aggregation is disabled");
+        return;
+    }
+    if (!json) {
+        ACAP_HTTP_Respond_Error(response, 500, "Memory allocation failed");
+        return;
+    }
+    ACAP_HTTP_Header_JSON(response);
+    ACAP_HTTP_Respond_Data(response, strlen(json), json);
+    free(json);
+}
+
+void Aggregate_Init(void) {
+    ACAP_HTTP_Node("aggregate", aggregate_http);
+    g_timeout_add_seconds(1, aggregate_tick, NULL);
+}
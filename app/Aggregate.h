@@ -0,0 +1,57 @@
+/**
+ * Aggregate.h - Windowed per-label detection summary
+ *
+ * Reduces the per-frame detections to one compact summary per window, for
+ * consumers that only need "how many cars in the last minute". For each
+ * label the summary has the min and max number of objects in a frame, the
+ * average number present over time and the total detections. When
+ * detections carry a track "id", it also counts entries (new ids) and
+ * exits (ids that left).
+ *
+ * The capture rate follows scene activity, so the average weights each
+ * frame by the time until the next one (at most 30 s) rather than
+ * counting frames.
+ *
+ * Frames are added to buckets of stepSec. A tumbling window is one bucket
+ * of windowSec; a sliding window covers the last windowSec and is
+ * summarized every stepSec. Each summary is published on
+ * aggregate/<serial> and served by the "aggregate" HTTP node.
+ */
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Register the "aggregate" HTTP node and the timer that closes windows
+ * when no frames arrive
+ */
+void Aggregate_Init(void);
+
+/**
+ * Read aggregate.enabled, aggregate.mode ("tumbling" or "sliding"),
+ * aggregate.windowSec, aggregate.stepSec and aggregate.mqtt.
+ * A change restarts the current window.
+ *
+ * @param settings Application settings
+ */
+void Aggregate_Settings(cJSON* settings);
+
+/**
+ * Add the detections of a frame
+ *
+ * @param detections Filtered detections, NULL or empty for a frame without objects
+ * @param nowMs ACAP_DEVICE_Timestamp() of the frame
+ */
+void Aggregate_Frame(cJSON* detections, double nowMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // AGGREGATE_H
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <syslog.h>
+#include <pthread.h>
 #include "CERTS.h"
 #include "ACAP.h"
 
@@ -16,6 +17,8 @@
 #define KEY_FILE "localdata/key.pem"
 
 static cJSON* CERTS_SETTINGS = NULL;
+// HTTP workers run in parallel; uploads and reads of CERTS_SETTINGS take turns
+static pthread_mutex_t certs_mutex = PTHREAD_MUTEX_INITIALIZER;
 static const char CERTS_CA_STORE[] = "/etc/ssl/certs/ca-certificates.crt";
 
 // Implementation of certificate validation functions
@@ -103,7 +106,7 @@ void construct_full_path(const char* type, char* fullpath, size_t fullpath_size)
 }
 
 
-void CERTS_HTTP_Callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+static void certs_request(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
     if (!CERTS_SETTINGS) {
         LOG_WARN("CERTS is not initialized\n");
         ACAP_HTTP_Respond_Error(response, 400, "Certificate service is not initialized");
@@ -312,6 +315,12 @@ void CERTS_HTTP_Callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Requ
     ACAP_HTTP_Respond_Text(response, "OK");
 }
 
+void CERTS_HTTP_Callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    pthread_mutex_lock(&certs_mutex);
+    certs_request(response, request);
+    pthread_mutex_unlock(&certs_mutex);
+}
+
 CERTS_Status CERTS_Init(void) {
 	
     if (CERTS_SETTINGS) return CERTS_SUCCESS;
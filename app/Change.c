@@ -0,0 +1,197 @@
+/**
+ * Change.c - Scene change gate
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "Change.h"
+
+#define LOG_MODULE "Change"
+#include "Log.h"
+
+#define CELLS           (CHANGE_GRID_WIDTH * CHANGE_GRID_HEIGHT)
+#define ROW_STEP        4       /* Sample every 4th row ... */
+#define COL_STEP        2       /* ... and every 2nd pixel within a block */
+#define SCALE           4       /* Block averages are kept in 1/4 grey levels */
+#define MIN_THRESHOLD   (3 * SCALE)     /* Block difference that always counts as noise */
+#define MAX_THRESHOLD   (16 * SCALE)    /* Noise estimate never hides larger differences */
+#define NOISE_FACTOR    4.0
+#define REGION_PAD      2       /* Blocks added around the changed blocks */
+#define REGION_MIN      8       /* Smallest region side in blocks */
+
+static int enabled = 0;
+static double min_changed_percent = 0.1;
+static unsigned int max_skip_ms = 10000;
+static int region_enabled = 0;
+static double region_max_percent = 40;
+
+static uint16_t reference[CELLS];
+static uint16_t current[CELLS];
+static int have_reference = 0;
+static int have_current = 0;
+static uint64_t reference_us = 0;
+static uint64_t current_us = 0;
+static uint64_t full_us = 0;    /* Last full-frame reference */
+static double noise = 0;       /* Mean block residual of unchanged frames */
+
+/* Blocks that differ from the reference in the last compared frame */
+static uint8_t changed_blocks[CELLS];
+static int have_changed = 0;
+static unsigned int frame_width = 0;
+static unsigned int frame_height = 0;
+
+void Change_Settings(cJSON* settings) {
+    cJSON* gate = cJSON_GetObjectItem(settings, "changeGate");
+    enabled = gate && cJSON_IsTrue(cJSON_GetObjectItem(gate, "enabled"));
+    cJSON* percent = cJSON_GetObjectItem(gate, "minChangedPercent");
+    min_changed_percent = percent && percent->valuedouble > 0 ? percent->valuedouble : 0.1;
+    cJSON* skip = cJSON_GetObjectItem(gate, "maxSkipMs");
+    max_skip_ms = skip && skip->valueint >= 0 ? skip->valueint : 10000;
+    region_enabled = gate && cJSON_IsTrue(cJSON_GetObjectItem(gate, "regionUpload"));
+    cJSON* region_percent = cJSON_GetObjectItem(gate, "regionMaxPercent");
+    region_max_percent = region_percent && region_percent->valuedouble > 0 ? region_percent->valuedouble : 40;
+    Change_Reset();
+    LOG_TRACE("%s: enabled=%d minChangedPercent=%.2f maxSkipMs=%u\n", __func__, enabled, min_changed_percent, max_skip_ms);
+}
+
+// Block averages of the luma plane, sampled sparsely
+static void change_grid(const uint8_t* luma, unsigned int width, unsigned int height, uint16_t* grid) {
+    unsigned int columns[CHANGE_GRID_WIDTH + 1];
+    for (int cx = 0; cx <= CHANGE_GRID_WIDTH; cx++)
+        columns[cx] = (unsigned int)((uint64_t)cx * width / CHANGE_GRID_WIDTH);
+
+    for (int cy = 0; cy < CHANGE_GRID_HEIGHT; cy++) {
+        unsigned int y0 = (unsigned int)((uint64_t)cy * height / CHANGE_GRID_HEIGHT);
+        unsigned int y1 = (unsigned int)((uint64_t)(cy + 1) * height / CHANGE_GRID_HEIGHT);
+        uint32_t sums[CHANGE_GRID_WIDTH];
+        memset(sums, 0, sizeof(sums));
+        unsigned int rows = 0;
+        for (unsigned int y = y0; y < y1; y += ROW_STEP, rows++) {
+            const uint8_t* row = luma + (size_t)y * width;
+            for (int cx = 0; cx < CHANGE_GRID_WIDTH; cx++) {
+                uint32_t sum = 0;
+                for (unsigned int x = columns[cx]; x < columns[cx + 1]; x += COL_STEP)
+                    sum += row[x];
+                sums[cx] += sum;
+            }
+        }
+        for (int cx = 0; cx < CHANGE_GRID_WIDTH; cx++) {
+            unsigned int samples = rows * ((columns[cx + 1] - columns[cx] + COL_STEP - 1) / COL_STEP);
+            grid[cy * CHANGE_GRID_WIDTH + cx] = samples ? (uint16_t)(sums[cx] * SCALE / samples) : 0;
+        }
+    }
+}
+
+int Change_Static(const uint8_t* luma, unsigned int width, unsigned int height, uint64_t nowUs) {
+    if (!enabled || !luma || width < CHANGE_GRID_WIDTH || height < CHANGE_GRID_HEIGHT)
+        return 0;
+
+    change_grid(luma, width, height, current);
+    have_current = 1;
+    have_changed = 0;
+    current_us = nowUs;
+    if (frame_width != width || frame_height != height)
+        have_reference = 0;
+    frame_width = width;
+    frame_height = height;
+    if (!have_reference || nowUs - reference_us >= (uint64_t)max_skip_ms * 1000)
+        return 0;
+
+    // Remove a global brightness shift before comparing blocks
+    int64_t shift_sum = 0;
+    for (int i = 0; i < CELLS; i++)
+        shift_sum += (int)current[i] - (int)reference[i];
+    int shift = (int)(shift_sum / CELLS);
+
+    double threshold = MIN_THRESHOLD + NOISE_FACTOR * noise;
+    if (threshold > MAX_THRESHOLD)
+        threshold = MAX_THRESHOLD;
+
+    unsigned int changed = 0;
+    uint64_t residual_sum = 0;
+    for (int i = 0; i < CELLS; i++) {
+        int residual = abs((int)current[i] - (int)reference[i] - shift);
+        residual_sum += residual;
+        changed_blocks[i] = residual > threshold;
+        changed += changed_blocks[i];
+    }
+    have_changed = 1;
+
+    int unchanged = changed * 100.0 < min_changed_percent * CELLS;
+    if (unchanged) {
+        double residual = (double)residual_sum / CELLS;
+        noise = noise > 0 ? noise + (residual - noise) / 16 : residual;
+    }
+    LOG_TRACE("%s: changed=%u threshold=%.1f noise=%.2f shift=%d\n", __func__, changed, threshold / SCALE, noise / SCALE, shift / SCALE);
+    return unchanged;
+}
+
+int Change_Region(uint64_t nowUs, unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height) {
+    if (!region_enabled || !have_changed || nowUs - full_us >= (uint64_t)max_skip_ms * 1000)
+        return 0;
+
+    int x0 = CHANGE_GRID_WIDTH, y0 = CHANGE_GRID_HEIGHT, x1 = -1, y1 = -1;
+    for (int by = 0; by < CHANGE_GRID_HEIGHT; by++) {
+        for (int bx = 0; bx < CHANGE_GRID_WIDTH; bx++) {
+            if (!changed_blocks[by * CHANGE_GRID_WIDTH + bx])
+                continue;
+            if (bx < x0) x0 = bx;
+            if (bx > x1) x1 = bx;
+            if (by < y0) y0 = by;
+            if (by > y1) y1 = by;
+        }
+    }
+    if (x1 < 0)
+        return 0;
+
+    // Pad so objects whose edges changed are fully inside, and keep the region large enough to detect in
+    x0 -= REGION_PAD; x1 += REGION_PAD;
+    y0 -= REGION_PAD; y1 += REGION_PAD;
+    while (x1 - x0 + 1 < REGION_MIN) { x0--; x1++; }
+    while (y1 - y0 + 1 < REGION_MIN) { y0--; y1++; }
+    if (x0 < 0) { x1 -= x0; x0 = 0; }
+    if (y0 < 0) { y1 -= y0; y0 = 0; }
+    if (x1 >= CHANGE_GRID_WIDTH) { x0 -= x1 - (CHANGE_GRID_WIDTH - 1); x1 = CHANGE_GRID_WIDTH - 1; }
+    if (y1 >= CHANGE_GRID_HEIGHT) { y0 -= y1 - (CHANGE_GRID_HEIGHT - 1); y1 = CHANGE_GRID_HEIGHT - 1; }
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+
+    double percent = 100.0 * (x1 - x0 + 1) * (y1 - y0 + 1) / CELLS;
+    if (percent > region_max_percent)
+        return 0;
+
+    // Block edges in pixels, aligned to the 2x2 chroma subsampling
+    unsigned int left = (unsigned int)((uint64_t)x0 * frame_width / CHANGE_GRID_WIDTH) & ~1u;
+    unsigned int right = (unsigned int)((uint64_t)(x1 + 1) * frame_width / CHANGE_GRID_WIDTH) & ~1u;
+    unsigned int top = (unsigned int)((uint64_t)y0 * frame_height / CHANGE_GRID_HEIGHT) & ~1u;
+    unsigned int bottom = (unsigned int)((uint64_t)(y1 + 1) * frame_height / CHANGE_GRID_HEIGHT) & ~1u;
+    if (right <= left || bottom <= top)
+        return 0;
+    *x = left;
+    *y = top;
+    *width = right - left;
+    *height = bottom - top;
+    LOG_TRACE("%s: %ux%u at %u,%u (%.1f%%)\n", __func__, *width, *height, *x, *y, percent);
+    return 1;
+}
+
+void Change_Accept(int full) {
+    if (!have_current)
+        return;
+    memcpy(reference, current, sizeof(reference));
+    have_reference = 1;
+    have_current = 0;
+    reference_us = current_us;
+    if (full)
+        full_us = current_us;
+}
+
+void Change_Reset(void) {
+    have_reference = 0;
+    have_current = 0;
+    have_changed = 0;
+    full_us = 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * Change.h - Scene change gate
+ *
+ * Reduces the luma plane of each captured NV12 frame to a small grid of
+ * block averages and compares it with the grid of the last frame that was
+ * sent to the Hub. Pipeline_Process() skips inference for frames that did
+ * not change and reuses the previous detections.
+ *
+ * The per-block threshold follows the measured frame-to-frame noise, and a
+ * global brightness shift (exposure, gain) is removed before comparing.
+ * When only part of the frame changed, Change_Region() gives the changed
+ * area so that only that region is sent to the Hub.
+ */
+
+#ifndef CHANGE_H
+#define CHANGE_H
+
+#include <stdint.h>
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHANGE_GRID_WIDTH  64
+#define CHANGE_GRID_HEIGHT 36
+
+/**
+ * Read changeGate.enabled, changeGate.minChangedPercent, changeGate.maxSkipMs,
+ * changeGate.regionUpload and changeGate.regionMaxPercent
+ *
+ * @param settings Application settings
+ */
+void Change_Settings(cJSON* settings);
+
+/**
+ * Compare a frame with the reference
+ *
+ * @param luma Y plane, width x height bytes without padding
+ * @param width Frame width
+ * @param height Frame height
+ * @param nowUs Metrics_Now() timestamp of the frame
+ * @return 1 if gating is enabled and the frame is unchanged, 0 if it must be inferred
+ */
+int Change_Static(const uint8_t* luma, unsigned int width, unsigned int height, uint64_t nowUs);
+
+/**
+ * Region of the frame that changed, for inference on that region only
+ *
+ * Available after Change_Static() returned 0 for a compared frame. The
+ * region is the bounding box of the changed blocks, padded by two blocks.
+ * It is at least 8x8 blocks, and its edges are aligned to even pixels.
+ *
+ * @param nowUs Metrics_Now() timestamp of the frame
+ * @param x, y, width, height Output region in pixels
+ * @return 1 if regionUpload is enabled and the region covers at most
+ *         regionMaxPercent of the frame; 0 if the whole frame should be
+ *         inferred (also when maxSkipMs passed since the last full frame)
+ */
+int Change_Region(uint64_t nowUs, unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height);
+
+/**
+ * Make the frame last passed to Change_Static() the reference; call after it was inferred
+ *
+ * @param full 1 if the whole frame was inferred, 0 for a region
+ */
+void Change_Accept(int full);
+
+/**
+ * Forget the reference so the next frame is inferred
+ */
+void Change_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CHANGE_H
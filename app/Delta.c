@@ -0,0 +1,127 @@
+/**
+ * Delta.c - Delta publishing of detection summaries
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Delta.h"
+
+#define LOG_MODULE "Delta"
+#include "Log.h"
+
+#define DELTA_MAX_OBJECTS   128     /* Compared per frame; more always counts as changed */
+#define DELTA_LABEL_SIZE    32
+
+typedef struct {
+    char label[DELTA_LABEL_SIZE];
+    double cx, cy, w, h;
+} DeltaObject;
+
+static int enabled = 0;
+static double move_percent = 10;
+static double keyframe_ms = 10000;
+
+static DeltaObject published[DELTA_MAX_OBJECTS];
+static int published_count = -1;    /* Objects in the last published set, -1 before the first */
+static double published_time = 0;
+
+static double setting_number(cJSON* delta, const char* name, double fallback) {
+    cJSON* item = cJSON_GetObjectItem(delta, name);
+    return item && cJSON_IsNumber(item) && item->valuedouble >= 0 ? item->valuedouble : fallback;
+}
+
+void Delta_Settings(cJSON* settings) {
+    cJSON* delta = cJSON_GetObjectItem(settings, "delta");
+    enabled = delta && cJSON_IsTrue(cJSON_GetObjectItem(delta, "enabled"));
+    move_percent = setting_number(delta, "movePercent", 10);
+    keyframe_ms = setting_number(delta, "keyframeMs", 10000);
+    Delta_Reset();
+    LOG_TRACE("%s: enabled=%d movePercent=%.1f keyframeMs=%.0f\n", __func__, enabled, move_percent, keyframe_ms);
+}
+
+int Delta_Enabled(void) {
+    return enabled;
+}
+
+void Delta_Reset(void) {
+    published_count = -1;
+    published_time = 0;
+}
+
+static double number(cJSON* detection, const char* name) {
+    cJSON* item = cJSON_GetObjectItem(detection, name);
+    return item && cJSON_IsNumber(item) ? item->valuedouble : 0;
+}
+
+// Boxes are top-left x/y with width and height, as set by Filter_Detections()
+static int parse(cJSON* detections, DeltaObject* objects) {
+    int count = 0;
+    cJSON* detection = detections ? detections->child : NULL;
+    for (; detection && count < DELTA_MAX_OBJECTS; detection = detection->next) {
+        DeltaObject* object = &objects[count++];
+        cJSON* label = cJSON_GetObjectItem(detection, "label");
+        snprintf(object->label, sizeof(object->label), "%s", cJSON_IsString(label) ? label->valuestring : "");
+        object->w = number(detection, "w");
+        object->h = number(detection, "h");
+        object->cx = number(detection, "x") + object->w / 2;
+        object->cy = number(detection, "y") + object->h / 2;
+    }
+    return count;
+}
+
+// Each object must match an unused published object with the same label, within the move threshold
+static int same_set(const DeltaObject* current, int count) {
+    unsigned char used[DELTA_MAX_OBJECTS] = { 0 };
+    for (int i = 0; i < count; i++) {
+        int best = -1;
+        double best_distance = 0;
+        for (int j = 0; j < published_count; j++) {
+            if (used[j] || strcmp(current[i].label, published[j].label) != 0)
+                continue;
+            double dx = current[i].cx - published[j].cx;
+            double dy = current[i].cy - published[j].cy;
+            double distance = dx * dx + dy * dy;
+            if (best < 0 || distance < best_distance) {
+                best = j;
+                best_distance = distance;
+            }
+        }
+        if (best < 0)
+            return 0;
+        used[best] = 1;
+
+        const DeltaObject* old = &published[best];
+        double size = fmax(fmax(old->w, old->h), 1);
+        double limit = size * move_percent / 100;
+        if (fabs(current[i].cx - old->cx) > limit || fabs(current[i].cy - old->cy) > limit ||
+            fabs(current[i].w - old->w) > limit || fabs(current[i].h - old->h) > limit)
+            return 0;
+    }
+    return 1;
+}
+
+DeltaResult Delta_Check(cJSON* detections, double nowMs) {
+    int total = detections ? cJSON_GetArraySize(detections) : 0;
+    if (!enabled)
+        return total ? DELTA_CHANGED : DELTA_SKIP;
+
+    // An empty scene is a set like any other, so late subscribers also learn that it emptied
+    DeltaObject current[DELTA_MAX_OBJECTS];
+    int count = parse(detections, current);
+    DeltaResult result = DELTA_SKIP;
+    if (total != published_count || total > DELTA_MAX_OBJECTS || !same_set(current, count))
+        result = DELTA_CHANGED;
+    else if (nowMs - published_time >= keyframe_ms)
+        result = DELTA_KEYFRAME;
+    if (result == DELTA_SKIP)
+        return DELTA_SKIP;
+
+    memcpy(published, current, sizeof(DeltaObject) * count);
+    published_count = total;
+    published_time = nowMs;
+    LOG_TRACE("%s: %s, %d objects\n", __func__, result == DELTA_KEYFRAME ? "keyframe" : "changed", total);
+    return result;
+}
@@ -0,0 +1,67 @@
+/**
+ * Delta.h - Delta publishing of detection summaries
+ *
+ * Output() publishes the detection/<serial> summary on every frame with
+ * detections. In delta mode the summary is only published when the set of
+ * detections changed materially since the last published one: an object
+ * appeared or left, changed label, or moved or resized beyond a threshold.
+ * A keyframe repeats the current set at a fixed interval for subscribers
+ * that connect later.
+ *
+ * Objects are matched to the last published set by label and nearest
+ * center; confidence and timestamps are not compared.
+ */
+
+#ifndef DELTA_H
+#define DELTA_H
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    DELTA_SKIP = 0,             /* Unchanged, do not publish */
+    DELTA_CHANGED,              /* Publish: the set changed */
+    DELTA_KEYFRAME              /* Publish: keyframe interval passed */
+} DeltaResult;
+
+/**
+ * Read delta.enabled, delta.movePercent and delta.keyframeMs
+ *
+ * Not thread safe: call from the thread that runs Delta_Check().
+ *
+ * @param settings Application settings
+ */
+void Delta_Settings(cJSON* settings);
+
+/**
+ * 1 if delta mode is enabled
+ */
+int Delta_Enabled(void);
+
+/**
+ * Decide whether a frame's detections are published
+ *
+ * With delta mode disabled every non-empty set is DELTA_CHANGED and an
+ * empty set is DELTA_SKIP, as before. With delta mode enabled, the first
+ * frame and every change are published, and the current set, empty or
+ * not, is repeated as a keyframe every keyframeMs.
+ *
+ * @param detections Filtered detections of the frame, may be NULL
+ * @param nowMs ACAP_DEVICE_Timestamp() of the frame
+ * @return DELTA_SKIP, or why the set should be published
+ */
+DeltaResult Delta_Check(cJSON* detections, double nowMs);
+
+/**
+ * Forget the last published set, so the next frame is published
+ */
+void Delta_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DELTA_H
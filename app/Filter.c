@@ -0,0 +1,124 @@
+/**
+ * Filter.c - Detection coordinate scaling and user filters
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "Filter.h"
+
+#define LOG_MODULE "Filter"
+#include "Log.h"
+
+cJSON*
+Filter_Detections(cJSON* detections, cJSON* settings, cJSON* model, double timestamp) {
+	const char* label = "Undefined";
+
+	if( !detections || !settings )
+		return NULL;
+
+	// Get video dimensions for coordinate scaling
+	unsigned int videoWidth = cJSON_GetObjectItem(model, "videoWidth") ?
+	                          cJSON_GetObjectItem(model, "videoWidth")->valueint : 1000;
+	unsigned int videoHeight = cJSON_GetObjectItem(model, "videoHeight") ?
+	                           cJSON_GetObjectItem(model, "videoHeight")->valueint : 1000;
+
+	// AOI and Size are always in display space (16:9)
+	cJSON* aoi = cJSON_GetObjectItem(settings,"aoi");
+	if(!aoi) {
+		LOG_WARN("No aoi settings\n");
+		return NULL;
+	}
+	unsigned int x1 = cJSON_GetObjectItem(aoi,"x1")?cJSON_GetObjectItem(aoi,"x1")->valueint:100;
+	unsigned int y1 = cJSON_GetObjectItem(aoi,"y1")?cJSON_GetObjectItem(aoi,"y1")->valueint:100;
+	unsigned int x2 = cJSON_GetObjectItem(aoi,"x2")?cJSON_GetObjectItem(aoi,"x2")->valueint:900;
+	unsigned int y2 = cJSON_GetObjectItem(aoi,"y2")?cJSON_GetObjectItem(aoi,"y2")->valueint:900;
+
+	cJSON* size = cJSON_GetObjectItem(settings,"size");
+	if(!size) {
+		LOG_WARN("No size settings\n");
+		return NULL;
+	}
+	unsigned int minWidth = cJSON_GetObjectItem(size,"x2")->valueint - cJSON_GetObjectItem(size,"x1")->valueint;
+	unsigned int minHeight = cJSON_GetObjectItem(size,"y2")->valueint - cJSON_GetObjectItem(size,"y1")->valueint;
+
+	int confidenceThreshold = cJSON_GetObjectItem(settings,"confidence")?cJSON_GetObjectItem(settings,"confidence")->valueint:0.5;
+
+	cJSON* processedDetections = cJSON_CreateArray();
+	cJSON* detection = detections->child;
+	while(detection) {
+		unsigned cx = 0;
+		unsigned cy = 0;
+		unsigned width = 0;
+		unsigned height = 0;
+		unsigned c = 0;
+		label = "Undefined";
+		cJSON* property = detection->child;
+		while(property) {
+			if( strcmp("c",property->string) == 0 ) {
+				property->valueint = property->valuedouble * 100;
+				property->valuedouble = property->valueint;
+				c = property->valueint;
+			}
+			if( strcmp("x",property->string) == 0 ) {
+				property->valueint = property->valuedouble * videoWidth;
+				property->valuedouble = property->valueint;
+				cx += property->valueint;
+			}
+			if( strcmp("y",property->string) == 0 ) {
+				property->valueint = property->valuedouble * videoHeight;
+				property->valuedouble = property->valueint;
+				cy += property->valueint;
+			}
+			if( strcmp("w",property->string) == 0 ) {
+				property->valueint = property->valuedouble * videoWidth;
+				width = property->valueint;
+				property->valuedouble = property->valueint;
+				cx += property->valueint / 2;
+			}
+			if( strcmp("h",property->string) == 0 ) {
+				property->valueint = property->valuedouble * videoHeight;
+				height = property->valueint;
+				property->valuedouble = property->valueint;
+				cy += property->valueint / 2;
+			}
+			if( strcmp("label",property->string) == 0 ) {
+				label = property->valuestring;
+			}
+			property = property->next;
+		}
+
+		//FILTER DETECTIONS
+		// Coordinates are in capture space [0-1000] and match the displayed image
+		// No transformation needed since overlay displays the captured image
+		unsigned int display_cx = cx;
+		unsigned int display_cy = cy;
+		unsigned int display_width = width;
+		unsigned int display_height = height;
+
+		int insert = 0;
+		if( c >= confidenceThreshold && display_cx >= x1 && display_cx <= x2 && display_cy >= y1 && display_cy <= y2 )
+			insert = 1;
+		if( display_width < minWidth || display_height < minHeight )
+			insert = 0;
+		cJSON* ignore = cJSON_GetObjectItem(settings,"ignore");
+		if( insert && ignore && ignore->type == cJSON_Array && cJSON_GetArraySize(ignore) > 0 ) {
+			cJSON* ignoreLabel = ignore->child;
+			while( ignoreLabel && insert ) {
+				if( strcmp( label, ignoreLabel->valuestring) == 0 )
+					insert = 0;
+				ignoreLabel = ignoreLabel->next;
+			}
+		}
+		//Add custom filter here.  Set "insert = 0" if you want to exclude the detection
+
+		if( insert ) {
+			cJSON_AddNumberToObject( detection, "timestamp", timestamp );
+			cJSON_AddItemToArray(processedDetections, cJSON_Duplicate(detection,1));
+		}
+		detection = detection->next;
+	}
+	return processedDetections;
+}
@@ -0,0 +1,37 @@
+/**
+ * Filter.h - Detection coordinate scaling and user filters
+ *
+ * Converts normalized Hub detections to capture pixel coordinates and applies
+ * the confidence, area-of-interest, minimum size and ignore-label filters from
+ * the settings.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Scale and filter detections for one frame
+ *
+ * The input detections are modified in place (coordinates scaled to pixels,
+ * confidence scaled to 0-100) and remain owned by the caller.
+ *
+ * @param detections Array returned by Model_Inference()
+ * @param settings Application settings ("aoi", "size", "confidence", "ignore")
+ * @param model Model info from Model_Setup() ("videoWidth", "videoHeight")
+ * @param timestamp Epoch milliseconds added to each accepted detection
+ * @return New array of accepted detections (caller must cJSON_Delete),
+ *         or NULL if the settings lack "aoi" or "size"
+ */
+cJSON* Filter_Detections(cJSON* detections, cJSON* settings, cJSON* model, double timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // FILTER_H
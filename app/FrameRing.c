@@ -0,0 +1,38 @@
+/**
+ * FrameRing.c - Single-producer/single-consumer ring of frame pointers
+ */
+
+#include <sched.h>
+#include <stddef.h>
+
+#include "FrameRing.h"
+
+_Static_assert((FRAME_RING_SLOTS & (FRAME_RING_SLOTS - 1)) == 0, "FRAME_RING_SLOTS must be a power of two");
+
+void FrameRing_Init(FrameRing* ring) {
+    for (int i = 0; i < FRAME_RING_SLOTS; i++)
+        ring->slots[i] = NULL;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+void FrameRing_Push(FrameRing* ring, void* frame) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= FRAME_RING_SLOTS)
+        sched_yield();
+
+    ring->slots[head % FRAME_RING_SLOTS] = frame;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void* FrameRing_Pop(FrameRing* ring) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail == atomic_load_explicit(&ring->head, memory_order_acquire))
+        return NULL;
+
+    void* frame = ring->slots[tail % FRAME_RING_SLOTS];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return frame;
+}
@@ -0,0 +1,52 @@
+/**
+ * FrameRing.h - Single-producer/single-consumer ring of frame pointers
+ *
+ * Carries frames the client has consumed back to the thread that fetches
+ * them from VDO, without locks. One thread pushes and one thread pops;
+ * indices grow and wrap freely, so the slot count must be a power of two.
+ */
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_RING_SLOTS 16
+
+typedef struct {
+    void* slots[FRAME_RING_SLOTS];
+    atomic_uint head;           /* Written by the producer */
+    atomic_uint tail;           /* Written by the consumer */
+} FrameRing;
+
+/**
+ * Empty the ring; not thread safe
+ */
+void FrameRing_Init(FrameRing* ring);
+
+/**
+ * Add a frame; producer only
+ *
+ * Yields while the ring is full. With more slots than frames in
+ * circulation this only happens while the consumer is stuck in VDO.
+ *
+ * @param frame Frame to hand over, not NULL
+ */
+void FrameRing_Push(FrameRing* ring, void* frame);
+
+/**
+ * Take the oldest frame; consumer only
+ *
+ * @return The frame, or NULL if the ring is empty
+ */
+void* FrameRing_Pop(FrameRing* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // FRAME_RING_H
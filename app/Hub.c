@@ -3,6 +3,7 @@
  */
 
 #include "Hub.h"
+#include "Metrics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,10 +13,8 @@
 #include <curl/curl.h>
 
 
-#define LOG(fmt, args...)    { LOG_TRACE(fmt, ## args); printf(fmt, ## args);}
-#define LOG_WARN(fmt, args...)    { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args);}
-//#define LOG_TRACE(fmt, args...)    { LOG_TRACE(fmt, ## args); printf(fmt, ## args); }
-#define LOG_TRACE(fmt, args...)    {}
+#define LOG_MODULE "Hub"
+#include "Log.h"
 
 #define HUB_TIMEOUT_SECS 30
 #define HUB_CONNECTTIMEOUT_SECS 10
@@ -26,6 +25,7 @@ struct HubContext {
     char* password;
     CURL* curl;
     double last_request_time_ms;
+    long last_http_status;      /* 0 if the last request got no response */
     bool available;
 };
 
@@ -141,6 +141,7 @@ static cJSON* hub_request_json(HubContext* ctx, const char* endpoint) {
                                 (end.tv_usec - start.tv_usec) / 1000.0;
 
     if (res != CURLE_OK) {
+        ctx->last_http_status = 0;
         LOG_WARN("Hub: request to %s failed: %s", url, curl_easy_strerror(res));
         free(resp.data);
         ctx->available = false;
@@ -149,6 +150,7 @@ static cJSON* hub_request_json(HubContext* ctx, const char* endpoint) {
 
     long http_code = 0;
     curl_easy_getinfo(ctx->curl, CURLINFO_RESPONSE_CODE, &http_code);
+    ctx->last_http_status = http_code;
     if (http_code != 200) {
         LOG_WARN("Hub: request to %s returned HTTP %ld", url, http_code);
         free(resp.data);
@@ -268,14 +270,47 @@ typedef struct {
     const uint8_t* data;
     size_t size;
     size_t pos;
+    uint64_t eof_us;    // Metrics_Now() when the last byte was handed to curl
 } ReadContext;
 
+/*
+ * Split a completed request into connect / TLS / upload / TTFB / download phases.
+ * curl reports phase ends as offsets from the start of the transfer; the upload end
+ * comes from read_callback() since curl has no info field for it.
+ */
+static void hub_record_timing(HubContext* ctx, uint64_t start_us, uint64_t upload_end_us) {
+    curl_off_t connect = 0, appconnect = 0, pretransfer = 0, starttransfer = 0, total = 0;
+    curl_easy_getinfo(ctx->curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(ctx->curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(ctx->curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(ctx->curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(ctx->curl, CURLINFO_TOTAL_TIME_T, &total);
+
+    // curl times are offsets from the start of curl_easy_perform()
+    Metrics_Span(METRICS_HUB_TOTAL, start_us, start_us + total);
+    if (connect > 0)
+        Metrics_Span(METRICS_HUB_CONNECT, start_us, start_us + connect);
+    if (appconnect > connect)
+        Metrics_Span(METRICS_HUB_TLS, start_us + connect, start_us + appconnect);
+    if (starttransfer <= 0)
+        return;  // No response received
+
+    curl_off_t upload_end = upload_end_us > start_us ? (curl_off_t)(upload_end_us - start_us) : 0;
+    if (upload_end < pretransfer || upload_end > starttransfer)
+        upload_end = pretransfer;
+    Metrics_Span(METRICS_HUB_UPLOAD, start_us + pretransfer, start_us + upload_end);
+    Metrics_Span(METRICS_HUB_TTFB, start_us + upload_end, start_us + starttransfer);
+    if (total > starttransfer)
+        Metrics_Span(METRICS_HUB_DOWNLOAD, start_us + starttransfer, start_us + total);
+}
+
 static size_t read_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
     ReadContext* ctx = (ReadContext*)userdata;
     size_t bytes_to_read = size * nitems;
     size_t bytes_remaining = ctx->size - ctx->pos;
 
     if (bytes_remaining == 0) {
+        ctx->eof_us = Metrics_Now();
         return 0;  // EOF
     }
 
@@ -317,7 +352,8 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
     ReadContext read_ctx = {
         .data = jpeg_data,
         .size = jpeg_size,
-        .pos = 0
+        .pos = 0,
+        .eof_us = 0
     };
 
     curl_easy_reset(ctx->curl);
@@ -341,6 +377,7 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
         curl_easy_setopt(ctx->curl, CURLOPT_PASSWORD, ctx->password);
     }
 
+    uint64_t start_us = Metrics_Now();  // curl phase times are relative to perform()
     CURLcode res = curl_easy_perform(ctx->curl);
     curl_slist_free_all(headers);
 
@@ -350,6 +387,10 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
 
     LOG_TRACE("Hub: Request completed in %.2f ms (curl_result=%d)", ctx->last_request_time_ms, res);
 
+    hub_record_timing(ctx, start_us, read_ctx.eof_us);
+    Metrics_Bytes(METRICS_BYTES_HUB_UPLOAD, read_ctx.pos);
+    Metrics_Bytes(METRICS_BYTES_HUB_DOWNLOAD, resp.size);
+
     if (res != CURLE_OK) {
         if (error_msg) {
             char buf[256];
@@ -357,6 +398,7 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
             *error_msg = strdup(buf);
         }
         LOG_WARN("Hub: inference request failed: %s", curl_easy_strerror(res));
+        ctx->last_http_status = 0;
         free(resp.data);
         ctx->available = false;
         return NULL;
@@ -364,6 +406,7 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
 
     long http_code = 0;
     curl_easy_getinfo(ctx->curl, CURLINFO_RESPONSE_CODE, &http_code);
+    ctx->last_http_status = http_code;
 
     if (http_code == 204) {
         /* No detections */
@@ -384,14 +427,20 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
         return NULL;
     }
 
-
-    cJSON* json = cJSON_Parse(resp.data);
+    uint64_t parse_us = Metrics_Now();
+    cJSON* detections_array = Hub_ParseDetections(resp.data, error_msg);
     free(resp.data);
+    Metrics_Since(METRICS_HUB_PARSE, parse_us);
+
+    ctx->available = detections_array != NULL;
+    return detections_array;
+}
 
+cJSON* Hub_ParseDetections(const char* response, char** error_msg) {
+    cJSON* json = response ? cJSON_Parse(response) : NULL;
     if (!json) {
         if (error_msg) *error_msg = strdup("Failed to parse response");
         LOG_WARN("Hub: failed to parse inference response");
-        ctx->available = false;
         return NULL;
     }
 
@@ -401,18 +450,12 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
         if (error_msg) *error_msg = strdup("Response missing detections array");
         LOG_WARN("Hub: response missing detections array");
         cJSON_Delete(json);
-        ctx->available = false;
         return NULL;
     }
 
     // Detach the array from the root object so we can delete the wrapper
     cJSON* detections_array = cJSON_DetachItemFromObject(json, "detections");
     cJSON_Delete(json);  // Delete the wrapper object
-
-    // Log parsed detection count
-    int detection_count = cJSON_GetArraySize(detections_array);
-
-    ctx->available = true;
     return detections_array;
 }
 
@@ -420,6 +463,10 @@ double Hub_GetLastRequestTime(HubContext* ctx) {
     return ctx ? ctx->last_request_time_ms : -1;
 }
 
+long Hub_GetLastHTTPStatus(HubContext* ctx) {
+    return ctx ? ctx->last_http_status : 0;
+}
+
 bool Hub_IsAvailable(HubContext* ctx) {
     if (!ctx) return false;
 
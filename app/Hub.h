@@ -91,6 +91,17 @@ cJSON* Hub_InferenceJPEG(HubContext* ctx, const uint8_t* jpeg_data,
                         size_t jpeg_size, int image_index,
                         const char* scale_mode, char** error_msg);
 
+/**
+ * Parse a Hub inference response body
+ *
+ * Used by Hub_InferenceJPEG() for HTTP 200 responses.
+ *
+ * @param response NUL-terminated JSON body ({"detections": [...], ...})
+ * @param error_msg Output error message (caller must free)
+ * @return cJSON array of detections (caller must delete) or NULL on failure
+ */
+cJSON* Hub_ParseDetections(const char* response, char** error_msg);
+
 /**
  * Update Hub connection settings
  *
@@ -111,6 +122,14 @@ bool Hub_UpdateSettings(HubContext* ctx, const char* hub_url,
  */
 double Hub_GetLastRequestTime(HubContext* ctx);
 
+/**
+ * Get the HTTP status of the last request
+ *
+ * @param ctx Hub context
+ * @return HTTP status (e.g. 200, 204, 503), or 0 if no response was received
+ */
+long Hub_GetLastHTTPStatus(HubContext* ctx);
+
 /**
  * Check if Hub is reachable and healthy
  *
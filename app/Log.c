@@ -0,0 +1,267 @@
+/**
+ * Log.c - Shared logging
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "Log.h"
+
+#define LOG_MAX_MODULES     32
+#define LOG_MODULE_NAME     24
+#define LOG_RING_SIZE       256     /* Power of two */
+#define LOG_MESSAGE_SIZE    256     /* Longer messages are truncated */
+#define LOG_DEFAULT_BURST   50
+#define LOG_DEFAULT_WINDOW  10000   /* ms */
+
+typedef struct {
+    char name[LOG_MODULE_NAME];
+    atomic_int level;
+} LogModule;
+
+typedef struct {
+    atomic_ulong sequence;
+    int level;
+    char text[LOG_MESSAGE_SIZE];
+} LogSlot;
+
+static LogModule modules[LOG_MAX_MODULES];
+static atomic_int module_count = 0;
+static pthread_mutex_t module_mutex = PTHREAD_MUTEX_INITIALIZER;
+static cJSON* module_levels = NULL;     /* Copy of log.modules, under module_mutex */
+static atomic_int default_level = LOG_LEVEL_INFO;
+static atomic_uint burst = LOG_DEFAULT_BURST;
+static atomic_ullong window_us = LOG_DEFAULT_WINDOW * 1000ULL;
+
+/* Bounded multi-producer ring, drained by the writer thread */
+static LogSlot ring[LOG_RING_SIZE];
+static atomic_ulong enqueue_pos = 0;
+static unsigned long dequeue_pos = 0;
+static atomic_ulong dropped = 0;
+
+static pthread_t writer_thread;
+static atomic_bool writer_running = 0;
+static atomic_bool writer_waiting = 0;
+static int writer_fd = -1;
+
+static uint64_t log_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int log_priority(int level) {
+    return level == LOG_LEVEL_WARN ? LOG_WARNING : level == LOG_LEVEL_INFO ? LOG_INFO : LOG_DEBUG;
+}
+
+static void log_output(int level, const char* text) {
+    syslog(log_priority(level), "%s", text);
+    fputs(text, stdout);
+}
+
+static int log_level_parse(const cJSON* item, int fallback) {
+    if (!item || !cJSON_IsString(item))
+        return fallback;
+    if (strcmp(item->valuestring, "warn") == 0)  return LOG_LEVEL_WARN;
+    if (strcmp(item->valuestring, "info") == 0)  return LOG_LEVEL_INFO;
+    if (strcmp(item->valuestring, "verbose") == 0) return LOG_LEVEL_VERBOSE;
+    if (strcmp(item->valuestring, "trace") == 0) return LOG_LEVEL_TRACE;
+    return fallback;
+}
+
+// Caller holds module_mutex
+static int module_level(const char* name) {
+    return log_level_parse(cJSON_GetObjectItem(module_levels, name), atomic_load(&default_level));
+}
+
+static int module_register(LogSite* site) {
+    pthread_mutex_lock(&module_mutex);
+    int index = atomic_load(&site->index);
+    if (index) {
+        pthread_mutex_unlock(&module_mutex);
+        return index;
+    }
+    int count = atomic_load(&module_count);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(modules[i].name, site->module) == 0) {
+            index = i + 1;
+            break;
+        }
+    }
+    if (!index && count < LOG_MAX_MODULES) {
+        snprintf(modules[count].name, LOG_MODULE_NAME, "%s", site->module);
+        atomic_store(&modules[count].level, module_level(site->module));
+        atomic_store(&module_count, count + 1);
+        index = count + 1;
+    }
+    if (!index)
+        index = 1;  // Table full; share the first module's level
+    atomic_store(&site->index, index);
+    pthread_mutex_unlock(&module_mutex);
+    return index;
+}
+
+int Log_Enabled(LogSite* site, int level) {
+    int index = atomic_load_explicit(&site->index, memory_order_acquire);
+    if (!index)
+        index = module_register(site);
+    return level <= atomic_load_explicit(&modules[index - 1].level, memory_order_relaxed);
+}
+
+static void log_queue(int level, const char* fmt, va_list args) {
+    if (!atomic_load(&writer_running)) {
+        char text[LOG_MESSAGE_SIZE];
+        vsnprintf(text, sizeof(text), fmt, args);
+        log_output(level, text);
+        return;
+    }
+
+    // Claim a slot; a full ring drops the message rather than block the caller
+    unsigned long pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    LogSlot* slot;
+    for (;;) {
+        slot = &ring[pos & (LOG_RING_SIZE - 1)];
+        unsigned long sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        long diff = (long)(sequence - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+    slot->level = level;
+    vsnprintf(slot->text, sizeof(slot->text), fmt, args);
+    atomic_store(&slot->sequence, pos + 1);
+
+    if (atomic_load(&writer_waiting))
+        eventfd_write(writer_fd, 1);
+}
+
+static void log_queue_format(int level, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_queue(level, fmt, args);
+    va_end(args);
+}
+
+void Log_Write(LogSite* site, int level, const char* fmt, ...) {
+    uint64_t now = log_now_us();
+    unsigned long long start = atomic_load_explicit(&site->window_us, memory_order_relaxed);
+    if (now - start >= atomic_load_explicit(&window_us, memory_order_relaxed) &&
+        atomic_compare_exchange_strong(&site->window_us, &start, now)) {
+        unsigned int suppressed = atomic_exchange(&site->suppressed, 0);
+        atomic_store(&site->count, 0);
+        if (suppressed)
+            log_queue_format(level, "%s: %u similar messages suppressed\n", site->module, suppressed);
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) >= atomic_load(&burst)) {
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    log_queue(level, fmt, args);
+    va_end(args);
+}
+
+// Single consumer; returns 0 when the ring is empty
+static int log_drain_one(void) {
+    LogSlot* slot = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+    if (atomic_load(&slot->sequence) != dequeue_pos + 1)
+        return 0;
+    log_output(slot->level, slot->text);
+    atomic_store_explicit(&slot->sequence, dequeue_pos + LOG_RING_SIZE, memory_order_release);
+    dequeue_pos++;
+    return 1;
+}
+
+static void log_drain(void) {
+    while (log_drain_one())
+        ;
+    unsigned long lost = atomic_exchange(&dropped, 0);
+    if (lost) {
+        char text[64];
+        snprintf(text, sizeof(text), "Log: %lu messages dropped\n", lost);
+        log_output(LOG_LEVEL_WARN, text);
+    }
+}
+
+static void* log_writer(void* arg) {
+    (void)arg;
+    while (atomic_load(&writer_running)) {
+        log_drain();
+        atomic_store(&writer_waiting, 1);
+        LogSlot* next = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+        if (atomic_load(&next->sequence) != dequeue_pos + 1 && atomic_load(&writer_running)) {
+            eventfd_t value;
+            eventfd_read(writer_fd, &value);
+        }
+        atomic_store(&writer_waiting, 0);
+    }
+    log_drain();
+    return NULL;
+}
+
+void Log_Init(void) {
+    if (atomic_load(&writer_running))
+        return;
+    for (unsigned long i = 0; i < LOG_RING_SIZE; i++)
+        atomic_store(&ring[i].sequence, i);
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+
+    writer_fd = eventfd(0, EFD_CLOEXEC);
+    if (writer_fd < 0) {
+        log_output(LOG_LEVEL_WARN, "Log: eventfd failed, logging synchronously\n");
+        return;
+    }
+    atomic_store(&writer_running, 1);
+    if (pthread_create(&writer_thread, NULL, log_writer, NULL) != 0) {
+        atomic_store(&writer_running, 0);
+        close(writer_fd);
+        writer_fd = -1;
+        log_output(LOG_LEVEL_WARN, "Log: Failed to start writer thread, logging synchronously\n");
+    }
+}
+
+void Log_Stop(void) {
+    if (!atomic_load(&writer_running))
+        return;
+    atomic_store(&writer_running, 0);
+    eventfd_write(writer_fd, 1);
+    pthread_join(writer_thread, NULL);
+    log_drain();
+    close(writer_fd);
+    writer_fd = -1;
+}
+
+void Log_Settings(cJSON* settings) {
+    cJSON* log = cJSON_GetObjectItem(settings, "log");
+    cJSON* item = cJSON_GetObjectItem(log, "burst");
+    atomic_store(&burst, item && cJSON_IsNumber(item) && item->valueint > 0 ? (unsigned int)item->valueint : LOG_DEFAULT_BURST);
+    item = cJSON_GetObjectItem(log, "windowMs");
+    atomic_store(&window_us, (item && cJSON_IsNumber(item) && item->valueint > 0 ? (unsigned long long)item->valueint : LOG_DEFAULT_WINDOW) * 1000ULL);
+    atomic_store(&default_level, log_level_parse(cJSON_GetObjectItem(log, "level"), LOG_LEVEL_INFO));
+
+    pthread_mutex_lock(&module_mutex);
+    cJSON_Delete(module_levels);
+    cJSON* levels = cJSON_GetObjectItem(log, "modules");
+    module_levels = levels && cJSON_IsObject(levels) ? cJSON_Duplicate(levels, 1) : NULL;
+    int count = atomic_load(&module_count);
+    for (int i = 0; i < count; i++)
+        atomic_store(&modules[i].level, module_level(modules[i].name));
+    pthread_mutex_unlock(&module_mutex);
+}
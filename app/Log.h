@@ -0,0 +1,104 @@
+/**
+ * Log.h - Shared logging
+ *
+ * Each module defines LOG_MODULE and includes this header in place of its
+ * own LOG, LOG_WARN and LOG_TRACE macros:
+ *
+ *     #define LOG_MODULE "Model"
+ *     #include "Log.h"
+ *
+ * Messages are formatted into a lock-free ring and written to syslog and
+ * stdout by a background thread, so the frame loop never waits for syslog.
+ * Levels can be set per module at runtime (setting "log"). Levels above
+ * LOG_COMPILE_LEVEL are removed by the compiler, and each call site is
+ * limited to a burst of messages per window; suppressed messages are
+ * counted and reported.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_LEVEL_WARN  0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_VERBOSE 2
+#define LOG_LEVEL_TRACE 3
+
+/* Build with -DLOG_COMPILE_LEVEL=LOG_LEVEL_TRACE to keep LOG_TRACE calls */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_VERBOSE
+#endif
+
+/**
+ * Per call site state, one static instance per LOG macro
+ */
+typedef struct {
+    const char* module;
+    atomic_int index;               /* Module slot + 1, 0 until first use */
+    atomic_ullong window_us;        /* Start of the current rate window */
+    atomic_uint count;              /* Messages in the current window */
+    atomic_uint suppressed;         /* Messages dropped in the current window */
+} LogSite;
+
+#define LOG_AT(level, fmt, args...) do { \
+    static LogSite _log_site = { .module = LOG_MODULE }; \
+    if ((level) <= LOG_COMPILE_LEVEL && Log_Enabled(&_log_site, level)) \
+        Log_Write(&_log_site, level, fmt, ## args); \
+} while (0)
+
+/* For work done only to build a message, e.g. printing a cJSON object */
+#define LOG_ENABLED(level) ({ \
+    static LogSite _log_site = { .module = LOG_MODULE }; \
+    (level) <= LOG_COMPILE_LEVEL && Log_Enabled(&_log_site, level); \
+})
+
+#define LOG_WARN(fmt, args...)  LOG_AT(LOG_LEVEL_WARN, fmt, ## args)
+#define LOG(fmt, args...)       LOG_AT(LOG_LEVEL_INFO, fmt, ## args)
+#define LOG_VERBOSE(fmt, args...) LOG_AT(LOG_LEVEL_VERBOSE, fmt, ## args)
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(fmt, args...) LOG_AT(LOG_LEVEL_TRACE, fmt, ## args)
+#else
+#define LOG_TRACE(fmt, args...) {}
+#endif
+
+/**
+ * Start the writer thread. Until then, and after Log_Stop(), messages are
+ * written directly by the calling thread.
+ */
+void Log_Init(void);
+
+/**
+ * Write the queued messages and stop the writer thread
+ */
+void Log_Stop(void);
+
+/**
+ * Read log.level, log.modules ({"Model": "verbose", ...}), log.burst and
+ * log.windowMs. Levels are "warn", "info", "verbose" and "trace".
+ *
+ * @param settings Application settings
+ */
+void Log_Settings(cJSON* settings);
+
+/**
+ * Level check for a call site; used by the macros
+ */
+int Log_Enabled(LogSite* site, int level);
+
+/**
+ * Queue a message for a call site; used by the macros
+ */
+void Log_Write(LogSite* site, int level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LOG_H
@@ -14,18 +14,19 @@ typedef struct MQTTPersistence_afterRead MQTTPersistence_afterRead;
 #include <stdlib.h>
 #include <string.h>
 #include <dlfcn.h>
-#include <syslog.h>
 #include <glib.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
 #include "ACAP.h"
 #include "MQTT.h"
 #include "MQTTAsync.h"
 #include "CERTS.h"
+#include "Metrics.h"
 
-#define LOG(fmt, ...) syslog(LOG_INFO, fmt, ##__VA_ARGS__); printf(fmt, ##__VA_ARGS__)
-#define LOG_WARN(fmt, ...) syslog(LOG_WARNING, fmt, ##__VA_ARGS__); printf(fmt, ##__VA_ARGS__)
-//#define LOG_TRACE(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
-#define LOG_TRACE(fmt, args...)    {}
+#define LOG_MODULE "MQTT"
+#include "Log.h"
 
 #define MQTTASYNC_MSG_QOS0 0
 #define MQTTASYNC_MSG_QOS1 1
@@ -33,6 +34,7 @@ typedef struct MQTTPersistence_afterRead MQTTPersistence_afterRead;
 
 // Function pointers for dynamically loaded Paho Async MQTT library
 typedef int (*MQTTAsync_create_func)(MQTTAsync*, const char*, const char*, int, void*);
+typedef int (*MQTTAsync_createWithOptions_func)(MQTTAsync*, const char*, const char*, int, void*, MQTTAsync_createOptions*);
 typedef int (*MQTTAsync_connect_func)(MQTTAsync, const MQTTAsync_connectOptions*);
 typedef int (*MQTTAsync_disconnect_func)(MQTTAsync, const MQTTAsync_disconnectOptions*);
 typedef int (*MQTTAsync_isConnected_func)(MQTTAsync);
@@ -47,6 +49,7 @@ typedef void (*MQTTAsync_free_func)(void* ptr);
 typedef void (*MQTTAsync_setConnected_func)(MQTTAsync handle, void* context, MQTTAsync_connected* co);
 static struct {
     MQTTAsync_create_func create;
+    MQTTAsync_createWithOptions_func createWithOptions;
     MQTTAsync_connect_func connect;
     MQTTAsync_disconnect_func disconnect;
     MQTTAsync_isConnected_func isConnected;
@@ -64,11 +67,14 @@ static struct {
 static void* MQTT_libHandle = NULL;
 static cJSON* MQTTSettings = NULL;
 static MQTTAsync mqtt_client = NULL;
+static int mqtt_version = MQTTVERSION_3_1_1;   /* Version the client was created for */
+static int mqtt_fallback = 0;                   /* Broker refused MQTT 5 */
 static MQTT_Callback_Message userSubscriptionCallback = NULL;
 static MQTT_Callback_Connection connectionCallback = NULL;
 static char LastWillTopic[64];
 static char LastWillMessage[512];
 static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int connect_enabled = 0;         /* MQTTSettings "connect", for the publish path */
 
 // Private function prototypes
 static int MQTT_SetupClient();
@@ -77,6 +83,9 @@ static int messageArrived(void* context, char* topicName, int topicLen, MQTTAsyn
 static void deliveryComplete(void* context, MQTTAsync_token token);
 static void onConnectFailure(void* context, MQTTAsync_failureData* response);
 static void onConnect(void* context, MQTTAsync_successData* response);
+static void onConnect5(void* context, MQTTAsync_successData5* response);
+static void onConnectFailure5(void* context, MQTTAsync_failureData5* response);
+static void onDisconnect5(void* context, MQTTAsync_successData5* response);
 static void onDisconnect(void* context, MQTTAsync_successData* response);
 static void onReconnect(void* context, char* cause);
 //static gboolean reconnect_task(gpointer user_data);
@@ -87,6 +96,697 @@ static int  MQTT_Connect(void);
 static int  MQTT_SetupClient(void);
 static void MQTT_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request);
 
+/*
+ * Outbound queue
+ *
+ * Publishes are queued and sent by queue_pump() with at most
+ * queue.inflight messages outstanding in the client. A message leaves the
+ * in-flight window when its send completes (onSent/onSendFailure). The
+ * queue is bounded by queue.maxQueued and the topic class decides what is
+ * dropped: detection summaries are coalesced to the latest per topic, crops
+ * beyond queue.maxCrops drop the oldest, and event transitions are only
+ * dropped when nothing else is left, or written to the SD card spool when
+ * queue.spool is set. The spool is replayed ahead of the queue after
+ * (re)connect, and whenever the queue has drained.
+ */
+
+#define QUEUE_DEFAULT_INFLIGHT  10
+#define QUEUE_DEFAULT_MAX       100
+#define QUEUE_DEFAULT_CROPS     5
+#define QUEUE_DEFAULT_SPOOL_KB  1024
+#define QUEUE_MAX_ATTEMPTS      3
+#define QUEUE_STATUS_INTERVAL   1000    /* ms between status updates */
+#ifndef SPOOL_FOLDER
+#define SPOOL_FOLDER            "/var/spool/storage/SD_DISK/detectx"
+#endif
+#define SPOOL_FILE              SPOOL_FOLDER "/mqtt.spool"
+
+enum { QUEUE_OTHER = 0, QUEUE_DETECTION, QUEUE_EVENT, QUEUE_CROP, QUEUE_CLASSES };
+
+typedef struct QueuedMessage {
+    struct QueuedMessage* next;
+    unsigned long id;           /* Response context while in flight */
+    int class;
+    int qos;
+    int retained;
+    int attempts;
+    int len;
+    char topic[256];
+    char payload[];
+} QueuedMessage;
+
+typedef struct {
+    uint16_t topic_len;
+    uint8_t class;
+    uint8_t qos;
+    uint8_t retained;
+    uint32_t len;
+} SpoolRecord;
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t send_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int pump_requested = 0;
+static QueuedMessage* queue_head = NULL;
+static QueuedMessage* queue_tail = NULL;
+static QueuedMessage* inflight_list = NULL;     /* In send order */
+static int queue_length = 0;
+static int queue_count[QUEUE_CLASSES];
+static int inflight_count = 0;
+static unsigned long next_id = 1;
+static unsigned long queue_dropped = 0;
+static unsigned long queue_coalesced = 0;
+static unsigned long queue_spooled = 0;
+static double queue_status_time = 0;
+static int queue_inflight_max = QUEUE_DEFAULT_INFLIGHT;
+static int queue_max = QUEUE_DEFAULT_MAX;
+static int queue_max_crops = QUEUE_DEFAULT_CROPS;
+static int spool_enabled = 0;
+static long spool_max_bytes = QUEUE_DEFAULT_SPOOL_KB * 1024L;
+static int spool_warned = 0;
+static int spool_pending = 1;   /* The spool file may hold messages */
+
+static int queue_class(const char* topic) {
+    if (strncmp(topic, "detection/", 10) == 0) return QUEUE_DETECTION;
+    if (strncmp(topic, "event/", 6) == 0)      return QUEUE_EVENT;
+    if (strncmp(topic, "crop/", 5) == 0)       return QUEUE_CROP;
+    return QUEUE_OTHER;
+}
+
+static int queue_setting(cJSON* queue, const char* name, int fallback, int min) {
+    cJSON* item = cJSON_GetObjectItem(queue, name);
+    return item && cJSON_IsNumber(item) && item->valueint >= min ? item->valueint : fallback;
+}
+
+static void queue_settings(void) {
+    cJSON* queue = cJSON_GetObjectItem(MQTTSettings, "queue");
+    pthread_mutex_lock(&queue_mutex);
+    queue_inflight_max = queue_setting(queue, "inflight", QUEUE_DEFAULT_INFLIGHT, 1);
+    queue_max = queue_setting(queue, "maxQueued", QUEUE_DEFAULT_MAX, 1);
+    queue_max_crops = queue_setting(queue, "maxCrops", QUEUE_DEFAULT_CROPS, 0);
+    spool_enabled = cJSON_IsTrue(cJSON_GetObjectItem(queue, "spool"));
+    spool_max_bytes = queue_setting(queue, "spoolMaxKB", QUEUE_DEFAULT_SPOOL_KB, 1) * 1024L;
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+static QueuedMessage* message_new(const char* topic, const void* payload, int len, int qos, int retained, int class) {
+    QueuedMessage* msg = malloc(sizeof(QueuedMessage) + len + 1);
+    if (!msg)
+        return NULL;
+    memset(msg, 0, sizeof(QueuedMessage));
+    snprintf(msg->topic, sizeof(msg->topic), "%s", topic);
+    memcpy(msg->payload, payload, len);
+    msg->payload[len] = 0;
+    msg->len = len;
+    msg->qos = qos;
+    msg->retained = retained;
+    msg->class = class;
+    return msg;
+}
+
+// Caller holds queue_mutex for all queue_* and spool_* helpers below
+static void queue_unlink(QueuedMessage* prev, QueuedMessage* msg) {
+    if (prev)
+        prev->next = msg->next;
+    else
+        queue_head = msg->next;
+    if (queue_tail == msg)
+        queue_tail = prev;
+    msg->next = NULL;
+    queue_length--;
+    queue_count[msg->class]--;
+}
+
+static void queue_append(QueuedMessage* msg) {
+    msg->next = NULL;
+    if (queue_tail)
+        queue_tail->next = msg;
+    else
+        queue_head = msg;
+    queue_tail = msg;
+    queue_length++;
+    queue_count[msg->class]++;
+}
+
+static void queue_prepend(QueuedMessage* msg) {
+    msg->next = queue_head;
+    queue_head = msg;
+    if (!queue_tail)
+        queue_tail = msg;
+    queue_length++;
+    queue_count[msg->class]++;
+}
+
+// Oldest queued message of a class, unlinked
+static QueuedMessage* queue_take_oldest(int class) {
+    QueuedMessage* prev = NULL;
+    for (QueuedMessage* msg = queue_head; msg; prev = msg, msg = msg->next) {
+        if (msg->class == class) {
+            queue_unlink(prev, msg);
+            return msg;
+        }
+    }
+    return NULL;
+}
+
+static int spool_write(const QueuedMessage* msg) {
+    if (!spool_enabled)
+        return 0;
+    mkdir(SPOOL_FOLDER, 0755);
+    FILE* file = fopen(SPOOL_FILE, "ab");
+    if (!file) {
+        if (!spool_warned) {
+            LOG_WARN("%s: Unable to open %s\n", __func__, SPOOL_FILE);
+            spool_warned = 1;
+        }
+        return 0;
+    }
+    SpoolRecord record = { (uint16_t)strlen(msg->topic), (uint8_t)msg->class, (uint8_t)msg->qos, (uint8_t)msg->retained, (uint32_t)msg->len };
+    int ok = ftell(file) + (long)(sizeof(record) + record.topic_len + record.len) <= spool_max_bytes &&
+             fwrite(&record, sizeof(record), 1, file) == 1 &&
+             fwrite(msg->topic, 1, record.topic_len, file) == record.topic_len &&
+             fwrite(msg->payload, 1, record.len, file) == record.len;
+    if (fclose(file) != 0)
+        ok = 0;
+    spool_warned = 0;
+    spool_pending = 1;
+    return ok;
+}
+
+// Put spooled messages ahead of the queue, in the order they were spooled
+static void spool_load(void) {
+    if (!spool_enabled || !spool_pending)
+        return;
+    spool_pending = 0;
+    FILE* file = fopen(SPOOL_FILE, "rb");
+    if (!file)
+        return;
+    QueuedMessage* first = NULL;
+    QueuedMessage* last = NULL;
+    int count = 0;
+    SpoolRecord record;
+    char topic[256];
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.topic_len >= sizeof(topic) || record.class >= QUEUE_CLASSES || (long)record.len > spool_max_bytes)
+            break;
+        if (fread(topic, 1, record.topic_len, file) != record.topic_len)
+            break;
+        topic[record.topic_len] = 0;
+        QueuedMessage* msg = malloc(sizeof(QueuedMessage) + record.len + 1);
+        if (!msg)
+            break;
+        memset(msg, 0, sizeof(QueuedMessage));
+        if (fread(msg->payload, 1, record.len, file) != record.len) {
+            free(msg);
+            break;
+        }
+        msg->payload[record.len] = 0;
+        snprintf(msg->topic, sizeof(msg->topic), "%s", topic);
+        msg->len = record.len;
+        msg->qos = record.qos;
+        msg->retained = record.retained;
+        msg->class = record.class;
+        if (last)
+            last->next = msg;
+        else
+            first = msg;
+        last = msg;
+        queue_length++;
+        queue_count[msg->class]++;
+        count++;
+    }
+    fclose(file);
+    unlink(SPOOL_FILE);
+    if (!first)
+        return;
+    last->next = queue_head;
+    queue_head = first;
+    if (!queue_tail)
+        queue_tail = last;
+    LOG("%s: Replaying %d spooled messages\n", __func__, count);
+}
+
+// Make room for one message; events are only dropped when nothing else is queued
+static void queue_trim(void) {
+    static const int order[] = { QUEUE_CROP, QUEUE_DETECTION, QUEUE_OTHER, QUEUE_EVENT };
+    while (queue_length > queue_max) {
+        QueuedMessage* msg = NULL;
+        for (int i = 0; !msg && i < 4; i++)
+            msg = queue_take_oldest(order[i]);
+        if (!msg)
+            break;
+        if (msg->class == QUEUE_EVENT && spool_write(msg)) {
+            queue_spooled++;
+        } else {
+            queue_dropped++;
+            if (msg->class == QUEUE_EVENT) {
+                LOG_WARN("%s: Queue full, event dropped: %s\n", __func__, msg->topic);
+            }
+        }
+        free(msg);
+    }
+}
+
+static void queue_push(QueuedMessage* msg) {
+    if (msg->class == QUEUE_DETECTION) {
+        QueuedMessage* prev = NULL;
+        for (QueuedMessage* old = queue_head; old; prev = old, old = old->next) {
+            if (old->class == QUEUE_DETECTION && strcmp(old->topic, msg->topic) == 0) {
+                queue_unlink(prev, old);
+                free(old);
+                queue_coalesced++;
+                break;
+            }
+        }
+    }
+    if (msg->class == QUEUE_CROP) {
+        while (queue_count[QUEUE_CROP] >= queue_max_crops) {
+            QueuedMessage* old = queue_take_oldest(QUEUE_CROP);
+            if (!old)
+                break;
+            free(old);
+            queue_dropped++;
+        }
+        if (queue_max_crops == 0) {
+            free(msg);
+            queue_dropped++;
+            return;
+        }
+    }
+    queue_append(msg);
+    queue_trim();
+}
+
+static QueuedMessage* inflight_take(unsigned long id) {
+    QueuedMessage* prev = NULL;
+    for (QueuedMessage* msg = inflight_list; msg; prev = msg, msg = msg->next) {
+        if (msg->id == id) {
+            if (prev)
+                prev->next = msg->next;
+            else
+                inflight_list = msg->next;
+            msg->next = NULL;
+            inflight_count--;
+            return msg;
+        }
+    }
+    return NULL;
+}
+
+static void inflight_add(QueuedMessage* msg) {
+    msg->id = next_id++;
+    msg->next = NULL;
+    QueuedMessage** last = &inflight_list;
+    while (*last)
+        last = &(*last)->next;
+    *last = msg;
+    inflight_count++;
+}
+
+static void queue_status(int force) {
+    pthread_mutex_lock(&queue_mutex);
+    double now = ACAP_DEVICE_Timestamp();
+    if (!force && now - queue_status_time < QUEUE_STATUS_INTERVAL) {
+        pthread_mutex_unlock(&queue_mutex);
+        return;
+    }
+    queue_status_time = now;
+    int queued = queue_length, inflight = inflight_count;
+    unsigned long dropped = queue_dropped, coalesced = queue_coalesced, spooled = queue_spooled;
+    pthread_mutex_unlock(&queue_mutex);
+
+    ACAP_STATUS_SetNumber("mqtt", "queued", queued);
+    ACAP_STATUS_SetNumber("mqtt", "inflight", inflight);
+    ACAP_STATUS_SetNumber("mqtt", "dropped", dropped);
+    ACAP_STATUS_SetNumber("mqtt", "coalesced", coalesced);
+    ACAP_STATUS_SetNumber("mqtt", "spooled", spooled);
+}
+
+static void onSent(void* context, MQTTAsync_successData* response);
+static void onSendFailure(void* context, MQTTAsync_failureData* response);
+
+/*
+ * Topic aliases (MQTT 5)
+ *
+ * detection/, event/ and crop/ topics get an alias from a table of up to
+ * the broker's Topic Alias Maximum. The first publish on a topic carries
+ * the topic and the alias, later ones only the alias. Aliases are reused
+ * round robin and belong to one connection; the callbacks only bump
+ * alias_epoch and the sender clears its table when it sees a new epoch.
+ */
+
+#define MQTT_MAX_ALIASES    16
+
+static atomic_int alias_limit = 0;      /* From CONNACK, 0 when aliases are off */
+static atomic_int alias_connack = 0;    /* Limit from the last CONNACK, restored after an automatic reconnect */
+static atomic_uint alias_epoch = 0;
+static unsigned int alias_seen_epoch = 0;
+static int alias_count = 0;
+static int alias_next = 0;
+static char alias_topics[MQTT_MAX_ALIASES][256];
+
+static void alias_reset(int limit) {
+    atomic_store(&alias_limit, limit < MQTT_MAX_ALIASES ? limit : MQTT_MAX_ALIASES);
+    atomic_fetch_add(&alias_epoch, 1);
+}
+
+// Sender only. Returns the alias for a topic, 0 for none; *known is set when the broker has the mapping
+static int alias_get(const char* topic, int* known) {
+    *known = 0;
+    unsigned int epoch = atomic_load(&alias_epoch);
+    if (epoch != alias_seen_epoch) {
+        alias_seen_epoch = epoch;
+        alias_count = atomic_load(&alias_limit);
+        alias_next = 0;
+        memset(alias_topics, 0, sizeof(alias_topics));
+    }
+    if (!alias_count)
+        return 0;
+    for (int i = 0; i < alias_count; i++) {
+        if (strcmp(alias_topics[i], topic) == 0) {
+            *known = 1;
+            return i + 1;
+        }
+    }
+    int i = alias_next;
+    alias_next = (alias_next + 1) % alias_count;
+    snprintf(alias_topics[i], sizeof(alias_topics[i]), "%s", topic);
+    return i + 1;
+}
+
+static void onSent5(void* context, MQTTAsync_successData5* response);
+static void onSendFailure5(void* context, MQTTAsync_failureData5* response);
+
+// Caller holds send_mutex, so messages and their aliases reach the client in queue order
+static void queue_send(void) {
+    for (;;) {
+        // Checked outside queue_mutex; the client takes its own lock
+        if (!mqtt_client || !mqtt.isConnected(mqtt_client))
+            break;
+        pthread_mutex_lock(&queue_mutex);
+        if (!queue_head)
+            spool_load();
+        if (!queue_head || inflight_count >= queue_inflight_max) {
+            pthread_mutex_unlock(&queue_mutex);
+            break;
+        }
+        QueuedMessage* msg = queue_head;
+        queue_unlink(NULL, msg);
+        inflight_add(msg);
+        unsigned long id = msg->id;
+        int len = msg->len;
+        pthread_mutex_unlock(&queue_mutex);
+
+        // The client copies topic, payload and properties; msg may be released by onSent as soon as this returns
+        MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
+        pubmsg.payload = msg->payload;
+        pubmsg.payloadlen = len;
+        pubmsg.qos = msg->qos;
+        pubmsg.retained = msg->retained;
+
+        MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+        opts.context = (void*)(uintptr_t)id;
+
+        const char* topic = msg->topic;
+        int alias = 0, known = 0;
+        MQTTProperty property;
+        if (mqtt_version == MQTTVERSION_5) {
+            opts.onSuccess5 = onSent5;
+            opts.onFailure5 = onSendFailure5;
+            if (msg->class != QUEUE_OTHER)
+                alias = alias_get(msg->topic, &known);
+            if (alias) {
+                property.identifier = MQTTPROPERTY_CODE_TOPIC_ALIAS;
+                property.value.integer2 = alias;
+                pubmsg.properties.count = 1;
+                pubmsg.properties.max_count = 1;
+                pubmsg.properties.length = 3;   /* Identifier and two byte value */
+                pubmsg.properties.array = &property;
+                if (known)
+                    topic = "";
+            }
+        } else {
+            opts.onSuccess = onSent;
+            opts.onFailure = onSendFailure;
+        }
+
+        // topic may point into msg, which onSent can free once the client has it
+        size_t topic_len = strlen(topic);
+        int rc = mqtt.sendMessage(mqtt_client, topic, &pubmsg, &opts);
+        if (rc == MQTTASYNC_SUCCESS) {
+            Metrics_Bytes(METRICS_BYTES_MQTT, len + topic_len);
+            continue;
+        }
+        // The broker never saw this mapping
+        if (alias && !known)
+            alias_topics[alias - 1][0] = 0;
+        pthread_mutex_lock(&queue_mutex);
+        QueuedMessage* failed = inflight_take(id);
+        if (failed) {
+            LOG_WARN("%s: MQTT publish failed on topic '%s' (rc=%d, payload size=%d bytes)\n", __func__, failed->topic, rc, len);
+            if (++failed->attempts < QUEUE_MAX_ATTEMPTS) {
+                queue_prepend(failed);
+            } else {
+                queue_dropped++;
+                free(failed);
+            }
+        }
+        pthread_mutex_unlock(&queue_mutex);
+        break;
+    }
+}
+
+// Send queued messages while the in-flight window has room. Never blocks:
+// if another thread is sending, it picks up the request before it stops.
+static void queue_pump(void) {
+    atomic_store(&pump_requested, 1);
+    while (atomic_load(&pump_requested)) {
+        if (pthread_mutex_trylock(&send_mutex) != 0)
+            break;
+        atomic_store(&pump_requested, 0);
+        queue_send();
+        pthread_mutex_unlock(&send_mutex);
+    }
+    queue_status(0);
+}
+
+static void onSent(void* context, MQTTAsync_successData* response) {
+    pthread_mutex_lock(&queue_mutex);
+    QueuedMessage* msg = inflight_take((unsigned long)(uintptr_t)context);
+    pthread_mutex_unlock(&queue_mutex);
+    free(msg);
+    queue_pump();
+}
+
+// Events and other messages are retried; a late failure for a message already requeued is ignored
+static void onSendFailure(void* context, MQTTAsync_failureData* response) {
+    pthread_mutex_lock(&queue_mutex);
+    QueuedMessage* msg = inflight_take((unsigned long)(uintptr_t)context);
+    if (msg) {
+        LOG_TRACE("%s: %s code %d\n", __func__, msg->topic, response ? response->code : 0);
+        if ((msg->class == QUEUE_EVENT || msg->class == QUEUE_OTHER) && ++msg->attempts < QUEUE_MAX_ATTEMPTS) {
+            queue_prepend(msg);
+        } else {
+            queue_dropped++;
+            free(msg);
+        }
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    queue_pump();
+}
+
+static void onSent5(void* context, MQTTAsync_successData5* response) {
+    onSent(context, NULL);
+}
+
+static void onSendFailure5(void* context, MQTTAsync_failureData5* response) {
+    onSendFailure(context, NULL);
+}
+
+// Connection lost: completions may never arrive, so requeue what may not have been delivered
+static void inflight_requeue(void) {
+    pthread_mutex_lock(&queue_mutex);
+    QueuedMessage* first = NULL;
+    QueuedMessage* last = NULL;
+    while (inflight_list) {
+        QueuedMessage* msg = inflight_list;
+        inflight_list = msg->next;
+        msg->next = NULL;
+        if (msg->class != QUEUE_EVENT && msg->class != QUEUE_OTHER) {
+            free(msg);
+            continue;
+        }
+        if (last)
+            last->next = msg;
+        else
+            first = msg;
+        last = msg;
+        queue_length++;
+        queue_count[msg->class]++;
+    }
+    inflight_count = 0;
+    if (first) {
+        last->next = queue_head;
+        if (!queue_head)
+            queue_tail = last;
+        queue_head = first;
+    }
+    queue_trim();
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+static void queue_connected(void) {
+    pthread_mutex_lock(&queue_mutex);
+    spool_load();
+    pthread_mutex_unlock(&queue_mutex);
+    queue_pump();
+    queue_status(1);
+}
+
+/*
+ * Publish templates
+ *
+ * The topic prefix and the name/location/serial members added to every JSON
+ * payload are rendered once per settings change instead of on each publish.
+ */
+
+static pthread_mutex_t template_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char topic_prefix[128] = "";
+static char* payload_fragment = NULL;  /* ,"name":"..","location":"..","serial":".." */
+static int payload_fragment_len = 0;
+
+static void templates_update(void) {
+    cJSON* preTopic = cJSON_GetObjectItem(MQTTSettings, "preTopic");
+    cJSON* fragment = cJSON_CreateObject();
+    cJSON* additional = cJSON_GetObjectItem(MQTTSettings, "payload");
+    cJSON* name = cJSON_GetObjectItem(additional, "name");
+    cJSON* location = cJSON_GetObjectItem(additional, "location");
+    if (cJSON_IsString(name) && strlen(name->valuestring))
+        cJSON_AddStringToObject(fragment, "name", name->valuestring);
+    if (cJSON_IsString(location) && strlen(location->valuestring))
+        cJSON_AddStringToObject(fragment, "location", location->valuestring);
+    const char* serial = ACAP_DEVICE_Prop("serial");
+    if (serial)
+        cJSON_AddStringToObject(fragment, "serial", serial);
+    char* json = cJSON_PrintUnformatted(fragment);
+    cJSON_Delete(fragment);
+
+    pthread_mutex_lock(&template_mutex);
+    if (cJSON_IsString(preTopic) && strlen(preTopic->valuestring)) {
+        if (snprintf(topic_prefix, sizeof(topic_prefix), "%s/", preTopic->valuestring) >= sizeof(topic_prefix)) {
+            LOG_WARN("%s: preTopic too long (truncated)\n", __func__);
+        }
+    } else {
+        topic_prefix[0] = 0;
+    }
+    free(payload_fragment);
+    payload_fragment = NULL;
+    payload_fragment_len = 0;
+    // Drop the braces and lead with a comma: {"a":1} -> ,"a":1
+    if (json && strlen(json) > 2) {
+        payload_fragment_len = strlen(json) - 1;
+        payload_fragment = json;
+        payload_fragment[0] = ',';
+        payload_fragment[payload_fragment_len] = 0;
+        json = NULL;
+    }
+    pthread_mutex_unlock(&template_mutex);
+    free(json);
+}
+
+// Serialize into a per-thread buffer that is reused across publishes
+static __thread char* format_buffer = NULL;
+static __thread int format_size = 0;
+
+static int format_reserve(int size) {
+    if (size <= format_size)
+        return 1;
+    int grown = format_size ? format_size : 4096;
+    while (grown < size)
+        grown *= 2;
+    char* buffer = realloc(format_buffer, grown);
+    if (!buffer)
+        return 0;
+    format_buffer = buffer;
+    format_size = grown;
+    return 1;
+}
+
+static const char* format_json(cJSON* payload, int* length) {
+    if (!format_reserve(4096))
+        return NULL;
+    // cJSON wants 5 bytes beyond what it prints
+    while (!cJSON_PrintPreallocated(payload, format_buffer, format_size - 5, 0)) {
+        if (format_size >= (64 << 20) || !format_reserve(format_size * 2))
+            return NULL;
+    }
+    int len = strlen(format_buffer);
+    if (cJSON_IsObject(payload) && len >= 2) {
+        pthread_mutex_lock(&template_mutex);
+        if (payload_fragment_len && format_reserve(len + payload_fragment_len + 1)) {
+            // Replace the closing brace; an empty object takes the fragment without its comma
+            int skip = len == 2;
+            memcpy(format_buffer + len - 1, payload_fragment + skip, payload_fragment_len - skip);
+            len += payload_fragment_len - skip;
+            format_buffer[len - 1] = '}';
+            format_buffer[len] = 0;
+        }
+        pthread_mutex_unlock(&template_mutex);
+    }
+    *length = len;
+    return format_buffer;
+}
+
+// Copy "connect" for publishers, which must not read MQTTSettings; caller holds config_mutex
+static void connect_update(void) {
+    atomic_store(&connect_enabled, cJSON_IsTrue(cJSON_GetObjectItem(MQTTSettings, "connect")));
+}
+
+// Publishing is accepted while a connection is configured, even if the broker is unreachable
+static int queue_accepting(void) {
+    return mqtt_client && atomic_load(&connect_enabled);
+}
+
+static int queue_publish(const char* topic, const void* payload, int len, int qos, int retained) {
+    char fullTopic[256];
+    pthread_mutex_lock(&template_mutex);
+    int result = snprintf(fullTopic, sizeof(fullTopic), "%s%s", topic_prefix, topic);
+    pthread_mutex_unlock(&template_mutex);
+    if (result >= sizeof(fullTopic)) {
+        LOG_WARN("%s: Topic too long (truncated)\n", __func__);
+        // Continue anyway - topic will be truncated but still valid
+    }
+
+    QueuedMessage* msg = message_new(fullTopic, payload, len, qos, retained, queue_class(topic));
+    if (!msg) {
+        LOG_WARN("%s: Out of memory (payload size=%d bytes)\n", __func__, len);
+        return 0;
+    }
+    pthread_mutex_lock(&queue_mutex);
+    queue_push(msg);
+    pthread_mutex_unlock(&queue_mutex);
+    queue_pump();
+    return 1;
+}
+
+// Remaining events are spooled when enabled, everything else is released
+static void queue_clear(void) {
+    pthread_mutex_lock(&queue_mutex);
+    while (inflight_list) {
+        QueuedMessage* msg = inflight_list;
+        inflight_list = msg->next;
+        free(msg);
+    }
+    inflight_count = 0;
+    while (queue_head) {
+        QueuedMessage* msg = queue_head;
+        queue_unlink(NULL, msg);
+        if (msg->class == QUEUE_EVENT)
+            spool_write(msg);
+        free(msg);
+    }
+    pthread_mutex_unlock(&queue_mutex);
+}
+
 
 cJSON*
 MQTT_Settings() {
@@ -127,16 +827,24 @@ MQTT_Connect() {
     static MQTTAsync_willOptions will_opts = MQTTAsync_willOptions_initializer;
     
     MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
+    if (mqtt_version == MQTTVERSION_5)
+        conn_opts = (MQTTAsync_connectOptions)MQTTAsync_connectOptions_initializer5;
     
     // Essential connection parameters
     conn_opts.keepAliveInterval = 60;
-    conn_opts.cleansession = 1;
     conn_opts.automaticReconnect = 1;
     conn_opts.minRetryInterval = 5;
     conn_opts.maxRetryInterval = 60;
     conn_opts.connectTimeout = 30;  // Add connection timeout
-    conn_opts.onSuccess = onConnect;
-    conn_opts.onFailure = onConnectFailure;
+    if (mqtt_version == MQTTVERSION_5) {
+        conn_opts.cleanstart = 1;
+        conn_opts.onSuccess5 = onConnect5;
+        conn_opts.onFailure5 = onConnectFailure5;
+    } else {
+        conn_opts.cleansession = 1;
+        conn_opts.onSuccess = onConnect;
+        conn_opts.onFailure = onConnectFailure;
+    }
     conn_opts.context = mqtt_client;
     
     // Authentication configuration
@@ -159,16 +867,16 @@ MQTT_Connect() {
 		const char* key = CERTS_Get_Key();
 		const char* password = CERTS_Get_Password();
 		
-		LOG_TRACE("%s: Initializing TLS", __func__);
+		LOG_TRACE("%s: Initializing TLS\n", __func__);
 		ssl_opts = (MQTTAsync_SSLOptions)MQTTAsync_SSLOptions_initializer;
 		ssl_opts.sslVersion = 3; // TLS 1.2
 		
 		// Always set trust store if available, regardless of length
 		if (caCert && strlen(caCert) > 0) {
 			ssl_opts.trustStore = caCert;
-			LOG_TRACE("TLS: Trust store configured");
+			LOG_TRACE("TLS: Trust store configured\n");
 		} else {
-			LOG_WARN("TLS: No CA certificate available");
+			LOG_WARN("TLS: No CA certificate available\n");
 		}
 		
 		// Client certificate configuration
@@ -178,11 +886,11 @@ MQTT_Connect() {
 			if (password && strlen(password) > 0) {
 				ssl_opts.privateKeyPassword = password;
 			}
-			LOG_TRACE("TLS: Client certificate configured");
+			LOG_TRACE("TLS: Client certificate configured\n");
 		}
 		
 		ssl_opts.enableServerCertAuth = cJSON_IsTrue(cJSON_GetObjectItem(MQTTSettings, "verify"));
-		LOG_TRACE("TLS: Server cert auth = %d", ssl_opts.enableServerCertAuth);
+		LOG_TRACE("TLS: Server cert auth = %d\n", ssl_opts.enableServerCertAuth);
 		
 		conn_opts.ssl = &ssl_opts;
 	}
@@ -300,6 +1008,7 @@ MQTT_Connect() {
         connect_item->type = cJSON_True;
 		ACAP_FILE_Write("localdata/mqtt.json", MQTTSettings);
 	}
+    connect_update();
    
     return 1;
 }
@@ -312,7 +1021,12 @@ MQTT_Disconnect() {
 	ACAP_STATUS_SetBool("mqtt","connected",0);
     
     MQTTAsync_disconnectOptions disc_opts = MQTTAsync_disconnectOptions_initializer;
-    disc_opts.onSuccess = onDisconnect;
+    if (mqtt_version == MQTTVERSION_5) {
+        disc_opts = (MQTTAsync_disconnectOptions)MQTTAsync_disconnectOptions_initializer5;
+        disc_opts.onSuccess5 = onDisconnect5;
+    } else {
+        disc_opts.onSuccess = onDisconnect;
+    }
     disc_opts.context = mqtt_client;
     
     return (mqtt.disconnect(mqtt_client, &disc_opts) == MQTTASYNC_SUCCESS);
@@ -320,8 +1034,7 @@ MQTT_Disconnect() {
 
 int
 MQTT_Publish(const char *topic, const char *payload, int qos, int retained) {
-//    LOG_TRACE("%s:\n",__func__);
-    if (!mqtt_client || !mqtt.isConnected(mqtt_client)) {
+    if (!queue_accepting()) {
         return 0;
     }
     
@@ -330,94 +1043,55 @@ MQTT_Publish(const char *topic, const char *payload, int qos, int retained) {
         return 0;
     }
 
-    char *preTopic = cJSON_GetObjectItem(MQTTSettings, "preTopic") ? 
-                     cJSON_GetObjectItem(MQTTSettings, "preTopic")->valuestring : NULL;
-    char fullTopic[256];
-    
-    if (preTopic && strlen(preTopic) > 0) {
-        int result = snprintf(fullTopic, sizeof(fullTopic), "%s/%s", preTopic, topic);
-        if (result >= sizeof(fullTopic)) {
-            LOG_WARN("%s: Topic too long (truncated)\n", __func__);
-            // Continue anyway - topic will be truncated but still valid
-        }
-    } else {
-        strncpy(fullTopic, topic, sizeof(fullTopic) - 1);
-        fullTopic[sizeof(fullTopic) - 1] = '\0';
-    }
-
-//    LOG_TRACE("%s: %s %s\n",__func__,fullTopic,payload);
+    return queue_publish(topic, payload, strlen(payload), qos, retained);
+}
 
-    MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
-    pubmsg.payload = (void*)payload;
-    pubmsg.payloadlen = strlen(payload);
-    pubmsg.qos = qos;
-    pubmsg.retained = retained;
+// Serialize a payload with the configured name/location and the device serial added
+char*
+MQTT_Format_JSON(cJSON *payload) {
 
-    MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-    opts.context = mqtt_client;
-    
-    int rc = mqtt.sendMessage(mqtt_client, fullTopic, &pubmsg, &opts);
-    if( rc != MQTTASYNC_SUCCESS )
-        LOG_WARN("%s: MQTT publish failed on topic '%s' (rc=%d, payload size=%d bytes)\n", __func__, fullTopic, rc, pubmsg.payloadlen);
+    if (!payload) {
+        LOG_WARN("%s: NULL payload\n", __func__);
+        return 0;
+    }
 
-    return (rc == MQTTASYNC_SUCCESS);
+    int len = 0;
+    const char* json = format_json(payload, &len);
+    if (!json) {
+        LOG_WARN("%s: Failed to serialize JSON\n", __func__);
+        return 0;
+    }
+    char* copy = malloc(len + 1);
+    if (copy)
+        memcpy(copy, json, len + 1);
+    return copy;
 }
 
 int
 MQTT_Publish_JSON(const char *topic, cJSON *payload, int qos, int retained) {
 
-    if (!mqtt_client || !mqtt.isConnected(mqtt_client)) {
-        return 0;
-    }
-    
-    if (!payload) {
-        LOG_WARN("%s: NULL payload\n", __func__);
+    if (!queue_accepting()) {
         return 0;
     }
 
-    cJSON* publish = cJSON_Duplicate(payload, 1);
-    if (!publish) {
-        LOG_WARN("%s: Failed to duplicate JSON\n", __func__);
+    if (!topic || !payload) {
+        LOG_WARN("%s: Invalid parameters\n", __func__);
         return 0;
     }
-    
-    cJSON* additional = cJSON_GetObjectItem(MQTTSettings, "payload");
-    if(additional) {
-        // Fixed: Proper NULL checking
-        cJSON* name_item = cJSON_GetObjectItem(additional, "name");
-        cJSON* location_item = cJSON_GetObjectItem(additional, "location");
-        
-        if(name_item && name_item->valuestring && strlen(name_item->valuestring)) {
-            cJSON_AddStringToObject(publish, "name", name_item->valuestring);
-        }
-        if(location_item && location_item->valuestring && strlen(name_item->valuestring)) {
-            cJSON_AddStringToObject(publish, "location", location_item->valuestring);
-        }
-    }
-    
-    const char* serial = ACAP_DEVICE_Prop("serial");
-    if (serial) {
-        cJSON_AddStringToObject(publish, "serial", serial);
-    }
-    
-    char* json = cJSON_PrintUnformatted(publish);
-    int result = 0;
-    
-    if (json) {
-        result = MQTT_Publish(topic, json, qos, retained);
-        free(json);
-    } else {
+
+    int len = 0;
+    const char* json = format_json(payload, &len);
+    if (!json) {
         LOG_WARN("%s: Failed to serialize JSON\n", __func__);
+        return 0;
     }
-    
-    cJSON_Delete(publish);
-    return result;
+    return queue_publish(topic, json, len, qos, retained);
 }
 
 int
 MQTT_Publish_Binary(const char *topic, int payloadlen, void *payload, int qos, int retained) {
     
-    if (!mqtt_client || !mqtt.isConnected(mqtt_client)) {
+    if (!queue_accepting()) {
         return 0;
     }
     
@@ -426,34 +1100,7 @@ MQTT_Publish_Binary(const char *topic, int payloadlen, void *payload, int qos, i
         return 0;
     }
 
-    char *preTopic = cJSON_GetObjectItem(MQTTSettings, "preTopic") ? cJSON_GetObjectItem(MQTTSettings, "preTopic")->valuestring : NULL;
-    char *fullTopic = NULL;
-    
-    if (preTopic && strlen(preTopic) > 0) {
-        fullTopic = malloc(strlen(preTopic) + strlen(topic) + 2); // +2 for '/' and null terminator
-        if (!fullTopic) {
-            LOG_WARN("%s: Failed to allocate memory for full topic\n", __func__);
-            return 0;
-        }
-        sprintf(fullTopic, "%s/%s", preTopic, topic);
-    } else {
-        fullTopic = (char *)topic;
-    }
-
-
-
-    MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
-    pubmsg.payload = (void*)payload;
-    pubmsg.payloadlen = payloadlen;
-    pubmsg.qos = qos;
-    pubmsg.retained = retained;
-
-    MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-    opts.context = mqtt_client;
-   
-    int rc = mqtt.sendMessage(mqtt_client, fullTopic, &pubmsg, &opts);
-    
-    return (rc == MQTTASYNC_SUCCESS);
+    return queue_publish(topic, payload, payloadlen, qos, retained);
 }
 
 int
@@ -502,6 +1149,9 @@ MQTT_Load_Library() {
 	LOAD_SYMBOL(setConnected)
     LOAD_SYMBOL(destroy)
 
+    // MQTT 5 needs createWithOptions; older libraries stay on 3.1.1
+    mqtt.createWithOptions = dlsym(MQTT_libHandle, "MQTTAsync_createWithOptions");
+
     return 1;
 }
 
@@ -538,8 +1188,17 @@ MQTT_SetupClient() {
     snprintf(clientId, sizeof(clientId), "%s-%s", 
             ACAP_Name(), ACAP_DEVICE_Prop("serial"));
 
-    /* Create client instance */
-    int rc = mqtt.create(&mqtt_client, serverURI, clientId, MQTTASYNC_PERSISTENCE_NONE, NULL);
+    /* Create client instance, MQTT 5 unless disabled or refused by the broker */
+    int rc;
+    cJSON* mqtt5 = cJSON_GetObjectItem(MQTTSettings, "mqtt5");
+    if (mqtt.createWithOptions && !cJSON_IsFalse(mqtt5) && !mqtt_fallback) {
+        MQTTAsync_createOptions create_opts = MQTTAsync_createOptions_initializer5;
+        mqtt_version = MQTTVERSION_5;
+        rc = mqtt.createWithOptions(&mqtt_client, serverURI, clientId, MQTTASYNC_PERSISTENCE_NONE, NULL, &create_opts);
+    } else {
+        mqtt_version = MQTTVERSION_3_1_1;
+        rc = mqtt.create(&mqtt_client, serverURI, clientId, MQTTASYNC_PERSISTENCE_NONE, NULL);
+    }
     if (rc != MQTTASYNC_SUCCESS) {
         LOG_WARN("%s: Client creation failed: %d\n", __func__, rc);
         return 0;
@@ -563,6 +1222,9 @@ static void connectionLost(void* context, char* cause) {
 	ACAP_STATUS_SetBool("mqtt","connected",0);
 	
     LOG_WARN("Connection lost: %s\n", cause ? cause : "unknown reason");
+    alias_reset(0);
+    inflight_requeue();
+    queue_status(1);
     
     connectionCallback(MQTT_RECONNECTING);
 }
@@ -587,6 +1249,7 @@ messageArrived(void* context, char* topicName, int topicLen, MQTTAsync_message*
     return 1;
 }
 
+// QoS 1/2 only; the in-flight window is released by the send callbacks, which also cover QoS 0
 static void
 deliveryComplete(void* context, MQTTAsync_token token) {
     LOG_TRACE("Message delivery confirmed for token %d\n", token);
@@ -596,18 +1259,79 @@ static void
 onConnect(void* context, MQTTAsync_successData* response) {
 	ACAP_STATUS_SetString("mqtt","status","Connected");
 	ACAP_STATUS_SetBool("mqtt","connected",1);
+	if (mqtt_version != MQTTVERSION_5) {
+		ACAP_STATUS_SetNumber("mqtt", "version", 4);
+		ACAP_STATUS_SetNumber("mqtt", "topicAliases", 0);
+	}
 
     LOG_TRACE("%s: Connection established to %s\n",__func__, response ? response->alt.connect.serverURI : "unknown");
     connectionCallback(MQTT_CONNECTED);
+    queue_connected();
 	LOG_TRACE("%s: Exit\n",__func__);
 }
 
+// MQTT 5: aliases are enabled up to the broker's Topic Alias Maximum
+static void
+onConnect5(void* context, MQTTAsync_successData5* response) {
+    int limit = 0;
+    for (int i = 0; response && i < response->properties.count; i++) {
+        if (response->properties.array[i].identifier == MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM)
+            limit = response->properties.array[i].value.integer2;
+    }
+    atomic_store(&alias_connack, limit);
+    alias_reset(limit);
+    ACAP_STATUS_SetNumber("mqtt", "version", 5);
+    ACAP_STATUS_SetNumber("mqtt", "topicAliases", limit < MQTT_MAX_ALIASES ? limit : MQTT_MAX_ALIASES);
+    onConnect(context, NULL);
+}
+
+// Recreate the client for MQTT 3.1.1 outside the client's callback thread
+static gboolean
+MQTT_Fallback(gpointer user_data) {
+    pthread_mutex_lock(&config_mutex);
+    if (mqtt_client) {
+        mqtt.destroy(&mqtt_client);
+        mqtt_client = NULL;
+        inflight_requeue();
+    }
+    if (MQTT_SetupClient())
+        MQTT_Connect();
+    pthread_mutex_unlock(&config_mutex);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+onConnectFailure5(void* context, MQTTAsync_failureData5* response) {
+    // A 3.1.1 broker answers a version 5 CONNECT with return code 1
+    if (response && !mqtt_fallback &&
+        (response->reasonCode == MQTTREASONCODE_UNSUPPORTED_PROTOCOL_VERSION || response->code == 1)) {
+        LOG("%s: Broker does not support MQTT 5, using 3.1.1\n", __func__);
+        mqtt_fallback = 1;
+        g_idle_add(MQTT_Fallback, NULL);
+        return;
+    }
+    MQTTAsync_failureData failure = { 0 };
+    if (response) {
+        failure.token = response->token;
+        failure.code = response->code ? response->code : response->reasonCode;
+        failure.message = response->message;
+    }
+    onConnectFailure(context, response ? &failure : NULL);
+}
+
 static void
 onReconnect(void* context, char* cause) {
     LOG("%s: Reconnected to MQTT broker.  %s\n",__func__, cause?cause:"Unknown");
 	ACAP_STATUS_SetString("mqtt","status","Connected");
 	ACAP_STATUS_SetBool("mqtt","connected",1);
 //    connectionCallback(MQTT_RECONNECTED);
+    // Automatic reconnects do not report the CONNACK; assume the broker kept its Topic Alias Maximum
+    if (mqtt_version == MQTTVERSION_5) {
+        int limit = atomic_load(&alias_connack);
+        alias_reset(limit);
+        ACAP_STATUS_SetNumber("mqtt", "topicAliases", limit < MQTT_MAX_ALIASES ? limit : MQTT_MAX_ALIASES);
+    }
+    queue_connected();
 	LOG_TRACE("%s: Exit\n",__func__);
 }
 
@@ -616,9 +1340,15 @@ onDisconnect(void* context, MQTTAsync_successData* response) {
 	LOG_TRACE("%s:\n",__func__);
 	ACAP_STATUS_SetString("mqtt","status","Disconnected");
 	ACAP_STATUS_SetBool("mqtt","connected",0);
+    inflight_requeue();
     connectionCallback(MQTT_DISCONNECTED);
 }
 
+static void
+onDisconnect5(void* context, MQTTAsync_successData5* response) {
+    onDisconnect(context, NULL);
+}
+
 static void
 onConnectFailure(void* context, MQTTAsync_failureData* response) {
     char text[256] = "Connection failed";
@@ -632,7 +1362,7 @@ onConnectFailure(void* context, MQTTAsync_failureData* response) {
         }
     }
     
-    LOG_WARN("%s", text);
+    LOG_WARN("%s\n", text);
 
 	ACAP_STATUS_SetString("mqtt","status",text);
 	ACAP_STATUS_SetBool("mqtt","connected",0);
@@ -652,6 +1382,8 @@ MQTT_Cleanup() {
         if (mqtt.isConnected && mqtt.isConnected(mqtt_client)) {
             // Synchronous disconnect with timeout
             MQTTAsync_disconnectOptions opts = MQTTAsync_disconnectOptions_initializer;
+            if (mqtt_version == MQTTVERSION_5)
+                opts = (MQTTAsync_disconnectOptions)MQTTAsync_disconnectOptions_initializer5;
             opts.timeout = 5000;  // 5 second timeout
             
             pthread_mutex_unlock(&config_mutex);  // Release mutex before async call
@@ -673,6 +1405,7 @@ MQTT_Cleanup() {
         mqtt.destroy(&mqtt_client);
         mqtt_client = NULL;
     }
+    queue_clear();
     
     // Clean up library handle
     if (MQTT_libHandle) {
@@ -681,6 +1414,7 @@ MQTT_Cleanup() {
     }
     
     // Clean up settings
+    atomic_store(&connect_enabled, 0);
     if (MQTTSettings) {
         cJSON_Delete(MQTTSettings);
         MQTTSettings = NULL;
@@ -710,6 +1444,9 @@ MQTT_Load_Settings() {
         }
         cJSON_Delete(saved);
     }
+    connect_update();
+    queue_settings();
+    templates_update();
     return 1;
 }
 
@@ -721,7 +1458,7 @@ MQTT_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request re
     // 1. Handle initial state checks
     if (!MQTTSettings) {
         ACAP_HTTP_Respond_Error(response, 500, "MQTT not initialized");
-        LOG_WARN("MQTT settings not initialized");
+        LOG_WARN("MQTT settings not initialized\n");
         pthread_mutex_unlock(&config_mutex);
         return;
     }
@@ -735,6 +1472,7 @@ MQTT_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request re
         
         if (MQTT_Disconnect()) {
             cJSON_GetObjectItem(MQTTSettings, "connect")->type = cJSON_False;
+            connect_update();
             ACAP_FILE_Write("localdata/mqtt.json", MQTTSettings);
             ACAP_HTTP_Respond_Text(response, "Disconnected");
         } else {
@@ -770,6 +1508,7 @@ MQTT_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request re
             cJSON_ReplaceItemInObject(mqtt_payload, item->string, cJSON_Duplicate(item, 1));
             item = item->next;
         }
+        templates_update();
         
         ACAP_FILE_Write("localdata/mqtt.json", MQTTSettings);
         ACAP_HTTP_Respond_Text(response, "Payload updated");
@@ -786,13 +1525,17 @@ MQTT_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request re
         if (existing) {
             // Check if parameter requires reinitialization
             if (strcmp(key, "address") == 0 || strcmp(key, "port") == 0 || 
-                strcmp(key, "user") == 0 || strcmp(key, "password") == 0) {
+                strcmp(key, "user") == 0 || strcmp(key, "password") == 0 ||
+                strcmp(key, "mqtt5") == 0) {
                 full_reinit_required = 1;
             }
             cJSON_ReplaceItemInObject(MQTTSettings, key, cJSON_Duplicate(item, 1));
         }
         item = item->next;
     }
+    connect_update();
+    queue_settings();
+    templates_update();
 
     if (!ACAP_FILE_Write("localdata/mqtt.json", MQTTSettings)) {
         ACAP_HTTP_Respond_Error(response, 500, "Failed to save settings");
@@ -803,11 +1546,13 @@ MQTT_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request re
 
     if (full_reinit_required) {
         LOG_TRACE("%s Performing full MQTT reinitialization\n",__func__);
+        mqtt_fallback = 0;
         
         if (mqtt_client) {
             MQTT_Disconnect();
             mqtt.destroy(&mqtt_client);
             mqtt_client = NULL;
+            inflight_requeue();
         }
 
         if (!MQTT_SetupClient() ) {
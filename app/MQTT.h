@@ -30,6 +30,7 @@ void   MQTT_Cleanup();
 cJSON* MQTT_Settings();
 int    MQTT_Publish( const char *topic, const char *payload, int qos, int retained );
 int    MQTT_Publish_JSON( const char *topic, cJSON *payload, int qos, int retained );
+char*  MQTT_Format_JSON( cJSON *payload );
 int    MQTT_Publish_Binary( const char *topic, int payloadlen, void *payload, int qos, int retained );
 int    MQTT_Subscribe( const char *topic );
 int    MQTT_Unsubscribe( const char *topic );
@@ -0,0 +1,254 @@
+/**
+ * Metrics.c - Per-stage latency histograms and byte counters
+ *
+ * Histograms are log-linear: values below 16us get one bucket each, above that
+ * every power of two is split into 8 linear sub-buckets, giving a worst case
+ * relative error of 1/16 over the full range. All counters are relaxed
+ * atomics so the frame loop, HTTP thread and MQTT callbacks can record
+ * without taking a lock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include "Metrics.h"
+#include "Trace.h"
+#include "ACAP.h"
+#include "Text.h"
+
+#define LOG_MODULE "Metrics"
+#include "Log.h"
+
+#define METRICS_LINEAR_LIMIT 16     /* Values below this get one bucket each */
+#define METRICS_SUB_BITS 3          /* 8 sub-buckets per power of two */
+#define METRICS_SUB_COUNT (1 << METRICS_SUB_BITS)
+#define METRICS_MAX_EXPONENT 35     /* 2^36us is ~19 hours, longer values are clamped */
+#define METRICS_BUCKETS (METRICS_LINEAR_LIMIT + (METRICS_MAX_EXPONENT - 4 + 1) * METRICS_SUB_COUNT)
+
+typedef struct {
+    atomic_uint_fast64_t buckets[METRICS_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum;
+    atomic_uint_fast64_t max;
+} MetricsHistogram;
+
+static MetricsHistogram histograms[METRICS_STAGE_COUNT];
+static atomic_uint_fast64_t byte_counters[METRICS_BYTES_COUNT];
+
+static const char* stage_names[METRICS_STAGE_COUNT] = {
+    [METRICS_FRAME_AGE]     = "frame_age",
+    [METRICS_CAPTURE]       = "capture",
+    [METRICS_QUALITY]       = "quality",
+    [METRICS_CHANGE_GATE]   = "change_gate",
+    [METRICS_RESIZE]        = "resize",
+    [METRICS_COLOR_CONVERT] = "color_convert",
+    [METRICS_JPEG_ENCODE]   = "jpeg_encode",
+    [METRICS_HUB_CONNECT]   = "hub_connect",
+    [METRICS_HUB_TLS]       = "hub_tls",
+    [METRICS_HUB_UPLOAD]    = "hub_upload",
+    [METRICS_HUB_TTFB]      = "hub_ttfb",
+    [METRICS_HUB_DOWNLOAD]  = "hub_download",
+    [METRICS_HUB_TOTAL]     = "hub_total",
+    [METRICS_HUB_PARSE]     = "hub_parse",
+    [METRICS_INFERENCE]     = "inference",
+    [METRICS_FILTER]        = "filter",
+    [METRICS_OUTPUT_STATUS] = "output_status",
+    [METRICS_OUTPUT_MQTT]   = "output_mqtt",
+    [METRICS_OUTPUT_CROP]   = "output_crop",
+    [METRICS_OUTPUT_SDCARD] = "output_sdcard",
+    [METRICS_OUTPUT_HTTP]   = "output_http",
+    [METRICS_OUTPUT]        = "output",
+    [METRICS_FRAME]         = "frame"
+};
+
+static const char* destination_names[METRICS_BYTES_COUNT] = {
+    [METRICS_BYTES_HUB_UPLOAD]   = "hub_upload",
+    [METRICS_BYTES_HUB_DOWNLOAD] = "hub_download",
+    [METRICS_BYTES_MQTT]         = "mqtt",
+    [METRICS_BYTES_HTTP]         = "http",
+    [METRICS_BYTES_SDCARD]       = "sdcard",
+    [METRICS_BYTES_SNAPSHOT]     = "snapshot"
+};
+
+static unsigned int bucket_index(uint64_t value) {
+    if (value < METRICS_LINEAR_LIMIT)
+        return (unsigned int)value;
+    unsigned int exponent = 63 - __builtin_clzll(value);
+    if (exponent > METRICS_MAX_EXPONENT)
+        return METRICS_BUCKETS - 1;
+    unsigned int sub = (unsigned int)(value >> (exponent - METRICS_SUB_BITS)) & (METRICS_SUB_COUNT - 1);
+    return METRICS_LINEAR_LIMIT + (exponent - 4) * METRICS_SUB_COUNT + sub;
+}
+
+// Midpoint of the value range covered by a bucket
+static uint64_t bucket_value(unsigned int index) {
+    if (index < METRICS_LINEAR_LIMIT)
+        return index;
+    unsigned int exponent = 4 + (index - METRICS_LINEAR_LIMIT) / METRICS_SUB_COUNT;
+    unsigned int sub = (index - METRICS_LINEAR_LIMIT) % METRICS_SUB_COUNT;
+    uint64_t width = 1ULL << (exponent - METRICS_SUB_BITS);
+    uint64_t lower = (uint64_t)(METRICS_SUB_COUNT + sub) * width;
+    return lower + width / 2;
+}
+
+uint64_t Metrics_Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+void Metrics_Record(MetricsStage stage, uint64_t micros) {
+    if ((unsigned int)stage >= METRICS_STAGE_COUNT)
+        return;
+    MetricsHistogram* h = &histograms[stage];
+    atomic_fetch_add_explicit(&h->buckets[bucket_index(micros)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, micros, memory_order_relaxed);
+    uint_fast64_t current = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (micros > current &&
+           !atomic_compare_exchange_weak_explicit(&h->max, &current, micros,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void Metrics_Span(MetricsStage stage, uint64_t start_us, uint64_t end_us) {
+    if ((unsigned int)stage >= METRICS_STAGE_COUNT)
+        return;
+    Metrics_Record(stage, end_us > start_us ? end_us - start_us : 0);
+    Trace_Span(stage_names[stage], start_us, end_us);
+}
+
+uint64_t Metrics_Since(MetricsStage stage, uint64_t start_us) {
+    uint64_t now = Metrics_Now();
+    Metrics_Span(stage, start_us, now);
+    return now;
+}
+
+void Metrics_Bytes(MetricsDestination dest, size_t bytes) {
+    if ((unsigned int)dest >= METRICS_BYTES_COUNT)
+        return;
+    atomic_fetch_add_explicit(&byte_counters[dest], bytes, memory_order_relaxed);
+}
+
+// Quantile from a bucket snapshot so several quantiles are mutually consistent
+static uint64_t snapshot_percentile(const uint64_t* counts, uint64_t total, uint64_t max, double quantile) {
+    if (total == 0)
+        return 0;
+    if (quantile <= 0)
+        quantile = 0;
+    if (quantile >= 1)
+        return max;
+    uint64_t rank = (uint64_t)(quantile * (double)total);
+    if (rank >= total)
+        rank = total - 1;
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < METRICS_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen > rank) {
+            uint64_t value = bucket_value(i);
+            return value > max ? max : value;
+        }
+    }
+    return max;
+}
+
+static uint64_t snapshot_histogram(MetricsStage stage, uint64_t* counts) {
+    uint64_t total = 0;
+    for (unsigned int i = 0; i < METRICS_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&histograms[stage].buckets[i], memory_order_relaxed);
+        total += counts[i];
+    }
+    return total;
+}
+
+uint64_t Metrics_Percentile(MetricsStage stage, double quantile) {
+    if ((unsigned int)stage >= METRICS_STAGE_COUNT)
+        return 0;
+    uint64_t counts[METRICS_BUCKETS];
+    uint64_t total = snapshot_histogram(stage, counts);
+    uint64_t max = atomic_load_explicit(&histograms[stage].max, memory_order_relaxed);
+    return snapshot_percentile(counts, total, max, quantile);
+}
+
+void Metrics_Reset(void) {
+    for (unsigned int s = 0; s < METRICS_STAGE_COUNT; s++) {
+        for (unsigned int i = 0; i < METRICS_BUCKETS; i++)
+            atomic_store_explicit(&histograms[s].buckets[i], 0, memory_order_relaxed);
+        atomic_store_explicit(&histograms[s].count, 0, memory_order_relaxed);
+        atomic_store_explicit(&histograms[s].sum, 0, memory_order_relaxed);
+        atomic_store_explicit(&histograms[s].max, 0, memory_order_relaxed);
+    }
+    for (unsigned int d = 0; d < METRICS_BYTES_COUNT; d++)
+        atomic_store_explicit(&byte_counters[d], 0, memory_order_relaxed);
+}
+
+static void
+Metrics_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    const char* method = ACAP_HTTP_Get_Method(request);
+    if (!method || strcmp(method, "GET") != 0) {
+        ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Use GET");
+        return;
+    }
+
+    const char* reset = ACAP_HTTP_Request_Param(request, "reset");
+
+    Text text;
+    Text_Init(&text, 16384);
+    static const double quantiles[] = { 0.5, 0.9, 0.99 };
+    uint64_t counts[METRICS_BUCKETS];
+
+    Text_Append(&text, "# HELP detectx_stage_duration_seconds Per-stage frame pipeline latency.\n");
+    Text_Append(&text, "# TYPE detectx_stage_duration_seconds summary\n");
+    for (unsigned int s = 0; s < METRICS_STAGE_COUNT; s++) {
+        uint64_t total = snapshot_histogram(s, counts);
+        uint64_t max = atomic_load_explicit(&histograms[s].max, memory_order_relaxed);
+        uint64_t sum = atomic_load_explicit(&histograms[s].sum, memory_order_relaxed);
+        for (unsigned int q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            Text_Append(&text, "detectx_stage_duration_seconds{stage=\"%s\",quantile=\"%g\"} %.6f\n",
+                        stage_names[s], quantiles[q],
+                        snapshot_percentile(counts, total, max, quantiles[q]) / 1e6);
+        }
+        Text_Append(&text, "detectx_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n", stage_names[s], sum / 1e6);
+        Text_Append(&text, "detectx_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                    stage_names[s], (unsigned long long)total);
+    }
+
+    Text_Append(&text, "# HELP detectx_stage_duration_max_seconds Longest observed duration per stage.\n");
+    Text_Append(&text, "# TYPE detectx_stage_duration_max_seconds gauge\n");
+    for (unsigned int s = 0; s < METRICS_STAGE_COUNT; s++) {
+        uint64_t max = atomic_load_explicit(&histograms[s].max, memory_order_relaxed);
+        Text_Append(&text, "detectx_stage_duration_max_seconds{stage=\"%s\"} %.6f\n", stage_names[s], max / 1e6);
+    }
+
+    Text_Append(&text, "# HELP detectx_bytes_total Bytes transferred per destination.\n");
+    Text_Append(&text, "# TYPE detectx_bytes_total counter\n");
+    for (unsigned int d = 0; d < METRICS_BYTES_COUNT; d++) {
+        Text_Append(&text, "detectx_bytes_total{destination=\"%s\"} %llu\n", destination_names[d],
+                    (unsigned long long)atomic_load_explicit(&byte_counters[d], memory_order_relaxed));
+    }
+
+    if (reset) {
+        if (strcmp(reset, "1") == 0 || strcmp(reset, "true") == 0)
+            Metrics_Reset();
+        free((void*)reset);
+    }
+
+    if (!text.data) {
+        ACAP_HTTP_Respond_Error(response, 500, "Memory allocation failed");
+        return;
+    }
+
+    ACAP_HTTP_Header_TEXT(response);
+    ACAP_HTTP_Respond_Data(response, text.size, text.data);
+    Text_Free(&text);
+}
+
+void Metrics_Init(void) {
+    LOG_TRACE("<%s\n", __func__);
+    ACAP_HTTP_Node("metrics", Metrics_HTTP_callback);
+    LOG_TRACE("%s>\n", __func__);
+}
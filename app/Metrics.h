@@ -0,0 +1,131 @@
+/**
+ * Metrics.h - Per-stage latency histograms and byte counters
+ *
+ * Records the duration of each step of the frame pipeline (capture, colour
+ * conversion, JPEG encode, Hub request phases, filtering and each output sink)
+ * into lock-free log-linear histograms, and exposes them together with
+ * per-destination byte counters on the "metrics" HTTP node in Prometheus
+ * text format.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Pipeline stages with their own latency histogram
+ */
+typedef enum {
+    METRICS_FRAME_AGE = 0,      /* VDO capture timestamp to dequeue */
+    METRICS_CAPTURE,            /* Video_Capture_RGB() incl. blocking wait */
+    METRICS_QUALITY,            /* Blur/exposure/obstruction check on the luma plane */
+    METRICS_CHANGE_GATE,        /* Scene change check on the luma plane */
+    METRICS_RESIZE,             /* Client-side scaling to the model input */
+    METRICS_COLOR_CONVERT,      /* NV12 to RGB */
+    METRICS_JPEG_ENCODE,        /* RGB to JPEG */
+    METRICS_HUB_CONNECT,        /* DNS + TCP connect */
+    METRICS_HUB_TLS,            /* TLS handshake */
+    METRICS_HUB_UPLOAD,         /* Request body transfer */
+    METRICS_HUB_TTFB,           /* Upload complete to first response byte */
+    METRICS_HUB_DOWNLOAD,       /* First to last response byte */
+    METRICS_HUB_TOTAL,          /* Complete Hub request */
+    METRICS_HUB_PARSE,          /* Hub response JSON parse */
+    METRICS_INFERENCE,          /* Complete Model_Inference() */
+    METRICS_FILTER,             /* Coordinate scaling and user filters */
+    METRICS_OUTPUT_STATUS,      /* Status update of current detections */
+    METRICS_OUTPUT_MQTT,        /* Detection and event MQTT publishing */
+    METRICS_OUTPUT_CROP,        /* Crop decode/crop/encode and crop cache */
+    METRICS_OUTPUT_SDCARD,      /* Crop and label files written to SD card */
+    METRICS_OUTPUT_HTTP,        /* Crop HTTP POST export */
+    METRICS_OUTPUT,             /* Complete Output() */
+    METRICS_FRAME,              /* Complete ImageProcess() */
+    METRICS_STAGE_COUNT
+} MetricsStage;
+
+/**
+ * Destinations with their own byte counter
+ */
+typedef enum {
+    METRICS_BYTES_HUB_UPLOAD = 0,
+    METRICS_BYTES_HUB_DOWNLOAD,
+    METRICS_BYTES_MQTT,
+    METRICS_BYTES_HTTP,
+    METRICS_BYTES_SDCARD,
+    METRICS_BYTES_SNAPSHOT,
+    METRICS_BYTES_COUNT
+} MetricsDestination;
+
+/**
+ * Register the "metrics" HTTP node.
+ *
+ * Recording is possible before initialization; the histograms are static.
+ */
+void Metrics_Init(void);
+
+/**
+ * Monotonic clock in microseconds
+ *
+ * @return Microseconds since an arbitrary fixed point
+ */
+uint64_t Metrics_Now(void);
+
+/**
+ * Record a stage duration. Safe to call from any thread.
+ *
+ * @param stage Pipeline stage
+ * @param micros Duration in microseconds
+ */
+void Metrics_Record(MetricsStage stage, uint64_t micros);
+
+/**
+ * Record a stage with known start and end timestamps. Also adds the span to
+ * the trace ring, tagged with the calling thread's current frame.
+ *
+ * @param stage Pipeline stage
+ * @param start_us Metrics_Now() timestamp when the stage started
+ * @param end_us Metrics_Now() timestamp when the stage ended
+ */
+void Metrics_Span(MetricsStage stage, uint64_t start_us, uint64_t end_us);
+
+/**
+ * Record a stage that started at a Metrics_Now() timestamp and ends now.
+ *
+ * @param stage Pipeline stage
+ * @param start_us Value returned by Metrics_Now() when the stage started
+ * @return The current Metrics_Now() value, usable as start of the next stage
+ */
+uint64_t Metrics_Since(MetricsStage stage, uint64_t start_us);
+
+/**
+ * Add to a destination byte counter. Safe to call from any thread.
+ *
+ * @param dest Destination
+ * @param bytes Number of bytes transferred
+ */
+void Metrics_Bytes(MetricsDestination dest, size_t bytes);
+
+/**
+ * Get a latency percentile for a stage
+ *
+ * @param stage Pipeline stage
+ * @param quantile Quantile in [0,1], e.g. 0.99
+ * @return Approximate duration in microseconds (within ~6%), 0 if no samples
+ */
+uint64_t Metrics_Percentile(MetricsStage stage, double quantile);
+
+/**
+ * Clear all histograms and byte counters
+ */
+void Metrics_Reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // METRICS_H
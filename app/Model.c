@@ -18,15 +18,14 @@
 #include "Video.h"
 #include "cJSON.h"
 #include "ACAP.h"
+#include "Metrics.h"
+#include "Snapshot.h"
+#include "imgutils.h"
+#include "preprocess.h"
 #include "vdo-frame.h"
 
-#define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
-#define LOG_WARN(fmt, args...)    { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args);}
-//#define LOG_TRACE(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
-#define LOG_TRACE(fmt, args...)    {}
-
-// External function from main.c to store inference JPEG for UI display
-extern void StoreInferenceJPEG(const unsigned char* jpeg_data, size_t jpeg_size, int width, int height);
+#define LOG_MODULE "Model"
+#include "Log.h"
 
 // Hub connection
 static HubContext* hub = NULL;
@@ -36,6 +35,48 @@ static HubCapabilities caps = {0};
 static unsigned int videoWidth = 1920;
 static unsigned int videoHeight = 1080;
 
+// Client-side resize to the model input (clientResize), NULL when the Hub scales
+static PreprocessContext* resize = NULL;
+
+// Letterbox contexts for changed regions, by region size. Regions snap to
+// the change grid, so a few sizes recur; the least recently used is replaced.
+#define REGION_CONTEXTS 4
+typedef struct {
+    unsigned int width;
+    unsigned int height;
+    unsigned long used;
+    PreprocessContext* context;
+} RegionContext;
+static RegionContext region_contexts[REGION_CONTEXTS];
+static unsigned long region_uses = 0;
+
+static PreprocessContext* region_context(unsigned int width, unsigned int height) {
+    RegionContext* slot = NULL;
+    for (int i = 0; i < REGION_CONTEXTS; i++) {
+        RegionContext* entry = &region_contexts[i];
+        if (entry->context && entry->width == width && entry->height == height) {
+            entry->used = ++region_uses;
+            return entry->context;
+        }
+        if (!slot || entry->used < slot->used)
+            slot = entry;
+    }
+    preprocess_destroy(slot->context);
+    slot->context = preprocess_create_cpu(width, height, VDO_FORMAT_YUV,
+                                          caps.model_width, caps.model_height, VDO_FORMAT_YUV,
+                                          SCALE_MODE_LETTERBOX);
+    slot->width = width;
+    slot->height = height;
+    slot->used = slot->context ? ++region_uses : 0;
+    return slot->context;
+}
+
+static void region_contexts_free(void) {
+    for (int i = 0; i < REGION_CONTEXTS; i++)
+        preprocess_destroy(region_contexts[i].context);
+    memset(region_contexts, 0, sizeof(region_contexts));
+}
+
 cJSON* Model_Setup(void) {
     LOG_TRACE("<%s\n", __func__);
 
@@ -140,6 +181,19 @@ cJSON* Model_Setup(void) {
     }
     LOG("Video aspect ratio: %s (%.2f)\n", videoAspect, aspect);
 
+    // Scale to the model input on the camera so only model-sized JPEGs are uploaded
+    if (cJSON_IsTrue(cJSON_GetObjectItem(settings, "clientResize"))) {
+        resize = preprocess_create_cpu(videoWidth, videoHeight, VDO_FORMAT_YUV,
+                                       caps.model_width, caps.model_height, VDO_FORMAT_YUV,
+                                       preprocess_mode_from_string(scale_mode));
+        if (resize) {
+            LOG("Client-side resize: %ux%u to %dx%d (%s)\n", videoWidth, videoHeight,
+                caps.model_width, caps.model_height, scale_mode);
+        } else {
+            LOG_WARN("%s: Client-side resize not available, the Hub scales the frames\n", __func__);
+        }
+    }
+
     // Create model info JSON for main.c
     cJSON* model = cJSON_CreateObject();
     cJSON_AddNumberToObject(model, "videoWidth", videoWidth);
@@ -165,106 +219,37 @@ cJSON* Model_Setup(void) {
     return model;
 }
 
-// Helper: Clamp value to 0-255 range
-static inline uint8_t clamp_u8(int val) {
-    if (val < 0) return 0;
-    if (val > 255) return 255;
-    return (uint8_t)val;
-}
-
-// Convert NV12 (YUV420SP) to RGB24
-// NV12 format: Y plane (width x height), followed by interleaved UV plane (width x height/2)
-static uint8_t* nv12_to_rgb(const uint8_t* nv12, unsigned int width, unsigned int height) {
-    size_t rgb_size = width * height * 3;
-    uint8_t* rgb = (uint8_t*)malloc(rgb_size);
-    if (!rgb) return NULL;
-
-    const uint8_t* y_plane = nv12;
-    const uint8_t* uv_plane = nv12 + (width * height);
-
-    for (unsigned int row = 0; row < height; row++) {
-        for (unsigned int col = 0; col < width; col++) {
-            unsigned int y_index = row * width + col;
-            unsigned int uv_index = (row / 2) * width + (col & ~1);
-
-            int y = y_plane[y_index];
-            int u = uv_plane[uv_index] - 128;
-            int v = uv_plane[uv_index + 1] - 128;
-
-            // YUV to RGB conversion (ITU-R BT.601)
-            int r = y + (1.402 * v);
-            int g = y - (0.344 * u) - (0.714 * v);
-            int b = y + (1.772 * u);
-
-            rgb[y_index * 3 + 0] = clamp_u8(r);
-            rgb[y_index * 3 + 1] = clamp_u8(g);
-            rgb[y_index * 3 + 2] = clamp_u8(b);
+/*
+ * Encode an NV12 image, send it to the Hub and return its detections
+ * normalized to the image. store_snapshot keeps the image for the UI and
+ * crop export. With a preprocess context the image is first scaled to the
+ * model input on the camera and the detections are mapped back.
+ */
+static cJSON* model_infer_nv12(const uint8_t* nv12_data, unsigned int width, unsigned int height,
+                               const char* scale_mode, int store_snapshot, PreprocessContext* preprocess) {
+    uint64_t stage_us = Metrics_Now();
+    if (preprocess) {
+        if (!preprocess_run(preprocess, nv12_data, (size_t)width * height * 3 / 2)) {
+            LOG_WARN("%s: Failed to resize %ux%u to the model input\n", __func__, width, height);
+            return cJSON_CreateArray();
         }
+        stage_us = Metrics_Since(METRICS_RESIZE, stage_us);
+
+        // The UI and crops need the whole frame; it is only encoded when they ask for it
+        if (store_snapshot)
+            StoreInferenceNV12(nv12_data, width, height);
+        store_snapshot = 0;
+
+        nv12_data = (const uint8_t*)preprocess_get_output(preprocess);
+        width = caps.model_width;
+        height = caps.model_height;
+        // Already model-sized: a center crop to the model aspect is a no-op on the Hub
+        scale_mode = "crop";
     }
 
-    return rgb;
-}
-
-// Encode RGB24 to JPEG
-static uint8_t* rgb_to_jpeg(const uint8_t* rgb, unsigned int width, unsigned int height,
-                            int quality, unsigned long* jpeg_size) {
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    uint8_t* jpeg_buf = NULL;
-    unsigned long jpeg_len = 0;
-
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
-
-    // Output to memory
-    jpeg_mem_dest(&cinfo, &jpeg_buf, &jpeg_len);
-
-    cinfo.image_width = width;
-    cinfo.image_height = height;
-    cinfo.input_components = 3;
-    cinfo.in_color_space = JCS_RGB;
-
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, quality, TRUE);
-
-    jpeg_start_compress(&cinfo, TRUE);
-
-    // Write scanlines
-    JSAMPROW row_pointer[1];
-    while (cinfo.next_scanline < cinfo.image_height) {
-        row_pointer[0] = (JSAMPROW)&rgb[cinfo.next_scanline * width * 3];
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
-    }
-
-    jpeg_finish_compress(&cinfo);
-    jpeg_destroy_compress(&cinfo);
-
-    *jpeg_size = jpeg_len;
-    return jpeg_buf;
-}
-
-cJSON* Model_Inference(VdoBuffer* buffer) {
-    LOG_TRACE("<%s: Starting inference\n", __func__);
-
-    if (!hub || !buffer) {
-        LOG_WARN("%s: Hub not initialized or buffer is NULL (hub=%p, buffer=%p)\n", __func__, hub, buffer);
-        return cJSON_CreateArray();
-    }
-
-    // Get NV12 data from VDO buffer (this is accessible!)
-    uint8_t* nv12_data = (uint8_t*)vdo_buffer_get_data(buffer);
-    if (!nv12_data) {
-        LOG_WARN("%s: Invalid NV12 buffer\n", __func__);
-        return cJSON_CreateArray();
-    }
-
-    // NV12 size = width × height × 1.5 (Y plane + UV plane)
-    size_t nv12_size = (videoWidth * videoHeight * 3) / 2;
-    LOG_TRACE("%s: Got NV12 buffer %p, size %zu\n", __func__, nv12_data, nv12_size);
-    (void)nv12_size;  // Suppress unused warning when LOG_TRACE is disabled
-
     // Convert NV12 to RGB
-    uint8_t* rgb_data = nv12_to_rgb(nv12_data, videoWidth, videoHeight);
+    uint8_t* rgb_data = nv12_to_rgb(nv12_data, width, height);
+    stage_us = Metrics_Since(METRICS_COLOR_CONVERT, stage_us);
     if (!rgb_data) {
         LOG_WARN("%s: Failed to convert NV12 to RGB\n", __func__);
         return cJSON_CreateArray();
@@ -274,8 +259,9 @@ cJSON* Model_Inference(VdoBuffer* buffer) {
 
     // Encode RGB to JPEG
     unsigned long jpeg_size = 0;
-    uint8_t* jpeg_data = rgb_to_jpeg(rgb_data, videoWidth, videoHeight, 90, &jpeg_size);
+    uint8_t* jpeg_data = rgb_to_jpeg(rgb_data, width, height, 90, &jpeg_size);
     free(rgb_data);  // Free RGB buffer
+    Metrics_Since(METRICS_JPEG_ENCODE, stage_us);
 
     if (!jpeg_data || jpeg_size == 0) {
         LOG_WARN("%s: Failed to encode JPEG\n", __func__);
@@ -283,28 +269,20 @@ cJSON* Model_Inference(VdoBuffer* buffer) {
     }
 
     LOG_TRACE("%s: Encoded JPEG, size %lu bytes\n", __func__, jpeg_size);
-
-    // Get scale mode from settings
-    cJSON* settings = ACAP_Get_Config("settings");
-    const char* scale_mode = "balanced";
-    if (settings) {
-        cJSON* scale_mode_item = cJSON_GetObjectItem(settings, "scaleMode");
-        if (scale_mode_item && scale_mode_item->valuestring) {
-            scale_mode = scale_mode_item->valuestring;
-        }
-    }
-
     LOG_TRACE("%s: Sending to Hub with scale_mode=%s, size=%lu\n", __func__, scale_mode, jpeg_size);
 
-    // Store JPEG for UI display (before sending to Hub)
-    StoreInferenceJPEG(jpeg_data, jpeg_size, videoWidth, videoHeight);
+    // Publish JPEG for UI display (before sending to Hub); the snapshot now owns it
+    SnapshotImage* snapshot = store_snapshot ? StoreInferenceJPEG(jpeg_data, jpeg_size, width, height) : NULL;
 
     // Send to Hub for inference
     char* error_msg = NULL;
     cJSON* detections = Hub_InferenceJPEG(hub, jpeg_data, jpeg_size, 0, scale_mode, &error_msg);
 
     // Free JPEG buffer
-    free(jpeg_data);
+    if (snapshot)
+        Snapshot_Unref(snapshot);
+    else
+        free(jpeg_data);
 
     if (!detections) {
         if (error_msg) {
@@ -334,10 +312,10 @@ cJSON* Model_Inference(VdoBuffer* buffer) {
     cJSON_ArrayForEach(detection, detections) {
         det_index++;
 
-        // Log the full detection object for debugging
-        char* det_str = cJSON_PrintUnformatted(detection);
+        // Log the full detection object for debugging; printed only when the level is on
+        char* det_str = LOG_ENABLED(LOG_LEVEL_VERBOSE) ? cJSON_PrintUnformatted(detection) : NULL;
         if (det_str) {
-            LOG("Detection #%d from server: %s\n", det_index, det_str);
+            LOG_VERBOSE("Detection #%d from server: %s\n", det_index, det_str);
             free(det_str);
         }
 
@@ -359,6 +337,18 @@ cJSON* Model_Inference(VdoBuffer* buffer) {
             continue;
         }
 
+        // Model input coordinates back to the captured image
+        double box_x = x_item->valuedouble, box_y = y_item->valuedouble;
+        double box_w = w_item->valuedouble, box_h = h_item->valuedouble;
+        if (preprocess) {
+            float fx = box_x, fy = box_y, fw = box_w, fh = box_h;
+            if (!preprocess_transform_detection(preprocess, &fx, &fy, &fw, &fh)) {
+                LOG_TRACE("%s: Detection #%d in letterbox padding, skipping\n", __func__, det_index);
+                continue;
+            }
+            box_x = fx; box_y = fy; box_w = fw; box_h = fh;
+        }
+
         // Create normalized detection in expected format
         cJSON* norm_det = cJSON_CreateObject();
 
@@ -375,15 +365,15 @@ cJSON* Model_Inference(VdoBuffer* buffer) {
         }
 
         // Add normalized coordinates (pass through as-is, normalized to captured image)
-        cJSON_AddNumberToObject(norm_det, "x", x_item->valuedouble);
-        cJSON_AddNumberToObject(norm_det, "y", y_item->valuedouble);
-        cJSON_AddNumberToObject(norm_det, "w", w_item->valuedouble);
-        cJSON_AddNumberToObject(norm_det, "h", h_item->valuedouble);
+        cJSON_AddNumberToObject(norm_det, "x", box_x);
+        cJSON_AddNumberToObject(norm_det, "y", box_y);
+        cJSON_AddNumberToObject(norm_det, "w", box_w);
+        cJSON_AddNumberToObject(norm_det, "h", box_h);
 
         // Log the transformed detection
-        char* norm_str = cJSON_PrintUnformatted(norm_det);
+        char* norm_str = LOG_ENABLED(LOG_LEVEL_VERBOSE) ? cJSON_PrintUnformatted(norm_det) : NULL;
         if (norm_str) {
-            LOG("Detection #%d transformed: %s\n", det_index, norm_str);
+            LOG_VERBOSE("Detection #%d transformed: %s\n", det_index, norm_str);
             free(norm_str);
         }
 
@@ -393,12 +383,99 @@ cJSON* Model_Inference(VdoBuffer* buffer) {
     cJSON_Delete(detections);
 
     int final_count = cJSON_GetArraySize(normalized_detections);
-    LOG("Model_Inference: Returning %d normalized detections to main.c\n", final_count);
+    LOG_VERBOSE("Model_Inference: Returning %d normalized detections to main.c\n", final_count);
     LOG_TRACE("%s>\n", __func__);
 
     return normalized_detections;
 }
 
+cJSON* Model_Inference(VdoBuffer* buffer) {
+    LOG_TRACE("<%s: Starting inference\n", __func__);
+
+    if (!hub || !buffer) {
+        LOG_WARN("%s: Hub not initialized or buffer is NULL (hub=%p, buffer=%p)\n", __func__, hub, buffer);
+        return cJSON_CreateArray();
+    }
+
+    // Get NV12 data from VDO buffer (this is accessible!)
+    uint8_t* nv12_data = (uint8_t*)vdo_buffer_get_data(buffer);
+    if (!nv12_data) {
+        LOG_WARN("%s: Invalid NV12 buffer\n", __func__);
+        return cJSON_CreateArray();
+    }
+
+    // NV12 size = width × height × 1.5 (Y plane + UV plane)
+    size_t nv12_size = (videoWidth * videoHeight * 3) / 2;
+    LOG_TRACE("%s: Got NV12 buffer %p, size %zu\n", __func__, nv12_data, nv12_size);
+    (void)nv12_size;  // Suppress unused warning when LOG_TRACE is disabled
+
+    // Get scale mode from settings
+    cJSON* settings = ACAP_Get_Config("settings");
+    const char* scale_mode = "balanced";
+    if (settings) {
+        cJSON* scale_mode_item = cJSON_GetObjectItem(settings, "scaleMode");
+        if (scale_mode_item && scale_mode_item->valuestring) {
+            scale_mode = scale_mode_item->valuestring;
+        }
+    }
+
+    return model_infer_nv12(nv12_data, videoWidth, videoHeight, scale_mode, 1, resize);
+}
+
+cJSON* Model_Inference_Region(VdoBuffer* buffer, unsigned int x, unsigned int y,
+                              unsigned int width, unsigned int height) {
+    LOG_TRACE("<%s: %ux%u at %u,%u\n", __func__, width, height, x, y);
+
+    uint8_t* nv12_data = buffer ? (uint8_t*)vdo_buffer_get_data(buffer) : NULL;
+    if (!hub || !nv12_data) {
+        LOG_WARN("%s: Hub not initialized or buffer is NULL\n", __func__);
+        return cJSON_CreateArray();
+    }
+
+    // Only the region goes to the Hub; the UI and crops still get the whole frame, encoded on demand
+    StoreInferenceNV12(nv12_data, videoWidth, videoHeight);
+
+    uint8_t* region = crop_nv12(nv12_data, videoWidth, videoHeight, x, y, width, height);
+    if (!region) {
+        LOG_WARN("%s: Invalid region %ux%u at %u,%u\n", __func__, width, height, x, y);
+        return cJSON_CreateArray();
+    }
+
+    // Letterbox so the Hub sees the whole region whatever its aspect ratio.
+    // With clientResize, regions larger than the model input are also scaled on the camera.
+    PreprocessContext* preprocess = NULL;
+    if (resize && (width > (unsigned int)caps.model_width || height > (unsigned int)caps.model_height))
+        preprocess = region_context(width, height);
+    cJSON* detections = model_infer_nv12(region, width, height, "letterbox", 0, preprocess);
+    free(region);
+
+    // Region-relative to frame-relative coordinates
+    cJSON* detection = NULL;
+    cJSON_ArrayForEach(detection, detections) {
+        cJSON* item;
+        if ((item = cJSON_GetObjectItem(detection, "x")))
+            cJSON_SetNumberValue(item, (x + item->valuedouble * width) / videoWidth);
+        if ((item = cJSON_GetObjectItem(detection, "y")))
+            cJSON_SetNumberValue(item, (y + item->valuedouble * height) / videoHeight);
+        if ((item = cJSON_GetObjectItem(detection, "w")))
+            cJSON_SetNumberValue(item, item->valuedouble * width / videoWidth);
+        if ((item = cJSON_GetObjectItem(detection, "h")))
+            cJSON_SetNumberValue(item, item->valuedouble * height / videoHeight);
+    }
+
+    LOG_TRACE("%s>\n", __func__);
+    return detections;
+}
+
+void Model_Last_Request(long* httpStatus, double* roundTripMs) {
+    *httpStatus = hub ? Hub_GetLastHTTPStatus(hub) : 0;
+    *roundTripMs = hub ? Hub_GetLastRequestTime(hub) : -1;
+}
+
+bool Model_Health(HubHealth* health) {
+    return hub && Hub_GetHealth(hub, health);
+}
+
 void Model_Reset(void) {
     // No-op for client (no local model state to reset)
     LOG_TRACE("<%s>\n", __func__);
@@ -425,6 +502,9 @@ void Model_Cleanup(void) {
         Hub_Cleanup(hub);
         hub = NULL;
     }
+    preprocess_destroy(resize);
+    resize = NULL;
+    region_contexts_free();
 
     LOG_TRACE("%s>\n", __func__);
 }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "imgprovider.h"
 #include "cJSON.h"
+#include "Hub.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,11 +43,29 @@ cJSON* Model_Setup(void);
  */
 cJSON* Model_Inference(VdoBuffer* image);
 
+/**
+ * @brief Remote inference on a region of the captured frame.
+ *
+ * Crops the region from the NV12 frame at capture resolution and sends it to the
+ * Hub letterboxed. The inference JPEG used by the UI and crop export is not updated.
+ *
+ * @param image The captured frame. Ownership is not transferred.
+ * @param x Left edge in pixels (even)
+ * @param y Top edge in pixels (even)
+ * @param width Region width in pixels (even)
+ * @param height Region height in pixels (even)
+ * @return Detections as for Model_Inference(), normalized to the full frame.
+ */
+cJSON* Model_Inference_Region(VdoBuffer* image, unsigned int x, unsigned int y,
+                              unsigned int width, unsigned int height);
+
 /**
  * @brief Reconnect to Hub with updated settings.
  *
  * Closes existing Hub connection, re-reads settings, and reconnects.
  * Allows updating Hub connection without full application restart.
+ * Frees what Model_Inference() and Model_Inference_Region() use, so call
+ * it from the thread that runs them.
  *
  * @return Pointer to updated model config JSON, or NULL on failure.
  */
@@ -67,6 +86,22 @@ void Model_Cleanup(void);
  */
 void Model_Reset(void);
 
+/**
+ * @brief Outcome of the last Hub request, for capture rate control.
+ *
+ * @param httpStatus Set to the HTTP status, or 0 if no response was received.
+ * @param roundTripMs Set to the round-trip time in ms, or -1 if unknown.
+ */
+void Model_Last_Request(long* httpStatus, double* roundTripMs);
+
+/**
+ * @brief Query the Hub /health endpoint (queue size and queue full).
+ *
+ * @param health Output health structure.
+ * @return true on success.
+ */
+bool Model_Health(HubHealth* health);
+
 #ifdef __cplusplus
 }
 #endif
@@ -11,18 +11,18 @@
 #include "Model.h"
 #include "cJSON.h"
 #include "imgutils.h"
+#include "Metrics.h"
+#include "Snapshot.h"
+#include "Delta.h"
+#include "Aggregate.h"
 
 #include "Output.h"
 #include "Output_crop_cache.h"
 #include "Output_helpers.h"
 #include "Output_http.h"
 
-// External function from main.c to get stored inference JPEG
-extern unsigned char* GetInferenceJPEG(size_t* out_size, int* out_width, int* out_height);
-
-#define LOG(fmt, args...)      { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
-#define LOG_WARN(fmt, args...) { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args);}
-#define LOG_TRACE(fmt, args...) {}
+#define LOG_MODULE "Output"
+#include "Log.h"
 
 #define MAX_LABELS 32
 #define MAX_ROLLING 16
@@ -41,7 +41,10 @@ typedef struct {
 static LabelEventState eventsCache[MAX_LABELS];
 static int eventsCache_len = 0;
 static int lastDetectionsWereEmpty = 0;
+static int lastFrameDetections = 0;
 static double last_output_time_ms = 0;
+static char detection_topic[96] = "";   /* detection/<serial>, built on first use */
+static char crop_topic[96] = "";        /* crop/<serial> */
 
 // Helper: manage per-label state
 static LabelEventState* find_or_create_label_state(const char* label) {
@@ -90,20 +93,51 @@ static gboolean Output_DeactivateExpired(gpointer user_data) {
     return TRUE;
 }
 
+static void output_topics(void) {
+    if (!detection_topic[0]) {
+        snprintf(detection_topic, sizeof(detection_topic), "detection/%s", ACAP_DEVICE_Prop("serial"));
+        snprintf(crop_topic, sizeof(crop_topic), "crop/%s", ACAP_DEVICE_Prop("serial"));
+    }
+}
+
+// Publish the detection/<serial> summary; in delta mode it carries the reason
+static void output_publish_detections(cJSON* detections, DeltaResult delta) {
+    uint64_t t_us = Metrics_Now();
+    output_topics();
+    // Serialized straight from the detections; the reference is not freed with the payload
+    cJSON* mqttPayload = cJSON_CreateObject();
+    if (detections)
+        cJSON_AddItemReferenceToObject(mqttPayload, "detections", detections);
+    else
+        cJSON_AddItemToObject(mqttPayload, "detections", cJSON_CreateArray());
+    if (Delta_Enabled())
+        cJSON_AddBoolToObject(mqttPayload, "keyframe", delta == DELTA_KEYFRAME);
+
+    MQTT_Publish_JSON(detection_topic, mqttPayload, 0, 0);
+    cJSON_Delete(mqttPayload);
+    Metrics_Since(METRICS_OUTPUT_MQTT, t_us);
+}
+
 void Output(cJSON* detections) {
+    uint64_t t_us = Metrics_Now();
+    output_topics();
+    Aggregate_Frame(detections, ACAP_DEVICE_Timestamp());
+    lastFrameDetections = detections ? cJSON_GetArraySize(detections) : 0;
     if (!detections || cJSON_GetArraySize(detections) == 0) {
-        cJSON* emptyArr = cJSON_CreateArray();
-        ACAP_STATUS_SetObject("labels", "detections", emptyArr);
-        cJSON_Delete(emptyArr);
+        ACAP_STATUS_TakeObject("labels", "detections", cJSON_CreateArray());
+        Metrics_Since(METRICS_OUTPUT_STATUS, t_us);
+        // Delta mode tells subscribers when the last objects left
+        DeltaResult delta = Delta_Check(NULL, ACAP_DEVICE_Timestamp());
+        if (delta != DELTA_SKIP)
+            output_publish_detections(NULL, delta);
         return;
     }
 
     LOG_TRACE("<%s %d\n", __func__, cJSON_GetArraySize(detections));
 
-    // Export current detections to status (DUPLICATE for safety)
-    cJSON* statusDup = cJSON_Duplicate(detections, 1);
-    ACAP_STATUS_SetObject("labels", "detections", statusDup);
-    cJSON_Delete(statusDup);
+    // Export current detections to status; the status tree keeps this copy
+    ACAP_STATUS_TakeObject("labels", "detections", cJSON_Duplicate(detections, 1));
+    Metrics_Since(METRICS_OUTPUT_STATUS, t_us);
 
     double now = ACAP_DEVICE_Timestamp();
 
@@ -128,12 +162,9 @@ void Output(cJSON* detections) {
 
     // --- Export all detections as MQTT (non-crop summary) ---
     char topic[256];
-    snprintf(topic, sizeof(topic), "detection/%s", ACAP_DEVICE_Prop("serial"));
-    cJSON* mqttPayload = cJSON_CreateObject();
-    cJSON_AddItemToObject(mqttPayload, "detections", cJSON_Duplicate(detections, 1));
-
-    MQTT_Publish_JSON(topic, mqttPayload, 0, 0);
-    cJSON_Delete(mqttPayload);
+    DeltaResult delta = Delta_Check(detections, now);
+    if (delta != DELTA_SKIP)
+        output_publish_detections(detections, delta);
     lastDetectionsWereEmpty = (cJSON_GetArraySize(detections) == 0);
 
     // --- Adaptive event gating
@@ -164,6 +195,11 @@ void Output(cJSON* detections) {
     int bottomborder_offset = cropping && cJSON_GetObjectItem(cropping, "bottomborder") ?
                                 cJSON_GetObjectItem(cropping, "bottomborder")->valueint : 0;
 
+    // Detections are in inference stream pixels; crops may come from the high resolution stream
+    cJSON* model = ACAP_Get_Config("model");
+    cJSON* videoWidth = model ? cJSON_GetObjectItem(model, "videoWidth") : NULL;
+    cJSON* videoHeight = model ? cJSON_GetObjectItem(model, "videoHeight") : NULL;
+
     int idx = 0;
     cJSON* detection = detections->child;
     char frame_labels[MAX_LABELS][64];
@@ -202,7 +238,9 @@ void Output(cJSON* detections) {
                 // Create temp object for event
                 cJSON* eventPayload = cJSON_Duplicate(detection, 1);
                 cJSON_AddTrueToObject(eventPayload, "state");
+                t_us = Metrics_Now();
                 MQTT_Publish_JSON(topic, eventPayload, 0, 0);
+                Metrics_Since(METRICS_OUTPUT_MQTT, t_us);
                 cJSON_Delete(eventPayload);
             } else {
                 evt->last_detect_time = now;
@@ -226,7 +264,9 @@ void Output(cJSON* detections) {
                 // Create temp object for event
                 cJSON* eventPayload = cJSON_Duplicate(detection, 1);
                 cJSON_AddTrueToObject(eventPayload, "state");
+                t_us = Metrics_Now();
                 MQTT_Publish_JSON(topic, eventPayload, 0, 0);
+                Metrics_Since(METRICS_OUTPUT_MQTT, t_us);
                 cJSON_Delete(eventPayload);
             }
             if (evt->state == 1) evt->last_detect_time = now;
@@ -234,14 +274,12 @@ void Output(cJSON* detections) {
 
         // Cropping output path
         if (cropping_active) {
-            // Get stored inference JPEG and dimensions
-            size_t full_jpeg_size = 0;
+            // Size of the stored snapshot image
+            t_us = Metrics_Now();
             int img_w = 0, img_h = 0;
-            unsigned char* full_jpeg = GetInferenceJPEG(&full_jpeg_size, &img_w, &img_h);
-
-            if (!full_jpeg || !full_jpeg_size || !img_w || !img_h) {
-                LOG_WARN("%s: No inference JPEG available for cropping\n", __func__);
-                if (full_jpeg) free(full_jpeg);
+            Snapshot_Need_HighRes();
+            if (!Snapshot_Size(&img_w, &img_h) || !img_w || !img_h) {
+                LOG_WARN("%s: No inference image available for cropping\n", __func__);
                 idx++;
                 detection = detection->next;
                 continue;
@@ -255,7 +293,6 @@ void Output(cJSON* detections) {
 
             if (!xObj || !yObj || !wObj || !hObj) {
                 LOG_WARN("%s: Detection missing bbox coordinates\n", __func__);
-                free(full_jpeg);
                 idx++;
                 detection = detection->next;
                 continue;
@@ -263,10 +300,12 @@ void Output(cJSON* detections) {
 
             // NOTE: main.c already converted normalized coords to pixels!
             // The x, y, w, h values are ALREADY in pixel coordinates (not 0-1)
-            int pixel_center_x = (int)(xObj->valuedouble);
-            int pixel_center_y = (int)(yObj->valuedouble);
-            int pixel_w = (int)(wObj->valuedouble);
-            int pixel_h = (int)(hObj->valuedouble);
+            double scale_x = videoWidth && videoWidth->valueint > 0 ? (double)img_w / videoWidth->valueint : 1;
+            double scale_y = videoHeight && videoHeight->valueint > 0 ? (double)img_h / videoHeight->valueint : 1;
+            int pixel_center_x = (int)(xObj->valuedouble * scale_x);
+            int pixel_center_y = (int)(yObj->valuedouble * scale_y);
+            int pixel_w = (int)(wObj->valuedouble * scale_x);
+            int pixel_h = (int)(hObj->valuedouble * scale_y);
 
             // Convert from center format to top-left format
             int bbox_left = pixel_center_x - pixel_w / 2;
@@ -283,21 +322,20 @@ void Output(cJSON* detections) {
             if (crop_y < 0) { crop_h += crop_y; crop_y = 0; }
             if (crop_x + crop_w > img_w) crop_w = img_w - crop_x;
             if (crop_y + crop_h > img_h) crop_h = img_h - crop_y;
+            // Even top-left corner, as NV12 crops need it
+            crop_w += crop_x & 1; crop_x &= ~1;
+            crop_h += crop_y & 1; crop_y &= ~1;
 
             if (crop_w <= 0 || crop_h <= 0) {
                 LOG_WARN("%s: Invalid crop dimensions after clamping: %dx%d\n", __func__, crop_w, crop_h);
-                free(full_jpeg);
                 idx++;
                 detection = detection->next;
                 continue;
             }
 
-            // Crop the JPEG
+            // Crop the snapshot image
             unsigned long cropped_jpeg_size = 0;
-            unsigned char* jpeg_data = crop_jpeg(full_jpeg, full_jpeg_size,
-                                                  crop_x, crop_y, crop_w, crop_h,
-                                                  &cropped_jpeg_size);
-            free(full_jpeg);  // Don't need full JPEG anymore
+            unsigned char* jpeg_data = Snapshot_Crop_JPEG(crop_x, crop_y, crop_w, crop_h, &cropped_jpeg_size);
 
             if (!jpeg_data || !cropped_jpeg_size) {
                 LOG_WARN("%s: Failed to crop JPEG\n", __func__);
@@ -319,12 +357,14 @@ void Output(cJSON* detections) {
             // NOTE: Implement cache eviction in output_crop_cache_add for safety
             const char* imageDataBase64 = output_crop_cache_add(
                 jpeg_data, jpeg_size, label, conf, det_x_in_crop, det_y_in_crop, det_w_in_crop, det_h_in_crop);
+            Metrics_Since(METRICS_OUTPUT_CROP, t_us);
 
             double now_ts = ACAP_DEVICE_Timestamp();
             if (imageDataBase64 && now_ts - last_output_time_ms > throttle) {
                 last_output_time_ms = now_ts;
 
                 if (sdcard_enable) {
+                    t_us = Metrics_Now();
                     char safe_label[64];
                     strncpy(safe_label, label, sizeof(safe_label) - 1);
                     safe_label[sizeof(safe_label) - 1] = 0;
@@ -337,6 +377,7 @@ void Output(cJSON* detections) {
                             SD_FOLDER, safe_label, timestamp, idx);
 
                     if (save_jpeg_to_file(fname_img, jpeg_data, jpeg_size)) {
+                        Metrics_Bytes(METRICS_BYTES_SDCARD, jpeg_size);
                         if (save_label_to_file(fname_label, label, det_x_in_crop, det_y_in_crop, det_w_in_crop, det_h_in_crop)) {
                             LOG_TRACE("Saved crop to SD: %s, %s\n", fname_img, fname_label);
                         } else {
@@ -345,6 +386,7 @@ void Output(cJSON* detections) {
                     } else {
                         LOG_WARN("%s: Failed to save crop to SD: %s\n", __func__, fname_img);
                     }
+                    Metrics_Since(METRICS_OUTPUT_SDCARD, t_us);
                 }
 
                 // MQTT and HTTP Export
@@ -359,9 +401,9 @@ void Output(cJSON* detections) {
                     cJSON_AddNumberToObject(payload, "h", det_h_in_crop);
                     cJSON_AddStringToObject(payload, "image", imageDataBase64);
                     if (mqtt_export) {
-                        char crop_topic[64];
-                        snprintf(crop_topic, sizeof(crop_topic), "crop/%s", ACAP_DEVICE_Prop("serial"));
+                        t_us = Metrics_Now();
                         int mqtt_ok = MQTT_Publish_JSON(crop_topic, payload, 0, 0);
+                        Metrics_Since(METRICS_OUTPUT_MQTT, t_us);
                         if (!mqtt_ok) {
                             LOG_WARN("MQTT crop publish failed - message may be too large (JPEG size: %u bytes)\n", jpeg_size);
                         }
@@ -380,7 +422,9 @@ void Output(cJSON* detections) {
                                             cJSON_GetObjectItem(cropping, "http_token")->valuestring : NULL;
 
                         if (url && url[0] != 0) {
+                            t_us = Metrics_Now();
                             int http_ok = output_http_post_json(url, payload, authentication, username, password, token);
+                            Metrics_Since(METRICS_OUTPUT_HTTP, t_us);
                             if (!http_ok) {
                                 LOG_WARN("HTTP POST failed: %s\n", url);
                             }
@@ -430,7 +474,9 @@ void Output(cJSON* detections) {
                         cJSON_AddStringToObject(statePayload, "label", eventsCache[i].name);
                         cJSON_AddFalseToObject(statePayload, "state");
                         cJSON_AddNumberToObject(statePayload, "timestamp", ACAP_DEVICE_Timestamp());
+                        t_us = Metrics_Now();
                         MQTT_Publish_JSON(topic, statePayload, 0, 0);
+                        Metrics_Since(METRICS_OUTPUT_MQTT, t_us);
                         cJSON_Delete(statePayload);
                         LOG_TRACE("%s: Label %s immediately deactivated (below threshold)\n", __func__, eventsCache[i].name);
                     }
@@ -442,12 +488,25 @@ void Output(cJSON* detections) {
     LOG_TRACE("%s>\n", __func__);
 }
 
+int Output_Events_Active(void) {
+    for (int i = 0; i < eventsCache_len; ++i)
+        if (eventsCache[i].state == 1)
+            return 1;
+    return 0;
+}
+
+int Output_Active(void) {
+    return lastFrameDetections > 0 || Output_Events_Active();
+}
+
 // Reset all state/crop API/eventsCache
 void Output_reset(void) {
     LOG_TRACE("<%s\n", __func__);
     eventsCache_len = 0;
     lastDetectionsWereEmpty = 0;
+    lastFrameDetections = 0;
     last_output_time_ms = 0;
+    Delta_Reset();
     output_crop_cache_reset();
     LOG_TRACE("%s>\n", __func__);
 }
@@ -486,7 +545,7 @@ void Output_init(void) {
             char* labelCopy = strdup(class_item->valuestring);
             if (labelCopy) {
                 replace_spaces(labelCopy);
-                LOG("Registering event: %s -> %s\n", labelCopy, niceName);
+                LOG_VERBOSE("Registering event: %s -> %s\n", labelCopy, niceName);
                 ACAP_EVENTS_Add_Event(labelCopy, niceName, 1);
                 free(labelCopy);
             }
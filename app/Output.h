@@ -24,6 +24,18 @@ void Output(cJSON* detectionList);
  */
 void Output_reset(void);
 
+/**
+ * @brief Whether objects are present: the last frame had detections or a label event is HIGH.
+ *
+ * Used by the capture rate to switch between burst and idle rates.
+ */
+int Output_Active(void);
+
+/**
+ * @brief Whether any label event is HIGH.
+ */
+int Output_Events_Active(void);
+
 /**
  * @brief Registers HTTP endpoint for crop API and sets up event state labels.
  *
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <syslog.h>
 #include "Output_http.h"
+#include "Metrics.h"
 
 int output_http_post_json(
     const char* url,
@@ -79,6 +80,7 @@ int output_http_post_json(
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
         if (http_code >= 200 && http_code < 300) {
             ok = 1;
+            Metrics_Bytes(METRICS_BYTES_HTTP, strlen(payload_str));
         } else {
             syslog(LOG_WARNING, "output_http_post_json: HTTP POST returned status %ld", http_code);
         }
@@ -0,0 +1,333 @@
+/**
+ * Pipeline.c - Per-frame processing after capture
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "Pipeline.h"
+#include "ACAP.h"
+#include "Model.h"
+#include "Filter.h"
+#include "Output.h"
+#include "Metrics.h"
+#include "Change.h"
+#include "Quality.h"
+
+#define LOG_MODULE "Pipeline"
+#include "Log.h"
+
+static cJSON* lastDetections = NULL;  /* Model_Inference() result of the change gate reference */
+static int lastSkipped = 0;
+static int lastQuality = -1;
+
+// Fresh region detections plus the cached ones whose center lies outside the region
+static cJSON*
+pipeline_merge(cJSON* fresh, double left, double top, double right, double bottom) {
+	cJSON* merged = cJSON_CreateArray();
+	cJSON* detection;
+	cJSON_ArrayForEach(detection, lastDetections) {
+		cJSON* x = cJSON_GetObjectItem(detection, "x");
+		cJSON* y = cJSON_GetObjectItem(detection, "y");
+		cJSON* w = cJSON_GetObjectItem(detection, "w");
+		cJSON* h = cJSON_GetObjectItem(detection, "h");
+		if( !x || !y || !w || !h )
+			continue;
+		double cx = x->valuedouble + w->valuedouble / 2;
+		double cy = y->valuedouble + h->valuedouble / 2;
+		if( cx >= left && cx < right && cy >= top && cy < bottom )
+			continue;
+		cJSON_AddItemToArray(merged, cJSON_Duplicate(detection, 1));
+	}
+	while( cJSON_GetArraySize(fresh) > 0 )
+		cJSON_AddItemToArray(merged, cJSON_DetachItemFromArray(fresh, 0));
+	cJSON_Delete(fresh);
+	return merged;
+}
+
+int
+Pipeline_Process(VdoBuffer* buffer, cJSON* settings, cJSON* model, uint64_t frameStart) {
+	LOG_TRACE("<%s\n",__func__);
+
+	// Blurred, badly exposed or obstructed frames can only give garbage detections
+	uint64_t qualityStart = Metrics_Now();
+	cJSON* width = cJSON_GetObjectItem(model, "videoWidth");
+	cJSON* height = cJSON_GetObjectItem(model, "videoHeight");
+	QualityStats stats;
+	QualityResult quality = width && height ?
+	                        Quality_Check(vdo_buffer_get_data(buffer), width->valueint, height->valueint, &stats) : QUALITY_OK;
+	if( (int)quality != lastQuality ) {
+		if( quality != QUALITY_OK )
+			LOG_WARN("Frame quality: %s (sharpness %.1f, dark %.0f%%, bright %.0f%%, uniform %.0f%%). Frames are not inferred\n",
+			         Quality_Name(quality), stats.sharpness, stats.dark_percent, stats.bright_percent, stats.uniform_percent);
+		if( quality == QUALITY_OK && lastQuality > 0 )
+			LOG("Frame quality: OK. Inference resumed\n");
+		ACAP_STATUS_SetString("quality", "status", Quality_Name(quality));
+		ACAP_STATUS_SetBool("quality", "state", quality == QUALITY_OK);
+		lastQuality = quality;
+	}
+	uint64_t gateStart = Metrics_Since(METRICS_QUALITY, qualityStart);
+
+	// Static scene and no event to keep alive: reuse the last result instead of a Hub round trip
+	lastSkipped = quality != QUALITY_OK ||
+	              (width && height &&
+	               Change_Static(vdo_buffer_get_data(buffer), width->valueint, height->valueint, frameStart) &&
+	               lastDetections && !Output_Events_Active());
+	uint64_t inferenceStart = Metrics_Since(METRICS_CHANGE_GATE, gateStart);
+
+	cJSON* detections = NULL;
+	int inferenceTime = 0;
+	uint64_t filterStart = inferenceStart;
+	if( quality != QUALITY_OK ) {
+		detections = cJSON_CreateArray();
+	} else if( lastSkipped ) {
+		detections = cJSON_Duplicate(lastDetections, 1);
+	} else {
+		// Only part of the scene changed: send that region and keep the cached detections elsewhere.
+		// Crop export cuts from the full inference image, so it needs every frame whole.
+		unsigned int rx = 0, ry = 0, rw = 0, rh = 0;
+		cJSON* cropping = cJSON_GetObjectItem(settings, "cropping");
+		int region = lastDetections && width && height &&
+		             !(cropping && cJSON_IsTrue(cJSON_GetObjectItem(cropping, "active"))) &&
+		             Change_Region(frameStart, &rx, &ry, &rw, &rh);
+		if( region ) {
+			detections = Model_Inference_Region(buffer, rx, ry, rw, rh);
+			if( detections )
+				detections = pipeline_merge(detections,
+				                            (double)rx / width->valueint, (double)ry / height->valueint,
+				                            (double)(rx + rw) / width->valueint, (double)(ry + rh) / height->valueint);
+		} else {
+			detections = Model_Inference(buffer);
+		}
+		filterStart = Metrics_Since(METRICS_INFERENCE, inferenceStart);
+		inferenceTime = (int)((filterStart - inferenceStart) / 1000);
+
+		// Only a Hub answer is a valid reference; after an error the next frame is inferred again
+		long hubStatus = 0;
+		double hubTime = -1;
+		Model_Last_Request(&hubStatus, &hubTime);
+		cJSON_Delete(lastDetections);
+		lastDetections = NULL;
+		if( detections && (hubStatus == 200 || hubStatus == 204) ) {
+			Change_Accept(!region);
+			lastDetections = cJSON_Duplicate(detections, 1);
+		}
+	}
+
+	double timestamp = ACAP_DEVICE_Timestamp();
+
+	//Apply Transform detection data and apply user filters
+	cJSON* processedDetections = Filter_Detections(detections, settings, model, timestamp);
+	if(!processedDetections) {
+		ACAP_STATUS_SetString("model","status","Error. Check log");
+		ACAP_STATUS_SetBool("model","state", 0);
+		cJSON_Delete( detections );
+		return -1;
+	}
+
+	cJSON_Delete( detections );
+	Metrics_Since(METRICS_FILTER, filterStart);
+
+	uint64_t outputStart = Metrics_Now();
+	Output( processedDetections );
+	Metrics_Since(METRICS_OUTPUT, outputStart);
+	Model_Reset();
+
+	cJSON_Delete(processedDetections);
+	Metrics_Since(METRICS_FRAME, frameStart);
+	LOG_TRACE("%s>\n",__func__);
+	return inferenceTime;
+}
+
+int
+Pipeline_Skipped(void) {
+	return lastSkipped;
+}
+
+#define RATE_STEP_FPS       0.25    /* Additive increase per uncongested frame */
+#define RATE_BACKOFF        2.0     /* Interval factor on 503, no response or a full queue */
+#define RATE_EASE           1.25    /* Interval factor when a queue starts to build */
+#define RATE_HOLD           4       /* Frames between decreases */
+#define RATE_QUEUE_RATIO    1.5     /* Round trip above base * ratio + slack means queueing */
+#define RATE_QUEUE_SLACK_MS 5.0
+
+void
+Pipeline_Rate_Init(PipelineRate* rate, cJSON* settings) {
+	memset(rate, 0, sizeof(*rate));
+	rate->max_rate_ms = 1000;
+	rate->min_rate_ms = 100;
+	rate->adaptive = 1;
+	rate->burst_hold_ms = 5000;
+
+	cJSON* hub_config = cJSON_GetObjectItem(settings, "hub");
+	if (hub_config) {
+		cJSON* captureRate = cJSON_GetObjectItem(hub_config, "captureRateMs");
+		if (captureRate && captureRate->valueint > 0) {
+			rate->max_rate_ms = captureRate->valueint;
+		}
+		cJSON* minRate = cJSON_GetObjectItem(hub_config, "minCaptureRateMs");
+		if (minRate && minRate->valueint > 0) {
+			rate->min_rate_ms = minRate->valueint;
+		}
+		cJSON* adaptive = cJSON_GetObjectItem(hub_config, "adaptiveRate");
+		if (adaptive) {
+			rate->adaptive = cJSON_IsTrue(adaptive);
+		}
+		cJSON* idleRate = cJSON_GetObjectItem(hub_config, "idleRateMs");
+		if (idleRate && idleRate->valueint > 0) {
+			rate->idle_rate_ms = idleRate->valueint;
+		}
+		cJSON* burstHold = cJSON_GetObjectItem(hub_config, "burstHoldMs");
+		if (burstHold && burstHold->valueint >= 0) {
+			rate->burst_hold_ms = burstHold->valueint;
+		}
+		cJSON* maxPerMinute = cJSON_GetObjectItem(hub_config, "maxRequestsPerMinute");
+		if (maxPerMinute && maxPerMinute->valueint > 0) {
+			rate->max_per_minute = maxPerMinute->valueint;
+		}
+	}
+	if (rate->min_rate_ms > rate->max_rate_ms)
+		rate->min_rate_ms = rate->max_rate_ms;
+	rate->rate_ms = rate->max_rate_ms;
+}
+
+static void
+rate_set(PipelineRate* rate, double interval) {
+	// Capturing faster than the Hub answers only makes frames run back-to-back
+	double floor = rate->min_rate_ms;
+	if (rate->latency_ms > floor)
+		floor = rate->latency_ms;
+	if (interval < floor)
+		interval = floor;
+	if (interval > rate->max_rate_ms)
+		interval = rate->max_rate_ms;
+	rate->rate_ms = (unsigned int)(interval + 0.5);
+}
+
+static void
+rate_decrease(PipelineRate* rate, double factor) {
+	if (rate->hold)
+		return;
+	rate_set(rate, rate->rate_ms * factor);
+	rate->hold = RATE_HOLD;
+	rate->decreases++;
+	LOG_TRACE("%s: %u ms (latency %.0f ms, base %.0f ms)\n", __func__, rate->rate_ms, rate->latency_ms, rate->base_latency_ms);
+}
+
+int
+Pipeline_Rate_Update(PipelineRate* rate, unsigned int inferenceTime, long httpStatus, double hubMs) {
+	int completed = 0;
+	rate->count++;
+	rate->sum_ms += inferenceTime;
+	if( rate->count >= PIPELINE_RATE_WINDOW ) {
+		rate->average_ms = rate->sum_ms / rate->count;
+		rate->count = 0;
+		rate->sum_ms = 0;
+		completed = 1;
+	}
+
+	if (!rate->adaptive)
+		return completed;
+
+	// Responses right after a decrease still carry the queue that caused it
+	int holding = rate->hold > 0;
+	if (holding)
+		rate->hold--;
+
+	if (httpStatus == 503 || httpStatus == 0) {
+		if (!holding)
+			rate_decrease(rate, RATE_BACKOFF);
+	} else if (httpStatus == 200 || httpStatus == 204) {
+		if (hubMs > 0) {
+			rate->latency_ms = rate->latency_ms > 0 ? rate->latency_ms + (hubMs - rate->latency_ms) / 8 : hubMs;
+			// Let the base follow a slower Hub so one fast outlier does not pin it
+			if (rate->base_latency_ms <= 0 || hubMs < rate->base_latency_ms)
+				rate->base_latency_ms = hubMs;
+			else
+				rate->base_latency_ms += (hubMs - rate->base_latency_ms) / 256;
+		}
+		if (!holding) {
+			if (rate->latency_ms > rate->base_latency_ms * RATE_QUEUE_RATIO + RATE_QUEUE_SLACK_MS)
+				rate_decrease(rate, RATE_EASE);
+			else
+				rate_set(rate, 1000.0 / (1000.0 / rate->rate_ms + RATE_STEP_FPS));
+		}
+	}
+	// Other errors say nothing about Hub load
+	return completed;
+}
+
+void
+Pipeline_Rate_Queue(PipelineRate* rate, int queueSize, int queueFull) {
+	if (!rate->adaptive)
+		return;
+	if (queueFull)
+		rate_decrease(rate, RATE_BACKOFF);
+	else if (queueSize > 0)
+		rate_decrease(rate, RATE_EASE);
+}
+
+// Requests in the last minute; advances the per-second window to nowMs
+static unsigned int
+rate_minute_count(PipelineRate* rate, uint64_t nowMs) {
+	uint64_t second = nowMs / 1000;
+	if (second >= rate->minute_second + 60) {
+		uint64_t shift = second - (rate->minute_second + 59);
+		if (shift >= 60) {
+			memset(rate->minute_counts, 0, sizeof(rate->minute_counts));
+		} else {
+			memmove(rate->minute_counts, rate->minute_counts + shift, (60 - shift) * sizeof(rate->minute_counts[0]));
+			memset(rate->minute_counts + 60 - shift, 0, shift * sizeof(rate->minute_counts[0]));
+		}
+		rate->minute_second = second - 59;
+	}
+	unsigned int total = 0;
+	for (int i = 0; i < 60; i++)
+		total += rate->minute_counts[i];
+	return total;
+}
+
+unsigned int
+Pipeline_Rate_Next(PipelineRate* rate, int requested, int active, uint64_t nowMs) {
+	if (active)
+		rate->last_active_ms = nowMs;
+	int burst = active || (rate->last_active_ms && nowMs - rate->last_active_ms < rate->burst_hold_ms);
+	if (burst != rate->burst) {
+		rate->burst = burst;
+		LOG_TRACE("%s: %s\n", __func__, burst ? "Burst" : "Idle");
+	}
+
+	unsigned int interval = rate->rate_ms;
+	if (rate->idle_rate_ms && !burst && rate->idle_rate_ms > interval)
+		interval = rate->idle_rate_ms;
+
+	if (!rate->max_per_minute)
+		return interval;
+
+	unsigned int used = rate_minute_count(rate, nowMs);
+	if (requested) {
+		unsigned short* slot = &rate->minute_counts[nowMs / 1000 - rate->minute_second];
+		if (*slot < 0xFFFF)
+			(*slot)++;
+		used++;
+	}
+
+	if (used >= rate->max_per_minute) {
+		// Wait for the oldest second in the window to expire
+		for (int i = 0; i < 60; i++) {
+			if (rate->minute_counts[i]) {
+				uint64_t expires = (rate->minute_second + i + 60) * 1000;
+				if (expires > nowMs && expires - nowMs > interval)
+					interval = (unsigned int)(expires - nowMs);
+				break;
+			}
+		}
+	} else if (used * 2 >= rate->max_per_minute) {
+		unsigned int paced = 60000 / rate->max_per_minute;
+		if (paced > interval)
+			interval = paced;
+	}
+	return interval;
+}
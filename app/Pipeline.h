@@ -0,0 +1,134 @@
+/**
+ * Pipeline.h - Per-frame processing after capture
+ *
+ * Runs a captured frame through remote inference, the user filters and all
+ * output sinks. main.c calls it from the capture timer; the host replay
+ * harness calls it with recorded frames.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "imgprovider.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Process one captured frame: Model_Inference(), Filter_Detections(), Output()
+ *
+ * With changeGate enabled, frames that match the last inferred frame are not
+ * sent to the Hub while no event is HIGH; the previous detections are used.
+ * With changeGate.regionUpload, a frame where only part of the scene changed
+ * sends that region (Model_Inference_Region()) and keeps the previous
+ * detections outside it.
+ *
+ * With quality.enabled, frames that fail the quality pre-check (Quality.h)
+ * are not inferred and give no detections; the "quality" status shows why.
+ *
+ * The caller owns the buffer and the trace frame (Trace_Frame_Begin/End).
+ * On failure the model status is set to an error.
+ *
+ * @param buffer Captured NV12 frame
+ * @param settings Application settings
+ * @param model Model info from Model_Setup()
+ * @param frameStart Metrics_Now() timestamp taken before the capture
+ * @return Inference time in ms, or -1 if frame processing must stop
+ */
+int Pipeline_Process(VdoBuffer* buffer, cJSON* settings, cJSON* model, uint64_t frameStart);
+
+/**
+ * Whether the last Pipeline_Process() call skipped inference, because the
+ * scene had not changed (Change.h; its detections were the previous ones)
+ * or the frame failed the quality pre-check (Quality.h); it returned 0.
+ */
+int Pipeline_Skipped(void);
+
+/**
+ * Adaptive capture rate (AIMD)
+ *
+ * Starts at hub.captureRateMs. The capture rate grows additively while the
+ * Hub answers within its uncongested round trip. It shrinks multiplicatively
+ * when the Hub shows a queue: round trip well above the lowest seen, HTTP 503
+ * or no response, or a non-empty queue in /health. The interval stays between
+ * hub.minCaptureRateMs and hub.captureRateMs. average_ms is reported every
+ * PIPELINE_RATE_WINDOW frames.
+ */
+#define PIPELINE_RATE_WINDOW 10
+
+typedef struct {
+	unsigned int rate_ms;       /* Current capture interval */
+	unsigned int max_rate_ms;   /* hub.captureRateMs: start and slowest interval */
+	unsigned int min_rate_ms;   /* hub.minCaptureRateMs: fastest interval */
+	int adaptive;               /* hub.adaptiveRate */
+	unsigned int count;         /* Frames in the current window */
+	unsigned int sum_ms;        /* Inference time in the current window */
+	unsigned int average_ms;    /* Average of the last completed window */
+	double latency_ms;          /* Smoothed Hub round trip */
+	double base_latency_ms;     /* Round trip without queueing: lowest seen, slowly aging */
+	unsigned int hold;          /* Frames to wait after a decrease before reacting again */
+	unsigned int decreases;     /* Multiplicative decreases so far */
+	/* Burst mode */
+	unsigned int idle_rate_ms;  /* hub.idleRateMs: interval with nothing detected, 0 disables */
+	unsigned int burst_hold_ms; /* hub.burstHoldMs: stay in burst this long after activity ends */
+	unsigned int max_per_minute;    /* hub.maxRequestsPerMinute, 0 for no cap */
+	int burst;                  /* Capturing at the burst (adaptive) interval */
+	uint64_t last_active_ms;    /* Last frame with activity */
+	uint64_t minute_second;     /* Second of minute_counts[0] */
+	unsigned short minute_counts[60];   /* Requests per second over the last minute */
+} PipelineRate;
+
+/**
+ * Initialize from hub.captureRateMs, hub.minCaptureRateMs, hub.adaptiveRate,
+ * hub.idleRateMs, hub.burstHoldMs and hub.maxRequestsPerMinute
+ *
+ * @param rate State to initialize
+ * @param settings Application settings, may be NULL for defaults (1000 ms, 100 ms, adaptive)
+ */
+void Pipeline_Rate_Init(PipelineRate* rate, cJSON* settings);
+
+/**
+ * Account one frame and adapt the capture interval
+ *
+ * @param rate Rate state
+ * @param inferenceTime Inference time in ms as returned by Pipeline_Process()
+ * @param httpStatus HTTP status of the Hub request, 0 if there was no response
+ * @param hubMs Hub round trip in ms, or a negative value if unknown
+ * @return 1 when a window completed and average_ms was updated, otherwise 0
+ */
+int Pipeline_Rate_Update(PipelineRate* rate, unsigned int inferenceTime, long httpStatus, double hubMs);
+
+/**
+ * Feed the Hub queue state from /health into the rate
+ *
+ * @param rate Rate state
+ * @param queueSize Requests waiting at the Hub
+ * @param queueFull Hub reports its queue as full
+ */
+void Pipeline_Rate_Queue(PipelineRate* rate, int queueSize, int queueFull);
+
+/**
+ * Interval to the next capture, after the frame captured at nowMs
+ *
+ * In burst mode the interval is rate_ms; after burst_hold_ms without
+ * activity it is idle_rate_ms (when slower). Once half of max_per_minute is
+ * used within the last minute, requests are paced at the per-minute
+ * average. When the cap is reached, capture waits until the oldest request
+ * leaves the window.
+ *
+ * @param rate Rate state
+ * @param requested A Hub request was made for this frame (counts against max_per_minute)
+ * @param active Objects are present (Output_Active())
+ * @param nowMs Monotonic time of the request in ms
+ * @return Capture interval in ms
+ */
+unsigned int Pipeline_Rate_Next(PipelineRate* rate, int requested, int active, uint64_t nowMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PIPELINE_H
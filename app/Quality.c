@@ -0,0 +1,156 @@
+/**
+ * Quality.c - Frame quality pre-check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "Quality.h"
+
+#define LOG_MODULE "Quality"
+#include "Log.h"
+
+#define BLOCKS              (QUALITY_GRID_WIDTH * QUALITY_GRID_HEIGHT)
+#define ROW_STEP            4       /* Sample every 4th row ... */
+#define COL_STEP            2       /* ... and every 2nd pixel */
+#define DARK_LEVEL          16      /* Black level of video range luma */
+#define BRIGHT_LEVEL        235     /* White level of video range luma */
+#define UNIFORM_STDDEV      3.0     /* Block contrast below this is sensor noise only */
+
+static int enabled = 0;
+static double min_sharpness = 15;
+static double max_dark_percent = 95;
+static double max_bright_percent = 95;
+static double max_uniform_percent = 80;
+
+static double setting_number(cJSON* quality, const char* name, double fallback) {
+    cJSON* item = cJSON_GetObjectItem(quality, name);
+    return item && cJSON_IsNumber(item) && item->valuedouble >= 0 ? item->valuedouble : fallback;
+}
+
+void Quality_Settings(cJSON* settings) {
+    cJSON* quality = cJSON_GetObjectItem(settings, "quality");
+    enabled = quality && cJSON_IsTrue(cJSON_GetObjectItem(quality, "enabled"));
+    min_sharpness = setting_number(quality, "minSharpness", 15);
+    max_dark_percent = setting_number(quality, "maxDarkPercent", 95);
+    max_bright_percent = setting_number(quality, "maxBrightPercent", 95);
+    max_uniform_percent = setting_number(quality, "maxUniformPercent", 80);
+    LOG_TRACE("%s: enabled=%d minSharpness=%.1f maxDark=%.0f%% maxBright=%.0f%% maxUniform=%.0f%%\n", __func__,
+              enabled, min_sharpness, max_dark_percent, max_bright_percent, max_uniform_percent);
+}
+
+// One sparse pass: Laplacian moments, exposure counts and per-block contrast
+static void quality_measure(const uint8_t* luma, unsigned int width, unsigned int height, QualityStats* stats) {
+    unsigned int columns[QUALITY_GRID_WIDTH + 1];
+    for (int bx = 0; bx <= QUALITY_GRID_WIDTH; bx++) {
+        unsigned int column = (unsigned int)((uint64_t)bx * width / QUALITY_GRID_WIDTH);
+        // The Laplacian needs both horizontal neighbours
+        columns[bx] = column < 1 ? 1 : column > width - 1 ? width - 1 : column;
+    }
+
+    int64_t lap_sum = 0;
+    uint64_t lap_squares = 0;
+    uint64_t samples = 0, dark = 0, bright = 0;
+    unsigned int uniform = 0;
+
+    for (int by = 0; by < QUALITY_GRID_HEIGHT; by++) {
+        unsigned int y0 = (unsigned int)((uint64_t)by * height / QUALITY_GRID_HEIGHT);
+        unsigned int y1 = (unsigned int)((uint64_t)(by + 1) * height / QUALITY_GRID_HEIGHT);
+        if (y0 < 1) y0 = 1;
+        if (y1 > height - 1) y1 = height - 1;
+
+        uint32_t sums[QUALITY_GRID_WIDTH];
+        uint64_t squares[QUALITY_GRID_WIDTH];
+        uint32_t counts[QUALITY_GRID_WIDTH];
+        memset(sums, 0, sizeof(sums));
+        memset(squares, 0, sizeof(squares));
+        memset(counts, 0, sizeof(counts));
+
+        for (unsigned int y = y0; y < y1; y += ROW_STEP) {
+            const uint8_t* up = luma + (size_t)(y - 1) * width;
+            const uint8_t* row = up + width;
+            const uint8_t* down = row + width;
+            for (int bx = 0; bx < QUALITY_GRID_WIDTH; bx++) {
+                uint32_t sum = 0, square = 0, count = 0, low = 0, high = 0;
+                int32_t lsum = 0;
+                uint32_t lsquare = 0;
+                for (unsigned int x = columns[bx]; x < columns[bx + 1]; x += COL_STEP) {
+                    int p = row[x];
+                    int lap = 4 * p - row[x - 1] - row[x + 1] - up[x] - down[x];
+                    sum += p;
+                    square += p * p;
+                    count++;
+                    low += p <= DARK_LEVEL;
+                    high += p >= BRIGHT_LEVEL;
+                    lsum += lap;
+                    lsquare += (uint32_t)(lap * lap);
+                }
+                sums[bx] += sum;
+                squares[bx] += square;
+                counts[bx] += count;
+                dark += low;
+                bright += high;
+                lap_sum += lsum;
+                lap_squares += lsquare;
+            }
+        }
+
+        for (int bx = 0; bx < QUALITY_GRID_WIDTH; bx++) {
+            if (!counts[bx])
+                continue;
+            samples += counts[bx];
+            double mean = (double)sums[bx] / counts[bx];
+            double variance = (double)squares[bx] / counts[bx] - mean * mean;
+            uniform += variance < UNIFORM_STDDEV * UNIFORM_STDDEV;
+        }
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    if (!samples)
+        return;
+    double lap_mean = (double)lap_sum / samples;
+    stats->sharpness = (double)lap_squares / samples - lap_mean * lap_mean;
+    stats->dark_percent = 100.0 * dark / samples;
+    stats->bright_percent = 100.0 * bright / samples;
+    stats->uniform_percent = 100.0 * uniform / BLOCKS;
+}
+
+QualityResult Quality_Check(const uint8_t* luma, unsigned int width, unsigned int height, QualityStats* stats) {
+    QualityStats measured;
+    if (stats)
+        memset(stats, 0, sizeof(*stats));
+    if (!enabled || !luma || width < QUALITY_GRID_WIDTH * COL_STEP + 2 || height < QUALITY_GRID_HEIGHT * ROW_STEP + 2)
+        return QUALITY_OK;
+
+    quality_measure(luma, width, height, &measured);
+    if (stats)
+        *stats = measured;
+
+    QualityResult result = QUALITY_OK;
+    // Exposure first: a saturated or black frame is also flat and unsharp
+    if (measured.dark_percent > max_dark_percent)
+        result = QUALITY_DARK;
+    else if (measured.bright_percent > max_bright_percent)
+        result = QUALITY_BRIGHT;
+    else if (measured.uniform_percent > max_uniform_percent)
+        result = QUALITY_OBSTRUCTED;
+    else if (measured.sharpness < min_sharpness)
+        result = QUALITY_BLURRED;
+
+    LOG_TRACE("%s: %s sharpness=%.1f dark=%.1f%% bright=%.1f%% uniform=%.1f%%\n", __func__, Quality_Name(result),
+              measured.sharpness, measured.dark_percent, measured.bright_percent, measured.uniform_percent);
+    return result;
+}
+
+const char* Quality_Name(QualityResult result) {
+    switch (result) {
+        case QUALITY_OK:         return "OK";
+        case QUALITY_BLURRED:    return "Blurred";
+        case QUALITY_DARK:       return "Underexposed";
+        case QUALITY_BRIGHT:     return "Overexposed";
+        case QUALITY_OBSTRUCTED: return "Obstructed";
+    }
+    return "Unknown";
+}
@@ -0,0 +1,69 @@
+/**
+ * Quality.h - Frame quality pre-check
+ *
+ * Measures the luma plane of each captured NV12 frame before it is encoded
+ * and sent to the Hub. Pipeline_Process() does not infer frames that are
+ * blurred, over- or underexposed (including IR day/night switch transients)
+ * or mostly uniform (lens obstruction, tampering, rain on the dome).
+ *
+ * One sparse pass over the Y plane collects the variance of the Laplacian
+ * (sharpness), a luma histogram and per-block contrast.
+ */
+
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#include <stdint.h>
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QUALITY_GRID_WIDTH  16
+#define QUALITY_GRID_HEIGHT 9
+
+typedef enum {
+    QUALITY_OK = 0,
+    QUALITY_BLURRED,
+    QUALITY_DARK,
+    QUALITY_BRIGHT,
+    QUALITY_OBSTRUCTED
+} QualityResult;
+
+typedef struct {
+    double sharpness;           /* Variance of the Laplacian */
+    double dark_percent;        /* Samples at luma 16 or below */
+    double bright_percent;      /* Samples at luma 235 or above */
+    double uniform_percent;     /* Blocks with almost no contrast */
+} QualityStats;
+
+/**
+ * Read quality.enabled, quality.minSharpness, quality.maxDarkPercent,
+ * quality.maxBrightPercent and quality.maxUniformPercent
+ *
+ * @param settings Application settings
+ */
+void Quality_Settings(cJSON* settings);
+
+/**
+ * Check a frame
+ *
+ * @param luma Y plane, width x height bytes without padding
+ * @param width Frame width
+ * @param height Frame height
+ * @param stats Optional output of the measured values
+ * @return QUALITY_OK if checking is disabled or the frame is usable, else the first failed check
+ */
+QualityResult Quality_Check(const uint8_t* luma, unsigned int width, unsigned int height, QualityStats* stats);
+
+/**
+ * Short description of a result for the status page ("OK", "Blurred", ...)
+ */
+const char* Quality_Name(QualityResult result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // QUALITY_H
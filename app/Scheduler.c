@@ -0,0 +1,119 @@
+/**
+ * Scheduler.c - Deadline-driven capture timer
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <glib-unix.h>
+
+#include "Scheduler.h"
+
+#define LOG_MODULE "Scheduler"
+#include "Log.h"
+
+static int timer_fd = -1;
+static guint source_id = 0;
+static uint64_t deadline_ns = 0;
+static unsigned int interval = 1000;
+static unsigned int missed = 0;
+static GSourceFunc capture_callback = NULL;
+static gpointer capture_data = NULL;
+
+static uint64_t
+monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+scheduler_arm(uint64_t deadline) {
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = deadline / 1000000000ULL;
+	spec.it_value.tv_nsec = deadline % 1000000000ULL;
+	if( timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0 ) {
+		LOG_WARN("%s: timerfd_settime failed: %s\n", __func__, strerror(errno));
+		return 0;
+	}
+	return 1;
+}
+
+static void
+scheduler_close(void) {
+	if( timer_fd >= 0 )
+		close(timer_fd);
+	timer_fd = -1;
+	source_id = 0;
+}
+
+static gboolean
+scheduler_tick(gint fd, GIOCondition condition, gpointer user_data) {
+	uint64_t expirations = 0;
+	if( read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN )
+		LOG_WARN("%s: read failed: %s\n", __func__, strerror(errno));
+
+	if( capture_callback(capture_data) == G_SOURCE_REMOVE ) {
+		LOG_TRACE("%s: Capture stopped\n", __func__);
+		scheduler_close();
+		return G_SOURCE_REMOVE;
+	}
+
+	// Next deadline from the previous one, not from now, so the rate does not drift
+	uint64_t now = monotonic_ns();
+	deadline_ns += (uint64_t)interval * 1000000ULL;
+	if( deadline_ns <= now ) {
+		uint64_t period = (uint64_t)interval * 1000000ULL;
+		missed += (unsigned int)((now - deadline_ns) / period);
+		deadline_ns = now + 1;
+	}
+	if( !scheduler_arm(deadline_ns) ) {
+		scheduler_close();
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+int
+Scheduler_Start(unsigned int interval_ms, GSourceFunc callback, gpointer data) {
+	Scheduler_Stop();
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if( timer_fd < 0 ) {
+		LOG_WARN("%s: timerfd_create failed: %s\n", __func__, strerror(errno));
+		return 0;
+	}
+	interval = interval_ms ? interval_ms : 1;
+	missed = 0;
+	capture_callback = callback;
+	capture_data = data;
+	deadline_ns = monotonic_ns() + 1;
+	if( !scheduler_arm(deadline_ns) ) {
+		scheduler_close();
+		return 0;
+	}
+	source_id = g_unix_fd_add(timer_fd, G_IO_IN, scheduler_tick, NULL);
+	return 1;
+}
+
+void
+Scheduler_Set_Interval(unsigned int interval_ms) {
+	interval = interval_ms ? interval_ms : 1;
+}
+
+unsigned int
+Scheduler_Missed(void) {
+	return missed;
+}
+
+void
+Scheduler_Stop(void) {
+	if( source_id )
+		g_source_remove(source_id);
+	scheduler_close();
+}
@@ -0,0 +1,51 @@
+/**
+ * Scheduler.h - Deadline-driven capture timer
+ *
+ * Runs the capture callback on absolute CLOCK_MONOTONIC deadlines from a
+ * timerfd attached to the GLib main loop. Each deadline is the previous one
+ * plus the current interval, so processing time does not add drift, and a
+ * new interval takes effect from the next frame. Deadlines missed while a
+ * frame was processed are skipped, not queued.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Start calling callback every interval_ms; the first call is immediate
+ *
+ * The schedule stops when the callback returns G_SOURCE_REMOVE.
+ *
+ * @param interval_ms Capture interval
+ * @param callback Capture function
+ * @param data Passed to callback
+ * @return 1 on success, 0 if the timer could not be created
+ */
+int Scheduler_Start(unsigned int interval_ms, GSourceFunc callback, gpointer data);
+
+/**
+ * Change the interval; applies to the deadline after the current one
+ */
+void Scheduler_Set_Interval(unsigned int interval_ms);
+
+/**
+ * Number of deadlines skipped because a frame overran its interval
+ */
+unsigned int Scheduler_Missed(void);
+
+/**
+ * Stop the schedule and close the timer
+ */
+void Scheduler_Stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SCHEDULER_H
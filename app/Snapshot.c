@@ -0,0 +1,539 @@
+/**
+ * Snapshot.c - Last inference JPEG store and "snapshot" HTTP node
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <glib.h>
+
+#include "Snapshot.h"
+#include "ACAP.h"
+#include "Metrics.h"
+#include "imgutils.h"
+
+#define LOG_MODULE "Snapshot"
+#include "Log.h"
+
+// Last published JPEG. jpeg_mutex only guards swapping this pointer and
+// taking a reference; readers use the image after unlocking.
+static SnapshotImage* latest = NULL;
+static GMutex jpeg_mutex;  // Statically allocated, no g_mutex_init() needed
+
+// Live view: viewers wait for a new image generation, then send the latest
+#define LIVE_BOUNDARY		"detectxframe"
+#define LIVE_DEFAULT_VIEWERS	2
+#define LIVE_KEEPALIVE_US	(5 * G_TIME_SPAN_SECOND)
+#define LIVE_STOP_US		(10 * G_TIME_SPAN_SECOND)
+static GCond image_cond;
+static guint64 image_generation = 0;  // Guarded by jpeg_mutex
+static atomic_int live_viewers = 0;
+static atomic_int live_stopping = 0;  // Set by Snapshot_Cleanup(); viewers end at the next image or timeout
+
+// Model and the NV12 snapshot encode at this quality
+#define IMAGE_QUALITY		90
+// Requested qualities are rounded up to these steps; the last is the image itself
+static const int variant_qualities[SNAPSHOT_QUALITIES] = { 30, 50, 70, IMAGE_QUALITY };
+// Serializes making variants so concurrent requests share one encode
+static GMutex variant_mutex;
+// Serializes encoding the pending frame the same way; never held with jpeg_mutex while encoding
+static GMutex encode_mutex;
+static guint64 latest_generation = 0;  // image_generation of latest; guarded by jpeg_mutex
+
+typedef struct {
+	ACAP_HTTP_Response response;
+	int width;
+	int quality;
+} LiveViewer;
+
+// Captured NV12 frame waiting to be encoded. It is borrowed from the video
+// stream and only valid until Snapshot_Release() before the next capture.
+static const unsigned char* pending_nv12 = NULL;
+static int pending_width = 0;
+static int pending_height = 0;
+static int pending = 0;
+static guint64 pending_generation = 0;
+static int high_res = 0;  // pending_nv12 is from the high resolution stream
+
+// High resolution frames are only captured for crops and while the UI shows snapshots
+#define SNAPSHOT_WANTED_US	(10 * G_TIME_SPAN_SECOND)
+static SnapshotHighResSource high_res_source = NULL;
+static int high_res_asked = 0;  // Frame loop only; the source ran for this frame
+static atomic_llong snapshot_requested = 0;  // g_get_monotonic_time() of the last request
+
+static SnapshotImage* snapshot_image_new(unsigned char* jpeg_data, size_t jpeg_size, int width, int height) {
+	SnapshotImage* image = (SnapshotImage*)malloc(sizeof(SnapshotImage));
+	if (!image) {
+		LOG_WARN("Failed to allocate memory for inference JPEG\n");
+		return NULL;
+	}
+	image->jpeg = jpeg_data;
+	image->size = jpeg_size;
+	image->width = width;
+	image->height = height;
+	image->quality = IMAGE_QUALITY;
+	atomic_init(&image->refs, 1);
+	memset(image->variants, 0, sizeof(image->variants));
+	return image;
+}
+
+// Make image the latest, taking over the caller's reference; call with jpeg_mutex held
+static void snapshot_publish(SnapshotImage* image, guint64 generation) {
+	SnapshotImage* previous = latest;
+	latest = image;
+	latest_generation = generation;
+	// Readers hold their own references, so the old image may outlive this
+	Snapshot_Unref(previous);
+}
+
+static SnapshotImage* snapshot_encode(const uint8_t* nv12, int width, int height) {
+	uint64_t stage_us = Metrics_Now();
+	uint8_t* rgb = nv12_to_rgb(nv12, width, height);
+	stage_us = Metrics_Since(METRICS_COLOR_CONVERT, stage_us);
+	if (!rgb) {
+		LOG_WARN("%s: Failed to convert snapshot to RGB\n", __func__);
+		return NULL;
+	}
+	unsigned long jpeg_size = 0;
+	unsigned char* jpeg = rgb_to_jpeg(rgb, width, height, IMAGE_QUALITY, &jpeg_size);
+	free(rgb);
+	Metrics_Since(METRICS_JPEG_ENCODE, stage_us);
+	if (!jpeg || jpeg_size == 0) {
+		LOG_WARN("%s: Failed to encode snapshot\n", __func__);
+		free(jpeg);
+		return NULL;
+	}
+
+	SnapshotImage* image = snapshot_image_new(jpeg, jpeg_size, width, height);
+	if (!image) {
+		free(jpeg);
+		return NULL;
+	}
+	LOG_TRACE("Encoded snapshot JPEG: %lu bytes (%dx%d)\n", jpeg_size, width, height);
+	return image;
+}
+
+// Encode the pending frame into the last JPEG. The borrowed frame is copied
+// under jpeg_mutex and encoded without it, so the frame loop is not held up.
+static void snapshot_encode_pending(void) {
+	g_mutex_lock(&encode_mutex);
+	g_mutex_lock(&jpeg_mutex);
+	if (!pending) {
+		g_mutex_unlock(&jpeg_mutex);
+		g_mutex_unlock(&encode_mutex);
+		return;
+	}
+	pending = 0;
+	int width = pending_width;
+	int height = pending_height;
+	guint64 generation = pending_generation;
+	size_t nv12_size = (size_t)width * height * 3 / 2;
+	uint8_t* nv12 = (uint8_t*)malloc(nv12_size);
+	if (nv12)
+		memcpy(nv12, pending_nv12, nv12_size);
+	g_mutex_unlock(&jpeg_mutex);
+
+	if (!nv12) {
+		LOG_WARN("%s: Failed to copy snapshot frame\n", __func__);
+		g_mutex_unlock(&encode_mutex);
+		return;
+	}
+	SnapshotImage* image = snapshot_encode(nv12, width, height);
+	free(nv12);
+	if (!image) {
+		g_mutex_unlock(&encode_mutex);
+		return;
+	}
+
+	// An inference JPEG stored while encoding is newer and stays
+	g_mutex_lock(&jpeg_mutex);
+	if (generation >= latest_generation)
+		snapshot_publish(image, generation);
+	else
+		Snapshot_Unref(image);
+	g_mutex_unlock(&jpeg_mutex);
+	g_mutex_unlock(&encode_mutex);
+}
+
+SnapshotImage* Snapshot_Acquire(void) {
+	snapshot_encode_pending();
+	g_mutex_lock(&jpeg_mutex);
+	SnapshotImage* image = latest;
+	if (image)
+		atomic_fetch_add_explicit(&image->refs, 1, memory_order_relaxed);
+	g_mutex_unlock(&jpeg_mutex);
+	return image;
+}
+
+void Snapshot_Unref(SnapshotImage* image) {
+	if (!image)
+		return;
+	if (atomic_fetch_sub_explicit(&image->refs, 1, memory_order_acq_rel) == 1) {
+		for (int s = 0; s < SNAPSHOT_SCALES; s++)
+			for (int q = 0; q < SNAPSHOT_QUALITIES; q++)
+				Snapshot_Unref(image->variants[s][q]);
+		free(image->jpeg);
+		free(image);
+	}
+}
+
+// Function to store the inference JPEG (called from Model.c)
+SnapshotImage* StoreInferenceJPEG(unsigned char* jpeg_data, size_t jpeg_size, int width, int height) {
+	if (!jpeg_data || jpeg_size == 0) {
+		return NULL;
+	}
+
+	SnapshotImage* image = snapshot_image_new(jpeg_data, jpeg_size, width, height);
+	if (!image) {
+		return NULL;
+	}
+
+	g_mutex_lock(&jpeg_mutex);
+	// The high resolution frame replaces the image sent for inference
+	if (!high_res) {
+		pending = 0;
+		pending_nv12 = NULL;
+		atomic_fetch_add_explicit(&image->refs, 1, memory_order_relaxed);
+		image_generation++;
+		snapshot_publish(image, image_generation);
+		g_cond_broadcast(&image_cond);
+		LOG_TRACE("Stored inference JPEG: %zu bytes (%dx%d)\n", jpeg_size, width, height);
+	}
+	g_mutex_unlock(&jpeg_mutex);
+	return image;
+}
+
+// Keep the full frame for the UI and crops when the Hub gets a resized image
+void StoreInferenceNV12(const unsigned char* nv12_data, int width, int height) {
+	if (!nv12_data || width <= 0 || height <= 0) {
+		return;
+	}
+
+	g_mutex_lock(&jpeg_mutex);
+	if (!high_res) {
+		pending_nv12 = nv12_data;
+		pending_width = width;
+		pending_height = height;
+		pending = 1;
+		pending_generation = ++image_generation;
+		g_cond_broadcast(&image_cond);
+	}
+	g_mutex_unlock(&jpeg_mutex);
+}
+
+void StoreHighResNV12(const unsigned char* nv12_data, int width, int height) {
+	if (!nv12_data || width <= 0 || height <= 0) {
+		return;
+	}
+
+	g_mutex_lock(&jpeg_mutex);
+	pending_nv12 = nv12_data;
+	pending_width = width;
+	pending_height = height;
+	pending = 1;
+	high_res = 1;
+	pending_generation = ++image_generation;
+	g_cond_broadcast(&image_cond);
+	g_mutex_unlock(&jpeg_mutex);
+}
+
+void Snapshot_HighRes_Source(SnapshotHighResSource source) {
+	high_res_source = source;
+}
+
+void Snapshot_Need_HighRes(void) {
+	if (!high_res_source || high_res_asked)
+		return;
+	high_res_asked = 1;
+	high_res_source();
+}
+
+int Snapshot_Wanted(void) {
+	return atomic_load(&live_viewers) > 0 ||
+	       g_get_monotonic_time() - atomic_load(&snapshot_requested) < SNAPSHOT_WANTED_US;
+}
+
+void Snapshot_Release(void) {
+	high_res_asked = 0;
+	// Encoders copy the frame under the lock, so this only waits for a copy
+	g_mutex_lock(&jpeg_mutex);
+	pending_nv12 = NULL;
+	pending = 0;
+	high_res = 0;
+	g_mutex_unlock(&jpeg_mutex);
+}
+
+int Snapshot_Size(int* width, int* height) {
+	int found = 0;
+	g_mutex_lock(&jpeg_mutex);
+	if (pending_nv12) {
+		*width = pending_width;
+		*height = pending_height;
+		found = 1;
+	} else if (latest) {
+		*width = latest->width;
+		*height = latest->height;
+		found = 1;
+	}
+	g_mutex_unlock(&jpeg_mutex);
+	return found;
+}
+
+unsigned char* Snapshot_Crop_JPEG(int x, int y, int width, int height, unsigned long* out_size) {
+	if (!out_size || width <= 0 || height <= 0) return NULL;
+	*out_size = 0;
+
+	g_mutex_lock(&jpeg_mutex);
+	if (!pending_nv12) {
+		// Only the encoded image is left: decode and crop it without holding the lock
+		SnapshotImage* image = latest;
+		if (image)
+			atomic_fetch_add_explicit(&image->refs, 1, memory_order_relaxed);
+		g_mutex_unlock(&jpeg_mutex);
+		if (!image)
+			return NULL;
+		unsigned char* jpeg = crop_jpeg(image->jpeg, image->size, x, y, width, height, out_size);
+		Snapshot_Unref(image);
+		return jpeg;
+	}
+
+	// Crop the frame before converting so only the crop is encoded; NV12 needs even edges
+	int left = x & ~1;
+	int top = y & ~1;
+	int right = (x + width + 1) & ~1;
+	int bottom = (y + height + 1) & ~1;
+	if (left < 0) left = 0;
+	if (top < 0) top = 0;
+	if (right > pending_width) right = pending_width & ~1;
+	if (bottom > pending_height) bottom = pending_height & ~1;
+	uint8_t* crop = NULL;
+	if (right > left && bottom > top)
+		crop = crop_nv12(pending_nv12, pending_width, pending_height, left, top, right - left, bottom - top);
+	g_mutex_unlock(&jpeg_mutex);
+	if (!crop) {
+		LOG_WARN("%s: Failed to crop %dx%d at %d,%d\n", __func__, width, height, x, y);
+		return NULL;
+	}
+
+	uint8_t* rgb = nv12_to_rgb(crop, right - left, bottom - top);
+	free(crop);
+	if (!rgb) {
+		LOG_WARN("%s: Failed to convert crop to RGB\n", __func__);
+		return NULL;
+	}
+	unsigned char* jpeg = rgb_to_jpeg(rgb, right - left, bottom - top, 90, out_size);
+	free(rgb);
+	if (!jpeg)
+		*out_size = 0;
+	return jpeg;
+}
+
+SnapshotImage* Snapshot_Acquire_Scaled(int width, int quality) {
+	SnapshotImage* image = Snapshot_Acquire();
+	if (!image)
+		return NULL;
+
+	// Variant slot: log2 of the scale denominator and quality step
+	int shift = 0;
+	while (width > 0 && shift < SNAPSHOT_SCALES - 1 && (image->width >> (shift + 1)) >= width)
+		shift++;
+	int step = SNAPSHOT_QUALITIES - 1;
+	while (quality > 0 && step > 0 && variant_qualities[step - 1] >= quality)
+		step--;
+	quality = variant_qualities[step];
+	if (shift == 0 && quality >= image->quality)
+		return image;
+
+	g_mutex_lock(&variant_mutex);
+	SnapshotImage* variant = image->variants[shift][step];
+	if (!variant) {
+		unsigned long size = 0;
+		int scaled_width = 0, scaled_height = 0;
+		unsigned char* jpeg = scale_jpeg(image->jpeg, image->size, 1 << shift, quality, &size, &scaled_width, &scaled_height);
+		SnapshotImage* fresh = jpeg && size ? snapshot_image_new(jpeg, size, scaled_width, scaled_height) : NULL;
+		if (fresh) {
+			fresh->quality = quality;
+			image->variants[shift][step] = variant = fresh;
+		} else {
+			LOG_WARN("%s: Failed to scale snapshot to 1/%d\n", __func__, 1 << shift);
+			free(jpeg);
+		}
+	}
+	if (variant)
+		atomic_fetch_add_explicit(&variant->refs, 1, memory_order_relaxed);
+	g_mutex_unlock(&variant_mutex);
+
+	Snapshot_Unref(image);
+	return variant;
+}
+
+// Optional width and quality request parameters; 0 when missing
+static void
+snapshot_request_size(const ACAP_HTTP_Request request, int* width, int* quality) {
+	const char* value = ACAP_HTTP_Request_Param(request, "width");
+	*width = value ? atoi(value) : 0;
+	free((void*)value);
+	value = ACAP_HTTP_Request_Param(request, "quality");
+	*quality = value ? atoi(value) : 0;
+	free((void*)value);
+}
+
+// Snapshot endpoint handler - serves the last inference JPEG, optionally scaled
+static void
+Snapshot_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+	const char* method = ACAP_HTTP_Get_Method(request);
+
+	if (!method || strcmp(method, "GET") != 0) {
+		ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Use GET");
+		return;
+	}
+
+	// The next frames keep the high resolution image up to date for the UI
+	atomic_store(&snapshot_requested, g_get_monotonic_time());
+
+	// The reference keeps the image alive while it is sent, even if a new one is published
+	int width, quality;
+	snapshot_request_size(request, &width, &quality);
+	SnapshotImage* image = Snapshot_Acquire_Scaled(width, quality);
+	if (!image) {
+		ACAP_HTTP_Respond_Error(response, 404, "No inference JPEG available");
+		return;
+	}
+
+	// Send JPEG response with headers and data
+	ACAP_HTTP_Header_FILE(response, "snapshot.jpg", "image/jpeg", image->size);
+	ACAP_HTTP_Respond_Data(response, image->size, image->jpeg);
+	Metrics_Bytes(METRICS_BYTES_SNAPSHOT, image->size);
+	Snapshot_Unref(image);
+}
+
+// Push every new image to one viewer until it disconnects
+static void*
+snapshot_live_thread(void* data) {
+	LiveViewer* viewer = (LiveViewer*)data;
+	ACAP_HTTP_Response response = viewer->response;
+	guint64 sent = 0;
+
+	int ok = ACAP_HTTP_Respond_String(response,
+		"Content-Type: multipart/x-mixed-replace; boundary=" LIVE_BOUNDARY "\r\n"
+		"Cache-Control: no-cache\r\n\r\n") && ACAP_HTTP_Flush(response);
+	while (ok) {
+		// Images published while the last one was being sent are skipped, so a
+		// slow viewer only lowers its own frame rate. Without new images the
+		// last one is resent now and then, which also detects a closed viewer.
+		g_mutex_lock(&jpeg_mutex);
+		gint64 deadline = g_get_monotonic_time() + LIVE_KEEPALIVE_US;
+		while (image_generation == sent && !atomic_load(&live_stopping) &&
+		       g_cond_wait_until(&image_cond, &jpeg_mutex, deadline))
+			;
+		sent = image_generation;
+		g_mutex_unlock(&jpeg_mutex);
+		if (atomic_load(&live_stopping))
+			break;
+
+		SnapshotImage* image = Snapshot_Acquire_Scaled(viewer->width, viewer->quality);
+		if (!image) {
+			// Nothing to show yet (or the timeout fired without one): an empty
+			// part keeps the connection alive and fails once the viewer is gone
+			ok = ACAP_HTTP_Respond_String(response, "--" LIVE_BOUNDARY "\r\nContent-Length: 0\r\n\r\n\r\n") &&
+			     ACAP_HTTP_Flush(response);
+			continue;
+		}
+		ok = ACAP_HTTP_Respond_String(response,
+				"--" LIVE_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n", image->size) &&
+		     ACAP_HTTP_Respond_Data(response, image->size, image->jpeg) &&
+		     ACAP_HTTP_Respond_String(response, "\r\n") &&
+		     ACAP_HTTP_Flush(response);
+		if (ok)
+			Metrics_Bytes(METRICS_BYTES_SNAPSHOT, image->size);
+		Snapshot_Unref(image);
+	}
+
+	LOG_TRACE("%s: Live viewer disconnected\n", __func__);
+	ACAP_HTTP_Finish(response);
+	free(viewer);
+	// Under jpeg_mutex, so Snapshot_Cleanup() cannot miss the last one leaving
+	g_mutex_lock(&jpeg_mutex);
+	atomic_fetch_sub(&live_viewers, 1);
+	g_cond_broadcast(&image_cond);
+	g_mutex_unlock(&jpeg_mutex);
+	return NULL;
+}
+
+// Live endpoint handler - multipart/x-mixed-replace stream of inference images
+static void
+Snapshot_Live_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+	const char* method = ACAP_HTTP_Get_Method(request);
+
+	if (!method || strcmp(method, "GET") != 0) {
+		ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Use GET");
+		return;
+	}
+
+	cJSON* settings = ACAP_Get_Config("settings");
+	cJSON* viewers = settings ? cJSON_GetObjectItem(settings, "liveViewers") : NULL;
+	int max_viewers = viewers && cJSON_IsNumber(viewers) ? viewers->valueint : LIVE_DEFAULT_VIEWERS;
+	if (atomic_fetch_add(&live_viewers, 1) >= max_viewers) {
+		atomic_fetch_sub(&live_viewers, 1);
+		ACAP_HTTP_Respond_Error(response, 503, "Too many live viewers - use snapshot");
+		return;
+	}
+	if (atomic_load(&live_stopping)) {
+		atomic_fetch_sub(&live_viewers, 1);
+		ACAP_HTTP_Respond_Error(response, 503, "Shutting down");
+		return;
+	}
+
+	// Request parameters do not outlive the callback
+	LiveViewer* viewer = (LiveViewer*)malloc(sizeof(LiveViewer));
+	if (!viewer) {
+		atomic_fetch_sub(&live_viewers, 1);
+		ACAP_HTTP_Respond_Error(response, 500, "Memory allocation failed");
+		return;
+	}
+	snapshot_request_size(request, &viewer->width, &viewer->quality);
+
+	viewer->response = ACAP_HTTP_Detach(request);
+	if (!viewer->response) {
+		free(viewer);
+		atomic_fetch_sub(&live_viewers, 1);
+		ACAP_HTTP_Respond_Error(response, 501, "Live view not available - use snapshot");
+		return;
+	}
+
+	pthread_t thread;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread, &attr, snapshot_live_thread, viewer) != 0) {
+		LOG_WARN("%s: Failed to start live viewer\n", __func__);
+		ACAP_HTTP_Respond_Error(viewer->response, 500, "Failed to start live view");
+		ACAP_HTTP_Finish(viewer->response);
+		free(viewer);
+		atomic_fetch_sub(&live_viewers, 1);
+	}
+	pthread_attr_destroy(&attr);
+}
+
+void
+Snapshot_Init(void) {
+	ACAP_HTTP_Node("snapshot", Snapshot_HTTP_callback);
+	ACAP_HTTP_Node("live", Snapshot_Live_HTTP_callback);
+}
+
+void
+Snapshot_Cleanup(void) {
+	// Viewer threads are detached; wake them and wait until they have left
+	g_mutex_lock(&jpeg_mutex);
+	atomic_store(&live_stopping, 1);
+	g_cond_broadcast(&image_cond);
+	gint64 deadline = g_get_monotonic_time() + LIVE_STOP_US;
+	while (atomic_load(&live_viewers) > 0 && g_cond_wait_until(&image_cond, &jpeg_mutex, deadline))
+		;
+	int remaining = atomic_load(&live_viewers);
+	g_mutex_unlock(&jpeg_mutex);
+	if (remaining)
+		LOG_WARN("%s: %d live viewers did not stop\n", __func__, remaining);
+}
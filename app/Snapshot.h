@@ -0,0 +1,157 @@
+/**
+ * Snapshot.h - Last inference JPEG store
+ *
+ * Model_Inference() stores every JPEG it sends to the Hub here. Output()
+ * crops detections from it and the "snapshot" HTTP node serves it to the UI.
+ * With client-side resize the Hub gets a model-sized image, so the full
+ * frame is kept as NV12 instead and encoded when it is first asked for.
+ * With a high resolution stream, its frame replaces the inference image on
+ * the frames where a crop or the UI needs it (Snapshot_Need_HighRes()).
+ *
+ * NV12 frames are borrowed from the video stream, not copied: call
+ * Snapshot_Release() before the stream buffers are returned.
+ *
+ * Encoded images are immutable and reference counted. The latest one is
+ * shared with the UI and crops without copying; each user holds its own
+ * reference, so a newer image never frees one that is still being sent.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNAPSHOT_SCALES    4   /* Full size, 1/2, 1/4 and 1/8 */
+#define SNAPSHOT_QUALITIES 4   /* Quality steps 30, 50, 70 and 90 */
+
+typedef struct SnapshotImage {
+	unsigned char* jpeg;     /* Read-only while referenced */
+	size_t size;
+	int width;
+	int height;
+	int quality;
+	atomic_int refs;
+	/* Scaled copies per scale and quality step, made on first request */
+	struct SnapshotImage* variants[SNAPSHOT_SCALES][SNAPSHOT_QUALITIES];
+} SnapshotImage;
+
+/**
+ * Register the "snapshot" HTTP node
+ */
+void Snapshot_Init(void);
+
+/**
+ * Stop the live viewers and wait for their threads to end
+ *
+ * Call before ACAP_Cleanup(), which closes the streams they write to.
+ */
+void Snapshot_Cleanup(void);
+
+/**
+ * Publish the JPEG sent for inference, replacing the previous image
+ *
+ * Takes ownership of jpeg_data, which must be malloc'd. The image is not
+ * published while a high resolution frame is kept.
+ *
+ * @return Reference for the caller to use and Snapshot_Unref(), or NULL
+ *         if wrapping failed and the caller still owns jpeg_data
+ */
+SnapshotImage* StoreInferenceJPEG(unsigned char* jpeg_data, size_t jpeg_size, int width, int height);
+
+/**
+ * Keep the full NV12 frame, replacing the previous image
+ *
+ * The JPEG is encoded by the first GetInferenceJPEG() or snapshot request.
+ * Ignored while a high resolution frame is kept.
+ */
+void StoreInferenceNV12(const unsigned char* nv12_data, int width, int height);
+
+/**
+ * Captures a high resolution frame and stores it with StoreHighResNV12()
+ */
+typedef void (*SnapshotHighResSource)(void);
+
+/**
+ * Set the high resolution frame source; NULL uses the inference image
+ */
+void Snapshot_HighRes_Source(SnapshotHighResSource source);
+
+/**
+ * Ask for a high resolution frame for the current frame
+ *
+ * Calls the source at most once per frame, on the frame loop thread.
+ * Output() calls it before cropping; main.c when Snapshot_Wanted().
+ */
+void Snapshot_Need_HighRes(void);
+
+/**
+ * 1 while a live viewer is connected or a snapshot was requested recently
+ */
+int Snapshot_Wanted(void);
+
+/**
+ * Keep a frame of the high resolution stream for the UI and crops
+ *
+ * Replaces the inference image until Snapshot_Release().
+ */
+void StoreHighResNV12(const unsigned char* nv12_data, int width, int height);
+
+/**
+ * Forget the borrowed NV12 frame; the last encoded JPEG is kept
+ */
+void Snapshot_Release(void);
+
+/**
+ * Size of the image that crops are taken from
+ *
+ * @return 1 if an image is available
+ */
+int Snapshot_Size(int* width, int* height);
+
+/**
+ * Encode a region of the current image as JPEG
+ *
+ * Crops the NV12 frame when one is kept, so the full image is never
+ * encoded or decoded. Edges may be widened by a pixel to even positions.
+ *
+ * @return malloc'd JPEG that the caller must free, or NULL
+ */
+unsigned char* Snapshot_Crop_JPEG(int x, int y, int width, int height, unsigned long* out_size);
+
+/**
+ * Reference to the latest image, encoding a pending NV12 frame first
+ *
+ * @return Image to release with Snapshot_Unref(), or NULL if none is available
+ */
+SnapshotImage* Snapshot_Acquire(void);
+
+/**
+ * Reference to a smaller or lower quality version of the latest image
+ *
+ * Scales by 1/2, 1/4 or 1/8 with libjpeg's DCT scaling: the smallest of
+ * these that is still at least width wide. The quality is rounded up to
+ * 30, 50, 70 or 90. Each scale and quality is made once per image and
+ * shared by later requests, so viewers asking for different qualities do
+ * not replace each other's copy.
+ *
+ * @param width Wanted width in pixels, 0 for full size
+ * @param quality JPEG quality 1-100, 0 to keep the image quality
+ * @return Image to release with Snapshot_Unref(), or NULL if none is available
+ */
+SnapshotImage* Snapshot_Acquire_Scaled(int width, int quality);
+
+/**
+ * Drop a reference; the last one frees the image. NULL is ignored.
+ */
+void Snapshot_Unref(SnapshotImage* image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SNAPSHOT_H
@@ -0,0 +1,47 @@
+/**
+ * Text.c - Growable printf text buffer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "Text.h"
+
+void Text_Init(Text* text, size_t capacity) {
+    text->data = malloc(capacity);
+    text->size = 0;
+    text->capacity = text->data ? capacity : 0;
+}
+
+void Text_Append(Text* text, const char* fmt, ...) {
+    if (!text->data)
+        return;
+    for (;;) {
+        va_list args;
+        va_start(args, fmt);
+        int written = vsnprintf(text->data + text->size, text->capacity - text->size, fmt, args);
+        va_end(args);
+        if (written < 0)
+            return;
+        if ((size_t)written < text->capacity - text->size) {
+            text->size += written;
+            return;
+        }
+        size_t capacity = text->capacity * 2 + written;
+        char* data = realloc(text->data, capacity);
+        if (!data) {
+            Text_Free(text);
+            return;
+        }
+        text->data = data;
+        text->capacity = capacity;
+    }
+}
+
+void Text_Free(Text* text) {
+    free(text->data);
+    text->data = NULL;
+    text->size = 0;
+    text->capacity = 0;
+}
@@ -0,0 +1,48 @@
+/**
+ * Text.h - Growable printf text buffer
+ *
+ * For HTTP responses that are built line by line and are too large or too
+ * many for a cJSON tree, such as the metrics exposition and the trace JSON.
+ */
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    char* data;                 /* NULL after an allocation failure */
+    size_t size;                /* Bytes written, excluding the terminator */
+    size_t capacity;
+} Text;
+
+/**
+ * Allocate the initial buffer
+ *
+ * @param text Buffer to initialize
+ * @param capacity Initial size in bytes
+ */
+void Text_Init(Text* text, size_t capacity);
+
+/**
+ * Append formatted text, doubling the buffer as needed
+ *
+ * On allocation failure the buffer is released and data is set to NULL;
+ * further appends are ignored, so callers only need to check data once.
+ */
+void Text_Append(Text* text, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * Release the buffer
+ */
+void Text_Free(Text* text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TEXT_H
@@ -0,0 +1,151 @@
+/**
+ * Trace.c - Per-frame span trace ring
+ *
+ * Writers claim a slot with a single atomic increment and publish it with a
+ * per-slot sequence number (odd while writing, even when complete), so
+ * recording never blocks the frame loop. The HTTP reader copies a slot and
+ * re-checks the sequence number, dropping any slot that was overwritten
+ * while it was being read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <stdatomic.h>
+
+#include "Trace.h"
+#include "Metrics.h"
+#include "ACAP.h"
+#include "Text.h"
+
+#define LOG_MODULE "Trace"
+#include "Log.h"
+
+#define TRACE_RING_SIZE 8192        /* Power of two; ~30s at 10 fps with all sinks enabled */
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+#define TRACE_DEFAULT_SECONDS 10
+#define TRACE_MAX_SECONDS 3600
+
+typedef struct {
+    atomic_uint_fast64_t seq;   /* 2*ticket+1 while writing, 2*ticket+2 when complete */
+    const char* name;
+    uint64_t start_us;
+    uint64_t end_us;
+    uint32_t frame;
+    uint32_t tid;
+} TraceEvent;
+
+static TraceEvent ring[TRACE_RING_SIZE];
+static atomic_uint_fast64_t ring_head;
+static atomic_uint_fast32_t next_frame_id = 1;
+
+static _Thread_local uint32_t current_frame = 0;
+static _Thread_local uint32_t current_tid = 0;
+
+uint32_t Trace_Frame_Begin(void) {
+    current_frame = (uint32_t)atomic_fetch_add_explicit(&next_frame_id, 1, memory_order_relaxed);
+    if (current_frame == 0)  // Wrapped; 0 means "no frame"
+        current_frame = (uint32_t)atomic_fetch_add_explicit(&next_frame_id, 1, memory_order_relaxed);
+    return current_frame;
+}
+
+void Trace_Frame_End(void) {
+    current_frame = 0;
+}
+
+void Trace_Span(const char* name, uint64_t start_us, uint64_t end_us) {
+    if (!name)
+        return;
+    if (!current_tid)
+        current_tid = (uint32_t)syscall(SYS_gettid);
+
+    uint64_t ticket = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed);
+    TraceEvent* event = &ring[ticket & TRACE_RING_MASK];
+
+    atomic_store_explicit(&event->seq, 2 * ticket + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    event->name = name;
+    event->start_us = start_us;
+    event->end_us = end_us > start_us ? end_us : start_us;
+    event->frame = current_frame;
+    event->tid = current_tid;
+    atomic_store_explicit(&event->seq, 2 * ticket + 2, memory_order_release);
+}
+
+// Copy a completed slot; returns 0 if it is empty, being written or was overwritten during the copy
+static int read_event(uint64_t ticket, TraceEvent* out) {
+    TraceEvent* event = &ring[ticket & TRACE_RING_MASK];
+    uint64_t before = atomic_load_explicit(&event->seq, memory_order_acquire);
+    if (before != 2 * ticket + 2)
+        return 0;
+    out->name = event->name;
+    out->start_us = event->start_us;
+    out->end_us = event->end_us;
+    out->frame = event->frame;
+    out->tid = event->tid;
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&event->seq, memory_order_relaxed) == before;
+}
+
+static void
+Trace_HTTP_callback(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    const char* method = ACAP_HTTP_Get_Method(request);
+    if (!method || strcmp(method, "GET") != 0) {
+        ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Use GET");
+        return;
+    }
+
+    int seconds = TRACE_DEFAULT_SECONDS;
+    const char* secondsParam = ACAP_HTTP_Request_Param(request, "seconds");
+    if (secondsParam) {
+        seconds = atoi(secondsParam);
+        free((void*)secondsParam);
+    }
+    if (seconds <= 0)
+        seconds = TRACE_DEFAULT_SECONDS;
+    if (seconds > TRACE_MAX_SECONDS)
+        seconds = TRACE_MAX_SECONDS;
+
+    uint64_t now = Metrics_Now();
+    uint64_t cutoff = now > (uint64_t)seconds * 1000000ULL ? now - (uint64_t)seconds * 1000000ULL : 0;
+    uint64_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+    Text text;
+    Text_Init(&text, 65536);
+    Text_Append(&text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    Text_Append(&text, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"detectx_client\"}}",
+                (int)getpid());
+
+    TraceEvent event;
+    for (uint64_t ticket = first; ticket < head; ticket++) {
+        if (!read_event(ticket, &event) || event.end_us < cutoff)
+            continue;
+        Text_Append(&text,
+                    ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+                    "\"pid\":%d,\"tid\":%u,\"args\":{\"frame\":%u}}",
+                    event.name, event.frame ? "frame" : "background",
+                    (unsigned long long)event.start_us,
+                    (unsigned long long)(event.end_us - event.start_us),
+                    (int)getpid(), event.tid, event.frame);
+    }
+    Text_Append(&text, "\n]}\n");
+
+    if (!text.data) {
+        ACAP_HTTP_Respond_Error(response, 500, "Memory allocation failed");
+        return;
+    }
+
+    ACAP_HTTP_Header_FILE(response, "trace.json", "application/json", (unsigned)text.size);
+    ACAP_HTTP_Respond_Data(response, text.size, text.data);
+    Text_Free(&text);
+}
+
+void Trace_Init(void) {
+    LOG_TRACE("<%s\n", __func__);
+    ACAP_HTTP_Node("trace", Trace_HTTP_callback);
+    LOG_TRACE("%s>\n", __func__);
+}
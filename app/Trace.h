@@ -0,0 +1,53 @@
+/**
+ * Trace.h - Per-frame span trace ring
+ *
+ * Every frame processed by ImageProcess() gets a trace ID. Spans recorded
+ * while the frame is in flight (capture, inference, Hub request phases,
+ * filtering, each output sink) are tagged with that ID and stored in a
+ * fixed-size lock-free ring. The "trace" HTTP node dumps the last N seconds
+ * as Chrome/Perfetto trace-event JSON (open in ui.perfetto.dev or
+ * chrome://tracing).
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Register the "trace" HTTP node.
+ *
+ * Recording is possible before initialization; the ring is static.
+ */
+void Trace_Init(void);
+
+/**
+ * Start a new frame on the calling thread
+ *
+ * @return Trace ID tagged on all spans recorded by this thread until Trace_Frame_End()
+ */
+uint32_t Trace_Frame_Begin(void);
+
+/**
+ * End the current frame on the calling thread
+ */
+void Trace_Frame_End(void);
+
+/**
+ * Record a completed span. Safe to call from any thread.
+ *
+ * @param name Span name, must be a string literal or otherwise never freed
+ * @param start_us Metrics_Now() timestamp when the span started
+ * @param end_us Metrics_Now() timestamp when the span ended
+ */
+void Trace_Span(const char* name, uint64_t start_us, uint64_t end_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TRACE_H
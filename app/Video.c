@@ -3,20 +3,27 @@
 #include <stdlib.h>
 #include "Video.h"
 #include "imgutils.h"
+#include "Metrics.h"
 
 
-#define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
-#define LOG_WARN(fmt, args...)    { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args);}
-//#define LOG_TRACE(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); }
-#define LOG_TRACE(fmt, args...)    {}
+#define LOG_MODULE "Video"
+#include "Log.h"
 
 ImgProvider_t* yuvProvider = NULL;
 VdoBuffer* yuvBuffer = NULL;
 ImgProvider_t* rgbProvider = NULL;
 VdoBuffer* rgbBuffer = NULL;
+ImgProvider_t* hiResProvider = NULL;
+VdoBuffer* hiResBuffer = NULL;
+
+// VDO delivers this many frames per capture interval, so the newest frame is
+// at most a quarter interval old while the fetcher threads stay mostly idle
+#define FRAMES_PER_INTERVAL	4
+#define MAX_FRAMERATE		30.0
+static double streamFramerate = 0;
 
 bool Video_Start_YUV(unsigned int width, unsigned int height) {
-    yuvProvider = createImgProvider(width, height, 2, VDO_FORMAT_YUV);
+    yuvProvider = createImgProvider(width, height, VDO_FORMAT_YUV);
     if (!yuvProvider) {
         LOG_WARN("%s: Could not create image provider\n", __func__);
 		return false;
@@ -55,7 +62,7 @@ Video_Capture_YUV() {
 bool Video_Start_RGB(unsigned int width, unsigned int height) {
     LOG("%s: Requesting RGB video stream with resolution %ux%u (YUV format)\n", __func__, width, height);
 
-    rgbProvider = createImgProvider(width, height, 1, VDO_FORMAT_YUV);
+    rgbProvider = createImgProvider(width, height, VDO_FORMAT_YUV);
     if (!rgbProvider) {
         LOG_WARN("%s: Could not create image provider for %ux%u JPEG\n", __func__, width, height);
 		return false;
@@ -78,6 +85,7 @@ Video_Stop_RGB() {
         destroyImgProvider(rgbProvider);
     }
 	rgbProvider = NULL;
+	streamFramerate = 0;
 }
 
 VdoBuffer*
@@ -86,10 +94,102 @@ Video_Capture_RGB() {
 		LOG_TRACE("No RGB provider");
 		return 0;
 	}
+	uint64_t start_us = Metrics_Now();
 	if( rgbBuffer )
 		returnFrame(rgbProvider, rgbBuffer);	
     rgbBuffer = getLastFrameBlocking(rgbProvider);
+	uint64_t now_us = Metrics_Since(METRICS_CAPTURE, start_us);
+	if( rgbBuffer ) {
+		// VDO frame timestamps are CLOCK_MONOTONIC microseconds, same clock as Metrics_Now()
+		uint64_t captured_us = vdo_frame_get_timestamp(vdo_buffer_get_frame(rgbBuffer));
+		if( captured_us && captured_us <= now_us )
+			Metrics_Span(METRICS_FRAME_AGE, captured_us, now_us);
+	}
     return rgbBuffer;
 }
 
 
+// High resolution stream for crops and the UI snapshot; inference uses the RGB stream
+bool Video_Start_HiRes(unsigned int width, unsigned int height) {
+    hiResProvider = createImgProvider(width, height, VDO_FORMAT_YUV);
+    if (!hiResProvider) {
+        LOG_WARN("%s: Could not create image provider for %ux%u\n", __func__, width, height);
+		return false;
+	}
+    if (!startFrameFetch(hiResProvider)) {
+        destroyImgProvider(hiResProvider);
+        hiResProvider = NULL;
+        LOG_WARN("%s: Unable to start frame fetch for %ux%u\n", __func__, width, height);
+		return false;
+    }
+	LOG("%s: High resolution video started: %ux%u\n",__func__,width,height);
+	return true;
+}
+
+void
+Video_Stop_HiRes() {
+	if( hiResProvider ) {
+		if( hiResBuffer )
+			returnFrame(hiResProvider, hiResBuffer);
+		stopFrameFetch(hiResProvider);
+        destroyImgProvider(hiResProvider);
+    }
+	hiResProvider = NULL;
+	hiResBuffer = NULL;
+}
+
+void
+Video_Frame_Counts(unsigned long* delivered, unsigned long* dropped) {
+	*delivered = *dropped = 0;
+	if( rgbProvider )
+		getFrameCounts(rgbProvider, delivered, dropped);
+}
+
+void
+Video_Set_Interval(unsigned int interval_ms) {
+	double fps = interval_ms ? FRAMES_PER_INTERVAL * 1000.0 / interval_ms : MAX_FRAMERATE;
+	if( fps > MAX_FRAMERATE )
+		fps = MAX_FRAMERATE;
+	if( fps < 1 )
+		fps = 1;
+	// Adaptive rate moves a little every frame; only reconfigure VDO on a clear change
+	if( streamFramerate > 0 && fps >= streamFramerate * 0.75 && fps <= streamFramerate * 1.25 )
+		return;
+	if( !rgbProvider )
+		return;
+	if( !setFrameRate(rgbProvider, fps) )
+		return;
+	if( hiResProvider )
+		setFrameRate(hiResProvider, fps);
+	LOG_TRACE("%s: %.2f fps for %u ms capture interval\n", __func__, fps, interval_ms);
+	streamFramerate = fps;
+}
+
+static uint64_t
+frame_distance(VdoBuffer* buffer, uint64_t timestamp_us) {
+	uint64_t captured_us = vdo_frame_get_timestamp(vdo_buffer_get_frame(buffer));
+	return captured_us > timestamp_us ? captured_us - timestamp_us : timestamp_us - captured_us;
+}
+
+// Only called when a crop or snapshot needs the frame, so the stream may
+// have moved on since the inference frame was captured
+VdoBuffer*
+Video_Capture_HiRes(uint64_t timestamp_us) {
+	if(!hiResProvider)
+		return 0;
+	VdoBuffer* newest = getLastFrame(hiResProvider);
+	// A kept frame from before the inference frame is replaced by the next one, which follows it
+	if( !newest && (!hiResBuffer || !timestamp_us ||
+	    vdo_frame_get_timestamp(vdo_buffer_get_frame(hiResBuffer)) < timestamp_us) )
+		newest = getLastFrameBlocking(hiResProvider);
+	if( !newest )
+		return hiResBuffer;
+	if( hiResBuffer && timestamp_us && frame_distance(hiResBuffer, timestamp_us) < frame_distance(newest, timestamp_us) ) {
+		returnFrame(hiResProvider, newest);
+		return hiResBuffer;
+	}
+	if( hiResBuffer )
+		returnFrame(hiResProvider, hiResBuffer);
+	hiResBuffer = newest;
+	return hiResBuffer;
+}
@@ -12,4 +12,17 @@ void Video_Stop_RGB();
 VdoBuffer* Video_Capture_YUV(); 
 VdoBuffer* Video_Capture_RGB();
 
+// Optional second stream in the same aspect; NULL when not started
+bool Video_Start_HiRes(unsigned int width, unsigned int height);
+void Video_Stop_HiRes();
+// The kept or newest frame, whichever was captured closer to timestamp_us
+// (CLOCK_MONOTONIC, as vdo_frame_get_timestamp())
+VdoBuffer* Video_Capture_HiRes(uint64_t timestamp_us);
+
+// Match the VDO frame rate to the capture interval
+void Video_Set_Interval(unsigned int interval_ms);
+
+// Inference stream frames delivered by VDO and dropped unclaimed
+void Video_Frame_Counts(unsigned long* delivered, unsigned long* dropped);
+
 #endif
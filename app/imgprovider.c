@@ -23,7 +23,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <gmodule.h>
+#include <sys/eventfd.h>
 #include <syslog.h>
+#include <unistd.h>
 
 #include "vdo-map.h"
 #include <vdo-channel.h>
@@ -67,25 +69,15 @@ static void releaseVdoBuffers(ImgProvider_t* provider);
  *
  * Responsible for fetching buffers/frames from VDO and re-enqueue buffers back
  * to VDO when they are not needed by the application. The ImgProvider always
- * keeps one or several of the most recent frames available in the application.
- * There are two queues involved: deliveredFrames and processedFrames.
- * - deliveredFrames are frames delivered from VDO and
- *   not processed by the client.
- * - processedFrames are frames that the client has consumed and handed
- *   back to the ImgProvider.
+ * keeps the most recent frame available in the application.
  * The thread works roughly like this:
  * 1. The thread blocks on vdo_stream_get_buffer() until VDO deliver a new
  * frame.
- * 2. The fresh frame is put at the end of the deliveredFrame queue. If the
- *    client want to fetch a frame the item at the end of deliveredFrame
- *    list is returned.
- * 3. If there are any frames in the processedFrames list one of these are
+ * 2. The fresh frame is swapped into latestFrame. If the client had not
+ *    claimed the previous frame, that frame is dropped and enqueued back to
+ *    VDO. A client sleeping in getLastFrameBlocking() is woken.
+ * 3. Frames the client has handed back through the returnedFrames ring are
  *    enqueued back to VDO to keep the flow of buffers.
- * 4. If the processedFrames list is empty we instead check if there are
- *    frames available in the deliveredFrames list. We want to make sure
- *    there is at least numAppFrames buffers available to the client to
- *    fetch. If there are more than numAppFrames in deliveredFrames we
- *    pick the first buffer (oldest) in the list and enqueue it to VDO.
 
  * param data Pointer to ImgProvider owning thread.
  * return Pointer to unused return data.
@@ -93,43 +85,24 @@ static void releaseVdoBuffers(ImgProvider_t* provider);
 static void* threadEntry(void* data);
 
 ImgProvider_t*
-createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFormat format) {
-    bool mtxInitialized  = false;
-    bool condInitialized = false;
-
+createImgProvider(unsigned int w, unsigned int h, VdoFormat format) {
     ImgProvider_t* provider = calloc(1, sizeof(ImgProvider_t));
     if (!provider) {
         syslog(LOG_ERR, "%s: Unable to allocate ImgProvider: %s", __func__, strerror(errno));
-        goto errorExit;
-    }
-
-    provider->vdoFormat    = format;
-    provider->numAppFrames = numFrames;
-
-    if (pthread_mutex_init(&provider->frameMutex, NULL)) {
-        syslog(LOG_ERR, "%s: Unable to initialize mutex: %s", __func__, strerror(errno));
-        goto errorExit;
-    }
-    mtxInitialized = true;
-
-    if (pthread_cond_init(&provider->frameDeliverCond, NULL)) {
-        syslog(LOG_ERR,
-               "%s: Unable to initialize condition variable: %s",
-               __func__,
-               strerror(errno));
-        goto errorExit;
+        return NULL;
     }
-    condInitialized = true;
 
-    provider->deliveredFrames = g_queue_new();
-    if (!provider->deliveredFrames) {
-        syslog(LOG_ERR, "%s: Unable to create deliveredFrames queue!", __func__);
-        goto errorExit;
-    }
-
-    provider->processedFrames = g_queue_new();
-    if (!provider->processedFrames) {
-        syslog(LOG_ERR, "%s: Unable to create processedFrames queue!", __func__);
+    provider->vdoFormat = format;
+    atomic_init(&provider->latestFrame, NULL);
+    FrameRing_Init(&provider->returnedFrames);
+    atomic_init(&provider->clientWaiting, false);
+    atomic_init(&provider->shutDown, false);
+    atomic_init(&provider->framesDelivered, 0);
+    atomic_init(&provider->framesDropped, 0);
+
+    provider->frameEventFd = eventfd(0, EFD_CLOEXEC);
+    if (provider->frameEventFd < 0) {
+        syslog(LOG_ERR, "%s: Unable to create frame eventfd: %s", __func__, strerror(errno));
         goto errorExit;
     }
 
@@ -141,17 +114,8 @@ createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFor
     return provider;
 
 errorExit:
-    if (mtxInitialized) {
-        pthread_mutex_destroy(&provider->frameMutex);
-    }
-    if (condInitialized) {
-        pthread_cond_destroy(&provider->frameDeliverCond);
-    }
-    if (provider->deliveredFrames) {
-        g_queue_free(provider->deliveredFrames);
-    }
-    if (provider->processedFrames) {
-        g_queue_free(provider->processedFrames);
+    if (provider->frameEventFd >= 0) {
+        close(provider->frameEventFd);
     }
 
     free(provider);
@@ -167,11 +131,7 @@ void destroyImgProvider(ImgProvider_t* provider) {
 
     releaseVdoBuffers(provider);
 
-    pthread_mutex_destroy(&provider->frameMutex);
-    pthread_cond_destroy(&provider->frameDeliverCond);
-
-    g_queue_free(provider->deliveredFrames);
-    g_queue_free(provider->processedFrames);
+    close(provider->frameEventFd);
 
     free(provider);
 }
@@ -319,6 +279,8 @@ bool createStream(ImgProvider_t* provider, unsigned int w, unsigned int h) {
     // Use INFINITE strategy (default) - VDO manages buffers
     vdo_map_set_uint32(vdoMap, "buffer.strategy", VDO_BUFFER_STRATEGY_INFINITE);
     vdo_map_set_uint32(vdoMap, "buffer.count", NUM_VDO_BUFFERS);
+    // Allow setFrameRate() to follow the capture schedule without restarting the stream
+    vdo_map_set_boolean(vdoMap, "dynamic.framerate", TRUE);
 
     syslog(LOG_INFO, "Dump of vdo stream settings map =====");
     vdo_map_dump(vdoMap);
@@ -380,30 +342,60 @@ static void releaseVdoBuffers(ImgProvider_t* provider) {
 }
 
 VdoBuffer* getLastFrameBlocking(ImgProvider_t* provider) {
-    VdoBuffer* returnBuf = NULL;
-    pthread_mutex_lock(&provider->frameMutex);
-
-    while (g_queue_get_length(provider->deliveredFrames) < 1) {
-        if (pthread_cond_wait(&provider->frameDeliverCond, &provider->frameMutex)) {
-            syslog(LOG_ERR, "%s: Failed to wait on condition: %s", __func__, strerror(errno));
-            goto errorExit;
+    for (;;) {
+        VdoBuffer* frame = atomic_exchange(&provider->latestFrame, NULL);
+        if (frame) {
+            return frame;
         }
-    }
 
-    returnBuf = g_queue_pop_tail(provider->deliveredFrames);
+        // Announce the wait, then look again: the fetcher may have published
+        // a frame before it could see the flag.
+        atomic_store(&provider->clientWaiting, true);
+        frame = atomic_exchange(&provider->latestFrame, NULL);
+        if (frame) {
+            atomic_store(&provider->clientWaiting, false);
+            return frame;
+        }
 
-errorExit:
-    pthread_mutex_unlock(&provider->frameMutex);
+        // A stale wakeup from an earlier wait only costs one more loop
+        eventfd_t count;
+        if (eventfd_read(provider->frameEventFd, &count) && errno != EINTR) {
+            syslog(LOG_ERR, "%s: Failed to wait for a frame: %s", __func__, strerror(errno));
+            return NULL;
+        }
+    }
+}
 
-    return returnBuf;
+VdoBuffer* getLastFrame(ImgProvider_t* provider) {
+    return atomic_exchange(&provider->latestFrame, NULL);
 }
 
 void returnFrame(ImgProvider_t* provider, VdoBuffer* buffer) {
-    pthread_mutex_lock(&provider->frameMutex);
+    // Only full if the fetcher thread is stuck in VDO while the client keeps
+    // returning frames; every buffer fits, so this never waits for long.
+    FrameRing_Push(&provider->returnedFrames, buffer);
+}
 
-    g_queue_push_tail(provider->processedFrames, buffer);
+void getFrameCounts(ImgProvider_t* provider, unsigned long* delivered, unsigned long* dropped) {
+    if (delivered) {
+        *delivered = atomic_load_explicit(&provider->framesDelivered, memory_order_relaxed);
+    }
+    if (dropped) {
+        *dropped = atomic_load_explicit(&provider->framesDropped, memory_order_relaxed);
+    }
+}
 
-    pthread_mutex_unlock(&provider->frameMutex);
+static void enqueueVdoBuffer(ImgProvider_t* provider, VdoBuffer* buffer) {
+    GError* error = NULL;
+
+    if (!vdo_stream_buffer_enqueue(provider->vdoStream, buffer, &error)) {
+        // Fail but we continue anyway hoping for the best.
+        syslog(LOG_WARNING,
+               "%s: Failed enqueueing buffer to vdo: %s",
+               __func__,
+               (error != NULL) ? error->message : "N/A");
+        g_clear_error(&error);
+    }
 }
 
 static void* threadEntry(void* data) {
@@ -423,42 +415,45 @@ static void* threadEntry(void* data) {
             g_clear_error(&error);
             continue;
         }
-        pthread_mutex_lock(&provider->frameMutex);
-
-        g_queue_push_tail(provider->deliveredFrames, newBuffer);
-
-        VdoBuffer* oldBuffer = NULL;
-
-        // First check if there are any frames returned from app
-        // processing
-        if (g_queue_get_length(provider->processedFrames) > 0) {
-            oldBuffer = g_queue_pop_head(provider->processedFrames);
-        } else {
-            // Client specifies the number-of-recent-frames it needs to collect
-            // in one chunk (numAppFrames). Thus only enqueue buffers back to
-            // VDO if we have collected more buffers than numAppFrames.
-            if (g_queue_get_length(provider->deliveredFrames) > provider->numAppFrames) {
-                oldBuffer = g_queue_pop_head(provider->deliveredFrames);
-            }
+        atomic_fetch_add_explicit(&provider->framesDelivered, 1, memory_order_relaxed);
+
+        // Publish the fresh frame; one the client never claimed goes back to VDO
+        VdoBuffer* unclaimed = atomic_exchange(&provider->latestFrame, newBuffer);
+        if (unclaimed) {
+            atomic_fetch_add_explicit(&provider->framesDropped, 1, memory_order_relaxed);
+            enqueueVdoBuffer(provider, unclaimed);
+        }
+        if (atomic_exchange(&provider->clientWaiting, false)) {
+            eventfd_write(provider->frameEventFd, 1);
         }
 
-        if (oldBuffer) {
-            if (!vdo_stream_buffer_enqueue(provider->vdoStream, oldBuffer, &error)) {
-                // Fail but we continue anyway hoping for the best.
-                syslog(LOG_WARNING,
-                       "%s: Failed enqueueing buffer to vdo: %s",
-                       __func__,
-                       (error != NULL) ? error->message : "N/A");
-                g_clear_error(&error);
-            }
+        // Recycle frames the client has handed back
+        VdoBuffer* oldBuffer;
+        while ((oldBuffer = FrameRing_Pop(&provider->returnedFrames))) {
+            enqueueVdoBuffer(provider, oldBuffer);
         }
+
         g_object_unref(newBuffer);  // Release the ref from vdo_stream_get_buffer
-        pthread_cond_signal(&provider->frameDeliverCond);
-        pthread_mutex_unlock(&provider->frameMutex);
     }
     return provider;
 }
 
+bool setFrameRate(ImgProvider_t* provider, double fps) {
+    GError* error = NULL;
+
+    if (!vdo_stream_set_framerate(provider->vdoStream, fps, &error)) {
+        syslog(LOG_WARNING,
+               "%s: Failed setting frame rate %.2f: %s",
+               __func__,
+               fps,
+               (error != NULL) ? error->message : "N/A");
+        g_clear_error(&error);
+        return false;
+    }
+
+    return true;
+}
+
 bool startFrameFetch(ImgProvider_t* provider) {
     if (pthread_create(&provider->fetcherThread, NULL, threadEntry, provider)) {
         syslog(LOG_ERR,
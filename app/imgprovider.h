@@ -24,10 +24,12 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 
+#include "FrameRing.h"
 #include "vdo-stream.h"
 #include "vdo-types.h"
 
 #define NUM_VDO_BUFFERS (8)
+_Static_assert(FRAME_RING_SLOTS >= 2 * NUM_VDO_BUFFERS, "returnedFrames must hold every buffer");
 
 /**
  * brief A type representing a provider of frames from VDO.
@@ -35,6 +37,11 @@
  * Keep track of what kind of images the user wants, all the necessary
  * VDO types to setup and maintain a stream, as well as parameters to make
  * the streaming thread safe.
+ *
+ * Frames are handed between the fetcher thread and one client thread
+ * without locks: the newest frame is swapped in and out of latestFrame,
+ * and consumed frames go back through a single-producer/single-consumer
+ * ring. The client only sleeps, on an eventfd, when no frame is waiting.
  */
 typedef struct ImgProvider {
     /// Stream configuration parameters.
@@ -44,17 +51,22 @@ typedef struct ImgProvider {
     VdoStream* vdoStream;
     VdoBuffer* vdoBuffers[NUM_VDO_BUFFERS];
 
-    /// Keeping track of frames' statuses.
-    GQueue* deliveredFrames;
-    GQueue* processedFrames;
-    /// Number of frames to keep in the deliveredFrames queue.
-    unsigned int numAppFrames;
+    /// Newest frame from VDO not yet claimed by the client, or NULL.
+    _Atomic(VdoBuffer*) latestFrame;
+
+    /// Frames the client has consumed, pushed by the client and
+    /// popped by the fetcher thread.
+    FrameRing returnedFrames;
 
     /// To support fetching frames asynchonously with VDO.
-    pthread_mutex_t frameMutex;
-    pthread_cond_t frameDeliverCond;
+    int frameEventFd;
+    atomic_bool clientWaiting;
     pthread_t fetcherThread;
     atomic_bool shutDown;
+
+    /// Frames delivered by VDO, and those replaced before the client claimed them.
+    atomic_ulong framesDelivered;
+    atomic_ulong framesDropped;
 } ImgProvider_t;
 
 /**
@@ -82,14 +94,16 @@ bool chooseStreamResolution(unsigned int reqWidth,
  * find resolution of the created stream. These numbers might not match the
  * requested resolution depending on platform properties.
  *
+ * Only the most recent frame is kept for the client; older ones go
+ * straight back to VDO.
+ *
  * param w Requested output image width.
  * param h Requested ouput image height.
- * param numFrames Number of fetched frames to keep.
  * param vdoFormat Image format to be output by stream.
  * return Pointer to new ImgProvider, or NULL if failed.
  */
 ImgProvider_t*
-createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFormat vdoFormat);
+createImgProvider(unsigned int w, unsigned int h, VdoFormat vdoFormat);
 
 /**
  * brief Release VDO buffers and deallocate provider.
@@ -98,6 +112,18 @@ createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFor
  */
 void destroyImgProvider(ImgProvider_t* provider);
 
+/**
+ * brief Change the frame rate of a running stream.
+ *
+ * VDO then only delivers, and the fetcher thread only wakes for, the
+ * frames the application can use.
+ *
+ * param provider Pointer to an ImgProvider fetching frames.
+ * param fps Requested frames per second.
+ * return False if VDO rejected the frame rate, otherwise true.
+ */
+bool setFrameRate(ImgProvider_t* provider, double fps);
+
 /**
  * brief Create the thread and start fetching frames.
  *
@@ -117,11 +143,25 @@ bool stopFrameFetch(ImgProvider_t* provider);
 /**
  * brief Get the most recent frame the thread has fetched from VDO.
  *
+ * Blocks only if the client already claimed the newest frame. Must be
+ * called from a single client thread, as must returnFrame().
+ *
  * param provider Pointer to an ImgProvider fetching frames.
  * return Pointer to an image buffer on success, otherwise NULL.
  */
 VdoBuffer* getLastFrameBlocking(ImgProvider_t* provider);
 
+/**
+ * brief Get the most recent frame if one is waiting, without blocking.
+ *
+ * Same single client thread rule as getLastFrameBlocking().
+ *
+ * param provider Pointer to an ImgProvider fetching frames.
+ * return Pointer to an image buffer, or NULL if the client already claimed
+ *        the newest frame.
+ */
+VdoBuffer* getLastFrame(ImgProvider_t* provider);
+
 /**
  * brief Release reference to an image buffer.
  *
@@ -129,3 +169,12 @@ VdoBuffer* getLastFrameBlocking(ImgProvider_t* provider);
  * param buffer Pointer to the image buffer to be released.
  */
 void returnFrame(ImgProvider_t* provider, VdoBuffer* buffer);
+
+/**
+ * brief Frame counters since the provider was created.
+ *
+ * param provider Pointer to an ImgProvider fetching frames.
+ * param delivered Frames delivered by VDO.
+ * param dropped Frames replaced by a newer one before the client claimed them.
+ */
+void getFrameCounts(ImgProvider_t* provider, unsigned long* delivered, unsigned long* dropped);
@@ -19,10 +19,8 @@
 #include <jpeglib.h>
 
 /* Logging macros */
-#define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
-#define LOG_WARN(fmt, args...) { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args); }
-//#define LOG_TRACE(fmt, args...) { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
-#define LOG_TRACE(fmt, args...) {}
+#define LOG_MODULE "imgutils"
+#include "Log.h"
 /**
  * @brief Encode an image buffer as JPEG and store it in memory.
  *
@@ -291,3 +289,164 @@ unsigned char* crop_jpeg(const unsigned char* jpeg_input,
     LOG_TRACE("%s>: Output size=%lu\n", __func__, *jpeg_output_size);
     return jpeg_output;
 }
+
+unsigned char* scale_jpeg(const unsigned char* jpeg_input,
+                          unsigned long jpeg_input_size,
+                          int scale_denom, int quality,
+                          unsigned long* jpeg_output_size,
+                          int* output_width, int* output_height)
+{
+    if (!jpeg_input || !jpeg_output_size || jpeg_input_size == 0 ||
+        (scale_denom != 1 && scale_denom != 2 && scale_denom != 4 && scale_denom != 8)) {
+        LOG_WARN("scale_jpeg: Invalid input parameters\n");
+        return NULL;
+    }
+    *jpeg_output_size = 0;
+
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char*)jpeg_input, jpeg_input_size);
+
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        LOG_WARN("scale_jpeg: Failed to read JPEG header\n");
+        jpeg_destroy_decompress(&cinfo);
+        return NULL;
+    }
+
+    // The IDCT produces the smaller image directly; no full-size pixels are made
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    jpeg_start_decompress(&cinfo);
+
+    int width = cinfo.output_width;
+    int height = cinfo.output_height;
+    int channels = cinfo.output_components;
+
+    unsigned char* buffer = (unsigned char*)malloc((size_t)width * height * channels);
+    if (!buffer) {
+        LOG_WARN("scale_jpeg: Failed to allocate buffer\n");
+        jpeg_destroy_decompress(&cinfo);
+        return NULL;
+    }
+
+    int row_stride = width * channels;
+    JSAMPROW row_pointer[1];
+    while (cinfo.output_scanline < cinfo.output_height) {
+        row_pointer[0] = &buffer[cinfo.output_scanline * row_stride];
+        jpeg_read_scanlines(&cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    unsigned char* jpeg_output = NULL;
+    struct jpeg_compress_struct cinfo_out;
+    set_jpeg_configuration(width, height, channels, quality, &cinfo_out);
+    buffer_to_jpeg(buffer, &cinfo_out, jpeg_output_size, &jpeg_output);
+    free(buffer);
+
+    if (output_width) *output_width = width;
+    if (output_height) *output_height = height;
+    LOG_TRACE("%s: 1/%d to %dx%d, q%d, %lu bytes\n", __func__, scale_denom, width, height, quality, *jpeg_output_size);
+    return jpeg_output;
+}
+
+// Helper: Clamp value to 0-255 range
+static inline uint8_t clamp_u8(int val) {
+    if (val < 0) return 0;
+    if (val > 255) return 255;
+    return (uint8_t)val;
+}
+
+// Copy a rectangle of an NV12 frame; chroma is subsampled 2x2 so edges must be even
+uint8_t* crop_nv12(const uint8_t* nv12, unsigned int width, unsigned int height,
+                   unsigned int x, unsigned int y, unsigned int crop_w, unsigned int crop_h) {
+    if (!nv12 || !crop_w || !crop_h || ((x | y | crop_w | crop_h) & 1) ||
+        x + crop_w > width || y + crop_h > height)
+        return NULL;
+
+    uint8_t* out = malloc((size_t)crop_w * crop_h * 3 / 2);
+    if (!out)
+        return NULL;
+    for (unsigned int row = 0; row < crop_h; row++)
+        memcpy(out + (size_t)row * crop_w, nv12 + (size_t)(y + row) * width + x, crop_w);
+    const uint8_t* src_uv = nv12 + (size_t)width * height;
+    uint8_t* dst_uv = out + (size_t)crop_w * crop_h;
+    for (unsigned int row = 0; row < crop_h / 2; row++)
+        memcpy(dst_uv + (size_t)row * crop_w, src_uv + (size_t)(y / 2 + row) * width + x, crop_w);
+    return out;
+}
+
+// Convert NV12 (YUV420SP) to RGB24
+// NV12 format: Y plane (width x height), followed by interleaved UV plane (width x height/2)
+uint8_t* nv12_to_rgb(const uint8_t* nv12, unsigned int width, unsigned int height) {
+    size_t rgb_size = width * height * 3;
+    uint8_t* rgb = (uint8_t*)malloc(rgb_size);
+    if (!rgb) return NULL;
+
+    const uint8_t* y_plane = nv12;
+    const uint8_t* uv_plane = nv12 + (width * height);
+
+    for (unsigned int row = 0; row < height; row++) {
+        for (unsigned int col = 0; col < width; col++) {
+            unsigned int y_index = row * width + col;
+            unsigned int uv_index = (row / 2) * width + (col & ~1);
+
+            int y = y_plane[y_index];
+            int u = uv_plane[uv_index] - 128;
+            int v = uv_plane[uv_index + 1] - 128;
+
+            // YUV to RGB conversion (ITU-R BT.601)
+            int r = y + (1.402 * v);
+            int g = y - (0.344 * u) - (0.714 * v);
+            int b = y + (1.772 * u);
+
+            rgb[y_index * 3 + 0] = clamp_u8(r);
+            rgb[y_index * 3 + 1] = clamp_u8(g);
+            rgb[y_index * 3 + 2] = clamp_u8(b);
+        }
+    }
+
+    return rgb;
+}
+
+// Encode RGB24 to JPEG
+uint8_t* rgb_to_jpeg(const uint8_t* rgb, unsigned int width, unsigned int height,
+                     int quality, unsigned long* jpeg_size) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    uint8_t* jpeg_buf = NULL;
+    unsigned long jpeg_len = 0;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    // Output to memory
+    jpeg_mem_dest(&cinfo, &jpeg_buf, &jpeg_len);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    // Write scanlines
+    JSAMPROW row_pointer[1];
+    while (cinfo.next_scanline < cinfo.image_height) {
+        row_pointer[0] = (JSAMPROW)&rgb[cinfo.next_scanline * width * 3];
+        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    *jpeg_size = jpeg_len;
+    return jpeg_buf;
+}
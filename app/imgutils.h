@@ -15,6 +15,7 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -98,6 +99,65 @@ unsigned char* crop_jpeg(const unsigned char* jpeg_input,
                          int crop_w, int crop_h,
                          unsigned long* jpeg_output_size);
 
+/**
+ * @brief Re-encode a JPEG at 1/2, 1/4 or 1/8 size using libjpeg's DCT scaling
+ *
+ * The smaller image is produced by the decoder itself, so this costs far
+ * less than a full decode and resize.
+ *
+ * @param jpeg_input Input JPEG buffer
+ * @param jpeg_input_size Size of input JPEG
+ * @param scale_denom 1, 2, 4 or 8
+ * @param quality JPEG quality of the output (0-100)
+ * @param jpeg_output_size Output parameter for the JPEG size
+ * @param output_width Optional output of the scaled width
+ * @param output_height Optional output of the scaled height
+ * @return Pointer to scaled JPEG buffer (caller must free), or NULL on error
+ */
+unsigned char* scale_jpeg(const unsigned char* jpeg_input,
+                          unsigned long jpeg_input_size,
+                          int scale_denom, int quality,
+                          unsigned long* jpeg_output_size,
+                          int* output_width, int* output_height);
+
+/**
+ * @brief Copy a rectangle out of an NV12 frame into a new NV12 image
+ *
+ * @param nv12 Source frame, Y plane followed by interleaved UV plane
+ * @param width Source width
+ * @param height Source height
+ * @param x Left edge of the rectangle (even)
+ * @param y Top edge of the rectangle (even)
+ * @param crop_w Rectangle width (even)
+ * @param crop_h Rectangle height (even)
+ * @return Pointer to crop_w * crop_h * 3 / 2 bytes (caller must free), or NULL if the rectangle is invalid
+ */
+uint8_t* crop_nv12(const uint8_t* nv12, unsigned int width, unsigned int height,
+                   unsigned int x, unsigned int y, unsigned int crop_w, unsigned int crop_h);
+
+/**
+ * @brief Convert an NV12 (YUV420SP) frame to interleaved RGB24 (ITU-R BT.601)
+ *
+ * @param nv12 Y plane (width x height) followed by interleaved UV plane (width x height/2)
+ * @param width The width of the image
+ * @param height The height of the image
+ * @return Pointer to RGB buffer of width * height * 3 bytes (caller must free), or NULL on error
+ */
+uint8_t* nv12_to_rgb(const uint8_t* nv12, unsigned int width, unsigned int height);
+
+/**
+ * @brief Encode an interleaved RGB24 buffer as JPEG in memory
+ *
+ * @param rgb The RGB buffer
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param quality The desired jpeg quality (0-100)
+ * @param jpeg_size Output parameter for the JPEG size
+ * @return Pointer to JPEG buffer (caller must free), or NULL on error
+ */
+uint8_t* rgb_to_jpeg(const uint8_t* rgb, unsigned int width, unsigned int height,
+                     int quality, unsigned long* jpeg_size);
+
 /**
  * @brief An example of how to use the supplied utility functions
  *
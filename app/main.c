@@ -12,6 +12,9 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "ACAP.h"
 #include "Model.h"
@@ -19,12 +22,19 @@
 #include "cJSON.h"
 #include "Output.h"
 #include "MQTT.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Pipeline.h"
+#include "Scheduler.h"
+#include "Change.h"
+#include "Quality.h"
+#include "Delta.h"
+#include "Aggregate.h"
+#include "Snapshot.h"
 
 
-#define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args);}
-#define LOG_WARN(fmt, args...)    { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args);}
-//#define LOG_TRACE(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
-#define LOG_TRACE(fmt, args...)    {}
+#define LOG_MODULE "main"
+#include "Log.h"
 
 #define APP_PACKAGE	"detectx_client"
 
@@ -35,76 +45,86 @@ cJSON* eventLabelCounter = 0;
 GTimer *cleanupTransitionTimer = 0;
 
 // Adaptive capture rate control
-static unsigned int capture_rate_ms = 1000;
-static unsigned int min_capture_rate_ms = 100;
-static gboolean adaptive_rate_enabled = TRUE;
-
-// Store last captured JPEG for UI display
-static unsigned char* last_jpeg_data = NULL;
-static size_t last_jpeg_size = 0;
-static int last_jpeg_width = 0;
-static int last_jpeg_height = 0;
-static GMutex jpeg_mutex;
-static guint capture_timer_id = 0;
-
-// Function to store the inference JPEG (called from Model.c)
-void StoreInferenceJPEG(const unsigned char* jpeg_data, size_t jpeg_size, int width, int height) {
-	if (!jpeg_data || jpeg_size == 0) {
-		return;
-	}
-
-	g_mutex_lock(&jpeg_mutex);
-
-	// Free old JPEG if exists
-	if (last_jpeg_data) {
-		free(last_jpeg_data);
-		last_jpeg_data = NULL;
-		last_jpeg_size = 0;
-	}
+static PipelineRate captureRate;
+static unsigned int reportedRate = 0;
+
+// The Hub queue is shared with other cameras; poll /health this often
+#define HUB_HEALTH_INTERVAL_US 5000000ULL
+static uint64_t lastHealthPoll = 0;
+
+// Optional high resolution stream for crops and the snapshot (hiResHeight)
+static unsigned int hiResWidth = 0;
+static unsigned int hiResHeight = 0;
+static uint64_t frameCaptured = 0;	// Monotonic capture time of the inference frame, us
+
+// The change gate, quality and delta state and the Hub client are used by the
+// frame loop, so their settings are applied on the main loop between frames,
+// not on the HTTP thread
+#define FRAME_SETTINGS_CHANGE	0x01
+#define FRAME_SETTINGS_QUALITY	0x02
+#define FRAME_SETTINGS_DELTA	0x04
+#define FRAME_SETTINGS_HUB	0x08
+static atomic_uint frameSettingsPending = 0;
+
+// Completed Hub reconnects, for the /model request waiting on one
+#define HUB_RECONNECT_WAIT_S	60
+static pthread_mutex_t hubReconnectMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hubReconnectCond = PTHREAD_COND_INITIALIZER;
+static unsigned int hubReconnects = 0;
+static int hubReconnected = 0;
+
+// Main loop only: replaces the Hub client, capabilities and resize context of the frame loop
+static void
+HubReconnect(void) {
+	LOG("Reconnecting to Hub...\n");
+	ACAP_Config_Lock();
+	cJSON* new_model = Model_Reconnect();
+	if (new_model) {
+		// Update global model reference
+		// Don't delete old model - ACAP_Set_Config will handle it
+		model = new_model;
+		ACAP_Set_Config("model", model);
+
+		// Update status
+		ACAP_STATUS_SetString("model", "status", "Hub reconnected");
+		ACAP_STATUS_SetBool("model", "state", 1);
 
-	// Allocate and copy new JPEG
-	last_jpeg_data = (unsigned char*)malloc(jpeg_size);
-	if (last_jpeg_data) {
-		memcpy(last_jpeg_data, jpeg_data, jpeg_size);
-		last_jpeg_size = jpeg_size;
-		last_jpeg_width = width;
-		last_jpeg_height = height;
-		LOG_TRACE("Stored inference JPEG: %zu bytes (%dx%d)\n", jpeg_size, width, height);
+		LOG("Hub reconnected successfully\n");
 	} else {
-		LOG_WARN("Failed to allocate memory for inference JPEG\n");
+		ACAP_STATUS_SetString("model", "status", "Hub reconnection failed");
+		ACAP_STATUS_SetBool("model", "state", 0);
+		LOG_WARN("Hub reconnection failed\n");
 	}
+	ACAP_Config_Unlock();
 
-	g_mutex_unlock(&jpeg_mutex);
+	pthread_mutex_lock(&hubReconnectMutex);
+	hubReconnects++;
+	hubReconnected = new_model != NULL;
+	pthread_cond_broadcast(&hubReconnectCond);
+	pthread_mutex_unlock(&hubReconnectMutex);
 }
 
-// Function to get a copy of the stored inference JPEG (called from Output.c)
-// Returns malloc'd buffer that caller must free, or NULL if no JPEG available
-unsigned char* GetInferenceJPEG(size_t* out_size, int* out_width, int* out_height) {
-	if (!out_size) return NULL;
-
-	g_mutex_lock(&jpeg_mutex);
-
-	if (!last_jpeg_data || last_jpeg_size == 0) {
-		g_mutex_unlock(&jpeg_mutex);
-		*out_size = 0;
-		if (out_width) *out_width = 0;
-		if (out_height) *out_height = 0;
-		return NULL;
-	}
-
-	// Allocate and copy JPEG data
-	unsigned char* jpeg_copy = (unsigned char*)malloc(last_jpeg_size);
-	if (jpeg_copy) {
-		memcpy(jpeg_copy, last_jpeg_data, last_jpeg_size);
-		*out_size = last_jpeg_size;
-		if (out_width) *out_width = last_jpeg_width;
-		if (out_height) *out_height = last_jpeg_height;
-	} else {
-		*out_size = 0;
-	}
+static gboolean
+FrameSettingsUpdate(gpointer data) {
+	unsigned int pending = atomic_exchange(&frameSettingsPending, 0);
+	ACAP_Config_Lock();
+	if (pending & FRAME_SETTINGS_CHANGE)
+		Change_Settings(settings);
+	if (pending & FRAME_SETTINGS_QUALITY)
+		Quality_Settings(settings);
+	if (pending & FRAME_SETTINGS_DELTA)
+		Delta_Settings(settings);
+	ACAP_Config_Unlock();
+	if (pending & FRAME_SETTINGS_HUB)
+		HubReconnect();
+	return G_SOURCE_REMOVE;
+}
 
-	g_mutex_unlock(&jpeg_mutex);
-	return jpeg_copy;
+static void
+FrameSettingsQueue(unsigned int setting) {
+	// One idle source applies all settings posted before it runs
+	if (atomic_fetch_or(&frameSettingsPending, setting) == 0)
+		g_idle_add(FrameSettingsUpdate, NULL);
 }
 
 void
@@ -118,28 +138,25 @@ ConfigUpdate( const char *setting, cJSON* data) {
 		free(json);
 	}
 
-	// Auto-reconnect when hub settings are updated
-	if (strcmp(setting, "hub") == 0) {
-		LOG("Hub settings changed, reconnecting...\n");
+	if (strcmp(setting, "changeGate") == 0)
+		FrameSettingsQueue(FRAME_SETTINGS_CHANGE);
 
-		cJSON* new_model = Model_Reconnect();
+	if (strcmp(setting, "quality") == 0)
+		FrameSettingsQueue(FRAME_SETTINGS_QUALITY);
 
-		if (new_model) {
-			// Update global model reference
-			// Don't delete old model - ACAP_Set_Config will handle it
-			model = new_model;
-			ACAP_Set_Config("model", model);
+	if (strcmp(setting, "delta") == 0)
+		FrameSettingsQueue(FRAME_SETTINGS_DELTA);
 
-			// Update status
-			ACAP_STATUS_SetString("model", "status", "Hub reconnected");
-			ACAP_STATUS_SetBool("model", "state", 1);
+	if (strcmp(setting, "aggregate") == 0)
+		Aggregate_Settings(settings);
 
-			LOG("Hub reconnected successfully\n");
-		} else {
-			ACAP_STATUS_SetString("model", "status", "Hub reconnection failed");
-			ACAP_STATUS_SetBool("model", "state", 0);
-			LOG_WARN("Hub reconnection failed\n");
-		}
+	if (strcmp(setting, "log") == 0)
+		Log_Settings(settings);
+
+	// Auto-reconnect when hub settings are updated
+	if (strcmp(setting, "hub") == 0) {
+		LOG("Hub settings changed, reconnecting...\n");
+		FrameSettingsQueue(FRAME_SETTINGS_HUB);
 	}
 
 	LOG_TRACE("%s>\n",__func__);
@@ -157,11 +174,13 @@ ACAP_ENDPOINT_model(const ACAP_HTTP_Response response, const ACAP_HTTP_Request r
 
 	// Handle GET request - return current model info
 	if (strcmp(method, "GET") == 0) {
+		ACAP_Config_Lock();
 		if (model) {
 			ACAP_HTTP_Respond_JSON(response, model);
 		} else {
 			ACAP_HTTP_Respond_Error(response, 503, "Hub not connected");
 		}
+		ACAP_Config_Unlock();
 		return;
 	}
 
@@ -196,29 +215,29 @@ ACAP_ENDPOINT_model(const ACAP_HTTP_Response response, const ACAP_HTTP_Request r
 		}
 
 		if (strcmp(action->valuestring, "reconnect") == 0) {
-			LOG("Reconnecting to Hub...\n");
-
-			// Reconnect to Hub
-			cJSON* new_model = Model_Reconnect();
-
-			if (new_model) {
-				// Update global model reference
-				// Don't delete old model - ACAP_Set_Config will handle it
-				model = new_model;
-				ACAP_Set_Config("model", model);
-
-				// Update status
-				ACAP_STATUS_SetString("model", "status", "Hub reconnected");
-				ACAP_STATUS_SetBool("model", "state", 1);
-
-				LOG("Hub reconnected successfully\n");
+			// Reconnect on the main loop, between frames, and wait for it.
+			// A reconnect already running also counts; it read the same settings.
+			struct timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += HUB_RECONNECT_WAIT_S;
+			pthread_mutex_lock(&hubReconnectMutex);
+			unsigned int done = hubReconnects;
+			FrameSettingsQueue(FRAME_SETTINGS_HUB);
+			while (hubReconnects == done &&
+			       pthread_cond_timedwait(&hubReconnectCond, &hubReconnectMutex, &deadline) == 0)
+				;
+			int completed = hubReconnects != done;
+			int connected = hubReconnected;
+			pthread_mutex_unlock(&hubReconnectMutex);
+
+			ACAP_Config_Lock();
+			if (!completed)
+				ACAP_HTTP_Respond_Error(response, 504, "Hub reconnection timed out");
+			else if (connected && model)
 				ACAP_HTTP_Respond_JSON(response, model);
-			} else {
-				ACAP_STATUS_SetString("model", "status", "Hub reconnection failed");
-				ACAP_STATUS_SetBool("model", "state", 0);
-				LOG_WARN("Hub reconnection failed\n");
+			else
 				ACAP_HTTP_Respond_Error(response, 503, "Hub reconnection failed");
-			}
+			ACAP_Config_Unlock();
 		} else {
 			cJSON_Delete(params);
 			ACAP_HTTP_Respond_Error(response, 400, "Unknown action");
@@ -233,57 +252,20 @@ ACAP_ENDPOINT_model(const ACAP_HTTP_Response response, const ACAP_HTTP_Request r
 	ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Use GET or POST");
 }
 
-// Snapshot endpoint handler - serves the last inference JPEG
-static void
-ACAP_ENDPOINT_snapshot(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
-	const char* method = ACAP_HTTP_Get_Method(request);
-
-	if (!method || strcmp(method, "GET") != 0) {
-		ACAP_HTTP_Respond_Error(response, 405, "Method Not Allowed - Use GET");
-		return;
-	}
-
-	g_mutex_lock(&jpeg_mutex);
-
-	if (!last_jpeg_data || last_jpeg_size == 0) {
-		g_mutex_unlock(&jpeg_mutex);
-		ACAP_HTTP_Respond_Error(response, 404, "No inference JPEG available");
-		return;
-	}
-
-	// Copy JPEG data while holding the lock
-	unsigned char* jpeg_copy = (unsigned char*)malloc(last_jpeg_size);
-	size_t jpeg_size = last_jpeg_size;
-
-	if (jpeg_copy) {
-		memcpy(jpeg_copy, last_jpeg_data, last_jpeg_size);
-	}
-
-	g_mutex_unlock(&jpeg_mutex);
-
-	if (!jpeg_copy) {
-		ACAP_HTTP_Respond_Error(response, 500, "Memory allocation failed");
-		return;
-	}
-
-	// Send JPEG response with headers and data
-	ACAP_HTTP_Header_FILE(response, "snapshot.jpg", "image/jpeg", jpeg_size);
-	ACAP_HTTP_Respond_Data(response, jpeg_size, jpeg_copy);
-	free(jpeg_copy);
-}
-
-
 VdoMap *capture_VDO_map = NULL;
 
-int inferenceCounter = 0;
-unsigned int inferenceAverage = 0;
+// Snapshot source: the high resolution frame closest to the inference frame
+static void
+HighResCapture(void) {
+	VdoBuffer* hiRes = Video_Capture_HiRes(frameCaptured);
+	if( hiRes )
+		StoreHighResNV12(vdo_buffer_get_data(hiRes), hiResWidth, hiResHeight);
+}
 
 
 gboolean
 ImageProcess(gpointer data) {
 	LOG_TRACE("<%s: Called (settings=%p, model=%p)\n",__func__, settings, model);
-	const char* label = "Undefined";
-    struct timeval startTs, endTs;
 
 	LOG_TRACE("%s: Start\n",__func__);
 
@@ -293,160 +275,67 @@ ImageProcess(gpointer data) {
 	}
 
 	LOG_TRACE("%s: Capturing RGB frame\n",__func__);
+	Trace_Frame_Begin();
+	uint64_t frameStart = Metrics_Now();
+	// The snapshot borrows the previous frames; they are recycled by the capture
+	Snapshot_Release();
 	VdoBuffer* buffer = Video_Capture_RGB();
 
 	if( !buffer ) {
 		ACAP_STATUS_SetString("model","status","Error. Check log");
 		ACAP_STATUS_SetBool("model","state", 0);
 		LOG_WARN("Image capture failed\n");
+		Trace_Frame_End();
 		return G_SOURCE_REMOVE;
 	}
 
+	// Crops ask for the high resolution frame from Output(); the UI only while it is watching
+	frameCaptured = vdo_frame_get_timestamp(vdo_buffer_get_frame(buffer));
+	if( Snapshot_Wanted() )
+		Snapshot_Need_HighRes();
+
 	LOG_TRACE("%s: Image\n",__func__);
-    gettimeofday(&startTs, NULL);
-	cJSON* detections = Model_Inference(buffer);
-    gettimeofday(&endTs, NULL);
+	int inferenceTime = Pipeline_Process(buffer, settings, model, frameStart);
 	LOG_TRACE("%s: Done\n",__func__);
-
-	unsigned int inferenceTime = (unsigned int)(((endTs.tv_sec - startTs.tv_sec) * 1000) + ((endTs.tv_usec - startTs.tv_usec) / 1000));
-	inferenceCounter++;
-	inferenceAverage += inferenceTime;
-	if( inferenceCounter >= 10 ) {
-		unsigned int avg = inferenceAverage / 10;
-		ACAP_STATUS_SetNumber(  "model", "averageTime", avg );
-
-		// Adaptive capture rate: use 4x the average response time (or 2x minimum)
-		if (adaptive_rate_enabled && avg > 0) {
-			unsigned int new_rate = avg * 4;
-			if (new_rate < min_capture_rate_ms) {
-				new_rate = min_capture_rate_ms;
-			}
-			if (new_rate != capture_rate_ms) {
-				capture_rate_ms = new_rate;
-				LOG("Adaptive rate: %u ms (based on avg response: %u ms)\n", capture_rate_ms, avg);
-			}
-		}
-
-		inferenceCounter = 0;
-		inferenceAverage = 0;
-	}
-
-	double timestamp = ACAP_DEVICE_Timestamp();
-
-	//Apply Transform detection data and apply user filters
-	cJSON* processedDetections = cJSON_CreateArray();
-
-	// Get video dimensions for coordinate scaling
-	unsigned int videoWidth = cJSON_GetObjectItem(model, "videoWidth") ?
-	                          cJSON_GetObjectItem(model, "videoWidth")->valueint : 1000;
-	unsigned int videoHeight = cJSON_GetObjectItem(model, "videoHeight") ?
-	                           cJSON_GetObjectItem(model, "videoHeight")->valueint : 1000;
-
-	// AOI and Size are always in display space (16:9)
-	cJSON* aoi = cJSON_GetObjectItem(settings,"aoi");
-	if(!aoi) {
-		ACAP_STATUS_SetString("model","status","Error. Check log");
-		ACAP_STATUS_SetBool("model","state", 0);
-		LOG_WARN("No aoi settings\n");
+	if( inferenceTime < 0 ) {
+		Trace_Frame_End();
 		return G_SOURCE_REMOVE;
 	}
-	unsigned int x1 = cJSON_GetObjectItem(aoi,"x1")?cJSON_GetObjectItem(aoi,"x1")->valueint:100;
-	unsigned int y1 = cJSON_GetObjectItem(aoi,"y1")?cJSON_GetObjectItem(aoi,"y1")->valueint:100;
-	unsigned int x2 = cJSON_GetObjectItem(aoi,"x2")?cJSON_GetObjectItem(aoi,"x2")->valueint:900;
-	unsigned int y2 = cJSON_GetObjectItem(aoi,"y2")?cJSON_GetObjectItem(aoi,"y2")->valueint:900;
 
-	cJSON* size = cJSON_GetObjectItem(settings,"size");
-	if(!size) {
-		ACAP_STATUS_SetString("model","status","Error. Check log");
-		ACAP_STATUS_SetBool("model","state", 0);
-		LOG_WARN("No size settings\n");
-		return G_SOURCE_REMOVE;
+	// Frames skipped by the change gate made no Hub request and say nothing about Hub load
+	int requested = !Pipeline_Skipped();
+	int windowDone = 0;
+	if( requested ) {
+		long hubStatus = 0;
+		double hubTime = -1;
+		Model_Last_Request(&hubStatus, &hubTime);
+		windowDone = Pipeline_Rate_Update(&captureRate, inferenceTime, hubStatus, hubTime);
+	}
+	if( requested && captureRate.adaptive && frameStart - lastHealthPoll >= HUB_HEALTH_INTERVAL_US ) {
+		HubHealth health;
+		lastHealthPoll = frameStart;
+		if( Model_Health(&health) )
+			Pipeline_Rate_Queue(&captureRate, health.queue_size, health.queue_full);
+	}
+	int wasBurst = captureRate.burst;
+	unsigned int interval = Pipeline_Rate_Next(&captureRate, requested, Output_Active(), frameStart / 1000);
+	Scheduler_Set_Interval(interval);
+	Video_Set_Interval(interval);
+	if( captureRate.idle_rate_ms && captureRate.burst != wasBurst ) {
+		LOG("Capture %s\n", captureRate.burst ? "burst: objects present" : "idle: no objects");
+		ACAP_STATUS_SetBool("model", "burst", captureRate.burst);
 	}
-	unsigned int minWidth = cJSON_GetObjectItem(size,"x2")->valueint - cJSON_GetObjectItem(size,"x1")->valueint;
-	unsigned int minHeight = cJSON_GetObjectItem(size,"y2")->valueint - cJSON_GetObjectItem(size,"y1")->valueint;
-
-	int confidenceThreshold = cJSON_GetObjectItem(settings,"confidence")?cJSON_GetObjectItem(settings,"confidence")->valueint:0.5;
-		
-	cJSON* detection = detections->child;
-	while(detection) {
-		unsigned cx = 0;
-		unsigned cy = 0;
-		unsigned width = 0;
-		unsigned height = 0;
-		unsigned c = 0;
-		label = "Undefined";
-		cJSON* property = detection->child;
-		while(property) {
-			if( strcmp("c",property->string) == 0 ) {
-				property->valueint = property->valuedouble * 100;
-				property->valuedouble = property->valueint;
-				c = property->valueint;
-			}
-			if( strcmp("x",property->string) == 0 ) {
-				property->valueint = property->valuedouble * videoWidth;
-				property->valuedouble = property->valueint;
-				cx += property->valueint;
-			}
-			if( strcmp("y",property->string) == 0 ) {
-				property->valueint = property->valuedouble * videoHeight;
-				property->valuedouble = property->valueint;
-				cy += property->valueint;
-			}
-			if( strcmp("w",property->string) == 0 ) {
-				property->valueint = property->valuedouble * videoWidth;
-				width = property->valueint;
-				property->valuedouble = property->valueint;
-				cx += property->valueint / 2;
-			}
-			if( strcmp("h",property->string) == 0 ) {
-				property->valueint = property->valuedouble * videoHeight;
-				height = property->valueint;
-				property->valuedouble = property->valueint;
-				cy += property->valueint / 2;
-			}
-			if( strcmp("label",property->string) == 0 ) {
-				label = property->valuestring;
-			}
-			property = property->next;
-		}
-		
-		//FILTER DETECTIONS
-		// Coordinates are in capture space [0-1000] and match the displayed image
-		// No transformation needed since overlay displays the captured image
-		unsigned int display_cx = cx;
-		unsigned int display_cy = cy;
-		unsigned int display_width = width;
-		unsigned int display_height = height;
-
-		int insert = 0;
-		if( c >= confidenceThreshold && display_cx >= x1 && display_cx <= x2 && display_cy >= y1 && display_cy <= y2 )
-			insert = 1;
-		if( display_width < minWidth || display_height < minHeight )
-			insert = 0;
-		cJSON* ignore = cJSON_GetObjectItem(settings,"ignore");
-		if( insert && ignore && ignore->type == cJSON_Array && cJSON_GetArraySize(ignore) > 0 ) {
-			cJSON* ignoreLabel = ignore->child;
-			while( ignoreLabel && insert ) {
-				if( strcmp( label, ignoreLabel->valuestring) == 0 )
-					insert = 0;
-				ignoreLabel = ignoreLabel->next;
-			}
-		}
-		//Add custom filter here.  Set "insert = 0" if you want to exclude the detection
 
-		if( insert ) {
-			cJSON_AddNumberToObject( detection, "timestamp", timestamp );
-			cJSON_AddItemToArray(processedDetections, cJSON_Duplicate(detection,1));
+	if( windowDone ) {
+		ACAP_STATUS_SetNumber(  "model", "averageTime", captureRate.average_ms );
+		ACAP_STATUS_SetNumber(  "model", "captureRate", captureRate.rate_ms );
+		if( captureRate.rate_ms != reportedRate ) {
+			LOG("Adaptive rate: %u ms (Hub round trip %.0f ms, base %.0f ms)\n", captureRate.rate_ms, captureRate.latency_ms, captureRate.base_latency_ms);
+			reportedRate = captureRate.rate_ms;
 		}
-		detection = detection->next;
 	}
 
-	cJSON_Delete( detections );
-
-	Output( processedDetections );
-	Model_Reset();
-
-	cJSON_Delete(processedDetections);
+	Trace_Frame_End();
 	LOG_TRACE("%s>\n",__func__);
 	return G_SOURCE_CONTINUE;
 }
@@ -517,6 +406,10 @@ static gboolean
 MAIN_STATUS_Timer() {
 	ACAP_STATUS_SetNumber("device", "cpu", ACAP_DEVICE_CPU_Average());	
 	ACAP_STATUS_SetNumber("device", "network", ACAP_DEVICE_Network_Average());
+	unsigned long delivered, dropped;
+	Video_Frame_Counts(&delivered, &dropped);
+	ACAP_STATUS_SetNumber("video", "framesDelivered", delivered);
+	ACAP_STATUS_SetNumber("video", "framesDropped", dropped);
 	return TRUE;
 }
 
@@ -561,9 +454,7 @@ int main(void) {
 	unsigned int videoHeight = 600;
 
 	openlog(APP_PACKAGE, LOG_PID|LOG_CONS, LOG_USER);
-
-	// Initialize JPEG storage mutex
-	g_mutex_init(&jpeg_mutex);
+	Log_Init();
 
 	ACAP( APP_PACKAGE, ConfigUpdate );
 	LOG("------------ %s ----------\n",APP_PACKAGE);
@@ -572,7 +463,11 @@ int main(void) {
 	ACAP_HTTP_Node("model", ACAP_ENDPOINT_model);
 
 	// Register snapshot endpoint to serve inference JPEG
-	ACAP_HTTP_Node("snapshot", ACAP_ENDPOINT_snapshot);
+	Snapshot_Init();
+
+	// Register metrics endpoint (Prometheus text format) and per-frame trace dump
+	Metrics_Init();
+	Trace_Init();
 
 	settings = ACAP_Get_Config("settings");
 	if(!settings) {
@@ -607,18 +502,15 @@ int main(void) {
 	videoHeight = cJSON_GetObjectItem(model,"videoHeight")?cJSON_GetObjectItem(model,"videoHeight")->valueint:1080;
 
 	// Read adaptive rate settings
-	cJSON* hub_config = cJSON_GetObjectItem(settings, "hub");
-	if (hub_config) {
-		cJSON* rate = cJSON_GetObjectItem(hub_config, "captureRateMs");
-		if (rate && rate->valueint > 0) {
-			capture_rate_ms = rate->valueint;
-		}
-		cJSON* adaptive = cJSON_GetObjectItem(hub_config, "adaptiveRate");
-		if (adaptive) {
-			adaptive_rate_enabled = cJSON_IsTrue(adaptive);
-		}
-	}
-	LOG("Capture rate: %u ms (adaptive: %s)\n", capture_rate_ms, adaptive_rate_enabled ? "enabled" : "disabled");
+	Pipeline_Rate_Init(&captureRate, settings);
+	Change_Settings(settings);
+	Quality_Settings(settings);
+	Delta_Settings(settings);
+	Aggregate_Settings(settings);
+	Log_Settings(settings);
+	reportedRate = captureRate.rate_ms;
+	ACAP_STATUS_SetNumber("model", "captureRate", captureRate.rate_ms);
+	LOG("Capture rate: %u ms (adaptive: %s, min %u ms)\n", captureRate.rate_ms, captureRate.adaptive ? "enabled" : "disabled", captureRate.min_rate_ms);
 
 	if( model ) {
 		ACAP_Set_Config("model", model );
@@ -627,13 +519,28 @@ int main(void) {
 		} else {
 			LOG_WARN("Video stream for image capture failed\n");
 		}
-		// Start timer-based capture instead of idle callback
-		capture_timer_id = g_timeout_add(capture_rate_ms, ImageProcess, NULL);
+		// Crops and the snapshot from a larger stream in the same aspect; boxes are scaled to it
+		cJSON* hiRes = cJSON_GetObjectItem(settings,"hiResHeight");
+		if( hiRes && hiRes->valueint > (int)videoHeight ) {
+			hiResHeight = hiRes->valueint & ~1u;
+			hiResWidth = (unsigned int)((double)hiResHeight * videoWidth / videoHeight + 4) & ~7u;
+			if( Video_Start_HiRes( hiResWidth, hiResHeight ) ) {
+				Snapshot_HighRes_Source(HighResCapture);
+			} else {
+				LOG_WARN("High resolution stream %ux%u failed, using the inference stream\n",hiResWidth,hiResHeight);
+				hiResWidth = hiResHeight = 0;
+			}
+		}
+		Video_Set_Interval(captureRate.rate_ms);
+		// Capture on absolute deadlines; ImageProcess() updates the interval
+		if( !Scheduler_Start(captureRate.rate_ms, ImageProcess, NULL) )
+			LOG_WARN("Capture scheduler failed\n");
 	} else {
 		LOG_WARN("Model setup failed\n");
 	}
 	ACAP_Set_Config("model",model);
 	Output_init();
+	Aggregate_Init();
 	MQTT_Init( Main_MQTT_Status, Main_MQTT_Subscription_Message  );	
 	ACAP_Set_Config("mqtt", MQTT_Settings() );
 	
@@ -655,15 +562,14 @@ int main(void) {
 	LOG("Terminating and cleaning up %s\n",APP_PACKAGE);
 
 	// Remove capture timer
-	if (capture_timer_id > 0) {
-		g_source_remove(capture_timer_id);
-		capture_timer_id = 0;
-	}
+	Scheduler_Stop();
 
 	Main_MQTT_Status(MQTT_DISCONNECTING); //Send graceful disconnect message
 	MQTT_Cleanup();
+	Snapshot_Cleanup();
     ACAP_Cleanup();
 	Model_Cleanup();
+	Log_Stop();
     closelog();
 
 
@@ -1,6 +1,9 @@
 /*
  * Image preprocessing module for DetectX
  * Supports multiple scaling modes: stretch, center-crop, and letterbox
+ *
+ * The CPU backend resamples NV12 directly (bilinear, or area averaging when
+ * shrinking by 2x or more). The larod backend is built with PREPROCESS_LAROD.
  */
 
 #include "preprocess.h"
@@ -15,7 +18,10 @@
 
 /* Internal context structure */
 struct PreprocessContext {
+    bool cpu;                   /* CPU backend; output_addr is malloc'd */
+#ifdef PREPROCESS_LAROD
     larodConnection* conn;
+#endif
 
     /* Input dimensions */
     unsigned int input_width;
@@ -30,6 +36,13 @@ struct PreprocessContext {
     /* Scale mode */
     PreprocessScaleMode scale_mode;
 
+    /* Region of the input that is scaled (crop and balanced modes) */
+    unsigned int crop_x;
+    unsigned int crop_y;
+    unsigned int crop_w;
+    unsigned int crop_h;
+
+#ifdef PREPROCESS_LAROD
     /* Larod preprocessing model and tensors */
     larodModel* pp_model;
     larodTensor** pp_input_tensors;
@@ -38,6 +51,7 @@ struct PreprocessContext {
     size_t pp_num_outputs;
     larodJobRequest* pp_request;
     larodMap* crop_map;
+#endif
 
     /* Input buffer */
     int input_fd;
@@ -55,12 +69,16 @@ struct PreprocessContext {
     size_t letterbox_size;
     unsigned int letterbox_width;
     unsigned int letterbox_height;
+    unsigned int pad_x;             /* Content offset in the output, even so the chroma lines up */
+    unsigned int pad_y;
+#ifdef PREPROCESS_LAROD
     larodModel* letterbox_model;
     larodTensor** letterbox_input_tensors;
     larodTensor** letterbox_output_tensors;
     size_t letterbox_num_inputs;
     size_t letterbox_num_outputs;
     larodJobRequest* letterbox_request;
+#endif
 
     /* Coordinate transformation parameters */
     float scale_x;
@@ -69,6 +87,7 @@ struct PreprocessContext {
     float offset_y;
 };
 
+#ifdef PREPROCESS_LAROD
 /* Helper to get format string for larod */
 static const char* get_format_string(VdoFormat format) {
     switch (format) {
@@ -96,6 +115,8 @@ static size_t get_bytes_per_pixel(VdoFormat format) {
     }
 }
 
+#endif
+
 /* Calculate buffer size for given dimensions and format */
 static size_t calculate_buffer_size(unsigned int width, unsigned int height, VdoFormat format) {
     switch (format) {
@@ -109,6 +130,90 @@ static size_t calculate_buffer_size(unsigned int width, unsigned int height, Vdo
     }
 }
 
+/*
+ * Input region, letterbox content size and the model-to-input transform for
+ * the scale mode. Edges are kept even for the 2x2 subsampled NV12 chroma.
+ */
+static void compute_geometry(PreprocessContext* ctx) {
+    unsigned int input_width = ctx->input_width;
+    unsigned int input_height = ctx->input_height;
+    unsigned int output_width = ctx->output_width;
+    unsigned int output_height = ctx->output_height;
+
+    /* Default transform (stretch mode - no adjustment needed) */
+    ctx->crop_x = 0;
+    ctx->crop_y = 0;
+    ctx->crop_w = input_width;
+    ctx->crop_h = input_height;
+    ctx->scale_x = (float)input_width / (float)output_width;
+    ctx->scale_y = (float)input_height / (float)output_height;
+    ctx->offset_x = 0.0f;
+    ctx->offset_y = 0.0f;
+
+    switch (ctx->scale_mode) {
+        case SCALE_MODE_STRETCH:
+            break;
+
+        case SCALE_MODE_CROP:
+        case SCALE_MODE_BALANCED: {
+            /* Center crop to the model aspect ratio, or to 4:3 for balanced */
+            float target_ratio = ctx->scale_mode == SCALE_MODE_CROP ?
+                                 (float)output_width / (float)output_height : 4.0f / 3.0f;
+            float crop_w_f = (float)input_width;
+            float crop_h_f = crop_w_f / target_ratio;
+
+            if (crop_h_f > (float)input_height) {
+                crop_h_f = (float)input_height;
+                crop_w_f = crop_h_f * target_ratio;
+            }
+
+            ctx->crop_w = ((unsigned int)crop_w_f / 2) * 2;
+            ctx->crop_h = ((unsigned int)crop_h_f / 2) * 2;
+            ctx->crop_x = ((input_width - ctx->crop_w) / 4) * 2;
+            ctx->crop_y = ((input_height - ctx->crop_h) / 4) * 2;
+
+            /* Transform: model coords map to cropped region of input */
+            ctx->scale_x = (float)ctx->crop_w / (float)output_width;
+            ctx->scale_y = (float)ctx->crop_h / (float)output_height;
+            ctx->offset_x = (float)ctx->crop_x / (float)input_width;
+            ctx->offset_y = (float)ctx->crop_y / (float)input_height;
+            break;
+        }
+
+        case SCALE_MODE_LETTERBOX: {
+            /* Calculate scaled dimensions preserving aspect ratio */
+            float input_ratio = (float)input_width / (float)input_height;
+            float output_ratio = (float)output_width / (float)output_height;
+
+            if (input_ratio > output_ratio) {
+                /* Input is wider - fit to width, pad top/bottom */
+                ctx->letterbox_width = output_width;
+                ctx->letterbox_height = (unsigned int)((float)output_width / input_ratio);
+            } else {
+                /* Input is taller - fit to height, pad left/right */
+                ctx->letterbox_height = output_height;
+                ctx->letterbox_width = (unsigned int)((float)output_height * input_ratio);
+            }
+
+            /* Ensure dimensions are even (required for some formats) */
+            ctx->letterbox_width = (ctx->letterbox_width / 2) * 2;
+            ctx->letterbox_height = (ctx->letterbox_height / 2) * 2;
+
+            /* Placement and the inverse transform both use this pad */
+            ctx->pad_x = ((output_width - ctx->letterbox_width) / 4) * 2;
+            ctx->pad_y = ((output_height - ctx->letterbox_height) / 4) * 2;
+
+            /* Transform: model coords need to account for letterbox padding */
+            ctx->scale_x = (float)input_width / (float)ctx->letterbox_width;
+            ctx->scale_y = (float)input_height / (float)ctx->letterbox_height;
+            ctx->offset_x = -(float)ctx->pad_x / (float)output_width;
+            ctx->offset_y = -(float)ctx->pad_y / (float)output_height;
+            break;
+        }
+    }
+}
+
+#ifdef PREPROCESS_LAROD
 /* Create a memory-mapped temporary file */
 static bool create_temp_buffer(size_t size, int* fd, void** addr) {
     char template[] = "/tmp/preprocess-XXXXXX";
@@ -259,12 +364,7 @@ PreprocessContext* preprocess_create(
     ctx->input_fd = -1;
     ctx->output_fd = -1;
     ctx->letterbox_fd = -1;
-
-    /* Default transform (stretch mode - no adjustment needed) */
-    ctx->scale_x = (float)input_width / (float)output_width;
-    ctx->scale_y = (float)input_height / (float)output_height;
-    ctx->offset_x = 0.0f;
-    ctx->offset_y = 0.0f;
+    compute_geometry(ctx);
 
     /* Calculate input/output buffer sizes */
     ctx->input_size = calculate_buffer_size(input_width, input_height, input_format);
@@ -277,7 +377,7 @@ PreprocessContext* preprocess_create(
     }
 
     /* Mode-specific setup */
-    unsigned int crop_x = 0, crop_y = 0, crop_w = 0, crop_h = 0;
+    unsigned int crop_x = ctx->crop_x, crop_y = ctx->crop_y, crop_w = ctx->crop_w, crop_h = ctx->crop_h;
 
     switch (scale_mode) {
         case SCALE_MODE_STRETCH:
@@ -291,27 +391,7 @@ PreprocessContext* preprocess_create(
             break;
 
         case SCALE_MODE_CROP: {
-            /* Calculate center crop region that matches output aspect ratio */
-            float output_ratio = (float)output_width / (float)output_height;
-            float crop_w_f = (float)input_width;
-            float crop_h_f = crop_w_f / output_ratio;
-
-            if (crop_h_f > (float)input_height) {
-                crop_h_f = (float)input_height;
-                crop_w_f = crop_h_f * output_ratio;
-            }
-
-            crop_w = (unsigned int)crop_w_f;
-            crop_h = (unsigned int)crop_h_f;
-            crop_x = (input_width - crop_w) / 2;
-            crop_y = (input_height - crop_h) / 2;
-
-            /* Transform: model coords map to cropped region of input */
-            ctx->scale_x = (float)crop_w / (float)output_width;
-            ctx->scale_y = (float)crop_h / (float)output_height;
-            ctx->offset_x = (float)crop_x / (float)input_width;
-            ctx->offset_y = (float)crop_y / (float)input_height;
-
+            /* Center crop region that matches output aspect ratio */
             syslog(LOG_INFO, "%s: Crop mode - region (%u,%u) %ux%u from %ux%u",
                    __func__, crop_x, crop_y, crop_w, crop_h, input_width, input_height);
 
@@ -325,27 +405,7 @@ PreprocessContext* preprocess_create(
         }
 
         case SCALE_MODE_BALANCED: {
-            /* Calculate 4:3 center crop region then stretch to output */
-            float target_ratio = 4.0f / 3.0f;
-            float crop_w_f = (float)input_width;
-            float crop_h_f = crop_w_f / target_ratio;
-
-            if (crop_h_f > (float)input_height) {
-                crop_h_f = (float)input_height;
-                crop_w_f = crop_h_f * target_ratio;
-            }
-
-            crop_w = (unsigned int)crop_w_f;
-            crop_h = (unsigned int)crop_h_f;
-            crop_x = (input_width - crop_w) / 2;
-            crop_y = (input_height - crop_h) / 2;
-
-            /* Transform: model coords map to 4:3 cropped region */
-            ctx->scale_x = (float)crop_w / (float)output_width;
-            ctx->scale_y = (float)crop_h / (float)output_height;
-            ctx->offset_x = (float)crop_x / (float)input_width;
-            ctx->offset_y = (float)crop_y / (float)input_height;
-
+            /* 4:3 center crop region then stretch to output */
             syslog(LOG_INFO, "%s: Balanced (4:3) mode - region (%u,%u) %ux%u from %ux%u",
                    __func__, crop_x, crop_y, crop_w, crop_h, input_width, input_height);
 
@@ -359,36 +419,10 @@ PreprocessContext* preprocess_create(
         }
 
         case SCALE_MODE_LETTERBOX: {
-            /* Calculate scaled dimensions preserving aspect ratio */
-            float input_ratio = (float)input_width / (float)input_height;
-            float output_ratio = (float)output_width / (float)output_height;
-
-            if (input_ratio > output_ratio) {
-                /* Input is wider - fit to width, pad top/bottom */
-                ctx->letterbox_width = output_width;
-                ctx->letterbox_height = (unsigned int)((float)output_width / input_ratio);
-            } else {
-                /* Input is taller - fit to height, pad left/right */
-                ctx->letterbox_height = output_height;
-                ctx->letterbox_width = (unsigned int)((float)output_height * input_ratio);
-            }
-
-            /* Ensure dimensions are even (required for some formats) */
-            ctx->letterbox_width = (ctx->letterbox_width / 2) * 2;
-            ctx->letterbox_height = (ctx->letterbox_height / 2) * 2;
-
-            unsigned int pad_x = (output_width - ctx->letterbox_width) / 2;
-            unsigned int pad_y = (output_height - ctx->letterbox_height) / 2;
-
-            /* Transform: model coords need to account for letterbox padding */
-            ctx->scale_x = (float)input_width / (float)ctx->letterbox_width;
-            ctx->scale_y = (float)input_height / (float)ctx->letterbox_height;
-            ctx->offset_x = -(float)pad_x / (float)output_width;
-            ctx->offset_y = -(float)pad_y / (float)output_height;
-
+            /* Scaled dimensions preserving aspect ratio, centered with padding */
             syslog(LOG_INFO, "%s: Letterbox mode - scale %ux%u to %ux%u, pad (%u,%u)",
                    __func__, input_width, input_height,
-                   ctx->letterbox_width, ctx->letterbox_height, pad_x, pad_y);
+                   ctx->letterbox_width, ctx->letterbox_height, ctx->pad_x, ctx->pad_y);
 
             /* Create intermediate buffer for scaled image */
             ctx->letterbox_size = calculate_buffer_size(
@@ -549,12 +583,220 @@ error:
     preprocess_destroy(ctx);
     return NULL;
 }
+#endif /* PREPROCESS_LAROD */
+
+/*
+ * Scale a region of one NV12 plane into dst. channels is 1 for Y and 2 for
+ * the interleaved UV plane; positions and sizes are in samples of the plane.
+ * Shrinking by 2x or more averages all source samples of each output sample
+ * (area), otherwise samples are interpolated bilinearly.
+ */
+static bool resample_plane(
+    const uint8_t* src, size_t src_stride,
+    unsigned int src_x, unsigned int src_y,
+    unsigned int src_w, unsigned int src_h,
+    unsigned int channels,
+    uint8_t* dst, size_t dst_stride,
+    unsigned int dst_w, unsigned int dst_h
+) {
+    if (!src_w || !src_h || !dst_w || !dst_h) {
+        return true;
+    }
+
+    if (src_w >= 2 * dst_w && src_h >= 2 * dst_h) {
+        unsigned int* spans = malloc((dst_w + 1) * sizeof(unsigned int));
+        uint32_t* sums = malloc((size_t)dst_w * channels * sizeof(uint32_t));
+        if (!spans || !sums) {
+            free(spans);
+            free(sums);
+            return false;
+        }
+        for (unsigned int ox = 0; ox <= dst_w; ox++) {
+            spans[ox] = src_x + (unsigned int)((uint64_t)ox * src_w / dst_w);
+        }
+
+        for (unsigned int oy = 0; oy < dst_h; oy++) {
+            unsigned int y0 = src_y + (unsigned int)((uint64_t)oy * src_h / dst_h);
+            unsigned int y1 = src_y + (unsigned int)((uint64_t)(oy + 1) * src_h / dst_h);
+            memset(sums, 0, (size_t)dst_w * channels * sizeof(uint32_t));
+
+            /* Walk source rows in order, summing each output column span */
+            for (unsigned int y = y0; y < y1; y++) {
+                const uint8_t* row = src + (size_t)y * src_stride;
+                uint32_t* sum = sums;
+                for (unsigned int ox = 0; ox < dst_w; ox++, sum += channels) {
+                    for (unsigned int x = spans[ox]; x < spans[ox + 1]; x++) {
+                        for (unsigned int c = 0; c < channels; c++) {
+                            sum[c] += row[x * channels + c];
+                        }
+                    }
+                }
+            }
+
+            uint8_t* out = dst + (size_t)oy * dst_stride;
+            for (unsigned int ox = 0; ox < dst_w; ox++) {
+                uint32_t count = (y1 - y0) * (spans[ox + 1] - spans[ox]);
+                for (unsigned int c = 0; c < channels; c++) {
+                    out[ox * channels + c] = (uint8_t)((sums[ox * channels + c] + count / 2) / count);
+                }
+            }
+        }
+
+        free(spans);
+        free(sums);
+        return true;
+    }
+
+    /* Bilinear: sample centers mapped back to the source, weights in 1/256 */
+    unsigned int* columns = malloc((size_t)dst_w * 3 * sizeof(unsigned int));
+    if (!columns) {
+        return false;
+    }
+    for (unsigned int ox = 0; ox < dst_w; ox++) {
+        int64_t pos = (int64_t)(2 * ox + 1) * src_w * 128 / dst_w - 128;
+        if (pos < 0) pos = 0;
+        unsigned int index = (unsigned int)(pos >> 8);
+        unsigned int weight = (unsigned int)(pos & 255);
+        if (index >= src_w - 1) {
+            index = src_w - 1;
+            weight = 0;
+        }
+        columns[ox * 3 + 0] = (src_x + index) * channels;
+        columns[ox * 3 + 1] = (src_x + (weight ? index + 1 : index)) * channels;
+        columns[ox * 3 + 2] = weight;
+    }
+
+    for (unsigned int oy = 0; oy < dst_h; oy++) {
+        int64_t pos = (int64_t)(2 * oy + 1) * src_h * 128 / dst_h - 128;
+        if (pos < 0) pos = 0;
+        unsigned int index = (unsigned int)(pos >> 8);
+        unsigned int wy = (unsigned int)(pos & 255);
+        if (index >= src_h - 1) {
+            index = src_h - 1;
+            wy = 0;
+        }
+        const uint8_t* top = src + (size_t)(src_y + index) * src_stride;
+        const uint8_t* bottom = wy ? top + src_stride : top;
+
+        uint8_t* out = dst + (size_t)oy * dst_stride;
+        for (unsigned int ox = 0; ox < dst_w; ox++) {
+            unsigned int x0 = columns[ox * 3 + 0];
+            unsigned int x1 = columns[ox * 3 + 1];
+            unsigned int wx = columns[ox * 3 + 2];
+            for (unsigned int c = 0; c < channels; c++) {
+                uint32_t upper = top[x0 + c] * (256 - wx) + top[x1 + c] * wx;
+                uint32_t lower = bottom[x0 + c] * (256 - wx) + bottom[x1 + c] * wx;
+                out[ox * channels + c] = (uint8_t)((upper * (256 - wy) + lower * wy + 32768) >> 16);
+            }
+        }
+    }
+
+    free(columns);
+    return true;
+}
+
+PreprocessContext* preprocess_create_cpu(
+    unsigned int input_width,
+    unsigned int input_height,
+    VdoFormat input_format,
+    unsigned int output_width,
+    unsigned int output_height,
+    VdoFormat output_format,
+    PreprocessScaleMode scale_mode
+) {
+    if (input_format != VDO_FORMAT_YUV || output_format != VDO_FORMAT_YUV) {
+        syslog(LOG_ERR, "%s: Only NV12 input and output are supported", __func__);
+        return NULL;
+    }
+    if (!input_width || !input_height || !output_width || !output_height ||
+        ((input_width | input_height | output_width | output_height) & 1)) {
+        syslog(LOG_ERR, "%s: Invalid size %ux%u -> %ux%u (NV12 needs even sizes)",
+               __func__, input_width, input_height, output_width, output_height);
+        return NULL;
+    }
+
+    PreprocessContext* ctx = calloc(1, sizeof(PreprocessContext));
+    if (!ctx) {
+        syslog(LOG_ERR, "%s: Failed to allocate context: %s", __func__, strerror(errno));
+        return NULL;
+    }
+
+    ctx->cpu = true;
+    ctx->input_width = input_width;
+    ctx->input_height = input_height;
+    ctx->input_format = input_format;
+    ctx->output_width = output_width;
+    ctx->output_height = output_height;
+    ctx->output_format = output_format;
+    ctx->scale_mode = scale_mode;
+    ctx->input_fd = -1;
+    ctx->output_fd = -1;
+    ctx->letterbox_fd = -1;
+    compute_geometry(ctx);
+
+    ctx->input_size = calculate_buffer_size(input_width, input_height, input_format);
+    ctx->output_size = calculate_buffer_size(output_width, output_height, output_format);
+    ctx->output_addr = malloc(ctx->output_size);
+    if (!ctx->output_addr) {
+        syslog(LOG_ERR, "%s: Failed to allocate output buffer", __func__);
+        free(ctx);
+        return NULL;
+    }
+
+    /* Letterbox padding is black and stays untouched between frames */
+    memset(ctx->output_addr, 0, (size_t)output_width * output_height);
+    memset((uint8_t*)ctx->output_addr + (size_t)output_width * output_height, 128,
+           ctx->output_size - (size_t)output_width * output_height);
+
+    syslog(LOG_INFO, "%s: Created CPU preprocessing context, mode=%s, %ux%u -> %ux%u, region (%u,%u) %ux%u",
+           __func__, preprocess_mode_to_string(scale_mode),
+           input_width, input_height, output_width, output_height,
+           ctx->crop_x, ctx->crop_y, ctx->crop_w, ctx->crop_h);
+    return ctx;
+}
+
+/* CPU backend: scale the NV12 planes straight into the output buffer */
+static bool preprocess_run_cpu(PreprocessContext* ctx, const void* input_data, size_t input_size) {
+    if (input_size < ctx->input_size) {
+        syslog(LOG_ERR, "%s: Input is %zu bytes, expected %zu", __func__, input_size, ctx->input_size);
+        return false;
+    }
+
+    unsigned int dst_x = 0, dst_y = 0;
+    unsigned int dst_w = ctx->output_width, dst_h = ctx->output_height;
+    if (ctx->scale_mode == SCALE_MODE_LETTERBOX) {
+        /* Content centered */
+        dst_w = ctx->letterbox_width;
+        dst_h = ctx->letterbox_height;
+        dst_x = ctx->pad_x;
+        dst_y = ctx->pad_y;
+    }
+
+    const uint8_t* y_in = (const uint8_t*)input_data;
+    const uint8_t* uv_in = y_in + (size_t)ctx->input_width * ctx->input_height;
+    uint8_t* y_out = (uint8_t*)ctx->output_addr;
+    uint8_t* uv_out = y_out + (size_t)ctx->output_width * ctx->output_height;
+
+    return resample_plane(y_in, ctx->input_width,
+                          ctx->crop_x, ctx->crop_y, ctx->crop_w, ctx->crop_h, 1,
+                          y_out + (size_t)dst_y * ctx->output_width + dst_x, ctx->output_width,
+                          dst_w, dst_h) &&
+           resample_plane(uv_in, ctx->input_width,
+                          ctx->crop_x / 2, ctx->crop_y / 2, ctx->crop_w / 2, ctx->crop_h / 2, 2,
+                          uv_out + (size_t)(dst_y / 2) * ctx->output_width + dst_x, ctx->output_width,
+                          dst_w / 2, dst_h / 2);
+}
 
 bool preprocess_run(PreprocessContext* ctx, const void* input_data, size_t input_size) {
     if (!ctx || !input_data) {
         return false;
     }
 
+    if (ctx->cpu) {
+        return preprocess_run_cpu(ctx, input_data, input_size);
+    }
+
+#ifdef PREPROCESS_LAROD
     larodError* error = NULL;
     static int power_retries = 0;
 
@@ -587,17 +829,13 @@ bool preprocess_run(PreprocessContext* ctx, const void* input_data, size_t input
         /* Clear output buffer (black padding) */
         memset(ctx->output_addr, 0, ctx->output_size);
 
-        /* Calculate padding offsets */
-        unsigned int pad_x = (ctx->output_width - ctx->letterbox_width) / 2;
-        unsigned int pad_y = (ctx->output_height - ctx->letterbox_height) / 2;
-
         /* Copy scaled image to center of output buffer */
         size_t bpp = get_bytes_per_pixel(ctx->output_format);
         size_t src_stride = ctx->letterbox_width * bpp;
         size_t dst_stride = ctx->output_width * bpp;
 
         uint8_t* src = (uint8_t*)ctx->letterbox_addr;
-        uint8_t* dst = (uint8_t*)ctx->output_addr + (pad_y * dst_stride) + (pad_x * bpp);
+        uint8_t* dst = (uint8_t*)ctx->output_addr + (ctx->pad_y * dst_stride) + (ctx->pad_x * bpp);
 
         for (unsigned int y = 0; y < ctx->letterbox_height; y++) {
             memcpy(dst, src, src_stride);
@@ -626,6 +864,9 @@ bool preprocess_run(PreprocessContext* ctx, const void* input_data, size_t input
     }
 
     return true;
+#else
+    return false;
+#endif
 }
 
 void* preprocess_get_output(PreprocessContext* ctx) {
@@ -718,8 +959,8 @@ bool preprocess_transform_detection(
              *
              * Detections in padding region are INVALID (return false)
              */
-            float pad_x_norm = (float)(ctx->output_width - ctx->letterbox_width) / 2.0f / ctx->output_width;
-            float pad_y_norm = (float)(ctx->output_height - ctx->letterbox_height) / 2.0f / ctx->output_height;
+            float pad_x_norm = (float)ctx->pad_x / ctx->output_width;
+            float pad_y_norm = (float)ctx->pad_y / ctx->output_height;
             float content_scale_x = (float)ctx->letterbox_width / ctx->output_width;
             float content_scale_y = (float)ctx->letterbox_height / ctx->output_height;
 
@@ -776,6 +1017,7 @@ void preprocess_destroy(PreprocessContext* ctx) {
         return;
     }
 
+#ifdef PREPROCESS_LAROD
     /* Clean up larod resources */
     if (ctx->pp_request) {
         larodDestroyJobRequest(&ctx->pp_request);
@@ -811,6 +1053,13 @@ void preprocess_destroy(PreprocessContext* ctx) {
     if (ctx->letterbox_model) {
         larodDestroyModel(&ctx->letterbox_model);
     }
+#endif
+
+    if (ctx->cpu) {
+        free(ctx->output_addr);
+        free(ctx);
+        return;
+    }
 
     /* Unmap and close buffers */
     if (ctx->input_addr && ctx->input_addr != MAP_FAILED) {
@@ -1,6 +1,9 @@
 /*
  * Image preprocessing module for DetectX
  * Supports multiple scaling modes: stretch, center-crop, and letterbox
+ *
+ * Contexts run on the CPU (preprocess_create_cpu) or, when built with
+ * PREPROCESS_LAROD, as larod jobs (preprocess_create).
  */
 
 #ifndef PREPROCESS_H
@@ -9,7 +12,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#ifdef PREPROCESS_LAROD
 #include "larod.h"
+#endif
 #include "vdo-types.h"
 
 #ifdef __cplusplus
@@ -27,6 +32,7 @@ typedef enum {
 /* Preprocessing context */
 typedef struct PreprocessContext PreprocessContext;
 
+#ifdef PREPROCESS_LAROD
 /**
  * @brief Create a preprocessing context
  *
@@ -50,6 +56,33 @@ PreprocessContext* preprocess_create(
     VdoFormat output_format,
     PreprocessScaleMode scale_mode
 );
+#endif
+
+/**
+ * @brief Create a preprocessing context that runs on the CPU
+ *
+ * Scales NV12 directly without a color conversion: bilinear, or averaging
+ * all covered input pixels when shrinking by 2x or more. Letterbox padding
+ * is black.
+ *
+ * @param input_width    Width of input frames (even)
+ * @param input_height   Height of input frames (even)
+ * @param input_format   Must be VDO_FORMAT_YUV (NV12)
+ * @param output_width   Width required by model (even)
+ * @param output_height  Height required by model (even)
+ * @param output_format  Must be VDO_FORMAT_YUV (NV12)
+ * @param scale_mode     How to handle aspect ratio mismatch
+ * @return Context pointer on success, NULL on failure
+ */
+PreprocessContext* preprocess_create_cpu(
+    unsigned int input_width,
+    unsigned int input_height,
+    VdoFormat input_format,
+    unsigned int output_width,
+    unsigned int output_height,
+    VdoFormat output_format,
+    PreprocessScaleMode scale_mode
+);
 
 /**
  * @brief Run preprocessing on an input buffer
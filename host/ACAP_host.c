@@ -0,0 +1,774 @@
+/*
+ * ACAP_host.c - Host stand-in for the ACAP SDK wrapper
+ *
+ * Implements ACAP.h for off-device builds. Settings are loaded from the
+ * same files as on the camera (manifest.json, settings/settings.json and
+ * localdata/settings.json) below a configurable app path. HTTP nodes are
+ * registered in a table and called directly through ACAP_HOST_HTTP_Call(),
+ * with responses written to an in-memory stream. Events only update the
+ * "events" status group and a counter. VAPIX is unavailable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <syslog.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include <sys/sysinfo.h>
+
+#include "ACAP.h"
+#include "ACAP_host.h"
+
+#define LOG(fmt, args...) { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
+#define LOG_WARN(fmt, args...) { syslog(LOG_WARNING, fmt, ## args); printf(fmt, ## args); }
+//#define LOG_TRACE(fmt, args...) { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
+#define LOG_TRACE(fmt, args...) {}
+
+static cJSON* app = NULL;
+static cJSON* status_container = NULL;
+static cJSON* device_container = NULL;
+static cJSON* event_declarations = NULL;
+static ACAP_Config_Update ACAP_UpdateCallback = NULL;
+static char ACAP_package_name[ACAP_MAX_PACKAGE_NAME] = "";
+static char ACAP_FILE_Path[ACAP_MAX_PATH_LENGTH] = "";
+static atomic_int events_fired = 0;
+
+pthread_mutex_t status_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*-----------------------------------------------------
+ * Core
+ *-----------------------------------------------------*/
+
+void ACAP_HOST_Set_AppPath(const char* path) {
+    if (!path)
+        return;
+    size_t len = strlen(path);
+    snprintf(ACAP_FILE_Path, sizeof(ACAP_FILE_Path), "%s%s", path,
+             (len && path[len - 1] != '/') ? "/" : "");
+}
+
+static void ACAP_ENDPOINT_status(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request);
+static void ACAP_ENDPOINT_settings(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request);
+
+cJSON* ACAP(const char* package, ACAP_Config_Update callback) {
+    if (!package) {
+        LOG_WARN("Invalid package name\n");
+        return NULL;
+    }
+    strncpy(ACAP_package_name, package, ACAP_MAX_PACKAGE_NAME - 1);
+    ACAP_package_name[ACAP_MAX_PACKAGE_NAME - 1] = '\0';
+
+    if (!ACAP_FILE_Path[0])
+        ACAP_HOST_Set_AppPath(getenv("DETECTX_APP_PATH") ? getenv("DETECTX_APP_PATH") : "../app/");
+
+    ACAP_UpdateCallback = callback;
+    app = cJSON_CreateObject();
+
+    cJSON* manifest = ACAP_FILE_Read("manifest.json");
+    if (manifest)
+        cJSON_AddItemToObject(app, "manifest", manifest);
+
+    cJSON* settings = ACAP_FILE_Read("settings/settings.json");
+    if (!settings)
+        settings = cJSON_CreateObject();
+    cJSON* savedSettings = ACAP_FILE_Read("localdata/settings.json");
+    if (savedSettings) {
+        cJSON* prop = savedSettings->child;
+        while (prop) {
+            if (cJSON_GetObjectItem(settings, prop->string))
+                cJSON_ReplaceItemInObject(settings, prop->string, cJSON_Duplicate(prop, 1));
+            prop = prop->next;
+        }
+        cJSON_Delete(savedSettings);
+    }
+    cJSON_AddItemToObject(app, "settings", settings);
+
+    status_container = cJSON_CreateObject();
+    device_container = cJSON_CreateObject();
+    cJSON_AddStringToObject(device_container, "serial", "HOST00000000");
+    cJSON_AddStringToObject(device_container, "model", "Host");
+    cJSON_AddStringToObject(device_container, "platform", "host");
+    cJSON_AddStringToObject(device_container, "chip", "host");
+    cJSON_AddStringToObject(device_container, "firmware", "0.0.0");
+    cJSON_AddStringToObject(device_container, "aspect", "16:9");
+    cJSON_AddStringToObject(device_container, "IPv4", "127.0.0.1");
+    cJSON* location = cJSON_CreateObject();
+    cJSON_AddNumberToObject(location, "lat", 0);
+    cJSON_AddNumberToObject(location, "lon", 0);
+    cJSON_AddItemToObject(device_container, "location", location);
+
+    ACAP_Set_Config("status", status_container);
+    ACAP_Set_Config("device", device_container);
+    ACAP_HTTP_Node("status", ACAP_ENDPOINT_status);
+    ACAP_HTTP_Node("settings", ACAP_ENDPOINT_settings);
+
+    if (ACAP_UpdateCallback) {
+        cJSON* setting = settings->child;
+        while (setting) {
+            ACAP_UpdateCallback(setting->string, setting);
+            setting = setting->next;
+        }
+    }
+    return settings;
+}
+
+const char* ACAP_Name(void) {
+    return ACAP_package_name;
+}
+
+int ACAP_Set_Config(const char* service, cJSON* serviceSettings) {
+    if (!app)
+        app = cJSON_CreateObject();
+    if (cJSON_GetObjectItem(app, service))
+        cJSON_ReplaceItemInObject(app, service, serviceSettings);
+    else
+        cJSON_AddItemToObject(app, service, serviceSettings);
+    return 1;
+}
+
+// Host requests are served one at a time on the calling thread
+void ACAP_Config_Lock(void) {
+}
+
+void ACAP_Config_Unlock(void) {
+}
+
+cJSON* ACAP_Get_Config(const char* service) {
+    cJSON* requestedService = cJSON_GetObjectItem(app, service);
+    if (!requestedService) {
+        LOG_WARN("%s: %s is undefined\n", __func__, service);
+        return 0;
+    }
+    return requestedService;
+}
+
+void ACAP_Cleanup(void) {
+    cJSON_Delete(app);  // Owns status and device containers
+    app = NULL;
+    status_container = NULL;
+    device_container = NULL;
+    cJSON_Delete(event_declarations);
+    event_declarations = NULL;
+}
+
+/*-----------------------------------------------------
+ * HTTP
+ *-----------------------------------------------------*/
+
+typedef struct {
+    char path[ACAP_MAX_PATH_LENGTH];
+    ACAP_HTTP_Callback callback;
+} HTTPNode;
+
+static HTTPNode http_nodes[ACAP_MAX_HTTP_NODES];
+static int http_node_count = 0;
+static pthread_mutex_t http_nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int ACAP_HTTP_Node(const char* nodename, ACAP_HTTP_Callback callback) {
+    if (!nodename || !callback)
+        return 0;
+    pthread_mutex_lock(&http_nodes_mutex);
+    for (int i = 0; i < http_node_count; i++) {
+        if (strcmp(http_nodes[i].path, nodename) == 0) {
+            http_nodes[i].callback = callback;
+            pthread_mutex_unlock(&http_nodes_mutex);
+            return 1;
+        }
+    }
+    if (http_node_count >= ACAP_MAX_HTTP_NODES) {
+        pthread_mutex_unlock(&http_nodes_mutex);
+        LOG_WARN("%s: Too many HTTP nodes\n", __func__);
+        return 0;
+    }
+    strncpy(http_nodes[http_node_count].path, nodename, ACAP_MAX_PATH_LENGTH - 1);
+    http_nodes[http_node_count].callback = callback;
+    http_node_count++;
+    pthread_mutex_unlock(&http_nodes_mutex);
+    return 1;
+}
+
+int ACAP_HOST_HTTP_Call(const char* node, const char* method, const char* query,
+                        const char* contentType, const char* body,
+                        char** output, size_t* outputSize) {
+    ACAP_HTTP_Callback callback = NULL;
+    pthread_mutex_lock(&http_nodes_mutex);
+    for (int i = 0; node && i < http_node_count; i++) {
+        if (strcmp(http_nodes[i].path, node) == 0)
+            callback = http_nodes[i].callback;
+    }
+    pthread_mutex_unlock(&http_nodes_mutex);
+    if (!callback)
+        return 0;
+
+    FCGX_Stream out = {0};
+    FCGX_Request request = { .out = &out };
+    ACAP_HTTP_Request_DATA requestData = {
+        .request = &request,
+        .postData = body,
+        .postDataLength = body ? strlen(body) : 0,
+        .method = method ? method : "GET",
+        .contentType = contentType,
+        .queryString = query
+    };
+    callback(&request, &requestData);
+
+    if (outputSize)
+        *outputSize = out.size;
+    if (output) {
+        // NUL-terminate so text responses can be used as strings
+        char* data = realloc(out.data, out.size + 1);
+        if (data)
+            data[out.size] = '\0';
+        *output = data;
+    } else {
+        free(out.data);
+    }
+    return 1;
+}
+
+static int stream_put(FCGX_Stream* stream, const void* data, size_t count) {
+    if (!stream)
+        return 0;
+    if (stream->size + count > stream->capacity) {
+        size_t capacity = stream->capacity ? stream->capacity * 2 : 4096;
+        while (capacity < stream->size + count)
+            capacity *= 2;
+        unsigned char* grown = realloc(stream->data, capacity);
+        if (!grown)
+            return 0;
+        stream->data = grown;
+        stream->capacity = capacity;
+    }
+    memcpy(stream->data + stream->size, data, count);
+    stream->size += count;
+    return 1;
+}
+
+const char* ACAP_HTTP_Get_Method(const ACAP_HTTP_Request request) {
+    return request ? request->method : NULL;
+}
+
+const char* ACAP_HTTP_Get_Content_Type(const ACAP_HTTP_Request request) {
+    return request ? request->contentType : NULL;
+}
+
+size_t ACAP_HTTP_Get_Content_Length(const ACAP_HTTP_Request request) {
+    return request ? request->postDataLength : 0;
+}
+
+static char* url_decode(const char* src, size_t len) {
+    char* decoded = malloc(len + 1);
+    if (!decoded)
+        return NULL;
+    size_t j = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] == '%' && i + 2 < len && isxdigit((unsigned char)src[i + 1]) && isxdigit((unsigned char)src[i + 2])) {
+            char hex[3] = { src[i + 1], src[i + 2], 0 };
+            decoded[j++] = (char)strtol(hex, NULL, 16);
+            i += 2;
+        } else if (src[i] == '+') {
+            decoded[j++] = ' ';
+        } else {
+            decoded[j++] = src[i];
+        }
+    }
+    decoded[j] = '\0';
+    return decoded;
+}
+
+static const char* find_param(const char* params, const char* name) {
+    if (!params || !name)
+        return NULL;
+    size_t nameLen = strlen(name);
+    const char* start = params;
+    while ((start = strstr(start, name)) != NULL) {
+        if ((start == params || *(start - 1) == '&') && start[nameLen] == '=') {
+            start += nameLen + 1;
+            const char* end = strchr(start, '&');
+            return url_decode(start, end ? (size_t)(end - start) : strlen(start));
+        }
+        start++;
+    }
+    return NULL;
+}
+
+const char* ACAP_HTTP_Request_Param(const ACAP_HTTP_Request request, const char* param) {
+    if (!request || !param)
+        return NULL;
+    if (request->method && strcmp(request->method, "POST") == 0 &&
+        request->contentType && strstr(request->contentType, "application/x-www-form-urlencoded")) {
+        const char* value = find_param(request->postData, param);
+        if (value)
+            return value;  // Caller must free
+    }
+    return find_param(request->queryString, param);  // Caller must free
+}
+
+cJSON* ACAP_HTTP_Request_JSON(const ACAP_HTTP_Request request, const char* param) {
+    const char* value = ACAP_HTTP_Request_Param(request, param);
+    if (!value)
+        return NULL;
+    cJSON* object = cJSON_Parse(value);
+    free((void*)value);
+    return object;
+}
+
+int ACAP_HTTP_Header_XML(ACAP_HTTP_Response response) {
+    return ACAP_HTTP_Respond_String(response, "Content-Type: text/xml; charset=utf-8\r\nCache-Control: no-cache\r\n\r\n");
+}
+
+int ACAP_HTTP_Header_JSON(ACAP_HTTP_Response response) {
+    return ACAP_HTTP_Respond_String(response, "Content-Type: application/json; charset=utf-8\r\nCache-Control: no-cache\r\n\r\n");
+}
+
+int ACAP_HTTP_Header_TEXT(ACAP_HTTP_Response response) {
+    return ACAP_HTTP_Respond_String(response, "Content-Type: text/plain; charset=utf-8\r\nCache-Control: no-cache\r\n\r\n");
+}
+
+int ACAP_HTTP_Header_FILE(ACAP_HTTP_Response response, const char* filename,
+                          const char* contenttype, unsigned filelength) {
+    if (!response || !filename || !contenttype)
+        return 0;
+    return ACAP_HTTP_Respond_String(response,
+        "Content-Type: %s\r\n"
+        "Content-Disposition: attachment; filename=%s\r\n"
+        "Content-Transfer-Encoding: binary\r\n"
+        "Content-Length: %u\r\n"
+        "\r\n",
+        contenttype, filename, filelength);
+}
+
+int ACAP_HTTP_Respond_String(ACAP_HTTP_Response response, const char* fmt, ...) {
+    if (!response || !response->out || !fmt)
+        return 0;
+    char buffer[ACAP_MAX_BUFFER_SIZE];
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    if (written < 0 || written >= (int)sizeof(buffer)) {
+        LOG_WARN("%s: Response failed\n", __func__);
+        return 0;
+    }
+    return stream_put(response->out, buffer, written);
+}
+
+int ACAP_HTTP_Respond_JSON(ACAP_HTTP_Response response, cJSON* object) {
+    if (!response || !object)
+        return 0;
+    char* jsonString = cJSON_PrintUnformatted(object);
+    if (!jsonString)
+        return 0;
+    ACAP_HTTP_Header_JSON(response);
+    int result = stream_put(response->out, jsonString, strlen(jsonString));
+    free(jsonString);
+    return result;
+}
+
+int ACAP_HTTP_Respond_Data(ACAP_HTTP_Response response, size_t count, const void* data) {
+    if (!response || !response->out || !data || count == 0) {
+        LOG_WARN("Invalid response parameters\n");
+        return 0;
+    }
+    return stream_put(response->out, data, count);
+}
+
+// Requests are answered synchronously on the host; streams cannot be detached
+ACAP_HTTP_Response ACAP_HTTP_Detach(const ACAP_HTTP_Request request) {
+    (void)request;
+    return NULL;
+}
+
+int ACAP_HTTP_Flush(ACAP_HTTP_Response response) {
+    return response && response->out;
+}
+
+void ACAP_HTTP_Finish(ACAP_HTTP_Response response) {
+    (void)response;
+}
+
+int ACAP_HTTP_Respond_Error(ACAP_HTTP_Response response, int code, const char* message) {
+    if (!response || !message)
+        return 0;
+    const char* error_type = (code < 500) ? "Client" : (code < 600) ? "Server" : "Unknown";
+    ACAP_HTTP_Respond_String(response, "Status: %d %s Error\r\nContent-Type: text/plain\r\n\r\n%s",
+                             code, error_type, message);
+    LOG_WARN("HTTP Error %d: %s\n", code, message);
+    return 1;
+}
+
+int ACAP_HTTP_Respond_Text(ACAP_HTTP_Response response, const char* message) {
+    if (!response || !message)
+        return 0;
+    return ACAP_HTTP_Header_TEXT(response) && ACAP_HTTP_Respond_String(response, "%s", message);
+}
+
+static void ACAP_ENDPOINT_status(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    pthread_mutex_lock(&status_mutex);
+    ACAP_HTTP_Respond_JSON(response, status_container);
+    pthread_mutex_unlock(&status_mutex);
+}
+
+static void ACAP_ENDPOINT_settings(const ACAP_HTTP_Response response, const ACAP_HTTP_Request request) {
+    const char* method = ACAP_HTTP_Get_Method(request);
+    cJSON* settings = cJSON_GetObjectItem(app, "settings");
+    if (method && strcmp(method, "POST") == 0) {
+        cJSON* params = request->postData ? cJSON_Parse(request->postData) : NULL;
+        if (!params) {
+            ACAP_HTTP_Respond_Error(response, 400, "Invalid JSON data");
+            return;
+        }
+        cJSON* param = params->child;
+        while (param) {
+            if (cJSON_GetObjectItem(settings, param->string)) {
+                cJSON_ReplaceItemInObject(settings, param->string, cJSON_Duplicate(param, 1));
+                if (ACAP_UpdateCallback)
+                    ACAP_UpdateCallback(param->string, cJSON_GetObjectItem(settings, param->string));
+            }
+            param = param->next;
+        }
+        cJSON_Delete(params);
+        if (ACAP_UpdateCallback)
+            ACAP_UpdateCallback("settings", settings);
+        ACAP_HTTP_Respond_Text(response, "Settings updated successfully");
+        return;
+    }
+    ACAP_HTTP_Respond_JSON(response, settings);
+}
+
+/*-----------------------------------------------------
+ * Events
+ *-----------------------------------------------------*/
+
+int ACAP_HOST_Events_Fired(void) {
+    return atomic_load(&events_fired);
+}
+
+int ACAP_EVENTS_Add_Event(const char* Id, const char* NiceName, int state) {
+    if (!Id)
+        return 0;
+    if (!event_declarations)
+        event_declarations = cJSON_CreateObject();
+    if (!cJSON_GetObjectItem(event_declarations, Id))
+        cJSON_AddNumberToObject(event_declarations, Id, cJSON_GetArraySize(event_declarations) + 1);
+    return 1;
+}
+
+int ACAP_EVENTS_Add_Event_JSON(cJSON* event) {
+    cJSON* id = cJSON_GetObjectItem(event, "id");
+    return id && cJSON_IsString(id) ? ACAP_EVENTS_Add_Event(id->valuestring, NULL, 0) : 0;
+}
+
+int ACAP_EVENTS_Remove_Event(const char* Id) {
+    if (!event_declarations || !Id)
+        return 0;
+    cJSON_DeleteItemFromObject(event_declarations, Id);
+    return 1;
+}
+
+int ACAP_EVENTS_Fire_State(const char* Id, int value) {
+    if (!Id)
+        return 0;
+    if (value && ACAP_STATUS_Bool("events", Id))
+        return 1;  // The state is already high
+    if (!value && !ACAP_STATUS_Bool("events", Id))
+        return 1;  // The state is already low
+    ACAP_STATUS_SetBool("events", Id, value);
+    atomic_fetch_add(&events_fired, 1);
+    LOG_TRACE("%s: %s %d\n", __func__, Id, value);
+    return 1;
+}
+
+int ACAP_EVENTS_Fire(const char* Id) {
+    if (!Id)
+        return 0;
+    atomic_fetch_add(&events_fired, 1);
+    return 1;
+}
+
+int ACAP_EVENTS_Fire_JSON(const char* Id, cJSON* data) {
+    return ACAP_EVENTS_Fire(Id);
+}
+
+int ACAP_EVENTS_SetCallback(ACAP_EVENTS_Callback callback) {
+    return 1;
+}
+
+int ACAP_EVENTS_Subscribe(cJSON* eventDeclaration, void* user_data) {
+    return 0;  // No event service off-device
+}
+
+int ACAP_EVENTS_Unsubscribe(int id) {
+    return 1;
+}
+
+/*-----------------------------------------------------
+ * Files
+ *-----------------------------------------------------*/
+
+const char* ACAP_FILE_AppPath(void) {
+    return ACAP_FILE_Path;
+}
+
+FILE* ACAP_FILE_Open(const char* filepath, const char* mode) {
+    if (!filepath)
+        return NULL;
+    char fullpath[ACAP_MAX_PATH_LENGTH * 2];
+    snprintf(fullpath, sizeof(fullpath), "%s%s", ACAP_FILE_Path, filepath);
+    FILE* file = fopen(fullpath, mode);
+    if (!file)
+        LOG_TRACE("%s: Opening file %s failed: %s\n", __func__, fullpath, strerror(errno));
+    return file;
+}
+
+int ACAP_FILE_Delete(const char* filepath) {
+    if (!filepath)
+        return 0;
+    char fullpath[ACAP_MAX_PATH_LENGTH * 2];
+    snprintf(fullpath, sizeof(fullpath), "%s%s", ACAP_FILE_Path, filepath);
+    return remove(fullpath) == 0;
+}
+
+cJSON* ACAP_FILE_Read(const char* filepath) {
+    FILE* file = ACAP_FILE_Open(filepath, "r");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 2) {
+        fclose(file);
+        return NULL;
+    }
+    char* jsonString = malloc(size + 1);
+    if (!jsonString) {
+        fclose(file);
+        return NULL;
+    }
+    size_t bytesRead = fread(jsonString, 1, size, file);
+    fclose(file);
+    jsonString[bytesRead] = '\0';
+    cJSON* object = cJSON_Parse(jsonString);
+    free(jsonString);
+    if (!object)
+        LOG_WARN("JSON Parse error for %s\n", filepath);
+    return object;
+}
+
+int ACAP_FILE_Write(const char* filepath, cJSON* object) {
+    if (!filepath || !object)
+        return 0;
+    char* jsonString = cJSON_Print(object);
+    if (!jsonString)
+        return 0;
+    int result = ACAP_FILE_WriteData(filepath, jsonString);
+    free(jsonString);
+    return result;
+}
+
+int ACAP_FILE_WriteData(const char* filepath, const char* data) {
+    if (!filepath || !data)
+        return 0;
+    FILE* file = ACAP_FILE_Open(filepath, "w");
+    if (!file)
+        return 0;
+    int result = fputs(data, file);
+    fclose(file);
+    return result >= 0;
+}
+
+int ACAP_FILE_Exists(const char* filepath) {
+    FILE* file = ACAP_FILE_Open(filepath, "r");
+    if (!file)
+        return 0;
+    fclose(file);
+    return 1;
+}
+
+/*-----------------------------------------------------
+ * Device
+ *-----------------------------------------------------*/
+
+double ACAP_DEVICE_Longitude() {
+    cJSON* location = cJSON_GetObjectItem(device_container, "location");
+    return cJSON_GetObjectItem(location, "lon") ? cJSON_GetObjectItem(location, "lon")->valuedouble : 0;
+}
+
+double ACAP_DEVICE_Latitude() {
+    cJSON* location = cJSON_GetObjectItem(device_container, "location");
+    return cJSON_GetObjectItem(location, "lat") ? cJSON_GetObjectItem(location, "lat")->valuedouble : 0;
+}
+
+int ACAP_DEVICE_Set_Location(double lat, double lon) {
+    cJSON* location = cJSON_GetObjectItem(device_container, "location");
+    if (!location)
+        return 0;
+    cJSON_ReplaceItemInObject(location, "lat", cJSON_CreateNumber(lat));
+    cJSON_ReplaceItemInObject(location, "lon", cJSON_CreateNumber(lon));
+    return 1;
+}
+
+const char* ACAP_DEVICE_Prop(const char* name) {
+    cJSON* item = cJSON_GetObjectItem(device_container, name);
+    return item ? item->valuestring : 0;
+}
+
+int ACAP_DEVICE_Prop_Int(const char* name) {
+    cJSON* item = cJSON_GetObjectItem(device_container, name);
+    return item ? item->valueint : 0;
+}
+
+cJSON* ACAP_DEVICE_JSON(const char* name) {
+    return cJSON_GetObjectItem(device_container, name);
+}
+
+int ACAP_DEVICE_Seconds_Since_Midnight(void) {
+    time_t t = time(NULL);
+    struct tm tm = *localtime(&t);
+    return tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+}
+
+double ACAP_DEVICE_Timestamp(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static const char* format_time(char* buffer, size_t size, const char* format) {
+    time_t t = time(NULL);
+    strftime(buffer, size, format, localtime(&t));
+    return buffer;
+}
+
+const char* ACAP_DEVICE_Local_Time(void) {
+    static char buffer[64];
+    return format_time(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S");
+}
+
+const char* ACAP_DEVICE_ISOTime(void) {
+    static char buffer[64];
+    return format_time(buffer, sizeof(buffer), "%Y-%m-%dT%T%z");
+}
+
+const char* ACAP_DEVICE_Date(void) {
+    static char buffer[64];
+    return format_time(buffer, sizeof(buffer), "%Y-%m-%d");
+}
+
+const char* ACAP_DEVICE_Time(void) {
+    static char buffer[64];
+    return format_time(buffer, sizeof(buffer), "%H:%M:%S");
+}
+
+double ACAP_DEVICE_Uptime(void) {
+    struct sysinfo info;
+    sysinfo(&info);
+    return (double)info.uptime;
+}
+
+double ACAP_DEVICE_CPU_Average(void) {
+    struct sysinfo info;
+    sysinfo(&info);
+    return (double)info.loads[2] / 65536.0;
+}
+
+double ACAP_DEVICE_Network_Average(void) {
+    return 0;
+}
+
+/*-----------------------------------------------------
+ * Status
+ *-----------------------------------------------------*/
+
+cJSON* ACAP_STATUS_Group(const char* name) {
+    if (!name || !status_container)
+        return NULL;
+    cJSON* group = cJSON_GetObjectItem(status_container, name);
+    if (!group) {
+        group = cJSON_CreateObject();
+        cJSON_AddItemToObject(status_container, name, group);
+    }
+    return group;
+}
+
+static void status_set(const char* group, const char* name, cJSON* value) {
+    if (!group || !name || !value) {
+        cJSON_Delete(value);
+        return;
+    }
+    pthread_mutex_lock(&status_mutex);
+    cJSON* groupObj = ACAP_STATUS_Group(group);
+    if (!groupObj)
+        cJSON_Delete(value);
+    else if (cJSON_GetObjectItem(groupObj, name))
+        cJSON_ReplaceItemInObject(groupObj, name, value);
+    else
+        cJSON_AddItemToObject(groupObj, name, value);
+    pthread_mutex_unlock(&status_mutex);
+}
+
+void ACAP_STATUS_SetBool(const char* group, const char* name, int state) {
+    status_set(group, name, cJSON_CreateBool(state));
+}
+
+void ACAP_STATUS_SetNumber(const char* group, const char* name, double value) {
+    status_set(group, name, cJSON_CreateNumber(value));
+}
+
+void ACAP_STATUS_SetString(const char* group, const char* name, const char* string) {
+    status_set(group, name, string ? cJSON_CreateString(string) : NULL);
+}
+
+void ACAP_STATUS_SetObject(const char* group, const char* name, cJSON* data) {
+    status_set(group, name, data ? cJSON_Duplicate(data, 1) : NULL);
+}
+
+void ACAP_STATUS_TakeObject(const char* group, const char* name, cJSON* data) {
+    status_set(group, name, data);
+}
+
+void ACAP_STATUS_SetNull(const char* group, const char* name) {
+    status_set(group, name, cJSON_CreateNull());
+}
+
+int ACAP_STATUS_Bool(const char* group, const char* name) {
+    cJSON* item = cJSON_GetObjectItem(ACAP_STATUS_Group(group), name);
+    return item && item->type == cJSON_True ? 1 : 0;
+}
+
+int ACAP_STATUS_Int(const char* group, const char* name) {
+    cJSON* item = cJSON_GetObjectItem(ACAP_STATUS_Group(group), name);
+    return item && cJSON_IsNumber(item) ? item->valueint : 0;
+}
+
+double ACAP_STATUS_Double(const char* group, const char* name) {
+    cJSON* item = cJSON_GetObjectItem(ACAP_STATUS_Group(group), name);
+    return item && cJSON_IsNumber(item) ? item->valuedouble : 0.0;
+}
+
+char* ACAP_STATUS_String(const char* group, const char* name) {
+    cJSON* item = cJSON_GetObjectItem(ACAP_STATUS_Group(group), name);
+    return item && cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+cJSON* ACAP_STATUS_Object(const char* group, const char* name) {
+    return cJSON_GetObjectItem(ACAP_STATUS_Group(group), name);
+}
+
+/*-----------------------------------------------------
+ * VAPIX
+ *-----------------------------------------------------*/
+
+char* ACAP_VAPIX_Get(const char* request) {
+    return NULL;  // No camera to talk to
+}
+
+char* ACAP_VAPIX_Post(const char* request, const char* body) {
+    return NULL;
+}
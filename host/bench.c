@@ -0,0 +1,598 @@
+/**
+ * bench.c - Microbenchmarks for the frame pipeline hot paths
+ *
+ * Runs the colour conversion, JPEG encode/crop, base64, Hub response parsing
+ * and MQTT payload serialization code from ../app on fixed synthetic inputs
+ * and reports ns/op, allocated bytes/op, allocations/op and throughput.
+ *
+ * Usage: detectx_bench [--filter TEXT] [--time MS] [--repeat N]
+ *                      [--json FILE] [--baseline FILE] [--threshold PCT] [--list]
+ *
+ * --json writes the results as JSON; the same file can later be passed as
+ * --baseline. With --baseline the exit status is 1 if any benchmark got
+ * slower than the threshold (default 15%) or allocates more than before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "ACAP.h"
+#include "cJSON.h"
+#include "Hub.h"
+#include "MQTT.h"
+#include "imgutils.h"
+#include "Output_helpers.h"
+
+#define DEFAULT_TIME_MS     300
+#define DEFAULT_REPEAT      5
+#define DEFAULT_THRESHOLD   15.0
+#define MAX_SAMPLES         32
+
+/*
+ * Allocation counting. Defining malloc/calloc/realloc/free in the executable
+ * interposes them for libjpeg, glib and libc as well, so the counts cover
+ * everything the benchmarked code allocates.
+ */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void  __libc_free(void* ptr);
+
+static int      alloc_counting = 0;
+static uint64_t alloc_count = 0;
+static uint64_t alloc_bytes = 0;
+
+void* malloc(size_t size) {
+    if (alloc_counting) { alloc_count++; alloc_bytes += size; }
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (alloc_counting) { alloc_count++; alloc_bytes += count * size; }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (alloc_counting) { alloc_count++; alloc_bytes += size; }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+/* Benchmark registry */
+
+typedef struct {
+    const char* name;
+    void (*run)(void* arg);
+    void* arg;
+    size_t bytes;       /* Input bytes processed per op, for throughput */
+} Bench;
+
+typedef struct {
+    const char* name;
+    uint64_t iterations;
+    double ns_per_op;
+    double bytes_per_op;
+    double allocs_per_op;
+    double mb_per_s;
+} BenchResult;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Prevents the compiler from discarding results */
+static volatile uintptr_t sink;
+
+/* Fixed inputs, generated once from a constant seed */
+
+static uint32_t rng_state;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* Gradient background, a few flat boxes and mild sensor noise, so JPEG sizes resemble camera frames */
+static uint8_t* make_nv12(unsigned int width, unsigned int height) {
+    uint8_t* nv12 = malloc(width * height * 3 / 2);
+    if (!nv12)
+        return NULL;
+    rng_state = 0x9E3779B9u ^ (width * 31 + height);
+    for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int x = 0; x < width; x++) {
+            int value = 40 + (int)(150 * x / width) + (int)(40 * y / height);
+            if ((x / (width / 8)) % 3 == 1 && (y / (height / 6)) % 2 == 1)
+                value = 200 - value / 4;
+            value += (int)(rng_next() % 9) - 4;
+            nv12[y * width + x] = (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+        }
+    }
+    uint8_t* uv = nv12 + width * height;
+    for (unsigned int y = 0; y < height / 2; y++) {
+        for (unsigned int x = 0; x < width; x += 2) {
+            uv[y * width + x] = (uint8_t)(112 + (x * 32 / width) + (rng_next() % 3));
+            uv[y * width + x + 1] = (uint8_t)(144 - (y * 64 / height) + (rng_next() % 3));
+        }
+    }
+    return nv12;
+}
+
+static const char* labels[] = { "person", "car", "bicycle", "truck", "dog", "bus" };
+
+static char* make_hub_response(int detections) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON* array = cJSON_AddArrayToObject(root, "detections");
+    rng_state = 0x2545F491u + (uint32_t)detections;
+    for (int i = 0; i < detections; i++) {
+        int class_id = (int)(rng_next() % (sizeof(labels) / sizeof(labels[0])));
+        double w = 0.02 + (rng_next() % 1000) / 5000.0;
+        double h = 0.04 + (rng_next() % 1000) / 4000.0;
+        double x = w / 2 + (rng_next() % 1000) / 1000.0 * (1 - w);
+        double y = h / 2 + (rng_next() % 1000) / 1000.0 * (1 - h);
+        cJSON* detection = cJSON_CreateObject();
+        cJSON_AddStringToObject(detection, "label", labels[class_id]);
+        cJSON_AddNumberToObject(detection, "class_id", class_id);
+        cJSON_AddNumberToObject(detection, "confidence", 0.25 + (rng_next() % 7500) / 10000.0);
+        cJSON* pixels = cJSON_AddObjectToObject(detection, "bbox_pixels");
+        cJSON_AddNumberToObject(pixels, "x", (int)((x - w / 2) * 1280));
+        cJSON_AddNumberToObject(pixels, "y", (int)((y - h / 2) * 720));
+        cJSON_AddNumberToObject(pixels, "w", (int)(w * 1280));
+        cJSON_AddNumberToObject(pixels, "h", (int)(h * 720));
+        cJSON* yolo = cJSON_AddObjectToObject(detection, "bbox_yolo");
+        cJSON_AddNumberToObject(yolo, "x", x);
+        cJSON_AddNumberToObject(yolo, "y", y);
+        cJSON_AddNumberToObject(yolo, "w", w);
+        cJSON_AddNumberToObject(yolo, "h", h);
+        cJSON_AddItemToArray(array, detection);
+    }
+    cJSON_AddNumberToObject(root, "inference_time_ms", 23.4);
+    cJSON_AddNumberToObject(root, "image_index", 0);
+    char* json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+/* Normalized detections as produced by Model_Inference() and filtered in main.c */
+static cJSON* make_detections(int detections) {
+    char* response = make_hub_response(detections);
+    cJSON* hub = Hub_ParseDetections(response, NULL);
+    free(response);
+    cJSON* array = cJSON_CreateArray();
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, hub) {
+        cJSON* yolo = cJSON_GetObjectItem(item, "bbox_yolo");
+        cJSON* detection = cJSON_CreateObject();
+        cJSON_AddStringToObject(detection, "label", cJSON_GetObjectItem(item, "label")->valuestring);
+        cJSON_AddNumberToObject(detection, "c", cJSON_GetObjectItem(item, "confidence")->valuedouble);
+        cJSON_AddNumberToObject(detection, "x", cJSON_GetObjectItem(yolo, "x")->valuedouble);
+        cJSON_AddNumberToObject(detection, "y", cJSON_GetObjectItem(yolo, "y")->valuedouble);
+        cJSON_AddNumberToObject(detection, "w", cJSON_GetObjectItem(yolo, "w")->valuedouble);
+        cJSON_AddNumberToObject(detection, "h", cJSON_GetObjectItem(yolo, "h")->valuedouble);
+        cJSON_AddNumberToObject(detection, "timestamp", 1760000000000.0);
+        cJSON_AddItemToArray(array, detection);
+    }
+    cJSON_Delete(hub);
+    return array;
+}
+
+/* Benchmark bodies */
+
+typedef struct {
+    const uint8_t* data;
+    unsigned int width;
+    unsigned int height;
+    int quality;
+    size_t size;
+    int crop_x, crop_y, crop_w, crop_h;
+} ImageArg;
+
+static void bench_nv12_to_rgb(void* arg) {
+    ImageArg* a = arg;
+    uint8_t* rgb = nv12_to_rgb(a->data, a->width, a->height);
+    sink = (uintptr_t)rgb[0];
+    free(rgb);
+}
+
+static void bench_rgb_to_jpeg(void* arg) {
+    ImageArg* a = arg;
+    unsigned long size = 0;
+    uint8_t* jpeg = rgb_to_jpeg(a->data, a->width, a->height, a->quality, &size);
+    sink = size;
+    free(jpeg);
+}
+
+static void bench_crop_interleaved(void* arg) {
+    ImageArg* a = arg;
+    unsigned char* crop = crop_interleaved((unsigned char*)a->data, a->width, a->height, 3,
+                                           a->crop_x, a->crop_y, a->crop_w, a->crop_h);
+    sink = (uintptr_t)crop[0];
+    free(crop);
+}
+
+static void bench_crop_jpeg(void* arg) {
+    ImageArg* a = arg;
+    unsigned long size = 0;
+    unsigned char* crop = crop_jpeg(a->data, a->size, a->crop_x, a->crop_y, a->crop_w, a->crop_h, &size);
+    sink = size;
+    free(crop);
+}
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+} BufferArg;
+
+static void bench_base64_encode(void* arg) {
+    BufferArg* a = arg;
+    char* encoded = base64_encode(a->data, a->size);
+    sink = (uintptr_t)encoded[0];
+    free(encoded);
+}
+
+static void bench_hub_parse(void* arg) {
+    BufferArg* a = arg;
+    cJSON* detections = Hub_ParseDetections((const char*)a->data, NULL);
+    sink = (uintptr_t)cJSON_GetArraySize(detections);
+    cJSON_Delete(detections);
+}
+
+/* Same payload construction as the "detection/<serial>" publish in Output() */
+static void bench_mqtt_json(void* arg) {
+    cJSON* detections = arg;
+    cJSON* mqttPayload = cJSON_CreateObject();
+    cJSON_AddItemReferenceToObject(mqttPayload, "detections", detections);
+    char* json = MQTT_Format_JSON(mqttPayload);
+    sink = strlen(json);
+    free(json);
+    cJSON_Delete(mqttPayload);
+}
+
+static size_t mqtt_json_size(cJSON* detections) {
+    cJSON* mqttPayload = cJSON_CreateObject();
+    cJSON_AddItemReferenceToObject(mqttPayload, "detections", detections);
+    char* json = MQTT_Format_JSON(mqttPayload);
+    size_t size = json ? strlen(json) : 0;
+    free(json);
+    cJSON_Delete(mqttPayload);
+    return size;
+}
+
+/* Runner */
+
+static BenchResult run_bench(const Bench* bench, uint64_t target_ns, int repeat) {
+    BenchResult result = { .name = bench->name };
+
+    // Calibrate: grow the batch until one batch takes at least target_ns / repeat
+    uint64_t batch_ns = target_ns / (uint64_t)repeat;
+    uint64_t iterations = 1;
+    for (;;) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < iterations; i++)
+            bench->run(bench->arg);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= batch_ns || iterations >= (1ULL << 30))
+            break;
+        uint64_t next = elapsed ? iterations * batch_ns / elapsed + 1 : iterations * 100;
+        if (next > iterations * 100)
+            next = iterations * 100;
+        iterations = next > iterations ? next : iterations + 1;
+    }
+
+    double samples[MAX_SAMPLES];
+    alloc_count = 0;
+    alloc_bytes = 0;
+    for (int r = 0; r < repeat; r++) {
+        alloc_counting = 1;
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < iterations; i++)
+            bench->run(bench->arg);
+        uint64_t elapsed = now_ns() - start;
+        alloc_counting = 0;
+        samples[r] = (double)elapsed / (double)iterations;
+    }
+    qsort(samples, repeat, sizeof(double), compare_double);
+
+    uint64_t total = iterations * (uint64_t)repeat;
+    result.iterations = total;
+    result.ns_per_op = samples[repeat / 2];
+    result.bytes_per_op = (double)alloc_bytes / (double)total;
+    result.allocs_per_op = (double)alloc_count / (double)total;
+    result.mb_per_s = bench->bytes && result.ns_per_op > 0 ?
+                      (double)bench->bytes / result.ns_per_op * 1000.0 : 0;
+    return result;
+}
+
+static cJSON* results_to_json(const BenchResult* results, int count, int time_ms, int repeat) {
+    cJSON* root = cJSON_CreateObject();
+    struct utsname uts;
+    char host[256] = "unknown";
+    if (uname(&uts) == 0)
+        snprintf(host, sizeof(host), "%s %s %s", uts.nodename, uts.sysname, uts.machine);
+    cJSON_AddStringToObject(root, "host", host);
+    cJSON_AddNumberToObject(root, "time_ms", time_ms);
+    cJSON_AddNumberToObject(root, "repeat", repeat);
+    cJSON* array = cJSON_AddArrayToObject(root, "benchmarks");
+    for (int i = 0; i < count; i++) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", results[i].name);
+        cJSON_AddNumberToObject(item, "iterations", (double)results[i].iterations);
+        cJSON_AddNumberToObject(item, "ns_per_op", results[i].ns_per_op);
+        cJSON_AddNumberToObject(item, "bytes_per_op", results[i].bytes_per_op);
+        cJSON_AddNumberToObject(item, "allocs_per_op", results[i].allocs_per_op);
+        cJSON_AddNumberToObject(item, "mb_per_s", results[i].mb_per_s);
+        cJSON_AddItemToArray(array, item);
+    }
+    return root;
+}
+
+static cJSON* read_json_file(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = malloc(size + 1);
+    if (!text) {
+        fclose(file);
+        return NULL;
+    }
+    size_t read = fread(text, 1, size, file);
+    text[read] = 0;
+    fclose(file);
+    cJSON* json = cJSON_Parse(text);
+    free(text);
+    return json;
+}
+
+// Returns the number of regressions
+static int compare_baseline(const BenchResult* results, int count, cJSON* baseline, double threshold) {
+    cJSON* array = cJSON_GetObjectItem(baseline, "benchmarks");
+    int regressions = 0;
+
+    printf("\n%-40s %12s %12s %8s %10s %10s\n", "vs baseline", "old ns/op", "new ns/op", "delta", "old allocs", "new allocs");
+    for (int i = 0; i < count; i++) {
+        cJSON* old = NULL;
+        cJSON* item = NULL;
+        cJSON_ArrayForEach(item, array) {
+            cJSON* name = cJSON_GetObjectItem(item, "name");
+            if (cJSON_IsString(name) && strcmp(name->valuestring, results[i].name) == 0) {
+                old = item;
+                break;
+            }
+        }
+        if (!old) {
+            printf("%-40s %12s\n", results[i].name, "new");
+            continue;
+        }
+        double old_ns = cJSON_GetObjectItem(old, "ns_per_op") ? cJSON_GetObjectItem(old, "ns_per_op")->valuedouble : 0;
+        double old_allocs = cJSON_GetObjectItem(old, "allocs_per_op") ? cJSON_GetObjectItem(old, "allocs_per_op")->valuedouble : 0;
+        double delta = old_ns > 0 ? (results[i].ns_per_op - old_ns) / old_ns * 100.0 : 0;
+        // Allocation counts are deterministic; allow rounding noise only
+        int slower = delta > threshold;
+        int allocates_more = results[i].allocs_per_op > old_allocs + 0.01;
+        if (slower || allocates_more)
+            regressions++;
+        printf("%-40s %12.0f %12.0f %+7.1f%% %10.1f %10.1f%s\n", results[i].name, old_ns, results[i].ns_per_op,
+               delta, old_allocs, results[i].allocs_per_op,
+               slower ? "  SLOWER" : allocates_more ? "  MORE ALLOCS" : "");
+    }
+    return regressions;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--filter TEXT] [--time MS] [--repeat N] [--json FILE]\n"
+            "          [--baseline FILE] [--threshold PCT] [--list]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    const char* filter = NULL;
+    const char* json_path = NULL;
+    const char* baseline_path = NULL;
+    int time_ms = DEFAULT_TIME_MS;
+    int repeat = DEFAULT_REPEAT;
+    double threshold = DEFAULT_THRESHOLD;
+    int list = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+            time_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_path = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baseline_path = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--list") == 0)
+            list = 1;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (time_ms <= 0)
+        time_ms = DEFAULT_TIME_MS;
+    if (repeat <= 0 || repeat > MAX_SAMPLES)
+        repeat = DEFAULT_REPEAT;
+
+    // Device properties (serial) used by the MQTT payload
+    ACAP("detectx", NULL);
+
+    // Frames at the resolutions the app captures
+    static const unsigned int sizes[][2] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+    enum { SIZES = 3 };
+    uint8_t* nv12[SIZES];
+    uint8_t* rgb[SIZES];
+    for (int s = 0; s < SIZES; s++) {
+        nv12[s] = make_nv12(sizes[s][0], sizes[s][1]);
+        rgb[s] = nv12[s] ? nv12_to_rgb(nv12[s], sizes[s][0], sizes[s][1]) : NULL;
+        if (!rgb[s]) {
+            fprintf(stderr, "Failed to generate input frames\n");
+            return 2;
+        }
+    }
+    unsigned long jpeg_size = 0;
+    uint8_t* jpeg = rgb_to_jpeg(rgb[1], sizes[1][0], sizes[1][1], 90, &jpeg_size);
+
+    static unsigned char random_bytes[512 * 1024];
+    rng_state = 0xB5297A4Du;
+    for (size_t i = 0; i < sizeof(random_bytes); i++)
+        random_bytes[i] = (unsigned char)rng_next();
+
+    char* hub_typical = make_hub_response(5);
+    char* hub_crowded = make_hub_response(100);
+    cJSON* detections_typical = make_detections(5);
+    cJSON* detections_crowded = make_detections(100);
+
+    ImageArg image_args[32];
+    BufferArg buffer_args[8];
+    Bench benches[48];
+    char names[48][64];
+    int count = 0, ia = 0, ba = 0;
+
+#define ADD_BENCH(fn, argp, nbytes, ...) do { \
+        snprintf(names[count], sizeof(names[count]), __VA_ARGS__); \
+        benches[count] = (Bench){ names[count], fn, argp, nbytes }; \
+        count++; \
+    } while (0)
+
+    for (int s = 0; s < SIZES; s++) {
+        image_args[ia] = (ImageArg){ .data = nv12[s], .width = sizes[s][0], .height = sizes[s][1] };
+        ADD_BENCH(bench_nv12_to_rgb, &image_args[ia], sizes[s][0] * sizes[s][1] * 3 / 2,
+                  "nv12_to_rgb/%ux%u", sizes[s][0], sizes[s][1]);
+        ia++;
+    }
+
+    static const int qualities[] = { 50, 75, 90 };
+    for (int s = 0; s < SIZES; s++) {
+        for (int q = 0; q < 3; q++) {
+            image_args[ia] = (ImageArg){ .data = rgb[s], .width = sizes[s][0], .height = sizes[s][1], .quality = qualities[q] };
+            ADD_BENCH(bench_rgb_to_jpeg, &image_args[ia], sizes[s][0] * sizes[s][1] * 3,
+                      "rgb_to_jpeg/%ux%u/q%d", sizes[s][0], sizes[s][1], qualities[q]);
+            ia++;
+        }
+    }
+
+    // Crop boxes: small distant object, typical person, large close object
+    static const int boxes[][2] = { { 64, 128 }, { 256, 384 }, { 640, 480 } };
+    for (int b = 0; b < 3; b++) {
+        image_args[ia] = (ImageArg){ .data = rgb[1], .width = sizes[1][0], .height = sizes[1][1],
+                                     .crop_x = 300, .crop_y = 120, .crop_w = boxes[b][0], .crop_h = boxes[b][1] };
+        ADD_BENCH(bench_crop_interleaved, &image_args[ia], boxes[b][0] * boxes[b][1] * 3,
+                  "crop_interleaved/1280x720/%dx%d", boxes[b][0], boxes[b][1]);
+        ia++;
+    }
+    for (int b = 0; b < 3; b++) {
+        image_args[ia] = (ImageArg){ .data = jpeg, .size = jpeg_size, .width = sizes[1][0], .height = sizes[1][1],
+                                     .crop_x = 300, .crop_y = 120, .crop_w = boxes[b][0], .crop_h = boxes[b][1] };
+        ADD_BENCH(bench_crop_jpeg, &image_args[ia], jpeg_size,
+                  "crop_jpeg/1280x720/%dx%d", boxes[b][0], boxes[b][1]);
+        ia++;
+    }
+
+    static const size_t base64_sizes[] = { 4 * 1024, 64 * 1024, 512 * 1024 };
+    for (int i = 0; i < 3; i++) {
+        buffer_args[ba] = (BufferArg){ random_bytes, base64_sizes[i] };
+        ADD_BENCH(bench_base64_encode, &buffer_args[ba], base64_sizes[i], "base64_encode/%zuKB", base64_sizes[i] / 1024);
+        ba++;
+    }
+
+    buffer_args[ba] = (BufferArg){ (const unsigned char*)hub_typical, strlen(hub_typical) };
+    ADD_BENCH(bench_hub_parse, &buffer_args[ba], buffer_args[ba].size, "hub_parse/typical_5");
+    ba++;
+    buffer_args[ba] = (BufferArg){ (const unsigned char*)hub_crowded, strlen(hub_crowded) };
+    ADD_BENCH(bench_hub_parse, &buffer_args[ba], buffer_args[ba].size, "hub_parse/crowded_100");
+    ba++;
+
+    // Throughput for the MQTT cases is in serialized payload bytes
+    ADD_BENCH(bench_mqtt_json, detections_typical, mqtt_json_size(detections_typical), "mqtt_json/typical_5");
+    ADD_BENCH(bench_mqtt_json, detections_crowded, mqtt_json_size(detections_crowded), "mqtt_json/crowded_100");
+
+#undef ADD_BENCH
+
+    BenchResult results[48];
+    int ran = 0;
+
+    if (!list)
+        printf("%-40s %12s %12s %12s %10s %10s\n", "benchmark", "iterations", "ns/op", "bytes/op", "allocs/op", "MB/s");
+    for (int i = 0; i < count; i++) {
+        if (filter && !strstr(benches[i].name, filter))
+            continue;
+        if (list) {
+            printf("%s\n", benches[i].name);
+            continue;
+        }
+        results[ran] = run_bench(&benches[i], (uint64_t)time_ms * 1000000ULL, repeat);
+        printf("%-40s %12llu %12.0f %12.0f %10.1f %10.1f\n", results[ran].name,
+               (unsigned long long)results[ran].iterations, results[ran].ns_per_op,
+               results[ran].bytes_per_op, results[ran].allocs_per_op, results[ran].mb_per_s);
+        fflush(stdout);
+        ran++;
+    }
+
+    int status = 0;
+    if (!list && json_path) {
+        cJSON* json = results_to_json(results, ran, time_ms, repeat);
+        char* text = cJSON_Print(json);
+        FILE* file = fopen(json_path, "w");
+        if (file && text) {
+            fprintf(file, "%s\n", text);
+            fclose(file);
+        } else {
+            fprintf(stderr, "Failed to write %s\n", json_path);
+            if (file)
+                fclose(file);
+            status = 2;
+        }
+        free(text);
+        cJSON_Delete(json);
+    }
+
+    if (!list && baseline_path) {
+        cJSON* baseline = read_json_file(baseline_path);
+        if (!baseline) {
+            fprintf(stderr, "Failed to read baseline %s\n", baseline_path);
+            status = 2;
+        } else {
+            int regressions = compare_baseline(results, ran, baseline, threshold);
+            printf("\n%d regression(s) (threshold %.1f%%)\n", regressions, threshold);
+            if (regressions && !status)
+                status = 1;
+            cJSON_Delete(baseline);
+        }
+    }
+
+    cJSON_Delete(detections_typical);
+    cJSON_Delete(detections_crowded);
+    free(hub_typical);
+    free(hub_crowded);
+    free(jpeg);
+    for (int s = 0; s < SIZES; s++) {
+        free(nv12[s]);
+        free(rgb[s]);
+    }
+    ACAP_Cleanup();
+    return status;
+}
@@ -0,0 +1,526 @@
+/*
+ * fleet.c - Load simulator for many cameras sharing one Hub
+ *
+ * Starts N virtual cameras, each a thread with its own Hub client context
+ * (Hub_Init()), that post pre-encoded JPEG frames to the Hub at their own
+ * capture interval. The interval follows the same adaptive policy as the
+ * camera (Pipeline_Rate_Update()), so the run shows how the fleet settles
+ * when the Hub saturates. The report lists per-camera throughput, latency
+ * percentiles and 503/queue-full rates, plus Jain's fairness index over the
+ * per-camera throughput.
+ *
+ * The bundled mock Hub runs in-process; --hub-workers and --hub-queue give
+ * it a bounded worker pool so that overload produces 503 responses.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ACAP.h"
+#include "cJSON.h"
+#include "Hub.h"
+#include "Metrics.h"
+#include "Pipeline.h"
+#include "imgutils.h"
+#include "mock_hub.h"
+
+#define APP_PACKAGE         "detectx_client"
+#define DEFAULT_CAMERAS     16
+#define DEFAULT_DURATION    60
+#define DEFAULT_WIDTH       640
+#define DEFAULT_HEIGHT      640
+#define JPEG_QUALITY        90
+#define MAX_FRAMES          64
+#define MAX_RATES           64
+#define HEALTH_INTERVAL_US  5000000ULL  /* Same /health poll as main.c */
+#define ACTIVITY_PERIOD_US  60000000ULL /* Scene activity repeats every minute */
+
+static FILE* report = NULL;
+
+typedef struct {
+    uint8_t* data;
+    unsigned long size;
+} Jpeg;
+
+typedef struct {
+    int id;
+    HubContext* hub;
+    PipelineRate rate;
+    unsigned int start_rate_ms;
+    const Jpeg* frames;
+    int frame_count;
+    uint64_t start_us;
+    uint64_t end_us;
+    double activity;            /* Fraction of time objects are present */
+    uint64_t activity_phase_us;
+    /* Results */
+    int requests;
+    int burst_requests;
+    int ok;
+    int busy;                   /* HTTP 503 (queue full) */
+    int http_errors;            /* Other non-200 responses */
+    int transport_errors;       /* No response */
+    int latency_count;
+    int latency_capacity;
+    double* latencies;          /* Round-trip ms of successful requests */
+    double percentile_ms[3];    /* p50, p90, p99 */
+} Camera;
+
+/*-----------------------------------------------------
+ * Frames
+ *-----------------------------------------------------*/
+
+// Synthetic NV12 frame with a moving gradient so each JPEG differs
+static uint8_t* synthetic_nv12(unsigned int width, unsigned int height, int seed) {
+    uint8_t* frame = malloc((size_t)width * height * 3 / 2);
+    if (!frame)
+        return NULL;
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++)
+            frame[(size_t)y * width + x] = (uint8_t)((x + y + seed * 16) & 0xFF);
+    memset(frame + (size_t)width * height, 128, (size_t)width * height / 2);
+    return frame;
+}
+
+static int read_nv12(FILE* file, unsigned int width, unsigned int height, uint8_t** frame) {
+    size_t size = (size_t)width * height * 3 / 2;
+    *frame = malloc(size);
+    if (*frame && fread(*frame, 1, size, file) == size)
+        return 1;
+    free(*frame);
+    *frame = NULL;
+    return 0;
+}
+
+// Encode every frame once; the cameras share the JPEGs read-only
+static int prepare_frames(const char* path, unsigned int width, unsigned int height, Jpeg* jpegs) {
+    FILE* file = NULL;
+    if (path) {
+        file = fopen(path, "rb");
+        if (!file) {
+            fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+            return 0;
+        }
+    }
+    int count = 0;
+    while (count < MAX_FRAMES) {
+        uint8_t* nv12 = NULL;
+        if (file) {
+            if (!read_nv12(file, width, height, &nv12))
+                break;
+        } else {
+            if (count == 8)
+                break;
+            nv12 = synthetic_nv12(width, height, count);
+            if (!nv12)
+                break;
+        }
+        uint8_t* rgb = nv12_to_rgb(nv12, width, height);
+        free(nv12);
+        jpegs[count].data = rgb ? rgb_to_jpeg(rgb, width, height, JPEG_QUALITY, &jpegs[count].size) : NULL;
+        free(rgb);
+        if (!jpegs[count].data)
+            break;
+        count++;
+    }
+    if (file)
+        fclose(file);
+    return count;
+}
+
+/*-----------------------------------------------------
+ * Cameras
+ *-----------------------------------------------------*/
+
+static void sleep_until(uint64_t target_us) {
+    uint64_t now = Metrics_Now();
+    if (now >= target_us)
+        return;
+    uint64_t wait = target_us - now;
+    struct timespec ts = { (time_t)(wait / 1000000), (long)(wait % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void record_latency(Camera* camera, double ms) {
+    if (camera->latency_count == camera->latency_capacity) {
+        int capacity = camera->latency_capacity ? camera->latency_capacity * 2 : 256;
+        double* grown = realloc(camera->latencies, sizeof(double) * capacity);
+        if (!grown)
+            return;
+        camera->latencies = grown;
+        camera->latency_capacity = capacity;
+    }
+    camera->latencies[camera->latency_count++] = ms;
+}
+
+/*
+ * One camera: capture tick, inference, rate update. Like the capture
+ * scheduler, the next deadline is rate_ms after the previous one, or
+ * immediately if the request took longer than that.
+ */
+static void* camera_thread(void* arg) {
+    Camera* camera = arg;
+    uint64_t next = camera->start_us;
+    uint64_t last_health = 0;
+
+    while (next < camera->end_us) {
+        sleep_until(next);
+        uint64_t tick = Metrics_Now();
+        if (tick >= camera->end_us)
+            break;
+
+        const Jpeg* jpeg = &camera->frames[camera->requests % camera->frame_count];
+        char* error = NULL;
+        cJSON* detections = Hub_InferenceJPEG(camera->hub, jpeg->data, jpeg->size, camera->id, "balanced", &error);
+        long status = Hub_GetLastHTTPStatus(camera->hub);
+        double round_trip = Hub_GetLastRequestTime(camera->hub);
+        camera->requests++;
+
+        if (detections) {
+            camera->ok++;
+            record_latency(camera, round_trip);
+            cJSON_Delete(detections);
+        } else if (status == 503) {
+            camera->busy++;
+        } else if (status == 0) {
+            camera->transport_errors++;
+        } else {
+            camera->http_errors++;
+        }
+        free(error);
+
+        int inference_ms = round_trip > 0 ? (int)round_trip : 0;
+        Pipeline_Rate_Update(&camera->rate, (unsigned int)inference_ms, status, round_trip);
+        if (camera->rate.adaptive && tick - last_health >= HEALTH_INTERVAL_US) {
+            HubHealth health;
+            last_health = tick;
+            if (Hub_GetHealth(camera->hub, &health))
+                Pipeline_Rate_Queue(&camera->rate, health.queue_size, health.queue_full);
+        }
+
+        // Objects are present for the first activity share of each period
+        int active = ((tick + camera->activity_phase_us) % ACTIVITY_PERIOD_US) < camera->activity * ACTIVITY_PERIOD_US;
+        unsigned int interval = Pipeline_Rate_Next(&camera->rate, 1, active, tick / 1000);
+        if (camera->rate.burst)
+            camera->burst_requests++;
+        next += (uint64_t)interval * 1000;
+        uint64_t now = Metrics_Now();
+        if (next < now)
+            next = now;
+    }
+    return NULL;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void camera_percentiles(Camera* camera) {
+    if (!camera->latency_count)
+        return;
+    qsort(camera->latencies, camera->latency_count, sizeof(double), compare_double);
+    static const double quantiles[] = { 0.50, 0.90, 0.99 };
+    for (int q = 0; q < 3; q++) {
+        int rank = (int)(quantiles[q] * camera->latency_count + 0.5) - 1;
+        rank = rank < 0 ? 0 : rank >= camera->latency_count ? camera->latency_count - 1 : rank;
+        camera->percentile_ms[q] = camera->latencies[rank];
+    }
+}
+
+// Jain's fairness index: 1 when every camera gets the same throughput, 1/n when one gets all
+static double jain_fairness(const Camera* cameras, int count, double seconds) {
+    double sum = 0, squares = 0;
+    for (int c = 0; c < count; c++) {
+        double x = cameras[c].ok / seconds;
+        sum += x;
+        squares += x * x;
+    }
+    return squares > 0 ? sum * sum / (count * squares) : 0;
+}
+
+static int parse_rates(const char* text, unsigned int* rates) {
+    int count = 0;
+    char* copy = strdup(text);
+    char* save = NULL;
+    for (char* token = strtok_r(copy, ",", &save); token && count < MAX_RATES; token = strtok_r(NULL, ",", &save)) {
+        int value = atoi(token);
+        if (value <= 0) {
+            count = -1;
+            break;
+        }
+        rates[count++] = (unsigned int)value;
+    }
+    free(copy);
+    return count;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --cameras N             Virtual cameras (default %d)\n"
+            "  --duration S            Test duration in seconds (default %d)\n"
+            "  --rate MS[,MS...]       Initial capture interval per camera, cycled (default hub.captureRateMs)\n"
+            "  --min-rate MS           Lower bound for the adaptive interval (default hub.minCaptureRateMs)\n"
+            "  --adaptive 0|1          Adaptive capture rate (default hub.adaptiveRate)\n"
+            "  --idle-rate MS          Interval with no objects present, 0 disables burst mode (default hub.idleRateMs)\n"
+            "  --max-per-minute N      Hub requests per camera and minute (default hub.maxRequestsPerMinute)\n"
+            "  --activity F            Fraction of each minute with objects present (default 1)\n"
+            "  --frames PATH           Raw NV12 file with one or more frames (default synthetic)\n"
+            "  --size WxH              Frame resolution (default %dx%d)\n"
+            "  --hub URL               Use this Hub instead of the bundled mock Hub\n"
+            "  --json FILE             Write results as JSON\n"
+            "  --seed N                Seed for the camera start offsets\n"
+            "  --verbose               Keep the application log on stdout\n"
+            "Mock Hub options:\n%s",
+            program, DEFAULT_CAMERAS, DEFAULT_DURATION, DEFAULT_WIDTH, DEFAULT_HEIGHT, MockHub_Usage());
+}
+
+int main(int argc, char* argv[]) {
+    int camera_count = DEFAULT_CAMERAS;
+    int duration = DEFAULT_DURATION;
+    unsigned int rates[MAX_RATES];
+    int rate_count = 0;
+    int min_rate = -1;
+    int adaptive = -1;
+    int idle_rate = -1;
+    int max_per_minute = -1;
+    double activity = 1.0;
+    const char* frames_path = NULL;
+    unsigned int width = DEFAULT_WIDTH, height = DEFAULT_HEIGHT;
+    const char* hub_url = NULL;
+    const char* json_path = NULL;
+    unsigned int seed = 1;
+    int verbose = 0;
+    MockHubConfig hub_config;
+    MockHub_Defaults(&hub_config);
+
+    for (int i = 1; i < argc; i++) {
+        int parsed = MockHub_Parse_Arg(&hub_config, argc, argv, &i);
+        if (parsed == 1)
+            continue;
+        if (parsed < 0) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i - 1], "--cameras") == 0)
+            camera_count = atoi(value);
+        else if (strcmp(argv[i - 1], "--duration") == 0)
+            duration = atoi(value);
+        else if (strcmp(argv[i - 1], "--rate") == 0)
+            rate_count = parse_rates(value, rates);
+        else if (strcmp(argv[i - 1], "--min-rate") == 0)
+            min_rate = atoi(value);
+        else if (strcmp(argv[i - 1], "--idle-rate") == 0)
+            idle_rate = atoi(value);
+        else if (strcmp(argv[i - 1], "--max-per-minute") == 0)
+            max_per_minute = atoi(value);
+        else if (strcmp(argv[i - 1], "--activity") == 0)
+            activity = atof(value);
+        else if (strcmp(argv[i - 1], "--adaptive") == 0)
+            adaptive = atoi(value) != 0;
+        else if (strcmp(argv[i - 1], "--frames") == 0)
+            frames_path = value;
+        else if (strcmp(argv[i - 1], "--size") == 0)
+            sscanf(value, "%ux%u", &width, &height);
+        else if (strcmp(argv[i - 1], "--hub") == 0)
+            hub_url = value;
+        else if (strcmp(argv[i - 1], "--json") == 0)
+            json_path = value;
+        else if (strcmp(argv[i - 1], "--seed") == 0)
+            seed = (unsigned int)strtoul(value, NULL, 10);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (camera_count <= 0 || duration <= 0 || rate_count < 0 || width < 2 || height < 2 ||
+        (width | height) & 1 || activity < 0 || activity > 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Jpeg jpegs[MAX_FRAMES];
+    int frame_count = prepare_frames(frames_path, width, height, jpegs);
+    if (!frame_count) {
+        fprintf(stderr, "No %ux%u frames available\n", width, height);
+        return 1;
+    }
+
+    char url[256];
+    if (!hub_url) {
+        int port = MockHub_Start(&hub_config);
+        if (port < 0) {
+            fprintf(stderr, "Mock Hub failed to start\n");
+            return 1;
+        }
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d", port);
+        hub_url = url;
+    }
+
+    // The Hub client logs every failed request on stdout; keep the report readable
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!verbose && !freopen("/dev/null", "w", stdout))
+        fprintf(stderr, "Cannot silence application log\n");
+
+    cJSON* settings = ACAP(APP_PACKAGE, NULL);
+    Camera* cameras = calloc(camera_count, sizeof(Camera));
+    pthread_t* threads = calloc(camera_count, sizeof(pthread_t));
+    if (!cameras || !threads)
+        return 1;
+
+    // Hub_Init() runs curl_global_init(), so contexts are created here and not in the threads
+    uint64_t start = Metrics_Now() + 100000;
+    uint64_t end = start + (uint64_t)duration * 1000000ULL;
+    for (int c = 0; c < camera_count; c++) {
+        Camera* camera = &cameras[c];
+        camera->id = c;
+        camera->hub = Hub_Init(hub_url, hub_config.username, hub_config.password);
+        if (!camera->hub) {
+            fprintf(stderr, "Camera %d: Hub client initialization failed\n", c);
+            return 1;
+        }
+        Pipeline_Rate_Init(&camera->rate, settings);
+        if (rate_count)
+            camera->rate.rate_ms = camera->rate.max_rate_ms = rates[c % rate_count];
+        if (min_rate > 0)
+            camera->rate.min_rate_ms = (unsigned int)min_rate;
+        if (camera->rate.min_rate_ms > camera->rate.max_rate_ms)
+            camera->rate.min_rate_ms = camera->rate.max_rate_ms;
+        if (adaptive >= 0)
+            camera->rate.adaptive = adaptive;
+        if (idle_rate >= 0)
+            camera->rate.idle_rate_ms = (unsigned int)idle_rate;
+        if (max_per_minute >= 0)
+            camera->rate.max_per_minute = (unsigned int)max_per_minute;
+        camera->activity = activity;
+        camera->activity_phase_us = (uint64_t)(rand_r(&seed) % 60000) * 1000;
+        camera->start_rate_ms = camera->rate.rate_ms;
+        camera->frames = jpegs;
+        camera->frame_count = frame_count;
+        // Cameras are not synchronized; spread the first capture over one interval
+        camera->start_us = start + (uint64_t)(rand_r(&seed) % camera->rate.rate_ms) * 1000;
+        camera->end_us = end;
+    }
+
+    fprintf(report, "Simulating %d camera(s) for %d s against %s (%d %ux%u frame(s), %lu bytes avg)\n",
+            camera_count, duration, hub_url, frame_count, width, height, jpegs[0].size);
+
+    for (int c = 0; c < camera_count; c++) {
+        if (pthread_create(&threads[c], NULL, camera_thread, &cameras[c]) != 0) {
+            fprintf(stderr, "Cannot start camera %d\n", c);
+            return 1;
+        }
+    }
+    for (int c = 0; c < camera_count; c++)
+        pthread_join(threads[c], NULL);
+    double seconds = (Metrics_Now() - start) / 1e6;
+
+    HubHealth health;
+    memset(&health, 0, sizeof(health));
+    int have_health = Hub_GetHealth(cameras[0].hub, &health);
+
+    int requests = 0, ok = 0, busy = 0, errors = 0;
+    fprintf(report, "\n%6s %8s %8s %8s %7s %8s %7s %7s %9s %9s %9s\n",
+            "camera", "start ms", "final ms", "requests", "burst", "ok/s", "503 %", "errors", "p50 ms", "p90 ms", "p99 ms");
+    for (int c = 0; c < camera_count; c++) {
+        Camera* camera = &cameras[c];
+        camera_percentiles(camera);
+        requests += camera->requests;
+        ok += camera->ok;
+        busy += camera->busy;
+        errors += camera->http_errors + camera->transport_errors;
+        fprintf(report, "%6d %8u %8u %8d %7d %8.2f %7.1f %7d %9.1f %9.1f %9.1f\n",
+                camera->id, camera->start_rate_ms, camera->rate.rate_ms, camera->requests, camera->burst_requests,
+                camera->ok / seconds,
+                camera->requests ? camera->busy * 100.0 / camera->requests : 0,
+                camera->http_errors + camera->transport_errors,
+                camera->percentile_ms[0], camera->percentile_ms[1], camera->percentile_ms[2]);
+    }
+    double fairness = jain_fairness(cameras, camera_count, seconds);
+    fprintf(report, "\nTotal: %d requests (%.0f/min), %.2f ok/s, %.1f%% 503, %d errors, fairness %.3f\n",
+            requests, requests * 60 / seconds, ok / seconds, requests ? busy * 100.0 / requests : 0, errors, fairness);
+    if (have_health)
+        fprintf(report, "Hub: %d requests, %d failed, avg inference %.1f ms (min %.1f, max %.1f)\n",
+                health.total_requests, health.failed, health.avg_inference_ms,
+                health.min_inference_ms, health.max_inference_ms);
+
+    int status = 0;
+    if (json_path) {
+        cJSON* root = cJSON_CreateObject();
+        cJSON_AddStringToObject(root, "hub", hub_url);
+        cJSON_AddNumberToObject(root, "cameras", camera_count);
+        cJSON_AddNumberToObject(root, "seconds", seconds);
+        cJSON_AddNumberToObject(root, "requests", requests);
+        cJSON_AddNumberToObject(root, "okPerSecond", ok / seconds);
+        cJSON_AddNumberToObject(root, "busyPercent", requests ? busy * 100.0 / requests : 0);
+        cJSON_AddNumberToObject(root, "errors", errors);
+        cJSON_AddNumberToObject(root, "fairness", fairness);
+        cJSON* list = cJSON_AddArrayToObject(root, "perCamera");
+        for (int c = 0; c < camera_count; c++) {
+            const Camera* camera = &cameras[c];
+            cJSON* item = cJSON_CreateObject();
+            cJSON_AddNumberToObject(item, "id", camera->id);
+            cJSON_AddNumberToObject(item, "startRateMs", camera->start_rate_ms);
+            cJSON_AddNumberToObject(item, "finalRateMs", camera->rate.rate_ms);
+            cJSON_AddNumberToObject(item, "requests", camera->requests);
+            cJSON_AddNumberToObject(item, "burstRequests", camera->burst_requests);
+            cJSON_AddNumberToObject(item, "ok", camera->ok);
+            cJSON_AddNumberToObject(item, "okPerSecond", camera->ok / seconds);
+            cJSON_AddNumberToObject(item, "busy", camera->busy);
+            cJSON_AddNumberToObject(item, "httpErrors", camera->http_errors);
+            cJSON_AddNumberToObject(item, "transportErrors", camera->transport_errors);
+            cJSON* latency = cJSON_AddObjectToObject(item, "latencyMs");
+            cJSON_AddNumberToObject(latency, "p50", camera->percentile_ms[0]);
+            cJSON_AddNumberToObject(latency, "p90", camera->percentile_ms[1]);
+            cJSON_AddNumberToObject(latency, "p99", camera->percentile_ms[2]);
+            cJSON_AddItemToArray(list, item);
+        }
+        if (have_health) {
+            cJSON* hub = cJSON_AddObjectToObject(root, "hubHealth");
+            cJSON_AddNumberToObject(hub, "totalRequests", health.total_requests);
+            cJSON_AddNumberToObject(hub, "successful", health.successful);
+            cJSON_AddNumberToObject(hub, "failed", health.failed);
+            cJSON_AddNumberToObject(hub, "avgInferenceMs", health.avg_inference_ms);
+        }
+        char* text = cJSON_Print(root);
+        FILE* file = fopen(json_path, "w");
+        if (file && text) {
+            fprintf(file, "%s\n", text);
+            fclose(file);
+        } else {
+            fprintf(stderr, "Cannot write %s\n", json_path);
+            if (file)
+                fclose(file);
+            status = 1;
+        }
+        free(text);
+        cJSON_Delete(root);
+    }
+
+    for (int c = 0; c < camera_count; c++) {
+        Hub_Cleanup(cameras[c].hub);
+        free(cameras[c].latencies);
+    }
+    for (int f = 0; f < frame_count; f++)
+        free(jpegs[f].data);
+    free(cameras);
+    free(threads);
+    fclose(report);
+    return status;
+}
@@ -0,0 +1,50 @@
+/**
+ * ACAP_host.h - Host-only additions to the ACAP stand-in
+ *
+ * ACAP_host.c implements ACAP.h without FastCGI, axevent or VAPIX: settings
+ * and status live in memory, HTTP nodes are called directly and events are
+ * counted instead of sent.
+ */
+
+#ifndef ACAP_HOST_H
+#define ACAP_HOST_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Set the directory that replaces /usr/local/packages/<app>/ for
+ * manifest.json, settings/ and localdata/. Call before ACAP().
+ * Defaults to $DETECTX_APP_PATH, or "../app/" if unset.
+ */
+void ACAP_HOST_Set_AppPath(const char* path);
+
+/**
+ * Invoke a registered HTTP node
+ *
+ * @param node Node name as passed to ACAP_HTTP_Node()
+ * @param method "GET" or "POST"
+ * @param query Query string without '?', or NULL
+ * @param contentType Content type of body, or NULL
+ * @param body Request body, or NULL
+ * @param output Receives the raw response (headers and body), caller must free. May be NULL.
+ * @param outputSize Receives the response size. May be NULL.
+ * @return 1 if the node exists, 0 otherwise
+ */
+int ACAP_HOST_HTTP_Call(const char* node, const char* method, const char* query,
+                        const char* contentType, const char* body,
+                        char** output, size_t* outputSize);
+
+/**
+ * Number of ACAP_EVENTS_Fire/Fire_State/Fire_JSON calls that changed state
+ */
+int ACAP_HOST_Events_Fired(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ACAP_HOST_H
@@ -0,0 +1,27 @@
+/**
+ * fcgi_stdio.h - Host stand-in for the FastCGI header included by ACAP.h
+ *
+ * Only the request/stream types are needed; ACAP_host.c writes responses
+ * into the in-memory stream instead of a FastCGI socket.
+ */
+
+#ifndef HOST_FCGI_STDIO_H
+#define HOST_FCGI_STDIO_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef struct FCGX_Stream {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+} FCGX_Stream;
+
+typedef struct FCGX_Request {
+    FCGX_Stream* in;
+    FCGX_Stream* out;
+    FCGX_Stream* err;
+    char** envp;
+} FCGX_Request;
+
+#endif  // HOST_FCGI_STDIO_H
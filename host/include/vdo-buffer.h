@@ -0,0 +1,14 @@
+/**
+ * vdo-buffer.h - Host stand-in for VDO buffer accessors
+ */
+
+#ifndef HOST_VDO_BUFFER_H
+#define HOST_VDO_BUFFER_H
+
+#include "vdo-types.h"
+
+gpointer  vdo_buffer_get_data(VdoBuffer* buffer);
+gsize     vdo_buffer_get_capacity(VdoBuffer* buffer);
+VdoFrame* vdo_buffer_get_frame(VdoBuffer* buffer);
+
+#endif  // HOST_VDO_BUFFER_H
@@ -0,0 +1,15 @@
+/**
+ * vdo-frame.h - Host stand-in for VDO frame accessors
+ */
+
+#ifndef HOST_VDO_FRAME_H
+#define HOST_VDO_FRAME_H
+
+#include "vdo-types.h"
+#include "vdo-buffer.h"
+
+guint64 vdo_frame_get_timestamp(VdoFrame* frame);
+gsize   vdo_frame_get_size(VdoFrame* frame);
+guint   vdo_frame_get_sequence_nbr(VdoFrame* frame);
+
+#endif  // HOST_VDO_FRAME_H
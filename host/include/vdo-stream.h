@@ -0,0 +1,15 @@
+/**
+ * vdo-stream.h - Host stand-in for the VDO stream header
+ *
+ * Streams are not available off-device; frames are wrapped from memory with
+ * vdo_host_buffer_new() instead (see vdo_host.h).
+ */
+
+#ifndef HOST_VDO_STREAM_H
+#define HOST_VDO_STREAM_H
+
+#include "vdo-types.h"
+#include "vdo-buffer.h"
+#include "vdo-frame.h"
+
+#endif  // HOST_VDO_STREAM_H
@@ -0,0 +1,29 @@
+/**
+ * vdo-types.h - Host stand-in for the Axis VDO types
+ */
+
+#ifndef HOST_VDO_TYPES_H
+#define HOST_VDO_TYPES_H
+
+#include <glib.h>
+
+typedef enum {
+    VDO_FORMAT_NONE = -1,
+    VDO_FORMAT_H264 = 0,
+    VDO_FORMAT_H265,
+    VDO_FORMAT_JPEG,
+    VDO_FORMAT_YUV,
+    VDO_FORMAT_BAYER,
+    VDO_FORMAT_IVS,
+    VDO_FORMAT_RAW,
+    VDO_FORMAT_RGBA,
+    VDO_FORMAT_RGB,
+    VDO_FORMAT_PLANAR_RGB
+} VdoFormat;
+
+typedef struct _VdoBuffer VdoBuffer;
+typedef struct _VdoFrame VdoFrame;
+typedef struct _VdoStream VdoStream;
+typedef struct _VdoMap VdoMap;
+
+#endif  // HOST_VDO_TYPES_H
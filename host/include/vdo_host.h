@@ -0,0 +1,31 @@
+/**
+ * vdo_host.h - Memory-backed VDO buffers for host builds
+ */
+
+#ifndef VDO_HOST_H
+#define VDO_HOST_H
+
+#include "vdo-types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Wrap caller-owned frame data in a VdoBuffer
+ *
+ * @param data Frame data (e.g. NV12), not copied and not freed by the buffer
+ * @param size Number of valid bytes in data
+ * @param timestamp Capture timestamp in CLOCK_MONOTONIC microseconds (0 if unknown)
+ * @param sequence Frame sequence number
+ * @return New buffer, free with vdo_host_buffer_free()
+ */
+VdoBuffer* vdo_host_buffer_new(gpointer data, gsize size, guint64 timestamp, guint sequence);
+
+void vdo_host_buffer_free(VdoBuffer* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // VDO_HOST_H
@@ -0,0 +1,654 @@
+/*
+ * mock_hub.c - Local stand-in for the DetectX Hub server
+ *
+ * A small blocking HTTP/1.1 server, one thread per connection, with
+ * keep-alive and Expect: 100-continue so that libcurl behaves as it does
+ * against the real Hub. Digest authentication follows RFC 2617 with
+ * qop="auth" and a single server nonce.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <glib.h>
+
+#include "cJSON.h"
+#include "mock_hub.h"
+
+#define LOG(fmt, args...) { printf(fmt, ## args); }
+#define LOG_WARN(fmt, args...) { fprintf(stderr, fmt, ## args); }
+
+#define MOCK_HUB_REALM          "DetectX Hub"
+#define MOCK_HUB_MAX_HEADER     16384
+#define MOCK_HUB_MAX_BODY       (32 * 1024 * 1024)
+
+static MockHubConfig config;
+static char* capabilities_body = NULL;
+static char* detections_body = NULL;
+static char nonce[33];
+static int listen_fd = -1;
+
+static atomic_uint_fast64_t stat_total;
+static atomic_uint_fast64_t stat_successful;
+static atomic_uint_fast64_t stat_failed;
+static pthread_mutex_t timing_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Inference worker pool, used when config.workers > 0 */
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static int in_flight = 0;      /* Waiting + running */
+static int running = 0;
+static double timing_sum_ms = 0, timing_min_ms = 0, timing_max_ms = 0;
+static uint64_t timing_count = 0;
+
+static const char* class_names[] = {
+    "person", "bicycle", "car", "motorcycle", "bus", "truck", "dog", "cat"
+};
+#define CLASS_COUNT (int)(sizeof(class_names) / sizeof(class_names[0]))
+
+void MockHub_Defaults(MockHubConfig* c) {
+    memset(c, 0, sizeof(*c));
+    c->latency_ms = 40;
+    c->jitter_ms = 10;
+    c->error_status = 500;
+    c->queue = 10;
+    c->detections = 3;
+    c->model_width = 640;
+    c->model_height = 640;
+    c->seed = 1;
+}
+
+const char* MockHub_Usage(void) {
+    return
+        "  --hub-port N            Listen port (default: any free port)\n"
+        "  --hub-latency MS        Inference delay (default 40)\n"
+        "  --hub-jitter MS         Uniform +/- jitter on the delay (default 10)\n"
+        "  --hub-error-rate P      Fraction of inference requests that fail, 0-1 (default 0)\n"
+        "  --hub-error-status N    HTTP status for failed requests (default 500)\n"
+        "  --hub-workers N         Concurrent inferences, 0 for unlimited (default 0)\n"
+        "  --hub-queue N           Requests waiting for a worker before 503 queue full (default 10)\n"
+        "  --hub-auth USER:PASS    Require digest authentication\n"
+        "  --hub-detections N|FILE Synthetic detections per response, or canned response JSON (default 3)\n"
+        "  --hub-model WxH         Model input size reported in capabilities (default 640x640)\n"
+        "  --hub-seed N            Seed for jitter, errors and synthetic detections (default 1)\n";
+}
+
+int MockHub_Parse_Arg(MockHubConfig* c, int argc, char* argv[], int* index) {
+    const char* option = argv[*index];
+    if (strncmp(option, "--hub-", 6) != 0)
+        return 0;
+    if (*index + 1 >= argc)
+        return -1;
+    const char* value = argv[++(*index)];
+
+    if (strcmp(option, "--hub-port") == 0)
+        c->port = atoi(value);
+    else if (strcmp(option, "--hub-latency") == 0)
+        c->latency_ms = atoi(value);
+    else if (strcmp(option, "--hub-jitter") == 0)
+        c->jitter_ms = atoi(value);
+    else if (strcmp(option, "--hub-error-rate") == 0)
+        c->error_rate = atof(value);
+    else if (strcmp(option, "--hub-error-status") == 0)
+        c->error_status = atoi(value);
+    else if (strcmp(option, "--hub-workers") == 0)
+        c->workers = atoi(value);
+    else if (strcmp(option, "--hub-queue") == 0)
+        c->queue = atoi(value);
+    else if (strcmp(option, "--hub-seed") == 0)
+        c->seed = (unsigned int)strtoul(value, NULL, 0);
+    else if (strcmp(option, "--hub-auth") == 0) {
+        const char* colon = strchr(value, ':');
+        if (!colon)
+            return -1;
+        c->username = strndup(value, colon - value);
+        c->password = colon + 1;
+    } else if (strcmp(option, "--hub-detections") == 0) {
+        char* end = NULL;
+        long count = strtol(value, &end, 10);
+        if (end && *end == 0 && count >= 0) {
+            c->detections = (int)count;
+            c->detections_file = NULL;
+        } else {
+            c->detections_file = value;
+        }
+    } else if (strcmp(option, "--hub-model") == 0) {
+        if (sscanf(value, "%dx%d", &c->model_width, &c->model_height) != 2)
+            return -1;
+    } else {
+        (*index)--;
+        return 0;
+    }
+
+    if (c->latency_ms < 0 || c->jitter_ms < 0 || c->error_rate < 0 || c->error_rate > 1 ||
+        c->workers < 0 || c->queue < 0 || c->model_width <= 0 || c->model_height <= 0)
+        return -1;
+    return 1;
+}
+
+/*-----------------------------------------------------
+ * Canned responses
+ *-----------------------------------------------------*/
+
+static char* build_capabilities(void) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "version", "mock-1.0");
+    cJSON* model = cJSON_AddObjectToObject(root, "model");
+    cJSON_AddNumberToObject(model, "input_width", config.model_width);
+    cJSON_AddNumberToObject(model, "input_height", config.model_height);
+    cJSON_AddNumberToObject(model, "channels", 3);
+    cJSON_AddNumberToObject(model, "max_queue_size", config.queue);
+    cJSON* classes = cJSON_AddArrayToObject(model, "classes");
+    for (int i = 0; i < CLASS_COUNT; i++) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "id", i);
+        cJSON_AddStringToObject(item, "name", class_names[i]);
+        cJSON_AddItemToArray(classes, item);
+    }
+    char* body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return body;
+}
+
+static char* build_detections(void) {
+    if (config.detections_file) {
+        FILE* file = fopen(config.detections_file, "r");
+        if (!file) {
+            LOG_WARN("mock_hub: cannot open %s: %s\n", config.detections_file, strerror(errno));
+            return NULL;
+        }
+        char buffer[65536];
+        size_t size = fread(buffer, 1, sizeof(buffer) - 1, file);
+        fclose(file);
+        buffer[size] = 0;
+        cJSON* json = cJSON_Parse(buffer);
+        if (!json) {
+            LOG_WARN("mock_hub: %s is not valid JSON\n", config.detections_file);
+            return NULL;
+        }
+        // Accept either a full response or a bare detections array
+        if (cJSON_IsArray(json)) {
+            cJSON* root = cJSON_CreateObject();
+            cJSON_AddItemToObject(root, "detections", json);
+            json = root;
+        }
+        char* body = cJSON_PrintUnformatted(json);
+        cJSON_Delete(json);
+        return body;
+    }
+
+    unsigned int state = config.seed;
+    cJSON* root = cJSON_CreateObject();
+    cJSON* array = cJSON_AddArrayToObject(root, "detections");
+    for (int i = 0; i < config.detections; i++) {
+        int class_id = rand_r(&state) % CLASS_COUNT;
+        double w = 0.05 + (rand_r(&state) % 1000) / 5000.0;
+        double h = 0.10 + (rand_r(&state) % 1000) / 3000.0;
+        double x = w / 2 + (rand_r(&state) % 1000) / 1000.0 * (1 - w);
+        double y = h / 2 + (rand_r(&state) % 1000) / 1000.0 * (1 - h);
+        cJSON* detection = cJSON_CreateObject();
+        cJSON_AddStringToObject(detection, "label", class_names[class_id]);
+        cJSON_AddNumberToObject(detection, "class_id", class_id);
+        cJSON_AddNumberToObject(detection, "confidence", 0.55 + (rand_r(&state) % 4000) / 10000.0);
+        cJSON* pixels = cJSON_AddObjectToObject(detection, "bbox_pixels");
+        cJSON_AddNumberToObject(pixels, "x", (int)((x - w / 2) * config.model_width));
+        cJSON_AddNumberToObject(pixels, "y", (int)((y - h / 2) * config.model_height));
+        cJSON_AddNumberToObject(pixels, "w", (int)(w * config.model_width));
+        cJSON_AddNumberToObject(pixels, "h", (int)(h * config.model_height));
+        cJSON* yolo = cJSON_AddObjectToObject(detection, "bbox_yolo");
+        cJSON_AddNumberToObject(yolo, "x", x);
+        cJSON_AddNumberToObject(yolo, "y", y);
+        cJSON_AddNumberToObject(yolo, "w", w);
+        cJSON_AddNumberToObject(yolo, "h", h);
+        cJSON_AddItemToArray(array, detection);
+    }
+    char* body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return body;
+}
+
+static char* build_health(void) {
+    pthread_mutex_lock(&timing_mutex);
+    double average = timing_count ? timing_sum_ms / timing_count : 0;
+    double min = timing_min_ms, max = timing_max_ms;
+    pthread_mutex_unlock(&timing_mutex);
+    pthread_mutex_lock(&queue_mutex);
+    int waiting = in_flight - running;
+    int full = config.workers > 0 && in_flight >= config.workers + config.queue;
+    pthread_mutex_unlock(&queue_mutex);
+
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddTrueToObject(root, "running");
+    cJSON_AddNumberToObject(root, "queue_size", waiting);
+    cJSON_AddBoolToObject(root, "queue_full", full);
+    cJSON* timing = cJSON_AddObjectToObject(root, "timing");
+    cJSON_AddNumberToObject(timing, "average_ms", average);
+    cJSON_AddNumberToObject(timing, "min_ms", min);
+    cJSON_AddNumberToObject(timing, "max_ms", max);
+    cJSON* stats = cJSON_AddObjectToObject(root, "statistics");
+    cJSON_AddNumberToObject(stats, "total_requests", (double)atomic_load(&stat_total));
+    cJSON_AddNumberToObject(stats, "successful", (double)atomic_load(&stat_successful));
+    cJSON_AddNumberToObject(stats, "failed", (double)atomic_load(&stat_failed));
+    char* body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return body;
+}
+
+static void record_timing(double ms) {
+    pthread_mutex_lock(&timing_mutex);
+    if (!timing_count || ms < timing_min_ms)
+        timing_min_ms = ms;
+    if (ms > timing_max_ms)
+        timing_max_ms = ms;
+    timing_sum_ms += ms;
+    timing_count++;
+    pthread_mutex_unlock(&timing_mutex);
+}
+
+/*-----------------------------------------------------
+ * HTTP
+ *-----------------------------------------------------*/
+
+typedef struct {
+    char method[16];
+    char uri[1024];
+    char authorization[1024];
+    size_t content_length;
+    int expect_continue;
+    int keep_alive;
+} MockRequest;
+
+static int send_all(int fd, const char* data, size_t size) {
+    while (size) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return 0;
+        data += sent;
+        size -= sent;
+    }
+    return 1;
+}
+
+static int send_response(int fd, int status, const char* reason, const char* extra_headers,
+                         const char* body, int keep_alive) {
+    char header[1024];
+    size_t length = body ? strlen(body) : 0;
+    int size = snprintf(header, sizeof(header),
+                        "HTTP/1.1 %d %s\r\n"
+                        "Content-Type: application/json\r\n"
+                        "Content-Length: %zu\r\n"
+                        "Connection: %s\r\n"
+                        "%s"
+                        "\r\n",
+                        status, reason, length, keep_alive ? "keep-alive" : "close",
+                        extra_headers ? extra_headers : "");
+    return send_all(fd, header, size) && (!length || send_all(fd, body, length));
+}
+
+// Reads the request line and headers; body bytes received with them stay in buffer
+static int read_request(int fd, char* buffer, size_t* buffered, MockRequest* request, size_t* header_size) {
+    char* end = NULL;
+    for (;;) {
+        buffer[*buffered] = 0;
+        end = strstr(buffer, "\r\n\r\n");
+        if (end)
+            break;
+        if (*buffered >= MOCK_HUB_MAX_HEADER - 1)
+            return 0;
+        ssize_t got = recv(fd, buffer + *buffered, MOCK_HUB_MAX_HEADER - 1 - *buffered, 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return 0;
+        *buffered += got;
+    }
+    *header_size = end - buffer + 4;
+
+    memset(request, 0, sizeof(*request));
+    request->keep_alive = 1;
+    if (sscanf(buffer, "%15s %1023s", request->method, request->uri) != 2)
+        return 0;
+    if (strstr(buffer, "HTTP/1.0"))
+        request->keep_alive = 0;
+
+    char* line = strstr(buffer, "\r\n");
+    while (line && line < end) {
+        line += 2;
+        char* next = strstr(line, "\r\n");
+        if (!next)
+            break;
+        *next = 0;
+        char* colon = strchr(line, ':');
+        if (colon) {
+            *colon = 0;
+            char* value = colon + 1;
+            while (*value == ' ')
+                value++;
+            if (strcasecmp(line, "Content-Length") == 0)
+                request->content_length = strtoul(value, NULL, 10);
+            else if (strcasecmp(line, "Authorization") == 0)
+                snprintf(request->authorization, sizeof(request->authorization), "%s", value);
+            else if (strcasecmp(line, "Expect") == 0)
+                request->expect_continue = strcasecmp(value, "100-continue") == 0;
+            else if (strcasecmp(line, "Connection") == 0)
+                request->keep_alive = strcasecmp(value, "close") != 0;
+            *colon = ':';
+        }
+        *next = '\r';
+        line = next;
+    }
+    return 1;
+}
+
+// Reads content_length body bytes, starting with those already buffered after the headers
+static char* read_body(int fd, char* buffer, size_t* buffered, size_t header_size, size_t content_length) {
+    char* body = malloc(content_length + 1);
+    if (!body)
+        return NULL;
+    size_t have = *buffered - header_size;
+    if (have > content_length)
+        have = content_length;
+    memcpy(body, buffer + header_size, have);
+    while (have < content_length) {
+        ssize_t got = recv(fd, body + have, content_length - have, 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0) {
+            free(body);
+            return NULL;
+        }
+        have += got;
+    }
+    body[content_length] = 0;
+
+    // Keep any pipelined bytes that followed this request
+    size_t consumed = header_size + (*buffered - header_size < content_length ? *buffered - header_size : content_length);
+    memmove(buffer, buffer + consumed, *buffered - consumed);
+    *buffered -= consumed;
+    return body;
+}
+
+static int digest_param(const char* header, const char* name, char* out, size_t size) {
+    size_t name_length = strlen(name);
+    const char* p = header;
+    while ((p = strstr(p, name)) != NULL) {
+        if ((p == header || p[-1] == ' ' || p[-1] == ',') && p[name_length] == '=') {
+            p += name_length + 1;
+            const char* end;
+            if (*p == '"') {
+                p++;
+                end = strchr(p, '"');
+            } else {
+                end = p + strcspn(p, ", ");
+            }
+            if (!end)
+                return 0;
+            size_t length = (size_t)(end - p) < size - 1 ? (size_t)(end - p) : size - 1;
+            memcpy(out, p, length);
+            out[length] = 0;
+            return 1;
+        }
+        p += name_length;
+    }
+    return 0;
+}
+
+static gchar* md5_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static gchar* md5_printf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    gchar* text = g_strdup_vprintf(fmt, args);
+    va_end(args);
+    gchar* digest = g_compute_checksum_for_string(G_CHECKSUM_MD5, text, -1);
+    g_free(text);
+    return digest;
+}
+
+static int authorized(const MockRequest* request) {
+    if (!config.username)
+        return 1;
+    if (strncasecmp(request->authorization, "Digest ", 7) != 0)
+        return 0;
+
+    const char* header = request->authorization + 7;
+    char username[128], realm[128], request_nonce[128], uri[1024], response[64];
+    char qop[32] = "", nc[16] = "", cnonce[128] = "";
+    if (!digest_param(header, "username", username, sizeof(username)) ||
+        !digest_param(header, "realm", realm, sizeof(realm)) ||
+        !digest_param(header, "nonce", request_nonce, sizeof(request_nonce)) ||
+        !digest_param(header, "uri", uri, sizeof(uri)) ||
+        !digest_param(header, "response", response, sizeof(response)))
+        return 0;
+    digest_param(header, "qop", qop, sizeof(qop));
+    digest_param(header, "nc", nc, sizeof(nc));
+    digest_param(header, "cnonce", cnonce, sizeof(cnonce));
+
+    if (strcmp(username, config.username) != 0 || strcmp(request_nonce, nonce) != 0)
+        return 0;
+
+    gchar* ha1 = md5_printf("%s:%s:%s", username, realm, config.password);
+    gchar* ha2 = md5_printf("%s:%s", request->method, uri);
+    gchar* expected = qop[0] ?
+                      md5_printf("%s:%s:%s:%s:%s:%s", ha1, request_nonce, nc, cnonce, qop, ha2) :
+                      md5_printf("%s:%s:%s", ha1, request_nonce, ha2);
+    int ok = strcasecmp(expected, response) == 0;
+    g_free(ha1);
+    g_free(ha2);
+    g_free(expected);
+    return ok;
+}
+
+static void sleep_ms(double ms) {
+    if (ms <= 0)
+        return;
+    struct timespec ts = { (time_t)(ms / 1000), (long)((ms - (time_t)(ms / 1000) * 1000) * 1000000) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+// Claim a worker, waiting in the queue if needed; returns 0 if the queue is full
+static int worker_acquire(void) {
+    if (config.workers <= 0)
+        return 1;
+    pthread_mutex_lock(&queue_mutex);
+    if (in_flight >= config.workers + config.queue) {
+        pthread_mutex_unlock(&queue_mutex);
+        return 0;
+    }
+    in_flight++;
+    while (running >= config.workers)
+        pthread_cond_wait(&queue_cond, &queue_mutex);
+    running++;
+    pthread_mutex_unlock(&queue_mutex);
+    return 1;
+}
+
+static void worker_release(void) {
+    if (config.workers <= 0)
+        return;
+    pthread_mutex_lock(&queue_mutex);
+    running--;
+    in_flight--;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void* connection_thread(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    char* buffer = malloc(MOCK_HUB_MAX_HEADER);
+    size_t buffered = 0;
+    unsigned int rng = config.seed ^ (unsigned int)fd ^ (unsigned int)(uintptr_t)pthread_self();
+    MockRequest request;
+    size_t header_size;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    while (buffer && read_request(fd, buffer, &buffered, &request, &header_size)) {
+        if (request.content_length > MOCK_HUB_MAX_BODY) {
+            send_response(fd, 413, "Payload Too Large", NULL, "{\"error\":\"Payload too large\"}", 0);
+            break;
+        }
+
+        if (!authorized(&request)) {
+            char challenge[256];
+            snprintf(challenge, sizeof(challenge),
+                     "WWW-Authenticate: Digest realm=\"%s\", qop=\"auth\", nonce=\"%s\", algorithm=MD5\r\n",
+                     MOCK_HUB_REALM, nonce);
+            // With Expect: 100-continue the client has not sent the body; closing skips it
+            int keep_alive = request.keep_alive && !(request.expect_continue && request.content_length);
+            if (keep_alive && request.content_length) {
+                char* discard = read_body(fd, buffer, &buffered, header_size, request.content_length);
+                if (!discard)
+                    break;
+                free(discard);
+            } else if (keep_alive) {
+                memmove(buffer, buffer + header_size, buffered - header_size);
+                buffered -= header_size;
+            }
+            if (!send_response(fd, 401, "Unauthorized", challenge, "{\"error\":\"Unauthorized\"}", keep_alive) || !keep_alive)
+                break;
+            continue;
+        }
+
+        if (request.expect_continue && request.content_length &&
+            !send_all(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25))
+            break;
+        char* body = read_body(fd, buffer, &buffered, header_size, request.content_length);
+        if (!body)
+            break;
+
+        int ok;
+        char path[1024];
+        snprintf(path, sizeof(path), "%s", request.uri);
+        char* query = strchr(path, '?');
+        if (query)
+            *query = 0;
+
+        if (strcmp(path, "/local/detectx/capabilities") == 0) {
+            ok = send_response(fd, 200, "OK", NULL, capabilities_body, request.keep_alive);
+        } else if (strcmp(path, "/local/detectx/health") == 0) {
+            char* health = build_health();
+            ok = send_response(fd, 200, "OK", NULL, health, request.keep_alive);
+            free(health);
+        } else if (strcmp(path, "/local/detectx/inference-jpeg") == 0 && strcmp(request.method, "POST") == 0) {
+            double start = now_ms();
+            atomic_fetch_add(&stat_total, 1);
+            int is_jpeg = request.content_length > 3 &&
+                          (unsigned char)body[0] == 0xFF && (unsigned char)body[1] == 0xD8;
+            double delay = config.latency_ms;
+            if (config.jitter_ms)
+                delay += (rand_r(&rng) % (2 * config.jitter_ms + 1)) - config.jitter_ms;
+            int admitted = worker_acquire();
+            if (admitted) {
+                sleep_ms(delay);
+                worker_release();
+            }
+            if (!admitted) {
+                atomic_fetch_add(&stat_failed, 1);
+                ok = send_response(fd, 503, "Service Unavailable", NULL, "{\"error\":\"Queue full\"}", request.keep_alive);
+            } else if (!is_jpeg) {
+                atomic_fetch_add(&stat_failed, 1);
+                ok = send_response(fd, 400, "Bad Request", NULL, "{\"error\":\"Body is not a JPEG image\"}", request.keep_alive);
+            } else if (config.error_rate > 0 && rand_r(&rng) / (RAND_MAX + 1.0) < config.error_rate) {
+                atomic_fetch_add(&stat_failed, 1);
+                ok = send_response(fd, config.error_status, "Error", NULL, "{\"error\":\"Injected failure\"}", request.keep_alive);
+            } else {
+                atomic_fetch_add(&stat_successful, 1);
+                record_timing(now_ms() - start);
+                ok = send_response(fd, 200, "OK", NULL, detections_body, request.keep_alive);
+            }
+        } else {
+            ok = send_response(fd, 404, "Not Found", NULL, "{\"error\":\"Not found\"}", request.keep_alive);
+        }
+        free(body);
+        if (!ok || !request.keep_alive)
+            break;
+    }
+
+    free(buffer);
+    close(fd);
+    return NULL;
+}
+
+static void* accept_thread(void* arg) {
+    (void)arg;
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            LOG_WARN("mock_hub: accept failed: %s\n", strerror(errno));
+            return NULL;
+        }
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, connection_thread, (void*)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+int MockHub_Start(const MockHubConfig* c) {
+    config = *c;
+    capabilities_body = build_capabilities();
+    detections_body = build_detections();
+    if (!capabilities_body || !detections_body)
+        return -1;
+    unsigned int state = config.seed * 2654435761u;
+    snprintf(nonce, sizeof(nonce), "%08x%08x%08x%08x", rand_r(&state), rand_r(&state), rand_r(&state), rand_r(&state));
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        LOG_WARN("mock_hub: socket failed: %s\n", strerror(errno));
+        return -1;
+    }
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)config.port);
+    socklen_t length = sizeof(address);
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listen_fd, 64) != 0 ||
+        getsockname(listen_fd, (struct sockaddr*)&address, &length) != 0) {
+        LOG_WARN("mock_hub: cannot listen on port %d: %s\n", config.port, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, accept_thread, NULL) != 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    pthread_detach(thread);
+    return ntohs(address.sin_port);
+}
@@ -0,0 +1,68 @@
+/**
+ * mock_hub.h - Local stand-in for the DetectX Hub server
+ *
+ * Serves /local/detectx/capabilities, /local/detectx/health and
+ * /local/detectx/inference-jpeg over loopback with configurable latency,
+ * jitter, error rate, digest authentication and canned detections. Used by
+ * the replay harness and available standalone as detectx_mock_hub.
+ */
+
+#ifndef MOCK_HUB_H
+#define MOCK_HUB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int port;                   /* 0 picks a free port */
+    int latency_ms;             /* Base inference delay */
+    int jitter_ms;              /* Uniform +/- jitter added to latency_ms */
+    double error_rate;          /* Fraction of inference requests that fail (0-1) */
+    int error_status;           /* HTTP status returned for failed requests */
+    int workers;                /* Concurrent inferences, 0 for unlimited */
+    int queue;                  /* Requests allowed to wait for a worker before 503 */
+    const char* username;       /* Digest auth user, NULL disables auth */
+    const char* password;
+    const char* detections_file;    /* Canned response body, or NULL */
+    int detections;             /* Synthetic detections per response when no file is given */
+    int model_width;
+    int model_height;
+    unsigned int seed;
+} MockHubConfig;
+
+/**
+ * Fill in defaults: ephemeral port, 40 ms latency, 10 ms jitter, no errors,
+ * unlimited workers, no auth, 3 synthetic detections, 640x640 model.
+ */
+void MockHub_Defaults(MockHubConfig* config);
+
+/**
+ * Consume one --hub-* command line option
+ *
+ * @param config Configuration to update
+ * @param argc Argument count
+ * @param argv Arguments
+ * @param index Current argument; advanced past any option value
+ * @return 1 if the option was recognized, 0 if not, -1 if its value is invalid
+ */
+int MockHub_Parse_Arg(MockHubConfig* config, int argc, char* argv[], int* index);
+
+/**
+ * Help text for the options accepted by MockHub_Parse_Arg()
+ */
+const char* MockHub_Usage(void);
+
+/**
+ * Start serving on 127.0.0.1 from a background thread
+ *
+ * @param config Configuration, copied
+ * @return Bound port, or -1 on failure
+ */
+int MockHub_Start(const MockHubConfig* config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MOCK_HUB_H
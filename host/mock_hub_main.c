@@ -0,0 +1,36 @@
+/*
+ * mock_hub_main.c - Standalone mock DetectX Hub
+ *
+ * Usage: detectx_mock_hub [--hub-port N] [--hub-latency MS] ...
+ * Point the camera or the replay harness (--hub URL) at the printed URL.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mock_hub.h"
+
+int main(int argc, char* argv[]) {
+    MockHubConfig config;
+    MockHub_Defaults(&config);
+    config.port = 8080;
+
+    for (int i = 1; i < argc; i++) {
+        if (MockHub_Parse_Arg(&config, argc, argv, &i) != 1) {
+            fprintf(stderr, "Usage: %s [options]\n%s", argv[0], MockHub_Usage());
+            return 2;
+        }
+    }
+
+    int port = MockHub_Start(&config);
+    if (port < 0)
+        return 1;
+    printf("Mock Hub listening on http://127.0.0.1:%d (latency %d+/-%d ms, error rate %.3f%s)\n",
+           port, config.latency_ms, config.jitter_ms, config.error_rate,
+           config.username ? ", digest auth" : "");
+    fflush(stdout);
+    for (;;)
+        pause();
+    return 0;
+}
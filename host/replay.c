@@ -0,0 +1,658 @@
+/*
+ * replay.c - End-to-end replay of recorded frames through the pipeline
+ *
+ * Feeds raw NV12 frames through Pipeline_Process() (Model_Inference(),
+ * Filter_Detections(), Output()) at a fixed rate, with the Hub client
+ * talking over loopback to the mock Hub. Each --config file is merged into
+ * the app settings and run in turn; the report lists sustained FPS,
+ * capture-to-output latency percentiles, CPU time and peak RSS per
+ * configuration.
+ *
+ * The mock Hub runs in a forked child process so that its CPU time and
+ * memory are not counted against the client.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <glib.h>
+
+#include "ACAP.h"
+#include "cJSON.h"
+#include "Model.h"
+#include "Output.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Pipeline.h"
+#include "Change.h"
+#include "Quality.h"
+#include "Delta.h"
+#include "Aggregate.h"
+#include "Snapshot.h"
+#include "vdo_host.h"
+#include "mock_hub.h"
+
+#define APP_PACKAGE         "detectx_client"
+#define DEFAULT_FPS         10.0
+#define DEFAULT_DURATION    30
+#define MAX_FRAMES          1000
+#define MAX_CONFIGS         32
+
+static FILE* report = NULL;
+
+typedef struct {
+    unsigned int width;
+    unsigned int height;
+    int count;
+    uint8_t** frames;
+} FrameSet;
+
+typedef struct {
+    char name[64];
+    unsigned int width;
+    unsigned int height;
+    char scale_mode[32];
+    int frames;
+    int dropped;
+    int hub_errors;
+    int skipped;                /* Frames not inferred by the change gate */
+    double seconds;
+    double fps;
+    double latency_ms[4];       /* p50, p90, p99, max */
+    double hub_p50_ms;
+    double cpu_seconds;
+    long peak_rss_kb;
+    int failed;
+} ReplayResult;
+
+/*-----------------------------------------------------
+ * Frames
+ *-----------------------------------------------------*/
+
+static size_t nv12_size(unsigned int width, unsigned int height) {
+    return (size_t)width * height * 3 / 2;
+}
+
+// Split a file of one or more concatenated NV12 frames
+static int load_frame_file(FrameSet* set, const char* path) {
+    size_t size = nv12_size(set->width, set->height);
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    while (set->count < MAX_FRAMES) {
+        uint8_t* frame = malloc(size);
+        if (!frame || fread(frame, 1, size, file) != size) {
+            free(frame);
+            break;
+        }
+        set->frames[set->count++] = frame;
+    }
+    fclose(file);
+    return 1;
+}
+
+static int compare_names(const struct dirent** a, const struct dirent** b) {
+    return strcmp((*a)->d_name, (*b)->d_name);
+}
+
+static int load_frames(FrameSet* set, const char* path) {
+    set->frames = calloc(MAX_FRAMES, sizeof(uint8_t*));
+    set->count = 0;
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Cannot access %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return load_frame_file(set, path) && set->count > 0;
+
+    struct dirent** entries = NULL;
+    int entry_count = scandir(path, &entries, NULL, compare_names);
+    for (int i = 0; i < entry_count; i++) {
+        if (entries[i]->d_name[0] != '.') {
+            char file[4096];
+            snprintf(file, sizeof(file), "%s/%s", path, entries[i]->d_name);
+            if (stat(file, &st) == 0 && S_ISREG(st.st_mode))
+                load_frame_file(set, file);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+    return set->count > 0;
+}
+
+/*
+ * Resample to the capture size the configuration asks for: center-crop to
+ * the target aspect ratio and scale nearest-neighbour, like VDO delivering a
+ * cropped stream of a different resolution.
+ */
+static uint8_t* resample_nv12(const uint8_t* src, unsigned int sw, unsigned int sh,
+                              unsigned int dw, unsigned int dh) {
+    uint8_t* dst = malloc(nv12_size(dw, dh));
+    if (!dst)
+        return NULL;
+    unsigned int cw = sw, ch = sh;
+    if ((uint64_t)sw * dh > (uint64_t)sh * dw)
+        cw = (unsigned int)((uint64_t)sh * dw / dh);
+    else
+        ch = (unsigned int)((uint64_t)sw * dh / dw);
+    unsigned int x0 = ((sw - cw) / 2) & ~1u;
+    unsigned int y0 = ((sh - ch) / 2) & ~1u;
+
+    for (unsigned int y = 0; y < dh; y++) {
+        const uint8_t* row = src + (size_t)(y0 + (uint64_t)y * ch / dh) * sw;
+        for (unsigned int x = 0; x < dw; x++)
+            dst[(size_t)y * dw + x] = row[x0 + (uint64_t)x * cw / dw];
+    }
+    const uint8_t* src_uv = src + (size_t)sw * sh;
+    uint8_t* dst_uv = dst + (size_t)dw * dh;
+    for (unsigned int y = 0; y < dh / 2; y++) {
+        const uint8_t* row = src_uv + (size_t)((y0 + (uint64_t)(2 * y) * ch / dh) / 2) * sw;
+        for (unsigned int x = 0; x < dw / 2; x++) {
+            unsigned int sx = (unsigned int)((x0 + (uint64_t)(2 * x) * cw / dw) / 2);
+            dst_uv[(size_t)y * dw + 2 * x] = row[2 * sx];
+            dst_uv[(size_t)y * dw + 2 * x + 1] = row[2 * sx + 1];
+        }
+    }
+    return dst;
+}
+
+static int frames_for_size(const FrameSet* recorded, FrameSet* out, unsigned int width, unsigned int height) {
+    out->width = width;
+    out->height = height;
+    out->count = recorded->count;
+    out->frames = calloc(recorded->count, sizeof(uint8_t*));
+    if (!out->frames)
+        return 0;
+    for (int i = 0; i < recorded->count; i++) {
+        if (width == recorded->width && height == recorded->height)
+            out->frames[i] = recorded->frames[i];
+        else
+            out->frames[i] = resample_nv12(recorded->frames[i], recorded->width, recorded->height, width, height);
+        if (!out->frames[i])
+            return 0;
+    }
+    return 1;
+}
+
+static void free_resampled(const FrameSet* recorded, FrameSet* set) {
+    for (int i = 0; i < set->count && set->frames; i++)
+        if (set->frames[i] != recorded->frames[i])
+            free(set->frames[i]);
+    free(set->frames);
+    set->frames = NULL;
+}
+
+/*-----------------------------------------------------
+ * Settings
+ *-----------------------------------------------------*/
+
+static void merge_json(cJSON* target, const cJSON* patch) {
+    const cJSON* item = NULL;
+    cJSON_ArrayForEach(item, patch) {
+        cJSON* existing = cJSON_GetObjectItem(target, item->string);
+        if (existing && cJSON_IsObject(existing) && cJSON_IsObject(item))
+            merge_json(existing, item);
+        else if (existing)
+            cJSON_ReplaceItemInObject(target, item->string, cJSON_Duplicate(item, 1));
+        else
+            cJSON_AddItemToObject(target, item->string, cJSON_Duplicate(item, 1));
+    }
+}
+
+static cJSON* read_json_file(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = malloc(size + 1);
+    size_t read = text ? fread(text, 1, size, file) : 0;
+    fclose(file);
+    if (!text)
+        return NULL;
+    text[read] = 0;
+    cJSON* json = cJSON_Parse(text);
+    free(text);
+    return json;
+}
+
+static void config_name(const char* path, char* name, size_t size) {
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(name, size, "%s", base);
+    char* dot = strrchr(name, '.');
+    if (dot && dot != name)
+        *dot = 0;
+}
+
+/*-----------------------------------------------------
+ * Measurement
+ *-----------------------------------------------------*/
+
+static double cpu_seconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// Resets the VmHWM peak so each configuration reports its own peak RSS (Linux 4.0+)
+static void reset_peak_rss(void) {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd >= 0) {
+        if (write(fd, "5", 1) < 0)
+            fprintf(stderr, "Cannot reset peak RSS: %s\n", strerror(errno));
+        close(fd);
+    }
+}
+
+static long peak_rss_kb(void) {
+    FILE* file = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = 0;
+    while (file && fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "VmHWM:", 6) == 0) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    if (file)
+        fclose(file);
+    return kb;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void sleep_until(uint64_t target_us) {
+    for (;;) {
+        // Let Output's GLib timers (event deactivation) run while waiting
+        while (g_main_context_iteration(NULL, FALSE))
+            ;
+        uint64_t now = Metrics_Now();
+        if (now >= target_us)
+            return;
+        uint64_t wait = target_us - now;
+        if (wait > 5000)
+            wait = 5000;
+        struct timespec ts = { 0, (long)wait * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*-----------------------------------------------------
+ * Replay
+ *-----------------------------------------------------*/
+
+static void run_config(const FrameSet* recorded, cJSON* settings, double fps, int duration, int count,
+                       ReplayResult* result) {
+    static int output_ready = 0;
+    ACAP_Set_Config("settings", settings);
+    Change_Settings(settings);
+    Quality_Settings(settings);
+    Delta_Settings(settings);
+    Aggregate_Settings(settings);
+
+    cJSON* model = output_ready ? Model_Reconnect() : Model_Setup();
+    if (!model) {
+        fprintf(stderr, "%s: Hub setup failed\n", result->name);
+        result->failed = 1;
+        return;
+    }
+    ACAP_Set_Config("model", model);
+    if (!output_ready) {
+        Output_init();
+        output_ready = 1;
+    }
+
+    result->width = cJSON_GetObjectItem(model, "videoWidth")->valueint;
+    result->height = cJSON_GetObjectItem(model, "videoHeight")->valueint;
+    cJSON* scale_mode = cJSON_GetObjectItem(settings, "scaleMode");
+    snprintf(result->scale_mode, sizeof(result->scale_mode), "%s",
+             cJSON_IsString(scale_mode) ? scale_mode->valuestring : "balanced");
+
+    FrameSet frames;
+    if (!frames_for_size(recorded, &frames, result->width, result->height)) {
+        fprintf(stderr, "%s: Cannot prepare %ux%u frames\n", result->name, result->width, result->height);
+        free_resampled(recorded, &frames);
+        result->failed = 1;
+        return;
+    }
+
+    int capacity = count > 0 ? count : (int)(duration * (fps > 0 ? fps : 1000)) + 16;
+    uint64_t* latencies = malloc(sizeof(uint64_t) * capacity);
+    uint64_t period = fps > 0 ? (uint64_t)(1e6 / fps) : 0;
+
+    Metrics_Reset();
+    reset_peak_rss();
+    double cpu_start = cpu_seconds();
+    uint64_t start = Metrics_Now();
+    uint64_t end = start + (uint64_t)duration * 1000000ULL;
+    uint64_t next = start;
+
+    while (latencies && result->frames < capacity) {
+        if (count > 0 ? result->frames >= count : Metrics_Now() >= end)
+            break;
+        if (period) {
+            sleep_until(next);
+            // Ticks missed while the previous frame was processed are skipped, like the capture timer
+            uint64_t now = Metrics_Now();
+            if (now >= next + period) {
+                uint64_t missed = (now - next) / period;
+                result->dropped += (int)missed;
+                next += missed * period;
+            }
+            next += period;
+        }
+
+        Trace_Frame_Begin();
+        uint64_t capture = Metrics_Now();
+        int index = result->frames % frames.count;
+        VdoBuffer* buffer = vdo_host_buffer_new(frames.frames[index], nv12_size(frames.width, frames.height),
+                                                capture, (guint)result->frames);
+        int inference_ms = Pipeline_Process(buffer, settings, model, capture);
+        Snapshot_Release();
+        vdo_host_buffer_free(buffer);
+        Trace_Frame_End();
+        if (inference_ms < 0) {
+            fprintf(stderr, "%s: Frame processing stopped (check aoi/size settings)\n", result->name);
+            result->failed = 1;
+            break;
+        }
+
+        latencies[result->frames++] = Metrics_Now() - capture;
+        const char* error = ACAP_STATUS_String("model", "error");
+        if (Pipeline_Skipped())
+            result->skipped++;
+        else if (error && error[0])
+            result->hub_errors++;
+    }
+
+    result->seconds = (Metrics_Now() - start) / 1e6;
+    result->cpu_seconds = cpu_seconds() - cpu_start;
+    result->peak_rss_kb = peak_rss_kb();
+    result->fps = result->seconds > 0 ? result->frames / result->seconds : 0;
+    result->hub_p50_ms = Metrics_Percentile(METRICS_HUB_TOTAL, 0.5) / 1000.0;
+    if (latencies && result->frames > 0) {
+        qsort(latencies, result->frames, sizeof(uint64_t), compare_u64);
+        static const double quantiles[] = { 0.50, 0.90, 0.99 };
+        for (int q = 0; q < 3; q++) {
+            int rank = (int)(quantiles[q] * result->frames + 0.5) - 1;
+            rank = rank < 0 ? 0 : rank >= result->frames ? result->frames - 1 : rank;
+            result->latency_ms[q] = latencies[rank] / 1000.0;
+        }
+        result->latency_ms[3] = latencies[result->frames - 1] / 1000.0;
+    }
+    free(latencies);
+    free_resampled(recorded, &frames);
+}
+
+static cJSON* result_to_json(const ReplayResult* r) {
+    cJSON* item = cJSON_CreateObject();
+    cJSON_AddStringToObject(item, "name", r->name);
+    cJSON_AddBoolToObject(item, "ok", !r->failed);
+    cJSON_AddNumberToObject(item, "width", r->width);
+    cJSON_AddNumberToObject(item, "height", r->height);
+    cJSON_AddStringToObject(item, "scaleMode", r->scale_mode);
+    cJSON_AddNumberToObject(item, "frames", r->frames);
+    cJSON_AddNumberToObject(item, "dropped", r->dropped);
+    cJSON_AddNumberToObject(item, "hubErrors", r->hub_errors);
+    cJSON_AddNumberToObject(item, "skipped", r->skipped);
+    cJSON_AddNumberToObject(item, "seconds", r->seconds);
+    cJSON_AddNumberToObject(item, "fps", r->fps);
+    cJSON* latency = cJSON_AddObjectToObject(item, "latencyMs");
+    cJSON_AddNumberToObject(latency, "p50", r->latency_ms[0]);
+    cJSON_AddNumberToObject(latency, "p90", r->latency_ms[1]);
+    cJSON_AddNumberToObject(latency, "p99", r->latency_ms[2]);
+    cJSON_AddNumberToObject(latency, "max", r->latency_ms[3]);
+    cJSON_AddNumberToObject(item, "hubP50Ms", r->hub_p50_ms);
+    cJSON_AddNumberToObject(item, "cpuSeconds", r->cpu_seconds);
+    cJSON_AddNumberToObject(item, "cpuPercent", r->seconds > 0 ? r->cpu_seconds / r->seconds * 100 : 0);
+    cJSON_AddNumberToObject(item, "cpuMsPerFrame", r->frames ? r->cpu_seconds * 1000 / r->frames : 0);
+    cJSON_AddNumberToObject(item, "peakRssKb", r->peak_rss_kb);
+    return item;
+}
+
+/* Runs the mock Hub in a child process; returns its port */
+static int start_mock_hub(const MockHubConfig* config, pid_t* child) {
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+    fflush(NULL);
+    *child = fork();
+    if (*child < 0)
+        return -1;
+    if (*child == 0) {
+        close(fds[0]);
+        int port = MockHub_Start(config);
+        if (write(fds[1], &port, sizeof(port)) != sizeof(port) || port < 0)
+            _exit(1);
+        close(fds[1]);
+        for (;;)
+            pause();
+    }
+    close(fds[1]);
+    int port = -1;
+    if (read(fds[0], &port, sizeof(port)) != sizeof(port))
+        port = -1;
+    close(fds[0]);
+    return port;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s --frames PATH --size WxH [options]\n"
+            "  --frames PATH           Raw NV12 file (one or more frames) or directory of such files\n"
+            "  --size WxH              Resolution of the recorded frames\n"
+            "  --fps F                 Capture rate, 0 for back-to-back (default %.0f)\n"
+            "  --duration S            Seconds per configuration (default %d)\n"
+            "  --count N               Frames per configuration instead of --duration\n"
+            "  --config FILE           Settings JSON merged into app/settings for one run (repeatable)\n"
+            "  --hub URL               Use this Hub instead of the bundled mock Hub\n"
+            "  --json FILE             Write results as JSON\n"
+            "  --verbose               Keep the application log on stdout\n"
+            "Mock Hub options:\n%s",
+            program, DEFAULT_FPS, DEFAULT_DURATION, MockHub_Usage());
+}
+
+int main(int argc, char* argv[]) {
+    const char* frames_path = NULL;
+    const char* hub_url = NULL;
+    const char* json_path = NULL;
+    const char* configs[MAX_CONFIGS];
+    int config_count = 0;
+    double fps = DEFAULT_FPS;
+    int duration = DEFAULT_DURATION;
+    int count = 0;
+    int verbose = 0;
+    FrameSet recorded = { 0 };
+    MockHubConfig hub_config;
+    MockHub_Defaults(&hub_config);
+
+    for (int i = 1; i < argc; i++) {
+        int parsed = MockHub_Parse_Arg(&hub_config, argc, argv, &i);
+        if (parsed == 1)
+            continue;
+        if (parsed < 0) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i - 1], "--frames") == 0)
+            frames_path = value;
+        else if (strcmp(argv[i - 1], "--size") == 0)
+            sscanf(value, "%ux%u", &recorded.width, &recorded.height);
+        else if (strcmp(argv[i - 1], "--fps") == 0)
+            fps = atof(value);
+        else if (strcmp(argv[i - 1], "--duration") == 0)
+            duration = atoi(value);
+        else if (strcmp(argv[i - 1], "--count") == 0)
+            count = atoi(value);
+        else if (strcmp(argv[i - 1], "--config") == 0 && config_count < MAX_CONFIGS)
+            configs[config_count++] = value;
+        else if (strcmp(argv[i - 1], "--hub") == 0)
+            hub_url = value;
+        else if (strcmp(argv[i - 1], "--json") == 0)
+            json_path = value;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!frames_path || recorded.width < 2 || recorded.height < 2 || (recorded.width | recorded.height) & 1 ||
+        fps < 0 || (duration <= 0 && count <= 0)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!load_frames(&recorded, frames_path)) {
+        fprintf(stderr, "No %ux%u NV12 frames found in %s\n", recorded.width, recorded.height, frames_path);
+        return 1;
+    }
+
+    pid_t hub_child = 0;
+    char url[256];
+    if (!hub_url) {
+        int port = start_mock_hub(&hub_config, &hub_child);
+        if (port < 0) {
+            fprintf(stderr, "Mock Hub failed to start\n");
+            return 1;
+        }
+        snprintf(url, sizeof(url), "http://127.0.0.1:%d", port);
+        hub_url = url;
+    }
+
+    // The application logs every detection on stdout; keep the report readable
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!verbose && !freopen("/dev/null", "w", stdout))
+        fprintf(stderr, "Cannot silence application log\n");
+
+    fprintf(report, "Replaying %d frame(s) of %ux%u against %s at %s\n", recorded.count,
+            recorded.width, recorded.height, hub_url, fps > 0 ? "fixed rate" : "full speed");
+
+    cJSON* base = ACAP(APP_PACKAGE, NULL);
+    if (!base) {
+        fprintf(stderr, "Cannot load app settings\n");
+        return 1;
+    }
+    base = cJSON_Duplicate(base, 1);
+    cJSON* hub = cJSON_GetObjectItem(base, "hub");
+    if (!hub)
+        hub = cJSON_AddObjectToObject(base, "hub");
+    cJSON* hub_patch = cJSON_CreateObject();
+    cJSON_AddStringToObject(hub_patch, "url", hub_url);
+    cJSON_AddStringToObject(hub_patch, "username", hub_config.username ? hub_config.username : "");
+    cJSON_AddStringToObject(hub_patch, "password", hub_config.password ? hub_config.password : "");
+    merge_json(hub, hub_patch);
+    cJSON_Delete(hub_patch);
+
+    int runs = config_count ? config_count : 1;
+    ReplayResult* results = calloc(runs, sizeof(ReplayResult));
+    int status = 0;
+
+    for (int r = 0; r < runs; r++) {
+        ReplayResult* result = &results[r];
+        cJSON* settings = cJSON_Duplicate(base, 1);
+        if (config_count) {
+            config_name(configs[r], result->name, sizeof(result->name));
+            cJSON* patch = read_json_file(configs[r]);
+            if (!patch || !cJSON_IsObject(patch)) {
+                fprintf(stderr, "Cannot read settings object from %s\n", configs[r]);
+                cJSON_Delete(patch);
+                cJSON_Delete(settings);
+                result->failed = 1;
+                status = 1;
+                continue;
+            }
+            merge_json(settings, patch);
+            cJSON_Delete(patch);
+        } else {
+            snprintf(result->name, sizeof(result->name), "default");
+        }
+
+        // settings is owned by the ACAP config store from here on
+        run_config(&recorded, settings, fps, duration, count, result);
+        if (result->failed)
+            status = 1;
+    }
+
+    fprintf(report, "\n%-20s %9s %7s %6s %6s %7s %7s %9s %9s %9s %9s %7s %8s\n",
+            "config", "capture", "frames", "drop", "errors", "skipped", "fps", "p50 ms", "p90 ms", "p99 ms", "max ms", "cpu %", "rss MB");
+    for (int r = 0; r < runs; r++) {
+        const ReplayResult* res = &results[r];
+        char capture[24];
+        snprintf(capture, sizeof(capture), "%ux%u", res->width, res->height);
+        if (res->failed && !res->frames) {
+            fprintf(report, "%-20s %9s failed\n", res->name, capture);
+            continue;
+        }
+        fprintf(report, "%-20s %9s %7d %6d %6d %7d %7.2f %9.1f %9.1f %9.1f %9.1f %7.1f %8.1f\n",
+                res->name, capture, res->frames, res->dropped, res->hub_errors, res->skipped, res->fps,
+                res->latency_ms[0], res->latency_ms[1], res->latency_ms[2], res->latency_ms[3],
+                res->seconds > 0 ? res->cpu_seconds / res->seconds * 100 : 0, res->peak_rss_kb / 1024.0);
+    }
+    fflush(report);
+
+    if (json_path) {
+        cJSON* root = cJSON_CreateObject();
+        cJSON_AddStringToObject(root, "frames", frames_path);
+        cJSON_AddNumberToObject(root, "fps", fps);
+        cJSON_AddStringToObject(root, "hub", hub_url);
+        cJSON_AddBoolToObject(root, "mockHub", hub_child != 0);
+        if (hub_child) {
+            cJSON* mock = cJSON_AddObjectToObject(root, "mockHubConfig");
+            cJSON_AddNumberToObject(mock, "latencyMs", hub_config.latency_ms);
+            cJSON_AddNumberToObject(mock, "jitterMs", hub_config.jitter_ms);
+            cJSON_AddNumberToObject(mock, "errorRate", hub_config.error_rate);
+            cJSON_AddBoolToObject(mock, "digestAuth", hub_config.username != NULL);
+        }
+        cJSON* array = cJSON_AddArrayToObject(root, "results");
+        for (int r = 0; r < runs; r++)
+            cJSON_AddItemToArray(array, result_to_json(&results[r]));
+        char* text = cJSON_Print(root);
+        FILE* file = fopen(json_path, "w");
+        if (file && text) {
+            fprintf(file, "%s\n", text);
+            fclose(file);
+        } else {
+            fprintf(stderr, "Cannot write %s\n", json_path);
+            if (file)
+                fclose(file);
+            status = 1;
+        }
+        free(text);
+        cJSON_Delete(root);
+    }
+
+    if (hub_child > 0) {
+        kill(hub_child, SIGTERM);
+        waitpid(hub_child, NULL, 0);
+    }
+    Model_Cleanup();
+    cJSON_Delete(base);
+    free(results);
+    return status;
+}
@@ -0,0 +1,917 @@
+/**
+ * test.c - Unit tests for the processing core
+ *
+ * Checks the detection filter, delta publishing, windowed aggregates, the
+ * adaptive capture rate, the log ring, the frame return ring, the letterbox
+ * inverse transform, the change gate, the quality pre-check and the MQTT
+ * queue policies and spool against fixed inputs. Runs without a Hub,
+ * broker or camera.
+ *
+ * Usage: detectx_test [--filter TEXT] [--list]
+ *
+ * The exit status is 1 if any check failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "ACAP.h"
+#include "ACAP_host.h"
+#include "cJSON.h"
+#include "Filter.h"
+#include "Delta.h"
+#include "Aggregate.h"
+#include "Pipeline.h"
+#include "Change.h"
+#include "Quality.h"
+#include "FrameRing.h"
+#include "preprocess.h"
+#include "test_mqtt.h"
+
+#define LOG_MODULE "Test"
+#include "Log.h"
+
+static const char* current_test = "";
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    checks++; \
+    if (!(cond)) { \
+        failures++; \
+        fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, current_test, #cond); \
+    } \
+} while (0)
+
+#define CHECK_NUMBER(object, name, expected) do { \
+    cJSON* _item = cJSON_GetObjectItem(object, name); \
+    checks++; \
+    if (!cJSON_IsNumber(_item) || fabs(_item->valuedouble - (expected)) > 1e-6) { \
+        failures++; \
+        fprintf(stderr, "%s:%d: %s: %s is %g, expected %g\n", __FILE__, __LINE__, current_test, \
+                name, cJSON_IsNumber(_item) ? _item->valuedouble : NAN, (double)(expected)); \
+    } \
+} while (0)
+
+static cJSON* parse(const char* json) {
+    cJSON* item = cJSON_Parse(json);
+    if (!item) {
+        fprintf(stderr, "%s: invalid test JSON: %s\n", current_test, json);
+        exit(2);
+    }
+    return item;
+}
+
+/* ---- Filter_Detections ---- */
+
+static const char* FILTER_SETTINGS =
+    "{\"aoi\":{\"x1\":100,\"y1\":100,\"x2\":900,\"y2\":900},"
+    "\"size\":{\"x1\":0,\"y1\":0,\"x2\":50,\"y2\":50},"
+    "\"confidence\":50,\"ignore\":[\"bird\"]}";
+
+static cJSON* filter(const char* detections_json, const char* settings_json, const char* model_json) {
+    cJSON* detections = parse(detections_json);
+    cJSON* settings = parse(settings_json);
+    cJSON* model = parse(model_json);
+    cJSON* result = Filter_Detections(detections, settings, model, 1234);
+    cJSON_Delete(detections);
+    cJSON_Delete(settings);
+    cJSON_Delete(model);
+    return result;
+}
+
+static const char* filter_label(cJSON* result, int index) {
+    cJSON* label = cJSON_GetObjectItem(cJSON_GetArrayItem(result, index), "label");
+    return cJSON_IsString(label) ? label->valuestring : "";
+}
+
+static void test_filter(void) {
+    const char* model = "{\"videoWidth\":1000,\"videoHeight\":1000}";
+
+    // Accepted: scaled to pixels, confidence to 0-100, timestamp added
+    cJSON* result = filter("[{\"label\":\"car\",\"c\":0.9,\"x\":0.4,\"y\":0.4,\"w\":0.1,\"h\":0.1}]",
+                           FILTER_SETTINGS, model);
+    CHECK(result && cJSON_GetArraySize(result) == 1);
+    cJSON* car = cJSON_GetArrayItem(result, 0);
+    CHECK_NUMBER(car, "x", 400);
+    CHECK_NUMBER(car, "y", 400);
+    CHECK_NUMBER(car, "w", 100);
+    CHECK_NUMBER(car, "h", 100);
+    CHECK_NUMBER(car, "c", 90);
+    CHECK_NUMBER(car, "timestamp", 1234);
+    cJSON_Delete(result);
+
+    // Scaling follows the video size
+    result = filter("[{\"label\":\"car\",\"c\":0.9,\"x\":0.4,\"y\":0.4,\"w\":0.1,\"h\":0.1}]",
+                    FILTER_SETTINGS, "{\"videoWidth\":2000,\"videoHeight\":500}");
+    CHECK(result && cJSON_GetArraySize(result) == 1);
+    CHECK_NUMBER(cJSON_GetArrayItem(result, 0), "x", 800);
+    CHECK_NUMBER(cJSON_GetArrayItem(result, 0), "y", 200);
+    cJSON_Delete(result);
+
+    // Rejected: low confidence, center outside the AOI, too small, ignored label
+    result = filter("["
+                    "{\"label\":\"car\",\"c\":0.3,\"x\":0.4,\"y\":0.4,\"w\":0.1,\"h\":0.1},"
+                    "{\"label\":\"car\",\"c\":0.9,\"x\":0.92,\"y\":0.4,\"w\":0.06,\"h\":0.1},"
+                    "{\"label\":\"car\",\"c\":0.9,\"x\":0.4,\"y\":0.02,\"w\":0.1,\"h\":0.1},"
+                    "{\"label\":\"person\",\"c\":0.9,\"x\":0.4,\"y\":0.4,\"w\":0.02,\"h\":0.2},"
+                    "{\"label\":\"bird\",\"c\":0.9,\"x\":0.4,\"y\":0.4,\"w\":0.1,\"h\":0.1},"
+                    "{\"label\":\"person\",\"c\":0.6,\"x\":0.6,\"y\":0.6,\"w\":0.1,\"h\":0.2}"
+                    "]", FILTER_SETTINGS, model);
+    CHECK(result && cJSON_GetArraySize(result) == 1);
+    CHECK(strcmp(filter_label(result, 0), "person") == 0);
+    CHECK_NUMBER(cJSON_GetArrayItem(result, 0), "c", 60);
+    cJSON_Delete(result);
+
+    // No detections
+    result = filter("[]", FILTER_SETTINGS, model);
+    CHECK(result && cJSON_GetArraySize(result) == 0);
+    cJSON_Delete(result);
+
+    // Settings without aoi or size
+    result = filter("[]", "{\"size\":{\"x1\":0,\"y1\":0,\"x2\":50,\"y2\":50}}", model);
+    CHECK(result == NULL);
+    result = filter("[]", "{\"aoi\":{\"x1\":100,\"y1\":100,\"x2\":900,\"y2\":900}}", model);
+    CHECK(result == NULL);
+}
+
+/* ---- Delta_Check ---- */
+
+static DeltaResult delta(const char* detections_json, double nowMs) {
+    cJSON* detections = parse(detections_json);
+    DeltaResult result = Delta_Check(detections, nowMs);
+    cJSON_Delete(detections);
+    return result;
+}
+
+static void delta_settings(const char* json) {
+    cJSON* settings = parse(json);
+    Delta_Settings(settings);
+    cJSON_Delete(settings);
+}
+
+static void test_delta(void) {
+    const char* one = "[{\"label\":\"car\",\"x\":100,\"y\":100,\"w\":100,\"h\":100}]";
+
+    // Disabled: every non-empty set is published
+    delta_settings("{\"delta\":{\"enabled\":false}}");
+    CHECK(!Delta_Enabled());
+    CHECK(delta("[]", 0) == DELTA_SKIP);
+    CHECK(Delta_Check(NULL, 0) == DELTA_SKIP);
+    CHECK(delta(one, 0) == DELTA_CHANGED);
+    CHECK(delta(one, 100) == DELTA_CHANGED);
+
+    // An empty scene is published at the start and repeated as a keyframe
+    delta_settings("{\"delta\":{\"enabled\":true,\"movePercent\":10,\"keyframeMs\":10000}}");
+    CHECK(Delta_Enabled());
+    CHECK(delta("[]", -20000) == DELTA_CHANGED);
+    CHECK(delta("[]", -15000) == DELTA_SKIP);
+    CHECK(delta("[]", -10000) == DELTA_KEYFRAME);
+    CHECK(delta(one, 1000) == DELTA_CHANGED);
+    CHECK(delta(one, 2000) == DELTA_SKIP);
+
+    // Within 10% of the box size is the same object; beyond it is a move
+    CHECK(delta("[{\"label\":\"car\",\"x\":105,\"y\":95,\"w\":100,\"h\":100}]", 3000) == DELTA_SKIP);
+    CHECK(delta("[{\"label\":\"car\",\"x\":115,\"y\":100,\"w\":100,\"h\":100}]", 4000) == DELTA_CHANGED);
+    CHECK(delta("[{\"label\":\"car\",\"x\":115,\"y\":100,\"w\":120,\"h\":100}]", 5000) == DELTA_CHANGED);
+    CHECK(delta("[{\"label\":\"truck\",\"x\":115,\"y\":100,\"w\":120,\"h\":100}]", 6000) == DELTA_CHANGED);
+
+    // Order does not matter; an added object does
+    const char* two = "[{\"label\":\"car\",\"x\":100,\"y\":100,\"w\":100,\"h\":100},"
+                      "{\"label\":\"car\",\"x\":500,\"y\":500,\"w\":100,\"h\":100}]";
+    const char* swapped = "[{\"label\":\"car\",\"x\":500,\"y\":500,\"w\":100,\"h\":100},"
+                          "{\"label\":\"car\",\"x\":100,\"y\":100,\"w\":100,\"h\":100}]";
+    CHECK(delta(two, 7000) == DELTA_CHANGED);
+    CHECK(delta(swapped, 8000) == DELTA_SKIP);
+
+    // Keyframe once keyframeMs passed since the last published set
+    CHECK(delta(two, 16999) == DELTA_SKIP);
+    CHECK(delta(two, 17000) == DELTA_KEYFRAME);
+    CHECK(delta(two, 18000) == DELTA_SKIP);
+
+    // The last objects leaving is published, then kept as a keyframe
+    CHECK(delta("[]", 19000) == DELTA_CHANGED);
+    CHECK(delta("[]", 20000) == DELTA_SKIP);
+    CHECK(Delta_Check(NULL, 28999) == DELTA_SKIP);
+    CHECK(Delta_Check(NULL, 29000) == DELTA_KEYFRAME);
+    CHECK(delta("[]", 30000) == DELTA_SKIP);
+
+    // Reset forgets the published set
+    CHECK(delta(one, 41000) == DELTA_CHANGED);
+    Delta_Reset();
+    CHECK(delta(one, 42000) == DELTA_CHANGED);
+
+    delta_settings("{}");
+}
+
+/* ---- Aggregate ---- */
+
+static cJSON* aggregate_get(const char* query, int* found) {
+    char* output = NULL;
+    size_t size = 0;
+    *found = 0;
+    if (!ACAP_HOST_HTTP_Call("aggregate", "GET", query, NULL, NULL, &output, &size) || !output)
+        return NULL;
+    cJSON* body = NULL;
+    if (!strstr(output, "Status: 404")) {
+        *found = 1;
+        const char* start = strstr(output, "\r\n\r\n");
+        body = start ? cJSON_Parse(start + 4) : NULL;
+    }
+    free(output);
+    return body;
+}
+
+static void aggregate_settings(const char* json) {
+    cJSON* settings = parse(json);
+    Aggregate_Settings(settings);
+    cJSON_Delete(settings);
+}
+
+static void aggregate_frame(const char* detections_json, double nowMs) {
+    cJSON* detections = parse(detections_json);
+    Aggregate_Frame(detections, nowMs);
+    cJSON_Delete(detections);
+}
+
+// Start of the window in progress, right after Aggregate_Settings()
+static double aggregate_start(void) {
+    int found = 0;
+    cJSON* current = aggregate_get("current=1", &found);
+    cJSON* start = cJSON_GetObjectItem(current, "start");
+    double value = cJSON_IsNumber(start) ? start->valuedouble : 0;
+    cJSON_Delete(current);
+    return value;
+}
+
+static cJSON* aggregate_label(cJSON* summary, const char* label) {
+    return cJSON_GetObjectItem(cJSON_GetObjectItem(summary, "labels"), label);
+}
+
+static void test_aggregate(void) {
+    int found = 0;
+    Aggregate_Init();
+
+    aggregate_settings("{\"aggregate\":{\"enabled\":false}}");
+    cJSON* summary = aggregate_get(NULL, &found);
+    CHECK(!found && !summary);
+
+    // Tumbling: one minute window, frames weighted by the time they cover
+    aggregate_settings("{\"aggregate\":{\"enabled\":true,\"mode\":\"tumbling\",\"windowSec\":60,\"mqtt\":false}}");
+    double start = aggregate_start();
+    CHECK(start > 0 && fmod(start, 60000) == 0);
+    aggregate_frame("[{\"label\":\"car\",\"id\":1},{\"label\":\"car\",\"id\":2}]", start);
+    aggregate_frame("[{\"label\":\"car\",\"id\":2}]", start + 10000);
+    aggregate_frame("[]", start + 20000);
+    aggregate_frame("[]", start + 40000);
+    aggregate_frame("[]", start + 60000);
+
+    summary = aggregate_get(NULL, &found);
+    CHECK(found && summary);
+    CHECK_NUMBER(summary, "start", start);
+    CHECK_NUMBER(summary, "end", start + 60000);
+    CHECK_NUMBER(summary, "frames", 4);
+    CHECK_NUMBER(summary, "seconds", 60);
+    cJSON* car = aggregate_label(summary, "car");
+    CHECK(car != NULL);
+    CHECK_NUMBER(car, "min", 0);
+    CHECK_NUMBER(car, "max", 2);
+    CHECK_NUMBER(car, "avg", 0.5);
+    CHECK_NUMBER(car, "detections", 3);
+    CHECK_NUMBER(car, "entries", 2);
+    CHECK_NUMBER(car, "exits", 2);
+    cJSON_Delete(summary);
+
+    // A gap longer than the window closes it; the last frame covers at most 30 s
+    aggregate_frame("[]", start + 200000);
+    summary = aggregate_get(NULL, &found);
+    CHECK_NUMBER(summary, "start", start + 60000);
+    CHECK_NUMBER(summary, "frames", 1);
+    CHECK_NUMBER(summary, "seconds", 30);
+    CHECK(aggregate_label(summary, "car") == NULL);
+    cJSON_Delete(summary);
+
+    // Sliding: 30 s window every 10 s; the car present since before the window is carried in
+    aggregate_settings("{\"aggregate\":{\"enabled\":true,\"mode\":\"sliding\",\"windowSec\":30,\"stepSec\":10,\"mqtt\":false}}");
+    start = aggregate_start();
+    CHECK(start > 0 && fmod(start, 10000) == 0);
+    for (int t = 0; t <= 40000; t += 5000)
+        aggregate_frame("[{\"label\":\"car\"}]", start + t);
+    summary = aggregate_get(NULL, &found);
+    CHECK_NUMBER(summary, "start", start + 10000);
+    CHECK_NUMBER(summary, "end", start + 40000);
+    CHECK_NUMBER(summary, "windowSec", 30);
+    CHECK_NUMBER(summary, "frames", 6);
+    CHECK_NUMBER(summary, "seconds", 30);
+    car = aggregate_label(summary, "car");
+    CHECK_NUMBER(car, "min", 1);
+    CHECK_NUMBER(car, "max", 1);
+    CHECK_NUMBER(car, "avg", 1);
+    CHECK_NUMBER(car, "detections", 6);
+    CHECK(cJSON_GetObjectItem(car, "entries") == NULL);
+    cJSON_Delete(summary);
+
+    aggregate_settings("{}");
+}
+
+/* ---- Pipeline rate ---- */
+
+static void rate_init(PipelineRate* rate, const char* json) {
+    cJSON* settings = parse(json);
+    Pipeline_Rate_Init(rate, settings);
+    cJSON_Delete(settings);
+}
+
+static void test_rate(void) {
+    PipelineRate rate;
+
+    // Additive increase of 0.25 fps per uncongested frame, down to the floor
+    rate_init(&rate, "{\"hub\":{\"captureRateMs\":1000,\"minCaptureRateMs\":100}}");
+    CHECK(rate.rate_ms == 1000);
+    Pipeline_Rate_Update(&rate, 10, 200, 50);
+    CHECK(rate.rate_ms == 800);
+    Pipeline_Rate_Update(&rate, 10, 200, 50);
+    CHECK(rate.rate_ms == 667);
+    for (int i = 0; i < 100; i++)
+        Pipeline_Rate_Update(&rate, 10, 200, 50);
+    CHECK(rate.rate_ms == 100);
+    CHECK(rate.average_ms == 10);
+
+    // 503 doubles the interval, then holds for four frames
+    Pipeline_Rate_Update(&rate, 10, 503, -1);
+    CHECK(rate.rate_ms == 200);
+    CHECK(rate.decreases == 1);
+    for (int i = 0; i < 4; i++)
+        Pipeline_Rate_Update(&rate, 10, 503, -1);
+    CHECK(rate.rate_ms == 200);
+    CHECK(rate.decreases == 1);
+    Pipeline_Rate_Update(&rate, 10, 0, -1);
+    CHECK(rate.rate_ms == 400);
+    CHECK(rate.decreases == 2);
+
+    // Decreases from /health honour the same hold
+    Pipeline_Rate_Queue(&rate, 3, 0);
+    CHECK(rate.rate_ms == 400);
+    for (int i = 0; i < 4; i++)
+        Pipeline_Rate_Update(&rate, 10, 404, -1);
+    Pipeline_Rate_Queue(&rate, 3, 0);
+    CHECK(rate.rate_ms == 500);
+    for (int i = 0; i < 4; i++)
+        Pipeline_Rate_Update(&rate, 10, 404, -1);
+    Pipeline_Rate_Queue(&rate, 0, 1);
+    CHECK(rate.rate_ms == 1000);
+    Pipeline_Rate_Queue(&rate, 0, 0);
+    CHECK(rate.rate_ms == 1000);
+
+    // A round trip well above the uncongested one eases off by 1.25
+    rate_init(&rate, "{\"hub\":{\"captureRateMs\":1000,\"minCaptureRateMs\":100}}");
+    for (int i = 0; i < 50; i++)
+        Pipeline_Rate_Update(&rate, 10, 200, 20);
+    CHECK(rate.rate_ms == 100);
+    Pipeline_Rate_Update(&rate, 10, 200, 200);
+    CHECK(rate.decreases == 1);
+    CHECK(rate.rate_ms == 125);
+
+    // Fixed rate
+    rate_init(&rate, "{\"hub\":{\"captureRateMs\":500,\"adaptiveRate\":false}}");
+    Pipeline_Rate_Update(&rate, 10, 503, -1);
+    Pipeline_Rate_Queue(&rate, 0, 1);
+    CHECK(rate.rate_ms == 500);
+    for (int i = 0; i < 10; i++)
+        Pipeline_Rate_Update(&rate, 10, 200, 10);
+    CHECK(rate.rate_ms == 500);
+
+    // Burst while active and burstHoldMs after, then the idle rate
+    rate_init(&rate, "{\"hub\":{\"captureRateMs\":1000,\"idleRateMs\":5000,\"burstHoldMs\":3000}}");
+    uint64_t now = 1000000;
+    CHECK(Pipeline_Rate_Next(&rate, 1, 0, now) == 5000);
+    CHECK(Pipeline_Rate_Next(&rate, 1, 1, now + 5000) == 1000);
+    CHECK(Pipeline_Rate_Next(&rate, 1, 0, now + 7000) == 1000);
+    CHECK(Pipeline_Rate_Next(&rate, 1, 0, now + 8000) == 5000);
+    CHECK(Pipeline_Rate_Next(&rate, 1, 1, now + 13000) == 1000);
+
+    // maxRequestsPerMinute: paced at the average after half, then wait for the oldest second
+    rate_init(&rate, "{\"hub\":{\"captureRateMs\":1000,\"maxRequestsPerMinute\":10}}");
+    for (int n = 0; n < 4; n++)
+        CHECK(Pipeline_Rate_Next(&rate, 1, 1, now + n * 1000) == 1000);
+    CHECK(Pipeline_Rate_Next(&rate, 1, 1, now + 4000) == 6000);
+    CHECK(Pipeline_Rate_Next(&rate, 0, 1, now + 5000) == 6000);
+    for (int n = 5; n < 9; n++)
+        Pipeline_Rate_Next(&rate, 1, 1, now + n * 1000);
+    CHECK(Pipeline_Rate_Next(&rate, 1, 1, now + 9000) == 51000);
+    // The first second has left the window
+    CHECK(Pipeline_Rate_Next(&rate, 0, 1, now + 60000) == 6000);
+}
+
+/* ---- Log ring ---- */
+
+#define LOG_TEST_PAD 200   /* Message length, so the drop test overruns the pipe buffer */
+
+typedef struct {
+    int pipe_fd[2];
+    int saved_stdout;
+    pthread_t reader;
+    int reading;
+    char* data;
+    size_t size;
+    size_t capacity;
+} Capture;
+
+static void* capture_reader(void* arg) {
+    Capture* capture = arg;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(capture->pipe_fd[0], chunk, sizeof(chunk))) > 0) {
+        if (capture->size + n + 1 > capture->capacity) {
+            capture->capacity = (capture->size + n + 1) * 2;
+            capture->data = realloc(capture->data, capture->capacity);
+        }
+        memcpy(capture->data + capture->size, chunk, n);
+        capture->size += n;
+        capture->data[capture->size] = 0;
+    }
+    return NULL;
+}
+
+static void capture_read(Capture* capture) {
+    if (!capture->reading)
+        capture->reading = pthread_create(&capture->reader, NULL, capture_reader, capture) == 0;
+}
+
+// Send stdout to a pipe; reading starts now or at capture_read()
+static int capture_start(Capture* capture, int read_now) {
+    memset(capture, 0, sizeof(*capture));
+    fflush(stdout);
+    if (pipe(capture->pipe_fd) != 0)
+        return 0;
+    capture->saved_stdout = dup(STDOUT_FILENO);
+    dup2(capture->pipe_fd[1], STDOUT_FILENO);
+    close(capture->pipe_fd[1]);
+    if (read_now)
+        capture_read(capture);
+    return 1;
+}
+
+static void capture_stop(Capture* capture) {
+    fflush(stdout);
+    dup2(capture->saved_stdout, STDOUT_FILENO);
+    close(capture->saved_stdout);
+    capture_read(capture);
+    if (capture->reading)
+        pthread_join(capture->reader, NULL);
+    close(capture->pipe_fd[0]);
+}
+
+static void log_messages(int first, int count) {
+    for (int i = first; i < first + count; i++)
+        LOG("seq %d %.*s\n", i, LOG_TEST_PAD, "................................................................"
+            "................................................................"
+            "................................................................"
+            "................................................................");
+}
+
+// Count the numbered messages and drop reports; 0 if they are out of order
+static int log_parse(const char* text, int* delivered, unsigned long* dropped) {
+    int last = -1;
+    *delivered = 0;
+    *dropped = 0;
+    for (const char* line = text; line && *line; ) {
+        int seq;
+        unsigned long lost;
+        if (sscanf(line, "seq %d", &seq) == 1) {
+            if (seq <= last)
+                return 0;
+            last = seq;
+            (*delivered)++;
+        } else if (sscanf(line, "Log: %lu messages dropped", &lost) == 1) {
+            *dropped += lost;
+        }
+        line = strchr(line, '\n');
+        if (line)
+            line++;
+    }
+    return 1;
+}
+
+static void test_log(void) {
+    cJSON* settings = parse("{\"log\":{\"burst\":100000}}");
+    Log_Settings(settings);
+    cJSON_Delete(settings);
+
+    Capture capture;
+    int delivered = 0;
+    unsigned long dropped = 0;
+
+    // Drained as it is written: the ring wraps four times without losing messages
+    CHECK(capture_start(&capture, 1));
+    Log_Init();
+    for (int batch = 0; batch < 32; batch++) {
+        log_messages(batch * 32, 32);
+        usleep(20000);
+    }
+    Log_Stop();
+    capture_stop(&capture);
+    CHECK(capture.data && log_parse(capture.data, &delivered, &dropped));
+    CHECK(delivered == 1024);
+    CHECK(dropped == 0);
+    free(capture.data);
+
+    // Output blocked: the ring fills, later messages are dropped and reported
+    CHECK(capture_start(&capture, 0));
+    Log_Init();
+    log_messages(0, 2000);
+    capture_read(&capture);
+    Log_Stop();
+    capture_stop(&capture);
+    CHECK(capture.data && log_parse(capture.data, &delivered, &dropped));
+    CHECK(dropped > 0);
+    CHECK(delivered >= 256);
+    CHECK(delivered + dropped == 2000);
+    free(capture.data);
+
+    settings = parse("{}");
+    Log_Settings(settings);
+    cJSON_Delete(settings);
+}
+
+/* ---- FrameRing ---- */
+
+#define RING_FRAMES 200000
+
+static void* ring_producer(void* arg) {
+    FrameRing* ring = arg;
+    for (uintptr_t i = 1; i <= RING_FRAMES; i++)
+        FrameRing_Push(ring, (void*)i);
+    return NULL;
+}
+
+static void test_ring(void) {
+    FrameRing ring;
+    FrameRing_Init(&ring);
+    CHECK(FrameRing_Pop(&ring) == NULL);
+
+    // Filled to capacity without waiting, drained in order
+    for (uintptr_t i = 1; i <= FRAME_RING_SLOTS; i++)
+        FrameRing_Push(&ring, (void*)i);
+    int ordered = 1;
+    for (uintptr_t i = 1; i <= FRAME_RING_SLOTS; i++)
+        ordered &= FrameRing_Pop(&ring) == (void*)i;
+    CHECK(ordered);
+    CHECK(FrameRing_Pop(&ring) == NULL);
+
+    // Indices keep counting across many wraps
+    ordered = 1;
+    for (uintptr_t i = 1; i <= 5 * FRAME_RING_SLOTS; i++) {
+        FrameRing_Push(&ring, (void*)i);
+        FrameRing_Push(&ring, (void*)(i + 1000));
+        ordered &= FrameRing_Pop(&ring) == (void*)i;
+        ordered &= FrameRing_Pop(&ring) == (void*)(i + 1000);
+    }
+    CHECK(ordered);
+    CHECK(FrameRing_Pop(&ring) == NULL);
+
+    // One producer and one consumer thread: nothing lost, duplicated or reordered
+    pthread_t producer;
+    CHECK(pthread_create(&producer, NULL, ring_producer, &ring) == 0);
+    uintptr_t expected = 1;
+    int in_order = 1;
+    while (expected <= RING_FRAMES) {
+        void* frame = FrameRing_Pop(&ring);
+        if (!frame) {
+            sched_yield();
+            continue;
+        }
+        in_order &= frame == (void*)expected;
+        expected++;
+    }
+    pthread_join(producer, NULL);
+    CHECK(in_order);
+    CHECK(FrameRing_Pop(&ring) == NULL);
+}
+
+/* ---- preprocess letterbox ---- */
+
+#define LB_OUT 320
+
+// First and last output row holding picture content in column x
+static void letterbox_rows(const uint8_t* out, unsigned int x, int* first, int* last) {
+    *first = -1;
+    *last = -1;
+    for (int y = 0; y < LB_OUT; y++) {
+        if (out[y * LB_OUT + x]) {
+            if (*first < 0)
+                *first = y;
+            *last = y;
+        }
+    }
+}
+
+static void test_preprocess(void) {
+    // 640x356 scales to 320x178: 142 rows of padding do not split evenly into even halves
+    const unsigned int in_w = 640, in_h = 356;
+    size_t in_size = in_w * in_h * 3 / 2;
+    uint8_t* frame = malloc(in_size);
+    memset(frame, 200, in_w * in_h);
+    memset(frame + in_w * in_h, 128, in_w * in_h / 2);
+
+    PreprocessContext* ctx = preprocess_create_cpu(in_w, in_h, VDO_FORMAT_YUV, LB_OUT, LB_OUT, VDO_FORMAT_YUV,
+                                                   SCALE_MODE_LETTERBOX);
+    CHECK(ctx != NULL);
+    if (!ctx) {
+        free(frame);
+        return;
+    }
+    CHECK(preprocess_run(ctx, frame, in_size));
+    const uint8_t* out = preprocess_get_output(ctx);
+
+    int top, bottom;
+    letterbox_rows(out, LB_OUT / 2, &top, &bottom);
+    int content = bottom - top + 1;
+    CHECK(top > 0 && top % 2 == 0);
+    CHECK(content == 178);
+    CHECK(LB_OUT - content - 2 * top == 2);  // The extra row of padding goes below
+    CHECK(out[(top - 1) * LB_OUT] == 0 && out[(bottom + 1) * LB_OUT] == 0);
+    CHECK(out[top * LB_OUT] == 200 && out[top * LB_OUT + LB_OUT - 1] == 200);
+
+    // A box exactly on the placed picture maps to the whole input frame
+    float x = 0, y = (float)top / LB_OUT, w = 1, h = (float)content / LB_OUT;
+    CHECK(preprocess_transform_detection(ctx, &x, &y, &w, &h));
+    CHECK(fabsf(x) < 1e-4f && fabsf(y) < 1e-4f && fabsf(w - 1) < 1e-4f && fabsf(h - 1) < 1e-4f);
+
+    // The middle of a box placed at the picture center stays at the center
+    x = 0.25f; w = 0.5f;
+    y = (top + content / 4.0f) / LB_OUT;
+    h = content / 2.0f / LB_OUT;
+    CHECK(preprocess_transform_detection(ctx, &x, &y, &w, &h));
+    CHECK(fabsf(x - 0.25f) < 1e-4f && fabsf(y - 0.25f) < 1e-4f && fabsf(w - 0.5f) < 1e-4f && fabsf(h - 0.5f) < 1e-4f);
+
+    // Centers in the padding are rejected
+    x = 0.4f; y = 0; w = 0.2f; h = 0.1f;
+    CHECK(!preprocess_transform_detection(ctx, &x, &y, &w, &h));
+    x = 0.4f; y = 0.95f; w = 0.2f; h = 0.05f;
+    CHECK(!preprocess_transform_detection(ctx, &x, &y, &w, &h));
+
+    preprocess_destroy(ctx);
+    free(frame);
+}
+
+/* ---- Change gate ---- */
+
+#define GATE_W 640
+#define GATE_H 360
+
+static void change_settings(const char* json) {
+    cJSON* settings = parse(json);
+    Change_Settings(settings);
+    cJSON_Delete(settings);
+}
+
+static void change_square(uint8_t* luma, unsigned int x0, unsigned int y0, unsigned int size, uint8_t value) {
+    for (unsigned int y = y0; y < y0 + size; y++)
+        memset(luma + y * GATE_W + x0, value, size);
+}
+
+static void test_change(void) {
+    static uint8_t luma[GATE_W * GATE_H];
+    const uint64_t s = 1000000;
+    unsigned int x = 0, y = 0, w = 0, h = 0;
+
+    change_settings("{\"changeGate\":{\"enabled\":false}}");
+    memset(luma, 100, sizeof(luma));
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 1 * s) == 0);
+    Change_Accept(1);
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 2 * s) == 0);
+
+    change_settings("{\"changeGate\":{\"enabled\":true,\"maxSkipMs\":10000,\"regionUpload\":true}}");
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 1 * s) == 0);  // No reference yet
+    Change_Accept(1);
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 2 * s) == 1);
+
+    // A global brightness shift is not a change
+    memset(luma, 130, sizeof(luma));
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 3 * s) == 1);
+
+    // A 40x40 object on 10x10 pixel blocks 30-33 x 15-18, padded to 8x8 blocks
+    memset(luma, 100, sizeof(luma));
+    change_square(luma, 300, 150, 40, 250);
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 4 * s) == 0);
+    CHECK(Change_Region(4 * s, &x, &y, &w, &h) == 1);
+    CHECK(x == 280 && y == 130 && w == 80 && h == 80);
+    Change_Accept(0);
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 5 * s) == 1);
+
+    // Changes over more than regionMaxPercent infer the whole frame
+    memset(luma, 100, GATE_W * GATE_H / 2);
+    change_square(luma, 0, 0, 300, 20);
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 6 * s) == 0);
+    CHECK(Change_Region(6 * s, &x, &y, &w, &h) == 0);
+
+    // maxSkipMs after the last full frame sends the whole frame
+    change_square(luma, 0, 0, 300, 100);
+    change_square(luma, 300, 150, 40, 250);
+    change_square(luma, 100, 100, 40, 250);
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 11 * s) == 0);
+    CHECK(Change_Region(11 * s, &x, &y, &w, &h) == 0);
+    Change_Accept(1);
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 12 * s) == 1);
+
+    // ... and after the reference, even for an unchanged frame
+    CHECK(Change_Static(luma, GATE_W, GATE_H, 21 * s) == 0);
+
+    // A new frame size drops the reference
+    Change_Accept(1);
+    CHECK(Change_Static(luma, GATE_W / 2, GATE_H, 22 * s) == 0);
+
+    change_settings("{}");
+}
+
+/* ---- Quality pre-check ---- */
+
+#define SAMPLE_W 320
+#define SAMPLE_H 180
+
+static void quality_settings(const char* json) {
+    cJSON* settings = parse(json);
+    Quality_Settings(settings);
+    cJSON_Delete(settings);
+}
+
+static void test_quality(void) {
+    static uint8_t luma[SAMPLE_W * SAMPLE_H];
+    QualityStats stats;
+
+    // Sharp, well exposed texture
+    uint32_t seed = 1;
+    for (size_t i = 0; i < sizeof(luma); i++) {
+        seed = seed * 1103515245 + 12345;
+        luma[i] = 40 + (seed >> 16) % 170;
+    }
+    quality_settings("{\"quality\":{\"enabled\":false}}");
+    CHECK(Quality_Check(luma, SAMPLE_W, SAMPLE_H, NULL) == QUALITY_OK);
+    quality_settings("{\"quality\":{\"enabled\":true}}");
+    CHECK(Quality_Check(luma, SAMPLE_W, SAMPLE_H, &stats) == QUALITY_OK);
+    CHECK(stats.sharpness > 1000 && stats.dark_percent == 0 && stats.bright_percent == 0 && stats.uniform_percent == 0);
+
+    // Smooth waves: contrast without edges
+    for (int y = 0; y < SAMPLE_H; y++)
+        for (int x = 0; x < SAMPLE_W; x++)
+            luma[y * SAMPLE_W + x] = (uint8_t)lround(128 + 50 * sin(x * M_PI / 32) + 50 * sin(y * M_PI / 32));
+    CHECK(Quality_Check(luma, SAMPLE_W, SAMPLE_H, &stats) == QUALITY_BLURRED);
+    CHECK(stats.sharpness < 15 && stats.uniform_percent < 80);
+    quality_settings("{\"quality\":{\"enabled\":true,\"minSharpness\":0}}");
+    CHECK(Quality_Check(luma, SAMPLE_W, SAMPLE_H, NULL) == QUALITY_OK);
+    quality_settings("{\"quality\":{\"enabled\":true}}");
+
+    memset(luma, 10, sizeof(luma));
+    CHECK(Quality_Check(luma, SAMPLE_W, SAMPLE_H, &stats) == QUALITY_DARK);
+    CHECK(stats.dark_percent == 100);
+    memset(luma, 250, sizeof(luma));
+    CHECK(Quality_Check(luma, SAMPLE_W, SAMPLE_H, NULL) == QUALITY_BRIGHT);
+    memset(luma, 128, sizeof(luma));
+    CHECK(Quality_Check(luma, SAMPLE_W, SAMPLE_H, &stats) == QUALITY_OBSTRUCTED);
+    CHECK(stats.uniform_percent == 100);
+
+    CHECK(strcmp(Quality_Name(QUALITY_BLURRED), "Blurred") == 0);
+    CHECK(strcmp(Quality_Name(QUALITY_OBSTRUCTED), "Obstructed") == 0);
+
+    quality_settings("{}");
+}
+
+/* ---- MQTT outbound queue ---- */
+
+static char mqtt_text[4096];
+
+static int mqtt_contents(const char* expected) {
+    TestMQTT_Contents(mqtt_text, sizeof(mqtt_text));
+    if (strcmp(mqtt_text, expected) == 0)
+        return 1;
+    fprintf(stderr, "%s: queue is \"%s\", expected \"%s\"\n", current_test, mqtt_text, expected);
+    return 0;
+}
+
+static void test_mqtt(void) {
+    unsigned long dropped, coalesced, spooled;
+
+    // Detection summaries keep only the latest per topic
+    TestMQTT_Queue("{}");
+    TestMQTT_Publish("detection/a", "1");
+    TestMQTT_Publish("event/e", "1");
+    TestMQTT_Publish("detection/a", "2");
+    TestMQTT_Publish("detection/b", "1");
+    CHECK(mqtt_contents("event/e=1 detection/a=2 detection/b=1"));
+    TestMQTT_Counters(&dropped, &coalesced, &spooled);
+    CHECK(dropped == 0 && coalesced == 1 && spooled == 0);
+
+    // Crops beyond maxCrops drop the oldest crop
+    TestMQTT_Queue("{\"maxCrops\":2}");
+    TestMQTT_Publish("crop/a", "1");
+    TestMQTT_Publish("status/x", "1");
+    TestMQTT_Publish("crop/a", "2");
+    TestMQTT_Publish("crop/a", "3");
+    CHECK(mqtt_contents("status/x=1 crop/a=2 crop/a=3"));
+    TestMQTT_Queue("{\"maxCrops\":0}");
+    TestMQTT_Publish("crop/a", "1");
+    CHECK(TestMQTT_Contents(mqtt_text, sizeof(mqtt_text)) == 0);
+    TestMQTT_Counters(&dropped, &coalesced, &spooled);
+    CHECK(dropped == 1);
+
+    // A full queue drops crops, then detections, then other topics, events last
+    TestMQTT_Queue("{\"maxQueued\":3}");
+    TestMQTT_Publish("event/e", "1");
+    TestMQTT_Publish("status/x", "1");
+    TestMQTT_Publish("detection/a", "1");
+    TestMQTT_Publish("crop/a", "1");
+    CHECK(mqtt_contents("event/e=1 status/x=1 detection/a=1"));
+    TestMQTT_Publish("status/x", "2");
+    CHECK(mqtt_contents("event/e=1 status/x=1 status/x=2"));
+    TestMQTT_Publish("event/e", "2");
+    TestMQTT_Publish("event/e", "3");
+    CHECK(mqtt_contents("event/e=1 event/e=2 event/e=3"));
+    TestMQTT_Publish("event/e", "4");
+    CHECK(mqtt_contents("event/e=2 event/e=3 event/e=4"));
+    TestMQTT_Counters(&dropped, &coalesced, &spooled);
+    CHECK(dropped == 5 && spooled == 0);
+
+    // With the spool, events that do not fit are replayed ahead of the queue
+    TestMQTT_Queue("{\"maxQueued\":1,\"spool\":true}");
+    TestMQTT_Publish("event/e", "1");
+    TestMQTT_Publish("event/e", "2");
+    TestMQTT_Publish("event/e", "3");
+    CHECK(mqtt_contents("event/e=3"));
+    TestMQTT_Counters(&dropped, &coalesced, &spooled);
+    CHECK(dropped == 0 && spooled == 2);
+    TestMQTT_Replay();
+    CHECK(mqtt_contents("event/e=1 event/e=2 event/e=3"));
+    TestMQTT_Replay();
+    CHECK(mqtt_contents("event/e=1 event/e=2 event/e=3"));
+
+    // spoolMaxKB bounds the spool file
+    TestMQTT_Queue("{\"maxQueued\":1,\"spool\":true,\"spoolMaxKB\":1}");
+    char payload[601];
+    memset(payload, 'p', sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = 0;
+    TestMQTT_Publish("event/e", payload);
+    TestMQTT_Publish("event/e", payload);
+    TestMQTT_Publish("event/e", payload);
+    TestMQTT_Counters(&dropped, &coalesced, &spooled);
+    CHECK(dropped == 1 && spooled == 1);
+
+    TestMQTT_Queue("{}");
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} Test;
+
+static const Test tests[] = {
+    { "filter",    test_filter },
+    { "delta",     test_delta },
+    { "aggregate", test_aggregate },
+    { "rate",      test_rate },
+    { "log",       test_log },
+    { "ring",      test_ring },
+    { "preprocess", test_preprocess },
+    { "change",    test_change },
+    { "quality",   test_quality },
+    { "mqtt",      test_mqtt },
+};
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [--filter TEXT] [--list]\n", name);
+}
+
+int main(int argc, char** argv) {
+    const char* only = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++)
+                printf("%s\n", tests[t].name);
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    int run = 0;
+    for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+        if (only && !strstr(tests[t].name, only))
+            continue;
+        current_test = tests[t].name;
+        int before = failures;
+        tests[t].run();
+        printf("%-10s %s\n", tests[t].name, failures == before ? "ok" : "FAILED");
+        run++;
+    }
+    printf("%d tests, %d checks, %d failed\n", run, checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+/**
+ * test_mqtt.c - Access to the MQTT outbound queue for the unit tests
+ *
+ * Built instead of MQTT.o into detectx_test. The spool goes to a
+ * temporary folder rather than the SD card.
+ */
+
+#define SPOOL_FOLDER "/tmp/detectx_test"
+
+#include "MQTT.c"
+
+#include "test_mqtt.h"
+
+void TestMQTT_Queue(const char* queue_json) {
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_head) {
+        QueuedMessage* msg = queue_head;
+        queue_unlink(NULL, msg);
+        free(msg);
+    }
+    queue_dropped = 0;
+    queue_coalesced = 0;
+    queue_spooled = 0;
+    spool_pending = 1;
+    unlink(SPOOL_FILE);
+    pthread_mutex_unlock(&queue_mutex);
+
+    cJSON* settings = cJSON_CreateObject();
+    cJSON_AddItemToObject(settings, "queue", cJSON_Parse(queue_json));
+    MQTTSettings = settings;
+    queue_settings();
+    MQTTSettings = NULL;
+    cJSON_Delete(settings);
+}
+
+int TestMQTT_Publish(const char* topic, const char* payload) {
+    return queue_publish(topic, payload, strlen(payload), 0, 0);
+}
+
+int TestMQTT_Contents(char* text, size_t size) {
+    size_t used = 0;
+    text[0] = 0;
+    pthread_mutex_lock(&queue_mutex);
+    for (QueuedMessage* msg = queue_head; msg; msg = msg->next) {
+        int n = snprintf(text + used, size - used, "%s%s=%s", used ? " " : "", msg->topic, msg->payload);
+        if (n < 0 || (size_t)n >= size - used)
+            break;
+        used += n;
+    }
+    int length = queue_length;
+    pthread_mutex_unlock(&queue_mutex);
+    return length;
+}
+
+void TestMQTT_Counters(unsigned long* dropped, unsigned long* coalesced, unsigned long* spooled) {
+    pthread_mutex_lock(&queue_mutex);
+    *dropped = queue_dropped;
+    *coalesced = queue_coalesced;
+    *spooled = queue_spooled;
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+void TestMQTT_Replay(void) {
+    pthread_mutex_lock(&queue_mutex);
+    spool_load();
+    pthread_mutex_unlock(&queue_mutex);
+}
@@ -0,0 +1,39 @@
+/**
+ * test_mqtt.h - Access to the MQTT outbound queue for the unit tests
+ *
+ * test_mqtt.c compiles MQTT.c itself so the tests can drive the queue and
+ * the spool without a broker. Messages are only queued; nothing is sent.
+ */
+
+#ifndef TEST_MQTT_H
+#define TEST_MQTT_H
+
+#include <stddef.h>
+
+/**
+ * Empty the queue and the spool, reset the counters and apply queue settings
+ *
+ * @param queue_json The "queue" settings object, e.g. {"maxQueued":3}
+ */
+void TestMQTT_Queue(const char* queue_json);
+
+/**
+ * Queue a message as MQTT_Publish() does once connected
+ */
+int TestMQTT_Publish(const char* topic, const char* payload);
+
+/**
+ * Queued messages in send order as "topic=payload" separated by spaces
+ *
+ * @return Number of queued messages
+ */
+int TestMQTT_Contents(char* text, size_t size);
+
+void TestMQTT_Counters(unsigned long* dropped, unsigned long* coalesced, unsigned long* spooled);
+
+/**
+ * Put spooled messages ahead of the queue, as after a reconnect
+ */
+void TestMQTT_Replay(void);
+
+#endif  // TEST_MQTT_H
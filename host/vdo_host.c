@@ -0,0 +1,61 @@
+/**
+ * vdo_host.c - Memory-backed VDO buffers for host builds
+ */
+
+#include <stdlib.h>
+
+#include "vdo-buffer.h"
+#include "vdo-frame.h"
+#include "vdo_host.h"
+
+struct _VdoFrame {
+    guint64 timestamp;
+    gsize size;
+    guint sequence;
+};
+
+struct _VdoBuffer {
+    gpointer data;
+    gsize capacity;
+    VdoFrame frame;
+};
+
+VdoBuffer* vdo_host_buffer_new(gpointer data, gsize size, guint64 timestamp, guint sequence) {
+    VdoBuffer* buffer = calloc(1, sizeof(VdoBuffer));
+    if (!buffer)
+        return NULL;
+    buffer->data = data;
+    buffer->capacity = size;
+    buffer->frame.timestamp = timestamp;
+    buffer->frame.size = size;
+    buffer->frame.sequence = sequence;
+    return buffer;
+}
+
+void vdo_host_buffer_free(VdoBuffer* buffer) {
+    free(buffer);
+}
+
+gpointer vdo_buffer_get_data(VdoBuffer* buffer) {
+    return buffer ? buffer->data : NULL;
+}
+
+gsize vdo_buffer_get_capacity(VdoBuffer* buffer) {
+    return buffer ? buffer->capacity : 0;
+}
+
+VdoFrame* vdo_buffer_get_frame(VdoBuffer* buffer) {
+    return buffer ? &buffer->frame : NULL;
+}
+
+guint64 vdo_frame_get_timestamp(VdoFrame* frame) {
+    return frame ? frame->timestamp : 0;
+}
+
+gsize vdo_frame_get_size(VdoFrame* frame) {
+    return frame ? frame->size : 0;
+}
+
+guint vdo_frame_get_sequence_nbr(VdoFrame* frame) {
+    return frame ? frame->sequence : 0;
+}